@@ -70,6 +70,34 @@ class RecordMethodChannel extends RecordPlatform {
     });
   }
 
+  @override
+  Future<void> arm(String recorderId, RecordConfig config) {
+    return _methodChannel.invokeMethod('arm', {
+      'recorderId': recorderId,
+      ...config.toMap(),
+    });
+  }
+
+  @override
+  Future<String> exportRecent(
+    String recorderId, {
+    required double seconds,
+    required AudioEncoder encoder,
+    required String path,
+  }) async {
+    final outputPath = await _methodChannel.invokeMethod<String>(
+      'exportRecent',
+      {
+        'recorderId': recorderId,
+        'seconds': seconds,
+        'encoder': encoder.name,
+        'path': path,
+      },
+    );
+
+    return outputPath ?? path;
+  }
+
   @override
   Future<Stream<Uint8List>> startStream(
     String recorderId,
@@ -128,6 +156,40 @@ class RecordMethodChannel extends RecordPlatform {
     );
   }
 
+  @override
+  Future<Meters> getMeters(String recorderId) async {
+    final result = await _methodChannel.invokeMethod<Map>(
+      'getMeters',
+      {'recorderId': recorderId},
+    );
+
+    return Meters.fromMap(result ?? const {});
+  }
+
+  @override
+  Future<Float32List> getWaveform(
+    String recorderId, {
+    required double seconds,
+    required int pixels,
+  }) async {
+    final result = await _methodChannel.invokeMethod<Float32List>(
+      'getWaveform',
+      {'recorderId': recorderId, 'seconds': seconds, 'pixels': pixels},
+    );
+
+    return result ?? Float32List(0);
+  }
+
+  @override
+  Future<Map<String, int>> getStats(String recorderId) async {
+    final result = await _methodChannel.invokeMethod<Map>(
+      'getStats',
+      {'recorderId': recorderId},
+    );
+
+    return result?.cast<String, int>() ?? const {};
+  }
+
   @override
   Future<bool> isEncoderSupported(
     String recorderId,
@@ -141,6 +203,21 @@ class RecordMethodChannel extends RecordPlatform {
     return isSupported ?? false;
   }
 
+  @override
+  Future<List<EncoderCapabilities>> getEncoderCapabilities(
+    String recorderId,
+  ) async {
+    final capabilities = await _methodChannel.invokeMethod<List<dynamic>>(
+      'getEncoderCapabilities',
+      {'recorderId': recorderId},
+    );
+
+    return capabilities
+            ?.map((c) => EncoderCapabilities.fromMap(c as Map))
+            .toList(growable: false) ??
+        [];
+  }
+
   @override
   Future<List<InputDevice>> listInputDevices(String recorderId) async {
     final devices = await _methodChannel.invokeMethod<List<dynamic>>(
@@ -154,6 +231,15 @@ class RecordMethodChannel extends RecordPlatform {
         [];
   }
 
+  @override
+  Stream<InputDeviceChange> onInputDevicesChanged() {
+    const eventChannel = EventChannel('com.llfbandit.record/devices');
+
+    return eventChannel.receiveBroadcastStream().map<InputDeviceChange>(
+          (change) => InputDeviceChange.fromMap(change as Map),
+        );
+  }
+
   @override
   Stream<RecordState> onStateChanged(String recorderId) {
     final eventChannel = EventChannel(
@@ -164,4 +250,37 @@ class RecordMethodChannel extends RecordPlatform {
           (state) => RecordState.values.firstWhere((e) => e.index == state),
         );
   }
+
+  @override
+  Stream<Uint8List> onMeterFrames(String recorderId) {
+    final eventChannel = EventChannel(
+      'com.llfbandit.record/eventsMeter/$recorderId',
+    );
+
+    return eventChannel
+        .receiveBroadcastStream()
+        .map<Uint8List>((data) => data);
+  }
+
+  @override
+  Stream<Uint8List> onRecordStream(String recorderId) {
+    final eventChannel = EventChannel(
+      'com.llfbandit.record/eventsRecord/$recorderId',
+    );
+
+    return eventChannel
+        .receiveBroadcastStream()
+        .map<Uint8List>((data) => data);
+  }
+
+  @override
+  Stream<Map<String, dynamic>> onSegmentFinalized(String recorderId) {
+    final eventChannel = EventChannel(
+      'com.llfbandit.record/eventsSegment/$recorderId',
+    );
+
+    return eventChannel
+        .receiveBroadcastStream()
+        .map<Map<String, dynamic>>((data) => Map<String, dynamic>.from(data));
+  }
 }
@@ -52,9 +52,44 @@ abstract class RecordPlatform extends PlatformInterface {
   ///
   /// When stopping the record, you must rely on stream close event to get
   /// full recorded data.
+  ///
+  /// With [AudioEncoder.pcm16bits], events carry raw PCM.
+  /// On `Windows` 10+, encoded streams are also available:
+  /// - [AudioEncoder.aacLc]: each event is a complete ADTS frame which can be
+  ///   decoded on its own.
+  /// - [AudioEncoder.opus]: Ogg Opus, one Ogg page per event, header pages
+  ///   first.
+  /// - [AudioEncoder.flac]: the first event is the FLAC stream header, then
+  ///   one FLAC frame per event.
   Future<Stream<Uint8List>> startStream(
           String recorderId, RecordConfig config);
 
+  /// Opens the input device without recording, keeping the last
+  /// [RecordConfig.preRollMs] of audio in memory.
+  ///
+  /// A following [start] on the same device, sample rate and channel count
+  /// begins the file with this audio, without the device opening delay.
+  /// Amplitude and meters are available while armed.
+  /// [stop] or [cancel] release the device.
+  Future<void> arm(String recorderId, RecordConfig config) =>
+      throw UnimplementedError('arm not implemented on the current platform.');
+
+  /// Writes the last [seconds] of captured audio to [path] with the given
+  /// [encoder], without interrupting the recording.
+  ///
+  /// Audio comes from memory, see [RecordConfig.historyMs] which also caps
+  /// the clip duration. The clip is encoded in the background.
+  ///
+  /// Returns the output path once the clip is complete.
+  Future<String> exportRecent(
+    String recorderId, {
+    required double seconds,
+    required AudioEncoder encoder,
+    required String path,
+  }) =>
+      throw UnimplementedError(
+          'exportRecent not implemented on the current platform.');
+
   /// Stops recording session and release internal recorder resource.
   ///
   /// Returns the output path.
@@ -87,9 +122,38 @@ abstract class RecordPlatform extends PlatformInterface {
   /// Always returns zeros on unsupported platforms
   Future<Amplitude> getAmplitude(String recorderId);
 
+  /// Gets per channel levels and loudness since the recording started.
+  Future<Meters> getMeters(String recorderId) => throw UnimplementedError(
+      'getMeters not implemented on the current platform.');
+
+  /// Gets an overview of the last [seconds] of audio, as [pixels] (min, max)
+  /// pairs in [-1, 1] (2 x [pixels] values, oldest first).
+  Future<Float32List> getWaveform(
+    String recorderId, {
+    required double seconds,
+    required int pixels,
+  }) =>
+      throw UnimplementedError(
+          'getWaveform not implemented on the current platform.');
+
+  /// Gets internal counters for diagnostics (buffer pools, queues, start
+  /// latency...). Names and values are platform specific.
+  Future<Map<String, int>> getStats(String recorderId) =>
+      throw UnimplementedError(
+          'getStats not implemented on the current platform.');
+
   /// Checks if the given encoder is supported on the current platform.
   Future<bool> isEncoderSupported(String recorderId, AudioEncoder encoder);
 
+  /// Lists the formats accepted by each encoder on the current platform.
+  ///
+  /// Computed once in the background and kept up to date by the platform,
+  /// calling this method is cheap.
+  Future<List<EncoderCapabilities>> getEncoderCapabilities(
+          String recorderId) =>
+      throw UnimplementedError(
+          'getEncoderCapabilities not implemented on the current platform.');
+
   /// Lists capture/input devices available on the platform.
   ///
   /// On Android and iOS, an empty list will be returned.
@@ -98,6 +162,14 @@ abstract class RecordPlatform extends PlatformInterface {
   /// accessing this method otherwise the list may return an empty list.
   Future<List<InputDevice>> listInputDevices(String recorderId);
 
+  /// Listen to capture devices being added, removed, or the default one
+  /// changing. Not tied to a recorder.
+  ///
+  /// [listInputDevices] returns the up to date list.
+  Stream<InputDeviceChange> onInputDevicesChanged() =>
+      throw UnimplementedError(
+          'onInputDevicesChanged not implemented on the current platform.');
+
   /// Listen to recorder states [RecordState].
   ///
   /// Provides pause, resume and stop states.
@@ -105,6 +177,37 @@ abstract class RecordPlatform extends PlatformInterface {
       throw UnimplementedError(
           'onStateChanged not implemented on the current platform.');
 
+  /// Listen to binary meter frames, sent every [RecordConfig.meterIntervalMs].
+  ///
+  /// Frame layout (little endian, levels as float32 dBFS/LUFS):
+  /// - uint8 version, uint8 channel count N, uint16 reserved,
+  /// - uint32 sequence, uint64 frames since start,
+  /// - float32 current & max amplitudes (as [getAmplitude]),
+  /// - float32 momentary, short term & integrated loudness (LUFS),
+  /// - N x (float32 peak, rms, true peak, max peak, max true peak,
+  ///   uint32 clip count).
+  Stream<Uint8List> onMeterFrames(String recorderId) =>
+      throw UnimplementedError(
+          'onMeterFrames not implemented on the current platform.');
+
+  /// Listen to the PCM stream sent next to the file when recording with
+  /// [RecordConfig.streamWhileRecording].
+  ///
+  /// Listen before calling [start] to get the stream from the first bytes.
+  Stream<Uint8List> onRecordStream(String recorderId) =>
+      throw UnimplementedError(
+          'onRecordStream not implemented on the current platform.');
+
+  /// Listen to segments closed while recording with
+  /// [RecordConfig.segmentMs] or [RecordConfig.segmentBytes].
+  ///
+  /// Each event is a map with `path` (String), `index` (int, from 1),
+  /// `bytes` (int, audio data written) and `error` (String) when the file
+  /// could not be finalized properly.
+  Stream<Map<String, dynamic>> onSegmentFinalized(String recorderId) =>
+      throw UnimplementedError(
+          'onSegmentFinalized not implemented on the current platform.');
+
   /// Stops the recording if needed and remove current file.
   Future<void> cancel(String recorderId);
 }
@@ -0,0 +1,63 @@
+import 'package:record_platform_interface/src/types/audio_encoder.dart';
+
+/// Formats accepted by an encoder on the current platform.
+///
+/// Empty lists mean no restriction, or that the platform can't tell.
+class EncoderCapabilities {
+  /// The encoder described.
+  final AudioEncoder encoder;
+
+  /// Whether the encoder can be used at all.
+  final bool supported;
+
+  /// Accepted sample rates, ascending.
+  final List<int> sampleRates;
+
+  /// Accepted channel counts, ascending.
+  final List<int> numChannels;
+
+  /// Accepted bit rates (bps), ascending.
+  ///
+  /// Empty when any value between [minBitRate] and [maxBitRate] is accepted.
+  final List<int> bitRates;
+
+  /// Bit rate bounds (bps), 0 when not applicable (e.g. lossless).
+  final int minBitRate;
+  final int maxBitRate;
+
+  const EncoderCapabilities({
+    required this.encoder,
+    required this.supported,
+    this.sampleRates = const [],
+    this.numChannels = const [],
+    this.bitRates = const [],
+    this.minBitRate = 0,
+    this.maxBitRate = 0,
+  });
+
+  factory EncoderCapabilities.fromMap(Map map) => EncoderCapabilities(
+        encoder: AudioEncoder.values.byName(map['encoder']),
+        supported: map['supported'] ?? false,
+        sampleRates: _intList(map['sampleRates']),
+        numChannels: _intList(map['numChannels']),
+        bitRates: _intList(map['bitRates']),
+        minBitRate: map['minBitRate'] ?? 0,
+        maxBitRate: map['maxBitRate'] ?? 0,
+      );
+
+  static List<int> _intList(dynamic values) =>
+      (values as List?)?.cast<int>().toList(growable: false) ?? const [];
+
+  @override
+  String toString() {
+    return '''
+      encoder: ${encoder.name}
+      supported: $supported
+      sampleRates: $sampleRates
+      numChannels: $numChannels
+      bitRates: $bitRates
+      minBitRate: $minBitRate
+      maxBitRate: $maxBitRate
+      ''';
+  }
+}
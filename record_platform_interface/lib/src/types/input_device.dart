@@ -38,3 +38,46 @@ class InputDevice {
   @override
   int get hashCode => id.hashCode ^ label.hashCode;
 }
+
+/// Kind of [InputDeviceChange].
+enum InputDeviceChangeType {
+  /// A capture device became available.
+  added,
+
+  /// A capture device is gone (unplugged, disabled...).
+  removed,
+
+  /// The system default capture device changed.
+  defaultChanged,
+}
+
+/// Change in the list of capture devices.
+class InputDeviceChange {
+  final InputDeviceChangeType type;
+
+  /// Device added or removed, or the new default device.
+  ///
+  /// Null when there's no default device anymore.
+  final InputDevice? device;
+
+  const InputDeviceChange({required this.type, this.device});
+
+  factory InputDeviceChange.fromMap(Map map) {
+    final String id = map['id'] ?? '';
+
+    return InputDeviceChange(
+      type: InputDeviceChangeType.values.byName(map['type']),
+      device: id.isEmpty
+          ? null
+          : InputDevice(id: id, label: map['label'] ?? ''),
+    );
+  }
+
+  @override
+  String toString() {
+    return '''
+      type: ${type.name}
+      device: $device
+      ''';
+  }
+}
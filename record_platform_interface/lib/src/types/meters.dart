@@ -0,0 +1,83 @@
+/// Levels of one channel, in dBFS.
+class ChannelMeters {
+  /// Sample peak of the last processed chunk.
+  final double peak;
+
+  /// RMS of the last processed chunk.
+  final double rms;
+
+  /// 4x oversampled peak of the last processed chunk (dBTP).
+  final double truePeak;
+
+  /// Highest [peak] since the recording started.
+  final double maxPeak;
+
+  /// Highest [truePeak] since the recording started.
+  final double maxTruePeak;
+
+  /// Samples at full scale since the recording started.
+  final int clipCount;
+
+  const ChannelMeters({
+    required this.peak,
+    required this.rms,
+    required this.truePeak,
+    required this.maxPeak,
+    required this.maxTruePeak,
+    required this.clipCount,
+  });
+
+  factory ChannelMeters.fromMap(Map map) => ChannelMeters(
+        peak: map['peak'] ?? -160.0,
+        rms: map['rms'] ?? -160.0,
+        truePeak: map['truePeak'] ?? -160.0,
+        maxPeak: map['maxPeak'] ?? -160.0,
+        maxTruePeak: map['maxTruePeak'] ?? -160.0,
+        clipCount: map['clipCount'] ?? 0,
+      );
+}
+
+/// Per channel levels and loudness (EBU R128) since the recording started.
+///
+/// Levels are floored at -160.
+class Meters {
+  final List<ChannelMeters> channels;
+
+  /// Loudness over the last 400 ms (LUFS).
+  final double momentaryLufs;
+
+  /// Loudness over the last 3 s (LUFS).
+  final double shortTermLufs;
+
+  /// Gated loudness since the recording started (LUFS).
+  final double integratedLufs;
+
+  final double maxMomentaryLufs;
+  final double maxShortTermLufs;
+
+  /// Frames (samples per channel) processed since the recording started.
+  final int frames;
+
+  const Meters({
+    required this.channels,
+    required this.momentaryLufs,
+    required this.shortTermLufs,
+    required this.integratedLufs,
+    required this.maxMomentaryLufs,
+    required this.maxShortTermLufs,
+    required this.frames,
+  });
+
+  factory Meters.fromMap(Map map) => Meters(
+        channels: (map['channels'] as List?)
+                ?.map((c) => ChannelMeters.fromMap(c as Map))
+                .toList(growable: false) ??
+            const [],
+        momentaryLufs: map['momentaryLufs'] ?? -160.0,
+        shortTermLufs: map['shortTermLufs'] ?? -160.0,
+        integratedLufs: map['integratedLufs'] ?? -160.0,
+        maxMomentaryLufs: map['maxMomentaryLufs'] ?? -160.0,
+        maxShortTermLufs: map['maxShortTermLufs'] ?? -160.0,
+        frames: map['frames'] ?? 0,
+      );
+}
@@ -20,6 +20,44 @@ import 'package:record_platform_interface/src/types/types.dart';
 ///
 /// `noiseSuppress`*: The recorder will try to negates the input noise.
 ///
+/// `streamChunkMs`*: Duration of each PCM frame delivered by the stream.
+///
+/// `streamChunkBytes`*: Size of each PCM frame delivered by the stream.
+///
+/// `meterIntervalMs`*: Interval of the binary meter frames pushed by the recorder.
+///
+/// `waveformSidecar`*: Writes a waveform overview next to the output file.
+///
+/// `checkpointMs`*: Interval of the WAV header updates while recording.
+///
+/// `checkpointBytes`*: Same as `checkpointMs`, expressed in bytes.
+///
+/// `segmentMs`*: Duration of each file when recording in segments.
+///
+/// `segmentBytes`*: Size of each file when recording in segments.
+///
+/// `retentionMs`*: Keeps only the most recent audio, reusing segment files.
+///
+/// `preRollMs`*: Audio kept in memory while armed, recorded first on start.
+///
+/// `historyMs`*: Recent audio kept in memory for clip exports.
+///
+/// `streamWhileRecording`*: Sends the PCM stream while recording to a file.
+///
+/// `opusFrameMs`*: Duration of each Opus packet.
+///
+/// `opusComplexity`*: Opus encoder complexity, from 0 to 10.
+///
+/// `opusVbr`*: Opus variable bit rate.
+///
+/// `opusDtx`*: Opus discontinuous transmission.
+///
+/// `flacCompressionLevel`*: FLAC compression level, from 0 to 8.
+///
+/// `mp4FragmentMs`*: Writes AAC in fragmented MP4, one fragment per duration.
+///
+/// `keepWarm`*: Keeps the input device opened after stop.
+///
 /// `*`: May not be considered on all platforms/formats.
 class RecordConfig {
   /// The requested output format through this given encoder.
@@ -54,6 +92,152 @@ class RecordConfig {
   /// Recording volume may be lowered by using this.
   final bool noiseSuppress;
 
+  /// Duration in milliseconds of each PCM frame emitted when streaming.
+  ///
+  /// Native side collects audio until a frame of exactly this duration is
+  /// available before sending it (e.g. 20 for Opus/ASR consumers, 100 for
+  /// lower overhead). The last frame may be shorter when recording stops.
+  ///
+  /// Defaults to 0, frames are sent as delivered by the capture device.
+  final int streamChunkMs;
+
+  /// Size in bytes of each PCM frame emitted when streaming.
+  ///
+  /// Same as [streamChunkMs] but expressed in bytes. Takes precedence over
+  /// [streamChunkMs] when both are set.
+  /// The size is aligned down to a whole number of samples for all channels.
+  ///
+  /// Defaults to 0.
+  final int streamChunkBytes;
+
+  /// Interval in milliseconds between meter frames pushed on the meter
+  /// stream (see [RecordPlatform.onMeterFrames]).
+  ///
+  /// Replaces polling [RecordPlatform.getAmplitude] at a fixed rate.
+  ///
+  /// Defaults to 0, no meter frame is sent.
+  final int meterIntervalMs;
+
+  /// Writes a min/max waveform overview next to the recorded file
+  /// (`<path>.peaks`) when the recording is stopped, so the waveform of a
+  /// long recording can be shown without decoding the audio.
+  ///
+  /// Defaults to false.
+  final bool waveformSidecar;
+
+  /// Interval in milliseconds (of recorded audio) between updates of the
+  /// WAV header sizes while recording.
+  ///
+  /// If the app is killed, the file stays readable and misses at most
+  /// this interval of audio.
+  ///
+  /// Defaults to 0, header is only written when the recording stops.
+  final int checkpointMs;
+
+  /// Same as [checkpointMs] but expressed in bytes. When both are set, the
+  /// shortest interval applies.
+  ///
+  /// Defaults to 0.
+  final int checkpointBytes;
+
+  /// Splits the recording in consecutive files of this duration in
+  /// milliseconds: `<name>_0001.<ext>`, `<name>_0002.<ext>`...
+  ///
+  /// Files are cut on exact sample boundaries, no audio is lost between
+  /// them. A segment is notified as soon as it is closed, see
+  /// [RecordPlatform.onSegmentFinalized].
+  ///
+  /// Defaults to 0, the recording is written to a single file.
+  final int segmentMs;
+
+  /// Same as [segmentMs] but expressed in bytes of audio data (estimated
+  /// from [bitRate] for compressed formats). When both are set, the
+  /// shortest segment applies.
+  ///
+  /// Defaults to 0.
+  final int segmentBytes;
+
+  /// Black box recording: only the most recent [retentionMs] of audio is
+  /// kept on disk.
+  ///
+  /// The recording is split in segments (see [segmentMs], the window is
+  /// split in 8 when not set) written in turn to a fixed set of files,
+  /// `<name>_0001.<ext>` to `<name>_000N.<ext>`. The oldest file is
+  /// overwritten in place when needed, so disk usage stays flat. Two files
+  /// more than the window are used: the one being written and the next one.
+  ///
+  /// Segment indexes reported by [RecordPlatform.onSegmentFinalized] keep
+  /// increasing, the path tells which file holds the segment.
+  ///
+  /// Defaults to 0, nothing is dropped.
+  final int retentionMs;
+
+  /// Duration in milliseconds of audio kept in memory while the recorder is
+  /// armed (see [RecordPlatform.arm]). Starting the recording then writes
+  /// these preceding moments first, with no gap with the live audio.
+  ///
+  /// Defaults to 0, arming only keeps the device open.
+  final int preRollMs;
+
+  /// Duration in milliseconds of the most recent audio kept in memory, so
+  /// clips can be exported while recording (see
+  /// [RecordPlatform.exportRecent]).
+  ///
+  /// Defaults to 0, exports are not available.
+  final int historyMs;
+
+  /// Also sends the captured audio as PCM 16 bits while recording to a file
+  /// with any encoder, from the same capture (see
+  /// [RecordPlatform.onRecordStream]). Chunks follow [streamChunkMs] and
+  /// [streamChunkBytes].
+  ///
+  /// Defaults to false.
+  final bool streamWhileRecording;
+
+  /// Duration in milliseconds of each Opus packet: 5, 10, 20, 40 or 60.
+  ///
+  /// Defaults to 20.
+  final int opusFrameMs;
+
+  /// Opus encoder complexity, from 0 (lowest CPU usage) to 10 (best
+  /// quality).
+  ///
+  /// Defaults to 5.
+  final int opusComplexity;
+
+  /// Opus variable bit rate. [bitRate] is then an average.
+  ///
+  /// Defaults to true.
+  final bool opusVbr;
+
+  /// Opus discontinuous transmission: silence is sent as tiny packets,
+  /// saving space on voice recordings.
+  ///
+  /// Defaults to false.
+  final bool opusDtx;
+
+  /// FLAC compression level, from 0 (fastest) to 8 (smallest files).
+  ///
+  /// Defaults to 5.
+  final int flacCompressionLevel;
+
+  /// Writes AAC-LC as fragmented MP4, one fragment every [mp4FragmentMs].
+  ///
+  /// The file is readable while recording and stays playable up to
+  /// the last fragment if the app crashes. 0 writes a plain MP4.
+  ///
+  /// Defaults to 0.
+  final int mp4FragmentMs;
+
+  /// Keeps the input device opened (paused) after stop.
+  ///
+  /// The next recording on the same device, sample rate and channels
+  /// starts faster (e.g. push-to-talk). The device is released when
+  /// another one is used or on dispose.
+  ///
+  /// Defaults to false.
+  final bool keepWarm;
+
   /// Android specific configuration.
   final AndroidRecordConfig androidConfig;
 
@@ -69,6 +253,25 @@ class RecordConfig {
     this.autoGain = false,
     this.echoCancel = false,
     this.noiseSuppress = false,
+    this.streamChunkMs = 0,
+    this.streamChunkBytes = 0,
+    this.meterIntervalMs = 0,
+    this.waveformSidecar = false,
+    this.checkpointMs = 0,
+    this.checkpointBytes = 0,
+    this.segmentMs = 0,
+    this.segmentBytes = 0,
+    this.retentionMs = 0,
+    this.preRollMs = 0,
+    this.historyMs = 0,
+    this.streamWhileRecording = false,
+    this.opusFrameMs = 20,
+    this.opusComplexity = 5,
+    this.opusVbr = true,
+    this.opusDtx = false,
+    this.flacCompressionLevel = 5,
+    this.mp4FragmentMs = 0,
+    this.keepWarm = false,
     this.androidConfig = const AndroidRecordConfig(),
     this.iosConfig = const IosRecordConfig(),
   });
@@ -83,6 +286,25 @@ class RecordConfig {
       'autoGain': autoGain,
       'echoCancel': echoCancel,
       'noiseSuppress': noiseSuppress,
+      'streamChunkMs': streamChunkMs,
+      'streamChunkBytes': streamChunkBytes,
+      'meterIntervalMs': meterIntervalMs,
+      'waveformSidecar': waveformSidecar,
+      'checkpointMs': checkpointMs,
+      'checkpointBytes': checkpointBytes,
+      'segmentMs': segmentMs,
+      'segmentBytes': segmentBytes,
+      'retentionMs': retentionMs,
+      'preRollMs': preRollMs,
+      'historyMs': historyMs,
+      'streamWhileRecording': streamWhileRecording,
+      'opusFrameMs': opusFrameMs,
+      'opusComplexity': opusComplexity,
+      'opusVbr': opusVbr,
+      'opusDtx': opusDtx,
+      'flacCompressionLevel': flacCompressionLevel,
+      'mp4FragmentMs': mp4FragmentMs,
+      'keepWarm': keepWarm,
       'androidConfig': androidConfig.toMap(),
       'iosConfig': iosConfig.toMap(),
     };
@@ -0,0 +1,395 @@
+#define NOMINMAX
+#include "aac_stream_encoder.h"
+#include "file_output.h"
+#include "utils.h"
+
+#include <cstring>
+
+namespace record_windows
+{
+    // Bit rates accepted by the Microsoft AAC encoder, in bytes per second
+    static const UINT32 kAacBytesPerSecond[] = { 12000, 16000, 20000, 24000 };
+
+    static const UINT32 kAdtsSampleRates[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+    };
+
+    static UINT32 SnapAacBytesPerSecond(UINT32 bitRate)
+    {
+        UINT32 wanted = bitRate / 8;
+        UINT32 best = kAacBytesPerSecond[0];
+
+        for (UINT32 bytes : kAacBytesPerSecond)
+        {
+            if (bytes <= wanted) best = bytes;
+        }
+        return best;
+    }
+
+    bool AacStreamEncoder::WriteAdtsHeader(uint8_t header[7], UINT32 sampleRate, UINT32 numChannels, size_t payloadSize)
+    {
+        int rateIndex = -1;
+        for (int i = 0; i < (int)(sizeof(kAdtsSampleRates) / sizeof(kAdtsSampleRates[0])); i++)
+        {
+            if (kAdtsSampleRates[i] == sampleRate) rateIndex = i;
+        }
+
+        size_t frameLength = payloadSize + 7;
+        if (rateIndex < 0 || numChannels == 0 || numChannels > 7 || frameLength > 0x1FFF)
+        {
+            return false;
+        }
+
+        const uint32_t profile = 1; // AAC-LC object type - 1
+
+        header[0] = 0xFF;
+        header[1] = 0xF1; // MPEG-4, layer 0, no CRC
+        header[2] = (uint8_t)((profile << 6) | (rateIndex << 2) | (numChannels >> 2));
+        header[3] = (uint8_t)(((numChannels & 3) << 6) | (frameLength >> 11));
+        header[4] = (uint8_t)((frameLength >> 3) & 0xFF);
+        header[5] = (uint8_t)(((frameLength & 7) << 5) | 0x1F); // buffer fullness 0x7FF (VBR)
+        header[6] = 0xFC;
+        return true;
+    }
+
+    AacStreamEncoder::AacStreamEncoder(IMFTransform* pTransform, const StreamEncoderConfig& config, PacketCallback onPacket, bool adts)
+        : m_pTransform(pTransform),
+        m_config(config),
+        m_onPacket(std::move(onPacket)),
+        m_adts(adts)
+    {
+    }
+
+    AacStreamEncoder::~AacStreamEncoder()
+    {
+        SafeRelease(m_pOutSample);
+        SafeRelease(m_pTransform);
+    }
+
+    HRESULT AacStreamEncoder::Create(const StreamEncoderConfig& config, PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder, bool adts)
+    {
+        MFT_REGISTER_TYPE_INFO inInfo = { MFMediaType_Audio, MFAudioFormat_PCM };
+        MFT_REGISTER_TYPE_INFO outInfo = { MFMediaType_Audio, MFAudioFormat_AAC };
+        IMFActivate** ppActivate = NULL;
+        UINT32 count = 0;
+        IMFTransform* pTransform = NULL;
+
+        HRESULT hr = MFTEnumEx(MFT_CATEGORY_AUDIO_ENCODER,
+            MFT_ENUM_FLAG_SYNCMFT | MFT_ENUM_FLAG_LOCALMFT | MFT_ENUM_FLAG_SORTANDFILTER,
+            &inInfo, &outInfo, &ppActivate, &count
+        );
+
+        if (SUCCEEDED(hr) && count == 0)
+        {
+            hr = MF_E_TOPO_CODEC_NOT_FOUND;
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = ppActivate[0]->ActivateObject(IID_PPV_ARGS(&pTransform));
+        }
+
+        for (UINT32 i = 0; i < count; i++)
+        {
+            ppActivate[i]->Release();
+        }
+        CoTaskMemFree(ppActivate);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        std::unique_ptr<AacStreamEncoder> aacEncoder(new AacStreamEncoder(pTransform, config, std::move(onPacket), adts));
+
+        hr = aacEncoder->Init();
+
+        if (SUCCEEDED(hr))
+        {
+            encoder = std::move(aacEncoder);
+        }
+
+        return hr;
+    }
+
+    HRESULT AacStreamEncoder::Init()
+    {
+        IMFMediaType* pTypeOut = NULL;
+        IMFMediaType* pTypeIn = NULL;
+        UINT32 blockAlign = m_config.numChannels * 2;
+
+        // Encoder output type must be set first
+        HRESULT hr = MFCreateMediaType(&pTypeOut);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_AAC);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, m_config.sampleRate);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetUINT32(MF_MT_AUDIO_NUM_CHANNELS, m_config.numChannels);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeOut->SetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, SnapAacBytesPerSecond(m_config.bitRate));
+        }
+        if (SUCCEEDED(hr))
+        {
+            // Raw access units, ADTS headers (if any) are ours
+            hr = pTypeOut->SetUINT32(MF_MT_AAC_PAYLOAD_TYPE, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->SetOutputType(0, pTypeOut, 0);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = MFCreateMediaType(&pTypeIn);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_PCM);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, m_config.sampleRate);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetUINT32(MF_MT_AUDIO_NUM_CHANNELS, m_config.numChannels);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetUINT32(MF_MT_AUDIO_BLOCK_ALIGNMENT, blockAlign);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pTypeIn->SetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, blockAlign * m_config.sampleRate);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->SetInputType(0, pTypeIn, 0);
+        }
+
+        // One output sample for the whole stream when the MFT allows it
+        MFT_OUTPUT_STREAM_INFO info = {};
+
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->GetOutputStreamInfo(0, &info);
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_providesSamples = (info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES)) != 0;
+
+            if (!m_providesSamples)
+            {
+                IMFMediaBuffer* pBuffer = NULL;
+                hr = MFCreateSample(&m_pOutSample);
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = MFCreateMemoryBuffer(info.cbSize > 0 ? info.cbSize : 8192, &pBuffer);
+                }
+                if (SUCCEEDED(hr))
+                {
+                    hr = m_pOutSample->AddBuffer(pBuffer);
+                }
+                SafeRelease(pBuffer);
+            }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0);
+        }
+
+        SafeRelease(pTypeIn);
+        SafeRelease(pTypeOut);
+
+        return hr;
+    }
+
+    HRESULT AacStreamEncoder::Encode(const BYTE* data, DWORD size)
+    {
+        if (m_drained || size == 0)
+        {
+            return S_OK;
+        }
+
+        UINT32 blockAlign = m_config.numChannels * 2;
+        uint64_t frames = size / blockAlign;
+        IMFSample* pSample = NULL;
+
+        HRESULT hr = CreatePcmSample(data, size, &pSample);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->SetSampleTime((LONGLONG)(m_frames * 10000000ULL / m_config.sampleRate));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->SetSampleDuration((LONGLONG)(frames * 10000000ULL / m_config.sampleRate));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->ProcessInput(0, pSample, 0);
+
+            // Pending output must be collected first
+            if (hr == MF_E_NOTACCEPTING)
+            {
+                hr = ProcessOutputs();
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = m_pTransform->ProcessInput(0, pSample, 0);
+                }
+            }
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_frames += frames;
+            hr = ProcessOutputs();
+        }
+
+        SafeRelease(pSample);
+
+        return hr;
+    }
+
+    HRESULT AacStreamEncoder::Drain()
+    {
+        if (m_drained)
+        {
+            return S_OK;
+        }
+        m_drained = true;
+
+        HRESULT hr = m_pTransform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, 0);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pTransform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = ProcessOutputs();
+        }
+
+        return hr;
+    }
+
+    HRESULT AacStreamEncoder::ProcessOutputs()
+    {
+        HRESULT hr = S_OK;
+
+        while (SUCCEEDED(hr))
+        {
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            DWORD status = 0;
+
+            if (!m_providesSamples)
+            {
+                IMFMediaBuffer* pBuffer = NULL;
+                hr = m_pOutSample->GetBufferByIndex(0, &pBuffer);
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = pBuffer->SetCurrentLength(0);
+                }
+                SafeRelease(pBuffer);
+
+                output.pSample = m_pOutSample;
+            }
+
+            if (SUCCEEDED(hr))
+            {
+                hr = m_pTransform->ProcessOutput(0, 1, &output, &status);
+            }
+
+            SafeRelease(output.pEvents);
+
+            if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT)
+            {
+                hr = S_OK;
+                break;
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = SendPacket(output.pSample);
+            }
+
+            if (m_providesSamples)
+            {
+                SafeRelease(output.pSample);
+            }
+        }
+
+        return hr;
+    }
+
+    HRESULT AacStreamEncoder::SendPacket(IMFSample* pSample)
+    {
+        IMFMediaBuffer* pBuffer = NULL;
+        BYTE* pData = NULL;
+        DWORD size = 0;
+
+        HRESULT hr = pSample->ConvertToContiguousBuffer(&pBuffer);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pBuffer->Lock(&pData, NULL, &size);
+        }
+        if (SUCCEEDED(hr))
+        {
+            if (size > 0 && !m_adts)
+            {
+                m_onPacket(pData, size);
+            }
+            else if (size > 0)
+            {
+                m_packet.resize(7 + size);
+
+                if (WriteAdtsHeader(m_packet.data(), m_config.sampleRate, m_config.numChannels, size))
+                {
+                    std::memcpy(m_packet.data() + 7, pData, size);
+                    m_onPacket(m_packet.data(), m_packet.size());
+                }
+                else
+                {
+                    hr = MF_E_INVALIDMEDIATYPE;
+                }
+            }
+
+            pBuffer->Unlock();
+        }
+
+        SafeRelease(pBuffer);
+
+        return hr;
+    }
+}
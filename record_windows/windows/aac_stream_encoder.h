@@ -0,0 +1,53 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+#include <mfidl.h>
+#include <mfapi.h>
+#include <mferror.h>
+#include <mftransform.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "stream_encoder.h"
+
+namespace record_windows
+{
+    // AAC-LC through the Media Foundation encoder MFT, without sink writer.
+    //
+    // The encoder outputs raw access units, each one is sent with its
+    // ADTS header, or as is without adts (e.g. for an MP4 muxer).
+    class AacStreamEncoder : public StreamEncoder
+    {
+    public:
+        static HRESULT Create(const StreamEncoderConfig& config, PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder, bool adts = true);
+
+        ~AacStreamEncoder() override;
+
+        HRESULT Encode(const BYTE* data, DWORD size) override;
+        HRESULT Drain() override;
+
+        // Writes the 7 bytes header (no CRC) of an ADTS frame holding
+        // payloadSize bytes. False if the format can't be described.
+        static bool WriteAdtsHeader(uint8_t header[7], UINT32 sampleRate, UINT32 numChannels, size_t payloadSize);
+
+    private:
+        AacStreamEncoder(IMFTransform* pTransform, const StreamEncoderConfig& config, PacketCallback onPacket, bool adts);
+
+        HRESULT Init();
+        HRESULT ProcessOutputs();
+        HRESULT SendPacket(IMFSample* pSample);
+
+        IMFTransform* m_pTransform;
+        IMFSample* m_pOutSample = NULL;     // reused, unless the MFT provides its own
+        bool m_providesSamples = false;
+
+        StreamEncoderConfig m_config;
+        PacketCallback m_onPacket;
+        bool m_adts;
+        std::vector<uint8_t> m_packet;      // ADTS header + payload
+        uint64_t m_frames = 0;
+        bool m_drained = false;
+    };
+}
@@ -0,0 +1,283 @@
+#include "amplitude_kernel.h"
+#include "cpu_features.h"
+
+#if RECORD_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace record_windows
+{
+    namespace amplitude_detail
+    {
+        AmplitudeStats Pcm16Scalar(const int16_t* samples, size_t count)
+        {
+            int peak = 0;
+            uint64_t sum = 0;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                int v = samples[i];
+                int a = v < 0 ? -v : v;
+                if (a > peak) peak = a;
+                sum += (uint64_t)(v * v);
+            }
+
+            AmplitudeStats stats;
+            stats.peak = peak / 32768.0f;
+            stats.sumSquares = (double)sum / (32768.0 * 32768.0);
+            stats.count = count;
+            return stats;
+        }
+
+        AmplitudeStats Float32Scalar(const float* samples, size_t count)
+        {
+            float peak = 0.0f;
+            double sum = 0.0;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                float v = samples[i];
+                float a = std::fabs(v);
+                if (a > peak) peak = a;
+                sum += (double)v * v;
+            }
+
+            AmplitudeStats stats;
+            stats.peak = peak;
+            stats.sumSquares = sum;
+            stats.count = count;
+            return stats;
+        }
+
+#if RECORD_X86
+        // 8 samples per iteration.
+        AmplitudeStats Pcm16Sse2(const int16_t* samples, size_t count)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            // No unsigned 16 bits max before SSE4.1: values are biased by
+            // 0x8000 so that the signed max orders them as unsigned.
+            const __m128i bias = _mm_set1_epi16((short)0x8000);
+            __m128i peak = bias;
+            __m128i sumLo = zero; // 2 x uint64
+            __m128i sumHi = zero;
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+
+                // |v| wrapping, -32768 gives 0x8000 which is 32768 unsigned,
+                // as the scalar and AVX2 kernels
+                __m128i sign = _mm_srai_epi16(v, 15);
+                __m128i a = _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+                peak = _mm_max_epi16(peak, _mm_xor_si128(a, bias));
+
+                // v*v pairwise summed; fits in uint32 (max 2^31)
+                __m128i sq = _mm_madd_epi16(v, v);
+                sumLo = _mm_add_epi64(sumLo, _mm_unpacklo_epi32(sq, zero));
+                sumHi = _mm_add_epi64(sumHi, _mm_unpackhi_epi32(sq, zero));
+            }
+
+            alignas(16) uint16_t peaks[8];
+            alignas(16) uint64_t sums[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(peaks), _mm_xor_si128(peak, bias));
+            _mm_store_si128(reinterpret_cast<__m128i*>(sums), sumLo);
+            _mm_store_si128(reinterpret_cast<__m128i*>(sums + 2), sumHi);
+
+            int maxPeak = 0;
+            for (int k = 0; k < 8; k++) if (peaks[k] > maxPeak) maxPeak = peaks[k];
+            uint64_t sum = sums[0] + sums[1] + sums[2] + sums[3];
+
+            // Tail
+            for (; i < count; i++)
+            {
+                int v = samples[i];
+                int a = v < 0 ? -v : v;
+                if (a > maxPeak) maxPeak = a;
+                sum += (uint64_t)(v * v);
+            }
+
+            AmplitudeStats stats;
+            stats.peak = maxPeak / 32768.0f;
+            stats.sumSquares = (double)sum / (32768.0 * 32768.0);
+            stats.count = count;
+            return stats;
+        }
+
+        // 16 samples per iteration.
+        RECORD_TARGET_AVX2
+        AmplitudeStats Pcm16Avx2(const int16_t* samples, size_t count)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i peak = zero;
+            __m256i sumLo = zero; // 4 x uint64
+            __m256i sumHi = zero;
+
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+
+                // abs(-32768) is 0x8000, which is 32768 when compared unsigned
+                __m256i a = _mm256_abs_epi16(v);
+                peak = _mm256_max_epu16(peak, a);
+
+                __m256i sq = _mm256_madd_epi16(v, v);
+                sumLo = _mm256_add_epi64(sumLo, _mm256_unpacklo_epi32(sq, zero));
+                sumHi = _mm256_add_epi64(sumHi, _mm256_unpackhi_epi32(sq, zero));
+            }
+
+            alignas(32) uint16_t peaks[16];
+            alignas(32) uint64_t sums[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(peaks), peak);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sumLo);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums + 4), sumHi);
+
+            int maxPeak = 0;
+            for (int k = 0; k < 16; k++) if (peaks[k] > maxPeak) maxPeak = peaks[k];
+            uint64_t sum = 0;
+            for (int k = 0; k < 8; k++) sum += sums[k];
+
+            for (; i < count; i++)
+            {
+                int v = samples[i];
+                int a = v < 0 ? -v : v;
+                if (a > maxPeak) maxPeak = a;
+                sum += (uint64_t)(v * v);
+            }
+
+            AmplitudeStats stats;
+            stats.peak = maxPeak / 32768.0f;
+            stats.sumSquares = (double)sum / (32768.0 * 32768.0);
+            stats.count = count;
+            return stats;
+        }
+
+        // 4 samples per iteration, energy accumulated in double.
+        AmplitudeStats Float32Sse2(const float* samples, size_t count)
+        {
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            __m128 peak = _mm_setzero_ps();
+            __m128d sumLo = _mm_setzero_pd();
+            __m128d sumHi = _mm_setzero_pd();
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 v = _mm_loadu_ps(samples + i);
+                peak = _mm_max_ps(peak, _mm_and_ps(v, absMask));
+
+                __m128d lo = _mm_cvtps_pd(v);
+                __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+                sumLo = _mm_add_pd(sumLo, _mm_mul_pd(lo, lo));
+                sumHi = _mm_add_pd(sumHi, _mm_mul_pd(hi, hi));
+            }
+
+            alignas(16) float peaks[4];
+            alignas(16) double sums[4];
+            _mm_store_ps(peaks, peak);
+            _mm_store_pd(sums, sumLo);
+            _mm_store_pd(sums + 2, sumHi);
+
+            float maxPeak = 0.0f;
+            for (int k = 0; k < 4; k++) if (peaks[k] > maxPeak) maxPeak = peaks[k];
+            double sum = sums[0] + sums[1] + sums[2] + sums[3];
+
+            for (; i < count; i++)
+            {
+                float a = std::fabs(samples[i]);
+                if (a > maxPeak) maxPeak = a;
+                sum += (double)samples[i] * samples[i];
+            }
+
+            AmplitudeStats stats;
+            stats.peak = maxPeak;
+            stats.sumSquares = sum;
+            stats.count = count;
+            return stats;
+        }
+
+        // 8 samples per iteration, energy accumulated in double.
+        RECORD_TARGET_AVX2
+        AmplitudeStats Float32Avx2(const float* samples, size_t count)
+        {
+            const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            __m256 peak = _mm256_setzero_ps();
+            __m256d sumLo = _mm256_setzero_pd();
+            __m256d sumHi = _mm256_setzero_pd();
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 v = _mm256_loadu_ps(samples + i);
+                peak = _mm256_max_ps(peak, _mm256_and_ps(v, absMask));
+
+                __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+                __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+                sumLo = _mm256_add_pd(sumLo, _mm256_mul_pd(lo, lo));
+                sumHi = _mm256_add_pd(sumHi, _mm256_mul_pd(hi, hi));
+            }
+
+            alignas(32) float peaks[8];
+            alignas(32) double sums[8];
+            _mm256_store_ps(peaks, peak);
+            _mm256_store_pd(sums, sumLo);
+            _mm256_store_pd(sums + 4, sumHi);
+
+            float maxPeak = 0.0f;
+            for (int k = 0; k < 8; k++) if (peaks[k] > maxPeak) maxPeak = peaks[k];
+            double sum = 0.0;
+            for (int k = 0; k < 8; k++) sum += sums[k];
+
+            for (; i < count; i++)
+            {
+                float a = std::fabs(samples[i]);
+                if (a > maxPeak) maxPeak = a;
+                sum += (double)samples[i] * samples[i];
+            }
+
+            AmplitudeStats stats;
+            stats.peak = maxPeak;
+            stats.sumSquares = sum;
+            stats.count = count;
+            return stats;
+        }
+#endif
+
+        using Pcm16Fn = AmplitudeStats(*)(const int16_t*, size_t);
+        using Float32Fn = AmplitudeStats(*)(const float*, size_t);
+
+        static Pcm16Fn SelectPcm16()
+        {
+#if RECORD_X86
+            const auto& cpu = GetCpuFeatures();
+            if (cpu.avx2) return &Pcm16Avx2;
+            if (cpu.sse2) return &Pcm16Sse2;
+#endif
+            return &Pcm16Scalar;
+        }
+
+        static Float32Fn SelectFloat32()
+        {
+#if RECORD_X86
+            const auto& cpu = GetCpuFeatures();
+            if (cpu.avx2) return &Float32Avx2;
+            if (cpu.sse2) return &Float32Sse2;
+#endif
+            return &Float32Scalar;
+        }
+
+        AmplitudeStats Pcm16Dispatch(const int16_t* samples, size_t count)
+        {
+            static const Pcm16Fn fn = SelectPcm16();
+            return fn(samples, count);
+        }
+
+        AmplitudeStats Float32Dispatch(const float* samples, size_t count)
+        {
+            static const Float32Fn fn = SelectFloat32();
+            return fn(samples, count);
+        }
+    }
+}
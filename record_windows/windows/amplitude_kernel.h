@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace record_windows
+{
+    // Peak and energy of a block of interleaved samples, normalized to [-1, 1].
+    struct AmplitudeStats
+    {
+        float peak = 0.0f;          // max absolute sample value
+        double sumSquares = 0.0;    // sum of squared normalized samples
+        size_t count = 0;           // number of samples (all channels)
+
+        double Rms() const { return count ? std::sqrt(sumSquares / (double)count) : 0.0; }
+
+        void Merge(const AmplitudeStats& other)
+        {
+            if (other.peak > peak) peak = other.peak;
+            sumSquares += other.sumSquares;
+            count += other.count;
+        }
+    };
+
+    // Converts a linear [0, 1] value to dBFS, floored at -160 dB.
+    inline double ToDbfs(double value)
+    {
+        return value > 1e-8 ? 20.0 * std::log10(value) : -160.0;
+    }
+
+    // Sample format traits.
+    struct Pcm8Format
+    {
+        using Sample = uint8_t; // unsigned, centered on 128
+        static float Normalize(Sample s) { return ((int)s - 128) / 128.0f; }
+    };
+
+    struct Pcm16Format
+    {
+        using Sample = int16_t;
+        static float Normalize(Sample s) { return s / 32768.0f; }
+    };
+
+    struct Pcm32Format
+    {
+        using Sample = int32_t;
+        static float Normalize(Sample s) { return (float)(s / 2147483648.0); }
+    };
+
+    struct Float32Format
+    {
+        using Sample = float;
+        static float Normalize(Sample s) { return s; }
+    };
+
+    namespace amplitude_detail
+    {
+        AmplitudeStats Pcm16Scalar(const int16_t* samples, size_t count);
+        AmplitudeStats Float32Scalar(const float* samples, size_t count);
+
+#if RECORD_X86
+        // Callers must check GetCpuFeatures() first, use the Dispatch variants.
+        AmplitudeStats Pcm16Sse2(const int16_t* samples, size_t count);
+        AmplitudeStats Float32Sse2(const float* samples, size_t count);
+        RECORD_TARGET_AVX2 AmplitudeStats Pcm16Avx2(const int16_t* samples, size_t count);
+        RECORD_TARGET_AVX2 AmplitudeStats Float32Avx2(const float* samples, size_t count);
+#endif
+
+        // Best available implementation for the running CPU (SSE2/AVX2/scalar).
+        AmplitudeStats Pcm16Dispatch(const int16_t* samples, size_t count);
+        AmplitudeStats Float32Dispatch(const float* samples, size_t count);
+
+        template <typename Format>
+        AmplitudeStats Scalar(const uint8_t* data, size_t count)
+        {
+            using Sample = typename Format::Sample;
+
+            AmplitudeStats stats;
+            for (size_t i = 0; i < count; i++)
+            {
+                Sample s;
+                std::memcpy(&s, data + i * sizeof(Sample), sizeof(Sample));
+
+                float v = Format::Normalize(s);
+                float a = std::fabs(v);
+                if (a > stats.peak) stats.peak = a;
+                stats.sumSquares += (double)v * v;
+            }
+            stats.count = count;
+            return stats;
+        }
+    }
+
+    // Computes peak and energy directly on a (locked) buffer of interleaved
+    // samples. No allocation. Trailing bytes of an incomplete sample are ignored.
+    template <typename Format>
+    AmplitudeStats ComputeAmplitude(const uint8_t* data, size_t bytes)
+    {
+        return amplitude_detail::Scalar<Format>(data, bytes / sizeof(typename Format::Sample));
+    }
+
+    template <>
+    inline AmplitudeStats ComputeAmplitude<Pcm16Format>(const uint8_t* data, size_t bytes)
+    {
+        size_t count = bytes / sizeof(int16_t);
+        if (reinterpret_cast<uintptr_t>(data) % alignof(int16_t) != 0)
+        {
+            return amplitude_detail::Scalar<Pcm16Format>(data, count);
+        }
+        return amplitude_detail::Pcm16Dispatch(reinterpret_cast<const int16_t*>(data), count);
+    }
+
+    template <>
+    inline AmplitudeStats ComputeAmplitude<Float32Format>(const uint8_t* data, size_t bytes)
+    {
+        size_t count = bytes / sizeof(float);
+        if (reinterpret_cast<uintptr_t>(data) % alignof(float) != 0)
+        {
+            return amplitude_detail::Scalar<Float32Format>(data, count);
+        }
+        return amplitude_detail::Float32Dispatch(reinterpret_cast<const float*>(data), count);
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mpsc_queue.h"
+
+namespace record_windows
+{
+    class BufferPool;
+
+    // Byte buffer borrowed from a BufferPool.
+    //
+    // Move-only. The storage goes back to the pool when the buffer is
+    // destroyed, so a dropped task cannot leak pool occupancy.
+    class PooledBuffer
+    {
+    public:
+        PooledBuffer() = default;
+        PooledBuffer(std::shared_ptr<BufferPool> pool, std::vector<uint8_t>&& data)
+            : m_pool(std::move(pool)), m_data(std::move(data))
+        {
+        }
+
+        PooledBuffer(PooledBuffer&&) noexcept = default;
+        PooledBuffer& operator=(PooledBuffer&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Recycle();
+                m_pool = std::move(other.m_pool);
+                m_data = std::move(other.m_data);
+            }
+            return *this;
+        }
+
+        PooledBuffer(const PooledBuffer&) = delete;
+        PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+        ~PooledBuffer() { Recycle(); }
+
+        std::vector<uint8_t>& Data() { return m_data; }
+        const std::vector<uint8_t>& Data() const { return m_data; }
+        size_t Size() const { return m_data.size(); }
+        bool Empty() const { return m_data.empty(); }
+
+        // Lends the storage (e.g. to build an EncodableValue without copy).
+        // Give it back with Restore() to keep it in the pool.
+        std::vector<uint8_t> Lend() { return std::move(m_data); }
+        void Restore(std::vector<uint8_t>&& data) { m_data = std::move(data); }
+
+    private:
+        inline void Recycle();
+
+        std::shared_ptr<BufferPool> m_pool;
+        std::vector<uint8_t> m_data;
+    };
+
+    // Recycled byte buffers for the stream path.
+    //
+    // Buffers are taken on the capture side, moved through the dispatch
+    // queue and the event channel, then returned to the pool so steady state
+    // streaming does not touch the heap.
+    //
+    // Acquire() must be called from one thread at a time (capture or
+    // pipeline thread), buffers may be released from any thread.
+    class BufferPool : public std::enable_shared_from_this<BufferPool>
+    {
+    public:
+        struct Stats
+        {
+            uint64_t allocations;   // buffers created or grown
+            uint64_t reuses;        // buffers served from the free list
+            uint64_t discarded;     // buffers freed because the free list was full
+            int64_t inUse;          // buffers currently handed out
+            int64_t available;      // buffers waiting in the free list
+        };
+
+        static std::shared_ptr<BufferPool> Create(size_t maxFree = 64)
+        {
+            return std::shared_ptr<BufferPool>(new BufferPool(maxFree));
+        }
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        // Returns an empty buffer with at least the given capacity.
+        PooledBuffer Acquire(size_t capacity)
+        {
+            std::vector<uint8_t> data;
+
+            if (m_free.TryPop(data))
+            {
+                m_available.fetch_sub(1, std::memory_order_relaxed);
+
+                if (data.capacity() >= capacity)
+                {
+                    m_reuses.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    m_allocations.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                m_allocations.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            data.clear();
+            data.reserve(capacity);
+            m_inUse.fetch_add(1, std::memory_order_relaxed);
+
+            return PooledBuffer(shared_from_this(), std::move(data));
+        }
+
+        Stats GetStats() const
+        {
+            return {
+                m_allocations.load(std::memory_order_relaxed),
+                m_reuses.load(std::memory_order_relaxed),
+                m_discarded.load(std::memory_order_relaxed),
+                m_inUse.load(std::memory_order_relaxed),
+                m_available.load(std::memory_order_relaxed),
+            };
+        }
+
+    private:
+        friend class PooledBuffer;
+
+        explicit BufferPool(size_t maxFree)
+            : m_free(maxFree)
+        {
+        }
+
+        void Release(std::vector<uint8_t>&& data)
+        {
+            m_inUse.fetch_sub(1, std::memory_order_relaxed);
+
+            if (data.capacity() == 0)
+            {
+                return;
+            }
+
+            // Count before pushing so that Acquire() never sees a negative value.
+            m_available.fetch_add(1, std::memory_order_relaxed);
+
+            if (!m_free.TryPush(std::move(data)))
+            {
+                m_available.fetch_sub(1, std::memory_order_relaxed);
+                m_discarded.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        MpscQueue<std::vector<uint8_t>> m_free;
+
+        std::atomic<uint64_t> m_allocations{ 0 };
+        std::atomic<uint64_t> m_reuses{ 0 };
+        std::atomic<uint64_t> m_discarded{ 0 };
+        std::atomic<int64_t> m_inUse{ 0 };
+        std::atomic<int64_t> m_available{ 0 };
+    };
+
+    inline void PooledBuffer::Recycle()
+    {
+        if (m_pool)
+        {
+            m_pool->Release(std::move(m_data));
+            m_pool.reset();
+        }
+        m_data = std::vector<uint8_t>();
+    }
+}
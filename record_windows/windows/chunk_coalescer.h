@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "buffer_pool.h"
+
+namespace record_windows
+{
+    // Regroups PCM bytes of arbitrary sizes into frames of an exact size.
+    //
+    // With a frame size of 0, coalescing is disabled and each pushed chunk
+    // is forwarded as is.
+    // Frames are written straight into buffers taken from the pool, this is
+    // the only copy of the captured bytes on the stream path.
+    class ChunkCoalescer
+    {
+    public:
+        using FrameCallback = std::function<void(PooledBuffer&& frame)>;
+
+        ChunkCoalescer() = default;
+
+        // Computes the frame size in bytes from the stream configuration.
+        // Explicit byte size wins over duration. Result is a multiple of blockAlign.
+        static size_t FrameBytesFor(int chunkMs, int chunkBytes, int sampleRate, int blockAlign)
+        {
+            if (blockAlign <= 0) return 0;
+
+            size_t bytes = 0;
+            if (chunkBytes > 0)
+            {
+                bytes = (size_t)chunkBytes;
+            }
+            else if (chunkMs > 0 && sampleRate > 0)
+            {
+                bytes = (size_t)((int64_t)sampleRate * chunkMs / 1000) * blockAlign;
+            }
+
+            if (bytes == 0) return 0;
+
+            bytes -= bytes % blockAlign;
+            return std::max(bytes, (size_t)blockAlign);
+        }
+
+        void Reset(size_t frameBytes, std::shared_ptr<BufferPool> pool, FrameCallback onFrame)
+        {
+            m_frameBytes = frameBytes;
+            m_pool = std::move(pool);
+            m_onFrame = std::move(onFrame);
+            m_pending = PooledBuffer();
+            m_framesEmitted.store(0, std::memory_order_relaxed);
+        }
+
+        void Push(const uint8_t* data, size_t size)
+        {
+            if (!m_onFrame || !m_pool || size == 0) return;
+
+            if (m_frameBytes == 0)
+            {
+                auto frame = m_pool->Acquire(size);
+                frame.Data().assign(data, data + size);
+                Emit(std::move(frame));
+                return;
+            }
+
+            while (size > 0)
+            {
+                if (m_pending.Data().capacity() == 0)
+                {
+                    m_pending = m_pool->Acquire(m_frameBytes);
+                }
+
+                auto& pending = m_pending.Data();
+                size_t count = std::min(size, m_frameBytes - pending.size());
+                pending.insert(pending.end(), data, data + count);
+                data += count;
+                size -= count;
+
+                if (pending.size() == m_frameBytes)
+                {
+                    Emit(std::move(m_pending));
+                    m_pending = PooledBuffer();
+                }
+            }
+        }
+
+        // Emits the remaining partial frame, if any.
+        void Flush()
+        {
+            if (m_onFrame && !m_pending.Empty())
+            {
+                Emit(std::move(m_pending));
+            }
+            m_pending = PooledBuffer();
+        }
+
+        size_t FrameBytes() const { return m_frameBytes; }
+        uint64_t FramesEmitted() const { return m_framesEmitted.load(std::memory_order_relaxed); }
+
+    private:
+        void Emit(PooledBuffer&& frame)
+        {
+            m_framesEmitted.fetch_add(1, std::memory_order_relaxed);
+            m_onFrame(std::move(frame));
+        }
+
+        size_t m_frameBytes = 0;
+        std::shared_ptr<BufferPool> m_pool;
+        FrameCallback m_onFrame;
+        PooledBuffer m_pending;
+        std::atomic<uint64_t> m_framesEmitted{ 0 };    // read by GetStats on the platform thread
+    };
+}
@@ -0,0 +1,62 @@
+#define NOMINMAX
+#include "command_executor.h"
+
+namespace record_windows
+{
+    CommandExecutor::CommandExecutor(std::shared_ptr<DispatchQueue> completionQueue)
+        : m_completionQueue(std::move(completionQueue))
+    {
+        m_worker.Start(
+            [](InplaceTask& task) { task(); },
+            []() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+            []() { CoUninitialize(); }
+        );
+    }
+
+    CommandExecutor::~CommandExecutor()
+    {
+        Stop();
+    }
+
+    bool CommandExecutor::Submit(Work work, Done done)
+    {
+        if (!m_worker.IsRunning())
+        {
+            return false;
+        }
+
+        auto command = std::make_unique<Command>();
+        command->work = std::move(work);
+        command->done = std::move(done);
+
+        return m_worker.Push(InplaceTask([this, command = std::move(command)]() mutable {
+            Run(std::move(command));
+        }));
+    }
+
+    void CommandExecutor::Stop()
+    {
+        m_worker.Stop();
+    }
+
+    void CommandExecutor::Run(std::unique_ptr<Command> command)
+    {
+        if (command->work)
+        {
+            command->work();
+        }
+
+        // Captures (e.g. a disposed recorder) are released off the platform thread
+        command->work = nullptr;
+
+        if (!command->done)
+        {
+            return;
+        }
+
+        // Dropped with the queue when the plugin goes away
+        m_completionQueue->Post([command = std::move(command)]() {
+            command->done();
+        });
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <functional>
+#include <memory>
+
+#include "inplace_task.h"
+#include "main_thread_dispatcher.h"
+#include "pipeline_worker.h"
+
+namespace record_windows
+{
+    // Runs the lifecycle calls of one recorder (start, stop, dispose...) on
+    // a dedicated worker so the platform thread never waits on a sink
+    // finalization or an fmedia process.
+    //
+    // Commands run one at a time in submission order, each one sees the
+    // state left by the previous ones. Their completion runs on the platform
+    // thread through the given queue.
+    class CommandExecutor
+    {
+    public:
+        static constexpr size_t kCapacity = 64;
+
+        using Work = std::function<void()>;
+        using Done = std::function<void()>;
+
+        explicit CommandExecutor(std::shared_ptr<DispatchQueue> completionQueue);
+        ~CommandExecutor();
+
+        CommandExecutor(const CommandExecutor&) = delete;
+        CommandExecutor& operator=(const CommandExecutor&) = delete;
+
+        // Platform thread only. work runs on the worker and is released
+        // there, done runs afterwards on the platform thread. False when
+        // too many commands are pending, nothing runs then.
+        bool Submit(Work work, Done done);
+
+        // Runs the commands still queued, then joins the worker.
+        // Completions not yet run on the platform thread are kept queued.
+        void Stop();
+
+        // Commands submitted and not yet run.
+        size_t Pending() const { return m_worker.Pending(); }
+
+    private:
+        struct Command
+        {
+            Work work;
+            Done done;
+        };
+
+        void Run(std::unique_ptr<Command> command);
+
+        std::shared_ptr<DispatchQueue> m_completionQueue;
+        PipelineWorker<InplaceTask> m_worker{ kCapacity };
+    };
+}
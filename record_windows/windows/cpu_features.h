@@ -0,0 +1,88 @@
+#pragma once
+
+// Runtime CPU feature detection for the SIMD kernels.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RECORD_X86 1
+#else
+#define RECORD_X86 0
+#endif
+
+#if RECORD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC accepts any intrinsic regardless of the /arch flag.
+#define RECORD_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define RECORD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace record_windows
+{
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool avx2 = false;
+    };
+
+    namespace cpu_detail
+    {
+#if RECORD_X86
+        inline void CpuId(int leaf, int subLeaf, unsigned int regs[4])
+        {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, leaf, subLeaf);
+            for (int i = 0; i < 4; i++) regs[i] = (unsigned int)r[i];
+#else
+            __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        inline unsigned long long XGetBv()
+        {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return ((unsigned long long)edx << 32) | eax;
+#endif
+        }
+#endif
+
+        inline CpuFeatures Detect()
+        {
+            CpuFeatures features;
+#if RECORD_X86
+            unsigned int regs[4] = {};
+
+            CpuId(0, 0, regs);
+            unsigned int maxLeaf = regs[0];
+
+            CpuId(1, 0, regs);
+            features.sse2 = (regs[3] & (1u << 26)) != 0;
+
+            bool osxsave = (regs[2] & (1u << 27)) != 0;
+            bool avx = (regs[2] & (1u << 28)) != 0;
+            // OS must save YMM registers on context switch
+            bool ymmEnabled = osxsave && avx && ((XGetBv() & 0x6) == 0x6);
+
+            if (ymmEnabled && maxLeaf >= 7)
+            {
+                CpuId(7, 0, regs);
+                features.avx2 = (regs[1] & (1u << 5)) != 0;
+            }
+#endif
+            return features;
+        }
+    }
+
+    inline const CpuFeatures& GetCpuFeatures()
+    {
+        static const CpuFeatures features = cpu_detail::Detect();
+        return features;
+    }
+}
@@ -0,0 +1,256 @@
+#define NOMINMAX
+#include "device_monitor.h"
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <shlwapi.h>
+
+#include "utils.h"
+
+namespace record_windows
+{
+    // MfDeviceEnumerator
+    bool MfDeviceEnumerator::Enumerate(std::vector<AudioDevice>& devices, std::string& defaultId)
+    {
+        IMFAttributes* pDeviceAttributes = NULL;
+        IMFActivate** ppDevices = NULL;
+        UINT32 deviceCount = 0;
+
+        HRESULT hr = MFCreateAttributes(&pDeviceAttributes, 1);
+        if (SUCCEEDED(hr))
+        {
+            // Request audio capture devices
+            hr = pDeviceAttributes->SetGUID(
+                MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+                MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_GUID);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = MFEnumDeviceSources(pDeviceAttributes, &ppDevices, &deviceCount);
+        }
+
+        devices.clear();
+
+        for (UINT32 i = 0; SUCCEEDED(hr) && i < deviceCount; i++)
+        {
+            LPWSTR id = NULL;
+            LPWSTR friendlyName = NULL;
+            UINT32 length = 0;
+
+            hr = ppDevices[i]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_ENDPOINT_ID, &id, &length);
+            if (SUCCEEDED(hr))
+            {
+                hr = ppDevices[i]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, &friendlyName, &length);
+            }
+            if (SUCCEEDED(hr))
+            {
+                devices.push_back({ toString(id), toString(friendlyName) });
+            }
+
+            CoTaskMemFree(id);
+            CoTaskMemFree(friendlyName);
+        }
+
+        for (UINT32 i = 0; i < deviceCount; i++)
+        {
+            SafeRelease(ppDevices[i]);
+        }
+        CoTaskMemFree(ppDevices);
+        SafeRelease(pDeviceAttributes);
+
+        // Default capture device, none is not an error
+        defaultId.clear();
+
+        if (SUCCEEDED(hr))
+        {
+            IMMDeviceEnumerator* pEnumerator = NULL;
+            IMMDevice* pDevice = NULL;
+            LPWSTR id = NULL;
+
+            HRESULT hrDefault = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, IID_PPV_ARGS(&pEnumerator));
+
+            if (SUCCEEDED(hrDefault))
+            {
+                hrDefault = pEnumerator->GetDefaultAudioEndpoint(eCapture, eConsole, &pDevice);
+            }
+            if (SUCCEEDED(hrDefault))
+            {
+                hrDefault = pDevice->GetId(&id);
+            }
+            if (SUCCEEDED(hrDefault))
+            {
+                defaultId = toString(id);
+            }
+
+            CoTaskMemFree(id);
+            SafeRelease(pDevice);
+            SafeRelease(pEnumerator);
+        }
+
+        m_lastError = hr;
+        return SUCCEEDED(hr);
+    }
+
+    // DeviceMonitor
+    DeviceMonitor::DeviceMonitor(EventStreamHandler<EncodableValue>* eventHandler, std::shared_ptr<DispatchQueue> dispatchQueue)
+        : m_deviceEnumerator(new MfDeviceEnumerator()),
+        m_registry(std::unique_ptr<DeviceEnumerator>(m_deviceEnumerator), [this](const std::vector<DeviceChange>& changes) {
+            SendChanges(changes);
+        }),
+        m_eventHandler(eventHandler),
+        m_dispatchQueue(std::move(dispatchQueue))
+    {
+    }
+
+    DeviceMonitor::~DeviceMonitor()
+    {
+        Stop();
+    }
+
+    HRESULT DeviceMonitor::Start()
+    {
+        m_worker.Start(
+            [](InplaceTask& task) { task(); },
+            []() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+            []() { CoUninitialize(); }
+        );
+
+        // First enumeration off the platform thread, no event for it
+        ScheduleRefresh();
+
+        HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, IID_PPV_ARGS(&m_pEnumerator));
+
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pEnumerator->RegisterEndpointNotificationCallback(this);
+        }
+        if (FAILED(hr))
+        {
+            // Cache still works, without hot-plug
+            SafeRelease(m_pEnumerator);
+        }
+
+        return hr;
+    }
+
+    void DeviceMonitor::Stop()
+    {
+        if (m_pEnumerator)
+        {
+            m_pEnumerator->UnregisterEndpointNotificationCallback(this);
+            SafeRelease(m_pEnumerator);
+        }
+
+        m_worker.Stop();
+        m_eventHandler = nullptr;
+    }
+
+    HRESULT DeviceMonitor::Devices(std::vector<AudioDevice>& devices)
+    {
+        if (m_registry.Devices(devices))
+        {
+            return S_OK;
+        }
+
+        HRESULT hr = m_deviceEnumerator->LastError();
+        return FAILED(hr) ? hr : E_FAIL;
+    }
+
+    // Any thread
+    void DeviceMonitor::ScheduleRefresh()
+    {
+        if (m_refreshQueued.exchange(true))
+        {
+            return;
+        }
+
+        bool queued = m_worker.Push(InplaceTask([this]() {
+            // Notifications from now on queue another pass
+            m_refreshQueued = false;
+            m_registry.Refresh();
+        }));
+
+        if (!queued)
+        {
+            m_refreshQueued = false;
+        }
+    }
+
+    // Worker thread
+    void DeviceMonitor::SendChanges(const std::vector<DeviceChange>& changes)
+    {
+        m_dispatchQueue->Post([this, changes]() -> void {
+            if (!m_eventHandler) {
+                return;
+            }
+
+            for (const auto& change : changes)
+            {
+                const char* type = change.kind == DeviceChange::Kind::added ? "added"
+                    : change.kind == DeviceChange::Kind::removed ? "removed"
+                    : "defaultChanged";
+
+                m_eventHandler->Success(EncodableValue(EncodableMap({
+                    {EncodableValue("type"), EncodableValue(type)},
+                    {EncodableValue("id"), EncodableValue(change.device.id)},
+                    {EncodableValue("label"), EncodableValue(change.device.label)},
+                })));
+            }
+        });
+    }
+
+    // IMMNotificationClient methods, on MMDevice threads
+    STDMETHODIMP DeviceMonitor::OnDeviceStateChanged(LPCWSTR, DWORD)
+    {
+        ScheduleRefresh();
+        return S_OK;
+    }
+
+    STDMETHODIMP DeviceMonitor::OnDeviceAdded(LPCWSTR)
+    {
+        ScheduleRefresh();
+        return S_OK;
+    }
+
+    STDMETHODIMP DeviceMonitor::OnDeviceRemoved(LPCWSTR)
+    {
+        ScheduleRefresh();
+        return S_OK;
+    }
+
+    STDMETHODIMP DeviceMonitor::OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR)
+    {
+        if (flow == eCapture && role == eConsole)
+        {
+            ScheduleRefresh();
+        }
+        return S_OK;
+    }
+
+    STDMETHODIMP DeviceMonitor::OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY)
+    {
+        return S_OK;
+    }
+
+    // IUnknown methods
+    STDMETHODIMP DeviceMonitor::QueryInterface(REFIID iid, void** ppv)
+    {
+        static const QITAB qit[] =
+        {
+            QITABENT(DeviceMonitor, IMMNotificationClient),
+            { 0 },
+        };
+        return QISearch(this, qit, iid, ppv);
+    }
+
+    // Lifetime is the plugin's, MMDevice doesn't call after unregistering
+    STDMETHODIMP_(ULONG) DeviceMonitor::AddRef()
+    {
+        return InterlockedIncrement(&m_nRefCount);
+    }
+
+    STDMETHODIMP_(ULONG) DeviceMonitor::Release()
+    {
+        return InterlockedDecrement(&m_nRefCount);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+#include <mmdeviceapi.h>
+
+#include <atomic>
+#include <memory>
+
+#include "device_registry.h"
+#include "event_stream_handler.h"
+#include "main_thread_dispatcher.h"
+#include "pipeline_worker.h"
+#include "inplace_task.h"
+
+namespace record_windows
+{
+    // Active capture endpoints from Media Foundation, default one from the
+    // MMDevice API (same endpoint IDs).
+    class MfDeviceEnumerator : public DeviceEnumerator
+    {
+    public:
+        bool Enumerate(std::vector<AudioDevice>& devices, std::string& defaultId) override;
+
+        HRESULT LastError() const { return m_lastError; }
+
+    private:
+        std::atomic<HRESULT> m_lastError{ S_OK };
+    };
+
+    // Keeps the device registry up to date from endpoint notifications, and
+    // sends the changes to the devices event channel.
+    //
+    // Notifications only queue a refresh, enumeration runs on a worker.
+    // Owned by the plugin, created and stopped on the platform thread.
+    class DeviceMonitor : public IMMNotificationClient
+    {
+    public:
+        DeviceMonitor(EventStreamHandler<EncodableValue>* eventHandler, std::shared_ptr<DispatchQueue> dispatchQueue);
+        virtual ~DeviceMonitor();
+
+        // Registers for endpoint notifications and fills the cache in the background.
+        HRESULT Start();
+        // No more notifications nor events afterwards.
+        void Stop();
+
+        // From the cache, see DeviceRegistry.
+        HRESULT Devices(std::vector<AudioDevice>& devices);
+
+        // IUnknown methods
+        STDMETHODIMP QueryInterface(REFIID iid, void** ppv);
+        STDMETHODIMP_(ULONG) AddRef();
+        STDMETHODIMP_(ULONG) Release();
+
+        // IMMNotificationClient methods
+        STDMETHODIMP OnDeviceStateChanged(LPCWSTR pwstrDeviceId, DWORD dwNewState);
+        STDMETHODIMP OnDeviceAdded(LPCWSTR pwstrDeviceId);
+        STDMETHODIMP OnDeviceRemoved(LPCWSTR pwstrDeviceId);
+        STDMETHODIMP OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR pwstrDefaultDeviceId);
+        STDMETHODIMP OnPropertyValueChanged(LPCWSTR pwstrDeviceId, const PROPERTYKEY key);
+
+    private:
+        void ScheduleRefresh();
+        void SendChanges(const std::vector<DeviceChange>& changes);
+
+        long m_nRefCount = 1;
+        IMMDeviceEnumerator* m_pEnumerator = NULL;  // notifications registration
+
+        MfDeviceEnumerator* m_deviceEnumerator;     // owned by the registry
+        DeviceRegistry m_registry;
+
+        // At most one refresh queued: pushes never overlap (single producer)
+        PipelineWorker<InplaceTask> m_worker{ 4 };
+        std::atomic<bool> m_refreshQueued{ false };
+
+        EventStreamHandler<EncodableValue>* m_eventHandler;
+        std::shared_ptr<DispatchQueue> m_dispatchQueue;
+    };
+}
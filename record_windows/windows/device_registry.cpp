@@ -0,0 +1,114 @@
+#include "device_registry.h"
+
+#include <unordered_map>
+
+namespace record_windows
+{
+    DeviceRegistry::DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator, ChangeCallback onChange)
+        : m_enumerator(std::move(enumerator)),
+        m_onChange(std::move(onChange))
+    {
+    }
+
+    bool DeviceRegistry::Devices(std::vector<AudioDevice>& devices, std::string* defaultId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_valid)
+        {
+            std::vector<DeviceChange> changes;
+            if (!EnumerateLocked(changes))
+            {
+                return false;
+            }
+        }
+
+        devices = m_devices;
+        if (defaultId) *defaultId = m_defaultId;
+        return true;
+    }
+
+    bool DeviceRegistry::Refresh()
+    {
+        std::vector<DeviceChange> changes;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!EnumerateLocked(changes))
+            {
+                return false;
+            }
+        }
+
+        // Outside the lock, the callback may read the list
+        if (!changes.empty() && m_onChange)
+        {
+            m_onChange(changes);
+        }
+        return true;
+    }
+
+    bool DeviceRegistry::EnumerateLocked(std::vector<DeviceChange>& changes)
+    {
+        std::vector<AudioDevice> devices;
+        std::string defaultId;
+
+        if (!m_enumerator->Enumerate(devices, defaultId))
+        {
+            return false;
+        }
+
+        if (m_valid)
+        {
+            changes = Diff(m_devices, m_defaultId, devices, defaultId);
+        }
+
+        m_devices = std::move(devices);
+        m_defaultId = std::move(defaultId);
+        m_valid = true;
+        return true;
+    }
+
+    std::vector<DeviceChange> DeviceRegistry::Diff(
+        const std::vector<AudioDevice>& before, const std::string& beforeDefault,
+        const std::vector<AudioDevice>& after, const std::string& afterDefault)
+    {
+        std::vector<DeviceChange> changes;
+        std::unordered_map<std::string, const AudioDevice*> beforeById;
+        std::unordered_map<std::string, const AudioDevice*> afterById;
+
+        for (const auto& device : before) beforeById[device.id] = &device;
+        for (const auto& device : after) afterById[device.id] = &device;
+
+        for (const auto& device : before)
+        {
+            auto it = afterById.find(device.id);
+            if (it == afterById.end() || *it->second != device)
+            {
+                changes.push_back({ DeviceChange::Kind::removed, device });
+            }
+        }
+
+        for (const auto& device : after)
+        {
+            auto it = beforeById.find(device.id);
+            if (it == beforeById.end() || *it->second != device)
+            {
+                changes.push_back({ DeviceChange::Kind::added, device });
+            }
+        }
+
+        if (beforeDefault != afterDefault)
+        {
+            DeviceChange change{ DeviceChange::Kind::defaultChanged, AudioDevice() };
+            auto it = afterById.find(afterDefault);
+
+            change.device.id = afterDefault;
+            if (it != afterById.end()) change.device.label = it->second->label;
+
+            changes.push_back(std::move(change));
+        }
+
+        return changes;
+    }
+}
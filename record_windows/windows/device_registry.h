@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace record_windows
+{
+    struct AudioDevice
+    {
+        std::string id;
+        std::string label;
+
+        bool operator==(const AudioDevice& other) const { return id == other.id && label == other.label; }
+        bool operator!=(const AudioDevice& other) const { return !(*this == other); }
+    };
+
+    struct DeviceChange
+    {
+        enum class Kind { added, removed, defaultChanged };
+
+        Kind kind;
+        // New default for defaultChanged, empty id when there's none.
+        AudioDevice device;
+    };
+
+    // Lists the capture endpoints, implemented per platform.
+    class DeviceEnumerator
+    {
+    public:
+        virtual ~DeviceEnumerator() = default;
+
+        // defaultId is empty when there's no default device. False on failure.
+        virtual bool Enumerate(std::vector<AudioDevice>& devices, std::string& defaultId) = 0;
+    };
+
+    // Cached capture device list.
+    //
+    // Enumerates once, then only on Refresh() (endpoint notifications), which
+    // reports the differences with the cached list.
+    // Portable, thread safe.
+    class DeviceRegistry
+    {
+    public:
+        using ChangeCallback = std::function<void(const std::vector<DeviceChange>& changes)>;
+
+        DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator, ChangeCallback onChange);
+
+        // From the cache, enumerated on first use. False if it never succeeded.
+        bool Devices(std::vector<AudioDevice>& devices, std::string* defaultId = nullptr);
+
+        // Enumerates again and sends the changes, if any. Nothing is sent for
+        // the first enumeration. False on failure, the cache is kept.
+        bool Refresh();
+
+        // Removed devices first, then added ones (in the new list order), then
+        // the default device. A relabeled device is removed and added again.
+        static std::vector<DeviceChange> Diff(
+            const std::vector<AudioDevice>& before, const std::string& beforeDefault,
+            const std::vector<AudioDevice>& after, const std::string& afterDefault);
+
+    private:
+        bool EnumerateLocked(std::vector<DeviceChange>& changes);
+
+        std::unique_ptr<DeviceEnumerator> m_enumerator;
+        ChangeCallback m_onChange;
+
+        std::mutex m_mutex;
+        std::vector<AudioDevice> m_devices;
+        std::string m_defaultId;
+        bool m_valid = false;
+    };
+}
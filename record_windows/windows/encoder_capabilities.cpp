@@ -0,0 +1,388 @@
+#define NOMINMAX
+#include "encoder_capabilities.h"
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mferror.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "utils.h"
+#include "record_config.h"
+#include "opus_ogg_encoder.h"
+#include "mf_runtime.h"
+
+namespace record_windows
+{
+    namespace
+    {
+        // Where MFTRegister writes, watched for (un)installed encoders
+        const wchar_t kTransformsKey[] = L"SOFTWARE\\Classes\\MediaFoundation\\Transforms";
+
+        // Installers write several values, the table is rebuilt once they settle
+        constexpr DWORD kRebuildDelayMs = 1000;
+
+        // Probed when the encoder doesn't list its output types
+        const int kProbeSampleRates[] = { 8000, 11025, 16000, 22050, 24000, 32000, 44100, 48000, 88200, 96000 };
+        const int kProbeChannels[] = { 1, 2, 6 };
+
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable built;
+            std::vector<EncoderCapability> table;
+            bool ready = false;
+            uint32_t generation = 0;
+
+            int users = 0;
+            std::thread thread;
+            HANDLE stopEvent = NULL;
+        };
+
+        State& GetState()
+        {
+            static State state;
+            return state;
+        }
+
+        void AddValue(std::vector<int>& values, int value)
+        {
+            auto it = std::lower_bound(values.begin(), values.end(), value);
+            if (it == values.end() || *it != value) values.insert(it, value);
+        }
+
+        void SetBitRateRange(EncoderCapability& capability)
+        {
+            if (!capability.bitRates.empty())
+            {
+                capability.minBitRate = capability.bitRates.front();
+                capability.maxBitRate = capability.bitRates.back();
+            }
+        }
+
+        bool ProbeOutputType(IMFTransform* pTransform, const GUID& subtype, int sampleRate, int numChannels)
+        {
+            IMFMediaType* pType = NULL;
+
+            HRESULT hr = MFCreateMediaType(&pType);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = pType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = pType->SetGUID(MF_MT_SUBTYPE, subtype);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = pType->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = pType->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, (UINT32)sampleRate);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = pType->SetUINT32(MF_MT_AUDIO_NUM_CHANNELS, (UINT32)numChannels);
+            }
+            if (SUCCEEDED(hr) && subtype == MFAudioFormat_AAC)
+            {
+                hr = pType->SetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, 16000);
+            }
+            if (SUCCEEDED(hr))
+            {
+                hr = pTransform->SetOutputType(0, pType, MFT_SET_TYPE_TEST_ONLY);
+            }
+
+            SafeRelease(&pType);
+            return SUCCEEDED(hr);
+        }
+
+        // Formats of the preferred encoder, left empty if it can't be queried.
+        void ListOutputTypes(IMFActivate* pActivate, const GUID& subtype, EncoderCapability& capability)
+        {
+            IMFTransform* pTransform = NULL;
+
+            HRESULT hr = pActivate->ActivateObject(IID_PPV_ARGS(&pTransform));
+
+            if (FAILED(hr))
+            {
+                return;
+            }
+
+            for (DWORD index = 0; SUCCEEDED(hr); index++)
+            {
+                IMFMediaType* pType = NULL;
+                GUID typeSubtype = GUID_NULL;
+                UINT32 value = 0;
+
+                hr = pTransform->GetOutputAvailableType(0, index, &pType);
+
+                if (SUCCEEDED(hr) && SUCCEEDED(pType->GetGUID(MF_MT_SUBTYPE, &typeSubtype)) && typeSubtype == subtype)
+                {
+                    if (SUCCEEDED(pType->GetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, &value))) AddValue(capability.sampleRates, (int)value);
+                    if (SUCCEEDED(pType->GetUINT32(MF_MT_AUDIO_NUM_CHANNELS, &value))) AddValue(capability.numChannels, (int)value);
+                    if (SUCCEEDED(pType->GetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, &value))) AddValue(capability.bitRates, (int)value * 8);
+                }
+
+                SafeRelease(&pType);
+            }
+
+            // Some encoders only list output types once the input is set
+            if (capability.sampleRates.empty())
+            {
+                for (int sampleRate : kProbeSampleRates)
+                {
+                    for (int numChannels : kProbeChannels)
+                    {
+                        if (ProbeOutputType(pTransform, subtype, sampleRate, numChannels))
+                        {
+                            AddValue(capability.sampleRates, sampleRate);
+                            AddValue(capability.numChannels, numChannels);
+                        }
+                    }
+                }
+            }
+
+            SetBitRateRange(capability);
+
+            pActivate->ShutdownObject();
+            SafeRelease(&pTransform);
+        }
+
+        void ProbeMft(const GUID& subtype, EncoderCapability& capability)
+        {
+            MFT_REGISTER_TYPE_INFO typeLookup = { MFMediaType_Audio, subtype };
+
+            // Enumerate all codecs except for codecs with field-of-use restrictions.
+            // Sort the results.
+            DWORD dwFlags =
+                (MFT_ENUM_FLAG_ALL & (~MFT_ENUM_FLAG_FIELDOFUSE)) |
+                MFT_ENUM_FLAG_SORTANDFILTER;
+
+            IMFActivate** ppActivate = NULL;
+            UINT32 count = 0;
+
+            HRESULT hr = MFTEnumEx(MFT_CATEGORY_AUDIO_ENCODER, dwFlags, NULL, &typeLookup, &ppActivate, &count);
+
+            if (SUCCEEDED(hr))
+            {
+                capability.supported = count > 0;
+
+                if (count > 0)
+                {
+                    ListOutputTypes(ppActivate[0], subtype, capability);
+                }
+
+                for (UINT32 i = 0; i < count; i++)
+                {
+                    ppActivate[i]->Release();
+                }
+                CoTaskMemFree(ppActivate);
+            }
+        }
+
+        std::vector<EncoderCapability> Build()
+        {
+            const AudioEncoder encoders;
+            std::vector<EncoderCapability> table;
+
+            auto add = [&table](const std::string& name) -> EncoderCapability& {
+                table.emplace_back();
+                table.back().encoderName = name;
+                return table.back();
+            };
+
+            // Keeps Media Foundation up while the encoders are queried
+            bool mfStarted = SUCCEEDED(MfRuntime::Acquire());
+
+            ProbeMft(MFAudioFormat_AAC, add(encoders.aacLc));
+            add(encoders.aacEld);
+            add(encoders.aacHe);
+            ProbeMft(MFAudioFormat_AMR_NB, add(encoders.amrNb));
+            ProbeMft(MFAudioFormat_AMR_WB, add(encoders.amrWb));
+
+            if (mfStarted)
+            {
+                MfRuntime::Release();
+            }
+
+            // In-process encoders, the capture resamples to the rate asked
+            {
+                auto& opus = add(encoders.opus);
+                opus.supported = OpusOggEncoder::Available();
+                opus.sampleRates = { 8000, 12000, 16000, 24000, 48000 };
+                opus.numChannels = { 1, 2 };
+                opus.minBitRate = 6000;
+                opus.maxBitRate = 510000;
+            }
+            {
+                auto& flac = add(encoders.flac);
+                flac.supported = true;
+                flac.numChannels = { 1, 2, 3, 4, 5, 6, 7, 8 };
+            }
+            add(encoders.pcm16bits).supported = true;
+            add(encoders.wav).supported = true;
+
+            return table;
+        }
+
+        void Publish(State& state, std::vector<EncoderCapability> table)
+        {
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.table = std::move(table);
+                state.ready = true;
+                state.generation++;
+            }
+            state.built.notify_all();
+        }
+
+        void WatchLoop(State& state, HANDLE stopEvent)
+        {
+            CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+            HKEY hKey = NULL;
+            HANDLE changeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+            if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, kTransformsKey, 0, KEY_NOTIFY, &hKey) != ERROR_SUCCESS)
+            {
+                hKey = NULL;
+            }
+
+            auto watch = [hKey, changeEvent]() {
+                return hKey && changeEvent &&
+                    RegNotifyChangeKeyValue(hKey, TRUE, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET, changeEvent, TRUE) == ERROR_SUCCESS;
+            };
+
+            // Armed before the build, changes made meanwhile trigger a rebuild
+            bool watching = watch();
+            Publish(state, Build());
+
+            while (watching)
+            {
+                HANDLE handles[] = { stopEvent, changeEvent };
+
+                if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+                {
+                    break;
+                }
+                if (WaitForSingleObject(stopEvent, kRebuildDelayMs) != WAIT_TIMEOUT)
+                {
+                    break;
+                }
+
+                watching = watch();
+                Publish(state, Build());
+            }
+
+            if (hKey) RegCloseKey(hKey);
+            if (changeEvent) CloseHandle(changeEvent);
+
+            CoUninitialize();
+        }
+    }
+
+    void EncoderCapabilities::Start()
+    {
+        State& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        if (state.users++ > 0)
+        {
+            return;
+        }
+
+        state.stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        if (state.stopEvent)
+        {
+            HANDLE stopEvent = state.stopEvent;
+            state.thread = std::thread([&state, stopEvent]() { WatchLoop(state, stopEvent); });
+        }
+    }
+
+    void EncoderCapabilities::Stop()
+    {
+        State& state = GetState();
+        std::thread thread;
+        HANDLE stopEvent = NULL;
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            if (state.users == 0 || --state.users > 0)
+            {
+                return;
+            }
+
+            thread = std::move(state.thread);
+            stopEvent = state.stopEvent;
+            state.stopEvent = NULL;
+        }
+
+        if (stopEvent)
+        {
+            SetEvent(stopEvent);
+        }
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+        if (stopEvent)
+        {
+            CloseHandle(stopEvent);
+        }
+    }
+
+    std::vector<EncoderCapability> EncoderCapabilities::All()
+    {
+        State& state = GetState();
+        bool buildInline = false;
+
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+
+            if (state.thread.joinable())
+            {
+                state.built.wait(lock, [&state] { return state.ready; });
+                return state.table;
+            }
+
+            buildInline = !state.ready;
+        }
+
+        if (buildInline)
+        {
+            Publish(state, Build());
+        }
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.table;
+    }
+
+    bool EncoderCapabilities::Find(const std::string& encoderName, EncoderCapability& capability)
+    {
+        for (auto& entry : All())
+        {
+            if (entry.encoderName == encoderName)
+            {
+                capability = std::move(entry);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    uint32_t EncoderCapabilities::Generation()
+    {
+        State& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.generation;
+    }
+}
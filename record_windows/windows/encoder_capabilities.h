@@ -0,0 +1,45 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+namespace record_windows
+{
+    // What an encoder accepts. Empty lists mean no restriction, or unknown
+    // when the encoder can't tell.
+    struct EncoderCapability
+    {
+        std::string encoderName;
+        bool supported = false;
+        std::vector<int> sampleRates;   // ascending
+        std::vector<int> numChannels;   // ascending
+        std::vector<int> bitRates;      // ascending, discrete values
+        int minBitRate = 0;             // 0 when not applicable (lossless)
+        int maxBitRate = 0;
+    };
+
+    // Process-wide encoder capability table.
+    //
+    // Built on a background thread by Start(), then rebuilt whenever the
+    // Media Foundation transform registrations change, so lookups never
+    // enumerate MFTs on the caller thread. Start()/Stop() are refcounted.
+    // Thread safe.
+    class EncoderCapabilities
+    {
+    public:
+        static void Start();
+        static void Stop();
+
+        // Waits for the first build when it is still running, builds the
+        // table inline when not started. False for unknown encoders.
+        static bool Find(const std::string& encoderName, EncoderCapability& capability);
+
+        static std::vector<EncoderCapability> All();
+
+        // Completed builds, for diagnostics.
+        static uint32_t Generation();
+    };
+}
@@ -16,6 +16,11 @@ public:
         if (m_sink.get()) m_sink.get()->Success(*_data.get());
     }
 
+    // Sends without taking ownership, so the caller can reuse the value storage.
+    void Success(const T& data) {
+        if (m_sink.get()) m_sink.get()->Success(data);
+    }
+
     void Error(const std::string& error_code, const std::string& error_message,
         const T& error_details) {
         if (m_sink.get())
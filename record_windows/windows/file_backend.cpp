@@ -0,0 +1,208 @@
+#include "file_backend.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+#endif
+
+namespace record_windows
+{
+#ifdef _WIN32
+    class Win32FileBackend : public FileBackend
+    {
+    public:
+        explicit Win32FileBackend(bool unbuffered) : m_unbuffered(unbuffered)
+        {
+            m_overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        }
+
+        ~Win32FileBackend() override
+        {
+            Close();
+            if (m_overlapped.hEvent) CloseHandle(m_overlapped.hEvent);
+        }
+
+        bool Open(const std::wstring& path, bool reuse) override
+        {
+            Close();
+
+            DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN;
+            if (m_unbuffered) flags |= FILE_FLAG_NO_BUFFERING;
+
+            m_hFile = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, reuse ? OPEN_ALWAYS : CREATE_ALWAYS, flags, NULL);
+            return Check(m_hFile != INVALID_HANDLE_VALUE);
+        }
+
+        bool IsOpen() const override { return m_hFile != INVALID_HANDLE_VALUE; }
+
+        bool Unbuffered() const override { return m_unbuffered; }
+
+        bool WriteAt(uint64_t offset, const void* data, size_t size) override
+        {
+            const BYTE* bytes = static_cast<const BYTE*>(data);
+
+            while (size > 0)
+            {
+                DWORD chunk = (DWORD)std::min<size_t>(size, 1u << 30);
+
+                m_overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+                m_overlapped.OffsetHigh = (DWORD)(offset >> 32);
+                ResetEvent(m_overlapped.hEvent);
+
+                DWORD written = 0;
+                if (!WriteFile(m_hFile, bytes, chunk, NULL, &m_overlapped) && GetLastError() != ERROR_IO_PENDING)
+                {
+                    return Check(false);
+                }
+                if (!GetOverlappedResult(m_hFile, &m_overlapped, &written, TRUE) || written == 0)
+                {
+                    return Check(false);
+                }
+
+                bytes += written;
+                offset += written;
+                size -= written;
+            }
+
+            return true;
+        }
+
+        bool Reserve(uint64_t size) override
+        {
+            // Only grows: a smaller allocation would cut a reused file
+            FILE_STANDARD_INFO standard;
+            if (GetFileInformationByHandleEx(m_hFile, FileStandardInfo, &standard, sizeof(standard)) &&
+                (uint64_t)standard.AllocationSize.QuadPart >= size)
+            {
+                return true;
+            }
+
+            FILE_ALLOCATION_INFO info;
+            info.AllocationSize.QuadPart = (LONGLONG)size;
+            // Not supported by every file system, ignore failures
+            SetFileInformationByHandle(m_hFile, FileAllocationInfo, &info, sizeof(info));
+            return true;
+        }
+
+        bool Truncate(uint64_t size) override
+        {
+            FILE_END_OF_FILE_INFO info;
+            info.EndOfFile.QuadPart = (LONGLONG)size;
+            return Check(SetFileInformationByHandle(m_hFile, FileEndOfFileInfo, &info, sizeof(info)) != FALSE);
+        }
+
+        void Close() override
+        {
+            if (m_hFile != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(m_hFile);
+                m_hFile = INVALID_HANDLE_VALUE;
+            }
+        }
+
+        int LastError() const override { return m_lastError; }
+
+    private:
+        bool Check(bool ok)
+        {
+            if (!ok) m_lastError = (int)GetLastError();
+            return ok;
+        }
+
+        const bool m_unbuffered;
+        HANDLE m_hFile = INVALID_HANDLE_VALUE;
+        OVERLAPPED m_overlapped{};
+        int m_lastError = 0;
+    };
+
+    std::unique_ptr<FileBackend> CreateFileBackend(bool unbuffered)
+    {
+        return std::make_unique<Win32FileBackend>(unbuffered);
+    }
+#else
+    class PosixFileBackend : public FileBackend
+    {
+    public:
+        ~PosixFileBackend() override { Close(); }
+
+        bool Open(const std::wstring& path, bool reuse) override
+        {
+            Close();
+            int flags = O_RDWR | O_CREAT | O_CLOEXEC | (reuse ? 0 : O_TRUNC);
+            m_fd = ::open(std::filesystem::path(path).c_str(), flags, 0644);
+            return Check(m_fd >= 0);
+        }
+
+        bool IsOpen() const override { return m_fd >= 0; }
+
+        bool Unbuffered() const override { return false; }
+
+        bool WriteAt(uint64_t offset, const void* data, size_t size) override
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+            while (size > 0)
+            {
+                ssize_t written = ::pwrite(m_fd, bytes, size, (off_t)offset);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) return Check(false);
+
+                bytes += written;
+                offset += (uint64_t)written;
+                size -= (size_t)written;
+            }
+
+            return true;
+        }
+
+        bool Reserve(uint64_t size) override
+        {
+#if defined(__linux__)
+            // Not supported by every file system, ignore failures
+            ::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size);
+#else
+            (void)size;
+#endif
+            return true;
+        }
+
+        bool Truncate(uint64_t size) override
+        {
+            return Check(::ftruncate(m_fd, (off_t)size) == 0);
+        }
+
+        void Close() override
+        {
+            if (m_fd >= 0)
+            {
+                ::close(m_fd);
+                m_fd = -1;
+            }
+        }
+
+        int LastError() const override { return m_lastError; }
+
+    private:
+        bool Check(bool ok)
+        {
+            if (!ok) m_lastError = errno;
+            return ok;
+        }
+
+        int m_fd = -1;
+        int m_lastError = 0;
+    };
+
+    std::unique_ptr<FileBackend> CreateFileBackend(bool /*unbuffered*/)
+    {
+        return std::make_unique<PosixFileBackend>();
+    }
+#endif
+}
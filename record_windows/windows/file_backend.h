@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace record_windows
+{
+    // Positioned file I/O used by the native file writers.
+    //
+    // Calls are not synchronized, a backend is driven by one thread at a time.
+    class FileBackend
+    {
+    public:
+        virtual ~FileBackend() = default;
+
+        // Creates the file, truncating any existing one. With reuse, an
+        // existing file is kept (with its disk allocation) and overwritten
+        // in place, callers truncate it to the final size.
+        virtual bool Open(const std::wstring& path, bool reuse) = 0;
+        virtual bool IsOpen() const = 0;
+
+        // True when writes must follow the kIoAlignment constraints below.
+        virtual bool Unbuffered() const = 0;
+
+        // Writes the whole range at offset, independently of any file pointer.
+        // Unbuffered backends require offset, size and data address to be
+        // multiples of kIoAlignment.
+        virtual bool WriteAt(uint64_t offset, const void* data, size_t size) = 0;
+
+        // Reserves disk space for size bytes without changing the file size,
+        // never shrinks the current allocation.
+        // Best effort: returns true when unsupported.
+        virtual bool Reserve(uint64_t size) = 0;
+
+        // Sets the file size (drops reserved space past it).
+        virtual bool Truncate(uint64_t size) = 0;
+
+        virtual void Close() = 0;
+
+        // Platform error code of the last failure (Win32 error or errno).
+        virtual int LastError() const = 0;
+    };
+
+    // Alignment (and size granularity) of unbuffered writes.
+    constexpr size_t kIoAlignment = 4096;
+
+    // Native backend: overlapped unbuffered handle on Windows, pwrite on POSIX.
+    std::unique_ptr<FileBackend> CreateFileBackend(bool unbuffered = true);
+
+    // Heap block aligned on kIoAlignment, suitable for unbuffered I/O.
+    class AlignedBuffer
+    {
+    public:
+        AlignedBuffer() = default;
+        explicit AlignedBuffer(size_t size)
+            : m_data(static_cast<uint8_t*>(::operator new(size, std::align_val_t(kIoAlignment)))),
+            m_size(size)
+        {
+        }
+
+        AlignedBuffer(AlignedBuffer&& other) noexcept : m_data(other.m_data), m_size(other.m_size)
+        {
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Free();
+                m_data = other.m_data;
+                m_size = other.m_size;
+                other.m_data = nullptr;
+                other.m_size = 0;
+            }
+            return *this;
+        }
+
+        AlignedBuffer(const AlignedBuffer&) = delete;
+        AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+        ~AlignedBuffer() { Free(); }
+
+        uint8_t* Data() { return m_data; }
+        const uint8_t* Data() const { return m_data; }
+        size_t Size() const { return m_size; }
+
+    private:
+        void Free()
+        {
+            if (m_data) ::operator delete(m_data, std::align_val_t(kIoAlignment));
+            m_data = nullptr;
+        }
+
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+    };
+}
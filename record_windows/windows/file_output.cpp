@@ -0,0 +1,473 @@
+#define NOMINMAX
+#include "file_output.h"
+#include "aac_stream_encoder.h"
+
+#include <cstring>
+
+namespace record_windows
+{
+    static HRESULT WriterError(int error)
+    {
+        return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+    }
+
+    // WavFileOutput
+    WavFileOutput::WavFileOutput(std::wstring path)
+        : FileOutput(std::move(path)),
+        m_writer(CreateFileBackend())
+    {
+    }
+
+    WavFileOutput::~WavFileOutput()
+    {
+        Close();
+    }
+
+    HRESULT WavFileOutput::Create(const std::wstring& path, const WavFormat& format, const WavWriter::Options& options, std::unique_ptr<FileOutput>& output)
+    {
+        std::unique_ptr<WavFileOutput> wavOutput(new WavFileOutput(path));
+
+        if (!wavOutput->m_writer.Open(path, format, options))
+        {
+            HRESULT hr = WriterError(wavOutput->m_writer.LastError());
+            wavOutput->m_writer.Close();
+            return hr;
+        }
+
+        output = std::move(wavOutput);
+        return S_OK;
+    }
+
+    HRESULT WavFileOutput::Write(IMFSample*, const BYTE* data, DWORD size)
+    {
+        if (!m_writer.Write(data, size))
+        {
+            return WriterError(m_writer.LastError());
+        }
+        return S_OK;
+    }
+
+    HRESULT WavFileOutput::Close()
+    {
+        if (m_writer.IsOpen() && !m_writer.Close())
+        {
+            return WriterError(m_writer.LastError());
+        }
+        return S_OK;
+    }
+
+    // SinkWriterOutput
+    SinkWriterOutput::SinkWriterOutput(std::wstring path, IMFSinkWriter* pWriter, DWORD streamIndex, UINT32 sampleRate, UINT32 blockAlign)
+        : FileOutput(std::move(path)),
+        m_pWriter(pWriter),
+        m_streamIndex(streamIndex),
+        m_sampleRate(sampleRate),
+        m_blockAlign(blockAlign)
+    {
+        m_pWriter->AddRef();
+    }
+
+    SinkWriterOutput::~SinkWriterOutput()
+    {
+        Close();
+    }
+
+    HRESULT SinkWriterOutput::Create(const std::wstring& path, IMFMediaType* pTypeOut, IMFMediaType* pTypeIn, UINT32 sampleRate, UINT32 blockAlign, std::unique_ptr<FileOutput>& output)
+    {
+        IMFSinkWriter* pSinkWriter = NULL;
+        DWORD streamIndex = 0;
+
+        HRESULT hr = MFCreateSinkWriterFromURL(path.c_str(), NULL, NULL, &pSinkWriter);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pSinkWriter->AddStream(pTypeOut, &streamIndex);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSinkWriter->SetInputMediaType(streamIndex, pTypeIn, NULL);
+        }
+
+        // Tell the sink writer to Start accepting data.
+        if (SUCCEEDED(hr))
+        {
+            hr = pSinkWriter->BeginWriting();
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            output.reset(new SinkWriterOutput(path, pSinkWriter, streamIndex, sampleRate, blockAlign));
+        }
+
+        SafeRelease(&pSinkWriter);
+
+        return hr;
+    }
+
+    HRESULT SinkWriterOutput::Write(IMFSample* pSample, const BYTE* data, DWORD size)
+    {
+        if (!m_pWriter)
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        HRESULT hr = S_OK;
+        IMFSample* pOwned = NULL;
+
+        if (!pSample)
+        {
+            hr = CreatePcmSample(data, size, &pOwned);
+            pSample = pOwned;
+        }
+
+        const uint64_t frames = m_blockAlign ? size / m_blockAlign : 0;
+
+        // 100 ns units
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->SetSampleTime((LONGLONG)(m_frames * 10000000ull / m_sampleRate));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->SetSampleDuration((LONGLONG)(frames * 10000000ull / m_sampleRate));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pWriter->WriteSample(m_streamIndex, pSample);
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_frames += frames;
+            m_bytes += size;
+        }
+
+        SafeRelease(&pOwned);
+
+        return hr;
+    }
+
+    HRESULT SinkWriterOutput::Close()
+    {
+        HRESULT hr = S_OK;
+
+        if (m_pWriter)
+        {
+            hr = m_pWriter->Finalize();
+            SafeRelease(&m_pWriter);
+        }
+
+        return hr;
+    }
+
+    // OggOpusFileOutput
+    OggOpusFileOutput::OggOpusFileOutput(std::wstring path)
+        : FileOutput(std::move(path)),
+        m_backend(CreateFileBackend(false))
+    {
+    }
+
+    OggOpusFileOutput::~OggOpusFileOutput()
+    {
+        Close();
+    }
+
+    HRESULT OggOpusFileOutput::Create(const std::wstring& path, const OpusOggEncoder::Options& options, std::unique_ptr<FileOutput>& output)
+    {
+        if (!OpusOggEncoder::Available())
+        {
+            return E_NOTIMPL;
+        }
+
+        std::unique_ptr<OggOpusFileOutput> opusOutput(new OggOpusFileOutput(path));
+
+        if (!opusOutput->m_backend->Open(path, false))
+        {
+            return WriterError(opusOutput->m_backend->LastError());
+        }
+
+        opusOutput->m_blockAlign = options.numChannels * 2;
+
+        // Pages are small (a few KB), written as they come
+        FileBackend* backend = opusOutput->m_backend.get();
+        uint64_t* fileBytes = &opusOutput->m_fileBytes;
+
+        bool opened = opusOutput->m_encoder.Open(options, [backend, fileBytes](const uint8_t* page, size_t size) {
+            if (!backend->WriteAt(*fileBytes, page, size)) return false;
+            *fileBytes += size;
+            return true;
+        });
+
+        if (!opened)
+        {
+            HRESULT hr = opusOutput->EncoderError();
+            opusOutput->m_backend->Close();
+            DeleteFile(path.c_str());
+            return hr;
+        }
+
+        output = std::move(opusOutput);
+        return S_OK;
+    }
+
+    HRESULT OggOpusFileOutput::EncoderError() const
+    {
+        int error = m_encoder.LastError();
+
+        if (error == OpusOggEncoder::kWriteError) return WriterError(m_backend->LastError());
+        if (error == -1) return MF_E_INVALIDMEDIATYPE;  // OPUS_BAD_ARG: unsupported rate/channels/frame
+        return E_FAIL;
+    }
+
+    HRESULT OggOpusFileOutput::Write(IMFSample*, const BYTE* data, DWORD size)
+    {
+        if (!m_backend->IsOpen())
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        if (!m_encoder.Encode(reinterpret_cast<const int16_t*>(data), size / m_blockAlign))
+        {
+            return EncoderError();
+        }
+
+        m_bytes += size;
+        return S_OK;
+    }
+
+    HRESULT OggOpusFileOutput::Close()
+    {
+        if (!m_backend->IsOpen())
+        {
+            return S_OK;
+        }
+
+        HRESULT hr = m_encoder.Finish() ? S_OK : EncoderError();
+        m_backend->Close();
+
+        return hr;
+    }
+
+    // FlacFileOutput
+    FlacFileOutput::FlacFileOutput(std::wstring path)
+        : FileOutput(std::move(path)),
+        m_backend(CreateFileBackend(false))
+    {
+    }
+
+    FlacFileOutput::~FlacFileOutput()
+    {
+        Close();
+    }
+
+    HRESULT FlacFileOutput::Create(const std::wstring& path, const FlacEncoder::Options& options, std::unique_ptr<FileOutput>& output)
+    {
+        std::unique_ptr<FlacFileOutput> flacOutput(new FlacFileOutput(path));
+
+        if (!flacOutput->m_backend->Open(path, false))
+        {
+            return WriterError(flacOutput->m_backend->LastError());
+        }
+
+        flacOutput->m_blockAlign = options.numChannels * 2;
+
+        // Frames and the final header rewrite go straight to the file
+        FileBackend* backend = flacOutput->m_backend.get();
+
+        bool opened = flacOutput->m_encoder.Open(options, [backend](uint64_t offset, const uint8_t* data, size_t size) {
+            return backend->WriteAt(offset, data, size);
+        });
+
+        if (!opened)
+        {
+            HRESULT hr = flacOutput->m_backend->LastError() ? WriterError(flacOutput->m_backend->LastError()) : MF_E_INVALIDMEDIATYPE;
+            flacOutput->m_backend->Close();
+            DeleteFile(path.c_str());
+            return hr;
+        }
+
+        output = std::move(flacOutput);
+        return S_OK;
+    }
+
+    HRESULT FlacFileOutput::Write(IMFSample*, const BYTE* data, DWORD size)
+    {
+        if (!m_backend->IsOpen())
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        if (!m_encoder.Encode(reinterpret_cast<const int16_t*>(data), size / m_blockAlign))
+        {
+            return WriterError(m_backend->LastError());
+        }
+
+        m_bytes += size;
+        return S_OK;
+    }
+
+    HRESULT FlacFileOutput::Close()
+    {
+        if (!m_backend->IsOpen())
+        {
+            return S_OK;
+        }
+
+        HRESULT hr = m_encoder.Finish() ? S_OK : WriterError(m_backend->LastError());
+        m_backend->Close();
+
+        return hr;
+    }
+
+    // Fmp4FileOutput
+    Fmp4FileOutput::Fmp4FileOutput(std::wstring path)
+        : FileOutput(std::move(path)),
+        m_backend(CreateFileBackend(false))
+    {
+    }
+
+    Fmp4FileOutput::~Fmp4FileOutput()
+    {
+        Close();
+    }
+
+    HRESULT Fmp4FileOutput::Create(const std::wstring& path, const StreamEncoderConfig& config, UINT32 fragmentMs, std::unique_ptr<FileOutput>& output)
+    {
+        Fmp4Writer::Options options;
+        options.sampleRate = config.sampleRate;
+        options.numChannels = config.numChannels;
+        options.bitRate = config.bitRate;
+        options.fragmentMs = fragmentMs;
+
+        if (!Fmp4Writer::AacDecoderConfig(config.sampleRate, config.numChannels, options.decoderConfig))
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+
+        std::unique_ptr<Fmp4FileOutput> fmp4Output(new Fmp4FileOutput(path));
+        Fmp4FileOutput* self = fmp4Output.get();
+
+        // Raw access units straight to the muxer
+        HRESULT hr = AacStreamEncoder::Create(config, [self](const uint8_t* data, size_t size) {
+            if (!self->m_muxerFailed && !self->m_writer.AddSample(data, size))
+            {
+                self->m_muxerFailed = true;
+            }
+        }, fmp4Output->m_encoder, false);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (!fmp4Output->m_backend->Open(path, false))
+        {
+            return WriterError(fmp4Output->m_backend->LastError());
+        }
+
+        // Whole fragments, written as they are cut
+        bool opened = fmp4Output->m_writer.Open(options, [self](const uint8_t* data, size_t size) {
+            if (!self->m_backend->WriteAt(self->m_fileBytes, data, size)) return false;
+            self->m_fileBytes += size;
+            return true;
+        });
+
+        if (!opened)
+        {
+            hr = fmp4Output->MuxerError();
+            fmp4Output->m_backend->Close();
+            DeleteFile(path.c_str());
+            return hr;
+        }
+
+        output = std::move(fmp4Output);
+        return S_OK;
+    }
+
+    HRESULT Fmp4FileOutput::MuxerError() const
+    {
+        return m_backend->LastError() ? WriterError(m_backend->LastError()) : MF_E_INVALIDMEDIATYPE;
+    }
+
+    HRESULT Fmp4FileOutput::Write(IMFSample*, const BYTE* data, DWORD size)
+    {
+        if (!m_backend->IsOpen())
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        HRESULT hr = m_encoder->Encode(data, size);
+
+        if (SUCCEEDED(hr) && m_muxerFailed)
+        {
+            hr = MuxerError();
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_bytes += size;
+        }
+
+        return hr;
+    }
+
+    HRESULT Fmp4FileOutput::Close()
+    {
+        if (!m_backend->IsOpen())
+        {
+            return S_OK;
+        }
+
+        // Last access units, then the pending fragment and the index
+        HRESULT hr = m_encoder->Drain();
+
+        if (SUCCEEDED(hr) && m_muxerFailed)
+        {
+            hr = MuxerError();
+        }
+        if (!m_writer.Finish() && SUCCEEDED(hr))
+        {
+            hr = MuxerError();
+        }
+
+        m_backend->Close();
+
+        return hr;
+    }
+
+    HRESULT CreatePcmSample(const BYTE* data, DWORD size, IMFSample** ppSample)
+    {
+        IMFSample* pSample = NULL;
+        IMFMediaBuffer* pBuffer = NULL;
+        BYTE* pDest = NULL;
+
+        HRESULT hr = MFCreateSample(&pSample);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = MFCreateMemoryBuffer(size, &pBuffer);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pBuffer->Lock(&pDest, NULL, NULL);
+        }
+        if (SUCCEEDED(hr))
+        {
+            std::memcpy(pDest, data, size);
+            pBuffer->Unlock();
+            hr = pBuffer->SetCurrentLength(size);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->AddBuffer(pBuffer);
+        }
+        if (SUCCEEDED(hr))
+        {
+            *ppSample = pSample;
+            (*ppSample)->AddRef();
+        }
+
+        SafeRelease(&pBuffer);
+        SafeRelease(&pSample);
+
+        return hr;
+    }
+}
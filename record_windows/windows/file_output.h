@@ -0,0 +1,169 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+#include <mfidl.h>
+#include <mfapi.h>
+#include <mferror.h>
+#include <Mfreadwrite.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "utils.h"
+#include "wav_writer.h"
+#include "opus_ogg_encoder.h"
+#include "flac_encoder.h"
+#include "fmp4_writer.h"
+#include "stream_encoder.h"
+
+namespace record_windows
+{
+    // File written by the recorder from captured PCM 16 bits samples.
+    //
+    // Outputs are created on any thread, then driven by one thread at a time
+    // (the pipeline worker while recording).
+    class FileOutput
+    {
+    public:
+        virtual ~FileOutput() = default;
+
+        // pSample may be NULL (e.g. part of a sample split on a segment
+        // boundary), data always holds the PCM bytes.
+        virtual HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) = 0;
+
+        // Finalizes the file. Safe to call several times.
+        virtual HRESULT Close() = 0;
+
+        // PCM bytes written so far.
+        virtual uint64_t Bytes() const = 0;
+
+        const std::wstring& Path() const { return m_path; }
+
+    protected:
+        explicit FileOutput(std::wstring path) : m_path(std::move(path)) {}
+
+    private:
+        std::wstring m_path;
+    };
+
+    // Native WAV or headerless PCM file, see WavWriter.
+    class WavFileOutput : public FileOutput
+    {
+    public:
+        static HRESULT Create(const std::wstring& path, const WavFormat& format, const WavWriter::Options& options, std::unique_ptr<FileOutput>& output);
+
+        ~WavFileOutput() override;
+
+        HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) override;
+        HRESULT Close() override;
+        uint64_t Bytes() const override { return m_writer.DataBytes(); }
+
+    private:
+        explicit WavFileOutput(std::wstring path);
+
+        WavWriter m_writer;
+    };
+
+    // Encoded file written by a Media Foundation sink writer.
+    //
+    // Sample times are stamped from the frames written to this file, each
+    // output starts at zero and has no gaps.
+    class SinkWriterOutput : public FileOutput
+    {
+    public:
+        static HRESULT Create(const std::wstring& path, IMFMediaType* pTypeOut, IMFMediaType* pTypeIn, UINT32 sampleRate, UINT32 blockAlign, std::unique_ptr<FileOutput>& output);
+
+        ~SinkWriterOutput() override;
+
+        HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) override;
+        HRESULT Close() override;
+        uint64_t Bytes() const override { return m_bytes; }
+
+    private:
+        SinkWriterOutput(std::wstring path, IMFSinkWriter* pWriter, DWORD streamIndex, UINT32 sampleRate, UINT32 blockAlign);
+
+        IMFSinkWriter* m_pWriter;
+        DWORD m_streamIndex;
+        UINT32 m_sampleRate;
+        UINT32 m_blockAlign;
+        uint64_t m_frames = 0;
+        uint64_t m_bytes = 0;
+    };
+
+    // Opus in Ogg, encoded in-process (see OpusOggEncoder).
+    class OggOpusFileOutput : public FileOutput
+    {
+    public:
+        static HRESULT Create(const std::wstring& path, const OpusOggEncoder::Options& options, std::unique_ptr<FileOutput>& output);
+
+        ~OggOpusFileOutput() override;
+
+        HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) override;
+        HRESULT Close() override;
+        uint64_t Bytes() const override { return m_bytes; }
+
+    private:
+        explicit OggOpusFileOutput(std::wstring path);
+
+        HRESULT EncoderError() const;
+
+        std::unique_ptr<FileBackend> m_backend;
+        OpusOggEncoder m_encoder;
+        UINT32 m_blockAlign = 0;
+        uint64_t m_fileBytes = 0;
+        uint64_t m_bytes = 0;
+    };
+
+    // Native FLAC, encoded in-process (see FlacEncoder).
+    class FlacFileOutput : public FileOutput
+    {
+    public:
+        static HRESULT Create(const std::wstring& path, const FlacEncoder::Options& options, std::unique_ptr<FileOutput>& output);
+
+        ~FlacFileOutput() override;
+
+        HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) override;
+        HRESULT Close() override;
+        uint64_t Bytes() const override { return m_bytes; }
+
+    private:
+        explicit FlacFileOutput(std::wstring path);
+
+        std::unique_ptr<FileBackend> m_backend;
+        FlacEncoder m_encoder;
+        UINT32 m_blockAlign = 0;
+        uint64_t m_bytes = 0;
+    };
+
+    // AAC-LC in fragmented MP4 (see Fmp4Writer), encoded by the Media
+    // Foundation AAC encoder without sink writer. Readable while recording
+    // and up to the last fragment after a crash.
+    class Fmp4FileOutput : public FileOutput
+    {
+    public:
+        static HRESULT Create(const std::wstring& path, const StreamEncoderConfig& config, UINT32 fragmentMs, std::unique_ptr<FileOutput>& output);
+
+        ~Fmp4FileOutput() override;
+
+        HRESULT Write(IMFSample* pSample, const BYTE* data, DWORD size) override;
+        HRESULT Close() override;
+        uint64_t Bytes() const override { return m_bytes; }
+
+    private:
+        explicit Fmp4FileOutput(std::wstring path);
+
+        HRESULT MuxerError() const;
+
+        std::unique_ptr<FileBackend> m_backend;
+        std::unique_ptr<StreamEncoder> m_encoder;
+        Fmp4Writer m_writer;
+        bool m_muxerFailed = false;
+        uint64_t m_fileBytes = 0;
+        uint64_t m_bytes = 0;
+    };
+
+    // New sample holding a copy of the given bytes.
+    HRESULT CreatePcmSample(const BYTE* data, DWORD size, IMFSample** ppSample);
+}
@@ -0,0 +1,1047 @@
+#include "flac_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace record_windows
+{
+    namespace
+    {
+        constexpr uint32_t kBitsPerSample = 16;
+        constexpr uint32_t kMaxLpcOrder = 32;
+        constexpr uint32_t kMaxFixedOrder = 4;
+        constexpr uint32_t kMaxPartitionOrder = 8;
+        constexpr size_t kStreamInfoBytes = 34;
+        constexpr size_t kSeekPointBytes = 18;
+        constexpr double kPi = 3.14159265358979323846;
+
+        struct CrcTables
+        {
+            uint8_t crc8[256];
+            uint16_t crc16[256];
+
+            CrcTables()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t c8 = i;
+                    uint32_t c16 = i << 8;
+                    for (int bit = 0; bit < 8; bit++)
+                    {
+                        c8 = (c8 & 0x80) ? (c8 << 1) ^ 0x07 : (c8 << 1);
+                        c16 = (c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : (c16 << 1);
+                    }
+                    crc8[i] = (uint8_t)c8;
+                    crc16[i] = (uint16_t)c16;
+                }
+            }
+        };
+
+        const CrcTables kCrc;
+
+        uint8_t Crc8(const uint8_t* data, size_t size)
+        {
+            uint8_t crc = 0;
+            for (size_t i = 0; i < size; i++) crc = kCrc.crc8[crc ^ data[i]];
+            return crc;
+        }
+
+        uint16_t Crc16(const uint8_t* data, size_t size)
+        {
+            uint16_t crc = 0;
+            for (size_t i = 0; i < size; i++) crc = (uint16_t)((crc << 8) ^ kCrc.crc16[(crc >> 8) ^ data[i]]);
+            return crc;
+        }
+
+        inline uint32_t ZigZag(int32_t value)
+        {
+            return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        }
+
+        uint32_t SampleRateCode(uint32_t sampleRate)
+        {
+            switch (sampleRate)
+            {
+            case 88200: return 1;
+            case 176400: return 2;
+            case 192000: return 3;
+            case 8000: return 4;
+            case 16000: return 5;
+            case 22050: return 6;
+            case 24000: return 7;
+            case 32000: return 8;
+            case 44100: return 9;
+            case 48000: return 10;
+            case 96000: return 11;
+            default: return 0;  // from STREAMINFO
+            }
+        }
+
+        uint32_t BlockSizeCode(uint32_t blockSize)
+        {
+            switch (blockSize)
+            {
+            case 192: return 1;
+            case 576: return 2;
+            case 1152: return 3;
+            case 2304: return 4;
+            case 4608: return 5;
+            case 256: return 8;
+            case 512: return 9;
+            case 1024: return 10;
+            case 2048: return 11;
+            case 4096: return 12;
+            case 8192: return 13;
+            case 16384: return 14;
+            case 32768: return 15;
+            default: return blockSize <= 256 ? 6 : 7;  // explicit size after the frame number
+            }
+        }
+
+        // Coefficients precision for a block size, as the reference encoder
+        uint32_t LpcPrecision(uint32_t blockSize)
+        {
+            if (blockSize <= 192) return 7;
+            if (blockSize <= 384) return 8;
+            if (blockSize <= 576) return 9;
+            if (blockSize <= 1152) return 10;
+            if (blockSize <= 2304) return 11;
+            if (blockSize <= 4608) return 12;
+            return 13;
+        }
+
+        // Partitioned Rice parameters of a residual, see PlanResidual
+        struct RicePlan
+        {
+            uint32_t partitionOrder = 0;
+            bool wideParameters = false;        // 5 bits parameters (coding method 1)
+            uint32_t parameters[1 << kMaxPartitionOrder];
+            uint64_t bits = UINT64_MAX;
+        };
+
+        inline uint64_t RiceBits(uint64_t sum, uint32_t count, uint32_t k)
+        {
+            return (uint64_t)count * (k + 1) + (sum >> k);
+        }
+
+        inline uint32_t BestRiceParameter(uint64_t sum, uint32_t count)
+        {
+            // Cost is convex in k, start from the mean
+            uint32_t k = 0;
+            if (count > 0 && sum > count)
+            {
+                uint64_t mean = sum / count;
+                while (k < 30 && (1ull << (k + 1)) <= mean) k++;
+            }
+
+            uint64_t bits = RiceBits(sum, count, k);
+            while (k > 0 && RiceBits(sum, count, k - 1) < bits) bits = RiceBits(sum, count, --k);
+            while (k < 30 && RiceBits(sum, count, k + 1) < bits) bits = RiceBits(sum, count, ++k);
+            return k;
+        }
+
+        // Picks the partition order and Rice parameters of the residual
+        // (n samples, the first order ones being warm-up).
+        void PlanResidual(const int32_t* residual, uint32_t n, uint32_t order, uint32_t maxPartitionOrder, RicePlan& plan)
+        {
+            // Finest usable order: partitions must split the block evenly and
+            // the first one must hold more than the warm-up
+            uint32_t maxOrder = std::min(maxPartitionOrder, kMaxPartitionOrder);
+            while (maxOrder > 0 && ((n & ((1u << maxOrder) - 1)) != 0 || (n >> maxOrder) <= order)) maxOrder--;
+
+            uint64_t sums[1 << kMaxPartitionOrder];
+            const uint32_t partitions = 1u << maxOrder;
+            const uint32_t partitionSize = n >> maxOrder;
+
+            for (uint32_t p = 0; p < partitions; p++)
+            {
+                uint32_t start = p == 0 ? order : p * partitionSize;
+                uint32_t end = (p + 1) * partitionSize;
+                uint64_t sum = 0;
+                for (uint32_t i = start; i < end; i++) sum += ZigZag(residual[i]);
+                sums[p] = sum;
+            }
+
+            plan.bits = UINT64_MAX;
+
+            for (int32_t po = (int32_t)maxOrder; po >= 0; po--)
+            {
+                const uint32_t count = 1u << po;
+                const uint32_t size = n >> po;
+                uint64_t bits = 2 + 4;
+                uint32_t parameters[1 << kMaxPartitionOrder];
+                bool wide = false;
+
+                for (uint32_t p = 0; p < count; p++)
+                {
+                    uint32_t samples = p == 0 ? size - order : size;
+                    uint32_t k = BestRiceParameter(sums[p], samples);
+                    parameters[p] = k;
+                    wide |= k > 14;
+                    bits += RiceBits(sums[p], samples, k);
+                }
+                bits += (uint64_t)count * (wide ? 5 : 4);
+
+                if (bits < plan.bits)
+                {
+                    plan.bits = bits;
+                    plan.partitionOrder = (uint32_t)po;
+                    plan.wideParameters = wide;
+                    std::memcpy(plan.parameters, parameters, count * sizeof(uint32_t));
+                }
+
+                // Merge pairs for the next (coarser) order
+                for (uint32_t p = 0; p < count / 2; p++) sums[p] = sums[2 * p] + sums[2 * p + 1];
+            }
+        }
+
+        void FixedResidual(const int32_t* x, uint32_t n, uint32_t order, int32_t* residual)
+        {
+            for (uint32_t i = 0; i < order; i++) residual[i] = x[i];
+
+            switch (order)
+            {
+            case 0:
+                for (uint32_t i = 0; i < n; i++) residual[i] = x[i];
+                break;
+            case 1:
+                for (uint32_t i = 1; i < n; i++) residual[i] = x[i] - x[i - 1];
+                break;
+            case 2:
+                for (uint32_t i = 2; i < n; i++) residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+                break;
+            case 3:
+                for (uint32_t i = 3; i < n; i++) residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+                break;
+            default:
+                for (uint32_t i = 4; i < n; i++) residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+                break;
+            }
+        }
+
+        // Order with the smallest residual magnitude (reference heuristic),
+        // bits estimated from it
+        uint32_t GuessFixedOrder(const int32_t* x, uint32_t n, uint64_t* estimatedBits)
+        {
+            if (n <= kMaxFixedOrder)
+            {
+                if (estimatedBits) *estimatedBits = (uint64_t)n * 17;
+                return 0;
+            }
+
+            uint64_t sums[kMaxFixedOrder + 1] = {};
+            int32_t e0p = x[3], e1p = x[3] - x[2], e2p = e1p - (x[2] - x[1]), e3p = e2p - (x[2] - 2 * x[1] + x[0]);
+
+            for (uint32_t i = 4; i < n; i++)
+            {
+                int32_t e0 = x[i];
+                int32_t e1 = e0 - e0p;
+                int32_t e2 = e1 - e1p;
+                int32_t e3 = e2 - e2p;
+                int32_t e4 = e3 - e3p;
+
+                sums[0] += (uint64_t)std::abs((int64_t)e0);
+                sums[1] += (uint64_t)std::abs((int64_t)e1);
+                sums[2] += (uint64_t)std::abs((int64_t)e2);
+                sums[3] += (uint64_t)std::abs((int64_t)e3);
+                sums[4] += (uint64_t)std::abs((int64_t)e4);
+
+                e0p = e0;
+                e1p = e1;
+                e2p = e2;
+                e3p = e3;
+            }
+
+            uint32_t order = 0;
+            for (uint32_t o = 1; o <= kMaxFixedOrder; o++)
+            {
+                if (sums[o] < sums[order]) order = o;
+            }
+
+            if (estimatedBits)
+            {
+                uint32_t count = n - 4;
+                uint64_t sum = sums[order] * 2;
+                *estimatedBits = RiceBits(sum, count, BestRiceParameter(sum, count));
+            }
+            return order;
+        }
+
+        // Levinson-Durbin recursion, lpc[o - 1] holds the coefficients of order o.
+        // Returns the highest order computed (stops on a perfect prediction).
+        uint32_t ComputeLpc(const double* autoc, uint32_t maxOrder, double lpc[][kMaxLpcOrder], double* error)
+        {
+            double a[kMaxLpcOrder] = {};
+            double err = autoc[0];
+
+            for (uint32_t i = 0; i < maxOrder; i++)
+            {
+                double r = -autoc[i + 1];
+                for (uint32_t j = 0; j < i; j++) r -= a[j] * autoc[i - j];
+                r /= err;
+
+                a[i] = r;
+                for (uint32_t j = 0; j < i / 2; j++)
+                {
+                    double tmp = a[j];
+                    a[j] += r * a[i - 1 - j];
+                    a[i - 1 - j] += r * tmp;
+                }
+                if (i & 1) a[i / 2] += a[i / 2] * r;
+
+                err *= 1.0 - r * r;
+
+                // Predictor coefficients are the negated filter
+                for (uint32_t j = 0; j <= i; j++) lpc[i][j] = -a[j];
+                error[i] = err;
+
+                if (err <= 0.0) return i + 1;
+            }
+            return maxOrder;
+        }
+
+        // Quantizes with error feedback. False when the coefficients can't
+        // be represented (shift would be negative).
+        bool QuantizeLpc(const double* lpc, uint32_t order, uint32_t precision, int32_t* qlp, int* shift)
+        {
+            double cmax = 0.0;
+            for (uint32_t i = 0; i < order; i++) cmax = std::max(cmax, std::fabs(lpc[i]));
+            if (cmax <= 0.0) return false;
+
+            int log2cmax;
+            std::frexp(cmax, &log2cmax);
+
+            const int magnitudeBits = (int)precision - 1;
+            int s = magnitudeBits - log2cmax;
+            if (s > 15) s = 15;
+            if (s < 0) return false;
+
+            const int32_t qmax = (1 << magnitudeBits) - 1;
+            const int32_t qmin = -(1 << magnitudeBits);
+            double error = 0.0;
+
+            for (uint32_t i = 0; i < order; i++)
+            {
+                error += lpc[i] * (double)(1 << s);
+                int32_t q = (int32_t)std::lround(error);
+                q = std::clamp(q, qmin, qmax);
+                error -= q;
+                qlp[i] = q;
+            }
+
+            *shift = s;
+            return true;
+        }
+
+        // False when a residual doesn't fit the Rice coder.
+        bool LpcResidual(const int32_t* x, uint32_t n, const int32_t* qlp, uint32_t order, int shift, int32_t* residual)
+        {
+            for (uint32_t i = 0; i < order; i++) residual[i] = x[i];
+
+            for (uint32_t i = order; i < n; i++)
+            {
+                int64_t sum = 0;
+                for (uint32_t j = 0; j < order; j++) sum += (int64_t)qlp[j] * x[i - j - 1];
+
+                int64_t r = (int64_t)x[i] - (sum >> shift);
+                if (r > (1 << 29) || r < -(1 << 29)) return false;
+                residual[i] = (int32_t)r;
+            }
+            return true;
+        }
+    }
+
+    // MSB first bit packing into a byte vector
+    class FlacBitWriter
+    {
+    public:
+        explicit FlacBitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+        // bits <= 32
+        void Write(uint32_t value, uint32_t bits)
+        {
+            if (bits == 0) return;
+            uint64_t mask = bits == 32 ? 0xFFFFFFFFull : ((1ull << bits) - 1);
+            m_acc = (m_acc << bits) | (value & mask);
+            m_count += bits;
+
+            while (m_count >= 8)
+            {
+                m_count -= 8;
+                m_out.push_back((uint8_t)(m_acc >> m_count));
+            }
+        }
+
+        void WriteSigned(int32_t value, uint32_t bits) { Write((uint32_t)value, bits); }
+
+        void WriteRice(int32_t value, uint32_t k)
+        {
+            uint32_t u = ZigZag(value);
+            uint32_t q = u >> k;
+
+            while (q >= 32)
+            {
+                Write(0, 32);
+                q -= 32;
+            }
+
+            // Unary quotient (q zeros, then 1) and the k low bits
+            if (q + 1 + k <= 32)
+            {
+                Write((1u << k) | (k ? (u & ((1u << k) - 1)) : 0), q + 1 + k);
+            }
+            else
+            {
+                Write(1, q + 1);
+                Write(u, k);
+            }
+        }
+
+        void AlignToByte()
+        {
+            if (m_count > 0) Write(0, 8 - m_count);
+        }
+
+    private:
+        std::vector<uint8_t>& m_out;
+        uint64_t m_acc = 0;
+        uint32_t m_count = 0;
+    };
+
+    namespace
+    {
+        void WriteResidual(FlacBitWriter& writer, const int32_t* residual, uint32_t n, uint32_t order, const RicePlan& plan)
+        {
+            writer.Write(plan.wideParameters ? 1 : 0, 2);
+            writer.Write(plan.partitionOrder, 4);
+
+            const uint32_t count = 1u << plan.partitionOrder;
+            const uint32_t size = n >> plan.partitionOrder;
+            const uint32_t parameterBits = plan.wideParameters ? 5 : 4;
+
+            for (uint32_t p = 0; p < count; p++)
+            {
+                uint32_t k = plan.parameters[p];
+                writer.Write(k, parameterBits);
+
+                uint32_t start = p == 0 ? order : p * size;
+                uint32_t end = (p + 1) * size;
+                for (uint32_t i = start; i < end; i++) writer.WriteRice(residual[i], k);
+            }
+        }
+
+        void WriteUtf8(FlacBitWriter& writer, uint64_t value)
+        {
+            if (value < 0x80)
+            {
+                writer.Write((uint32_t)value, 8);
+                return;
+            }
+
+            // Leading byte holds 7 - bytes bits, continuation bytes 6 bits each
+            int bytes = 2;
+            while (bytes < 7 && value >= (1ull << (5 * bytes + 1))) bytes++;
+
+            uint32_t lead = (0xFF00u >> bytes) & 0xFF;
+            writer.Write(lead | (uint32_t)(value >> (6 * (bytes - 1))), 8);
+            for (int i = bytes - 2; i >= 0; i--)
+            {
+                writer.Write(0x80 | (uint32_t)((value >> (6 * i)) & 0x3F), 8);
+            }
+        }
+    }
+
+    FlacFrameEncoder::Params FlacFrameEncoder::ParamsFor(int compressionLevel)
+    {
+        Params params;
+
+        switch (std::clamp(compressionLevel, 0, 8))
+        {
+        case 0: params = { 1152, 0, 3, false, false }; break;
+        case 1: params = { 1152, 0, 3, true, false }; break;
+        case 2: params = { 1152, 0, 3, true, true }; break;
+        case 3: params = { 4096, 6, 4, false, false }; break;
+        case 4: params = { 4096, 8, 4, true, false }; break;
+        case 5: params = { 4096, 8, 5, true, false }; break;
+        case 6: params = { 4096, 8, 6, true, false }; break;
+        case 7: params = { 4096, 12, 6, true, false }; break;
+        default: params = { 4096, 12, 6, true, true }; break;
+        }
+
+        return params;
+    }
+
+    void FlacFrameEncoder::PrepareWindow(uint32_t n)
+    {
+        if (m_window.size() == n) return;
+
+        // Tukey (0.5), as the reference encoder
+        m_window.assign(n, 1.0);
+        const uint32_t taper = n / 4;
+        for (uint32_t i = 0; i < taper && taper > 1; i++)
+        {
+            double w = 0.5 - 0.5 * std::cos(kPi * i / (taper - 1));
+            m_window[i] = w;
+            m_window[n - 1 - i] = w;
+        }
+        m_windowed.resize(n);
+    }
+
+    void FlacFrameEncoder::EncodeSubframe(FlacBitWriter& writer, const int32_t* x, uint32_t n, uint32_t bps, const Params& params)
+    {
+        // Constant
+        bool constant = true;
+        for (uint32_t i = 1; i < n && constant; i++) constant = x[i] == x[0];
+
+        if (constant)
+        {
+            writer.Write(0x00, 8);  // padding, type 000000, no wasted bits
+            writer.WriteSigned(x[0], bps);
+            return;
+        }
+
+        m_residual.resize(n);
+        m_trial.resize(n);
+
+        RicePlan best;
+        RicePlan trial;
+        uint32_t bestOrder = 0;
+        bool bestLpc = false;
+        int32_t bestQlp[kMaxLpcOrder];
+        uint32_t precision = LpcPrecision(n);
+        int bestShift = 0;
+
+        // Fixed predictors
+        uint64_t bestBits = UINT64_MAX;
+        uint32_t firstOrder = 0;
+        uint32_t lastOrder = std::min(kMaxFixedOrder, n - 1);
+
+        if (!params.exhaustive)
+        {
+            firstOrder = lastOrder = std::min(GuessFixedOrder(x, n, nullptr), n - 1);
+        }
+
+        for (uint32_t order = firstOrder; order <= lastOrder; order++)
+        {
+            FixedResidual(x, n, order, m_trial.data());
+            PlanResidual(m_trial.data(), n, order, params.maxPartitionOrder, trial);
+
+            uint64_t bits = 8 + (uint64_t)order * bps + trial.bits;
+            if (bits < bestBits)
+            {
+                bestBits = bits;
+                bestOrder = order;
+                best = trial;
+                m_residual.swap(m_trial);
+            }
+        }
+
+        // Linear prediction
+        uint32_t maxLpcOrder = std::min({ params.maxLpcOrder, kMaxLpcOrder, n - 1 });
+
+        if (maxLpcOrder > 0)
+        {
+            PrepareWindow(n);
+            for (uint32_t i = 0; i < n; i++) m_windowed[i] = x[i] * m_window[i];
+
+            double autoc[kMaxLpcOrder + 1];
+            for (uint32_t lag = 0; lag <= maxLpcOrder; lag++)
+            {
+                double sum = 0.0;
+                for (uint32_t i = lag; i < n; i++) sum += m_windowed[i] * m_windowed[i - lag];
+                autoc[lag] = sum;
+            }
+
+            if (autoc[0] > 0.0)
+            {
+                double lpc[kMaxLpcOrder][kMaxLpcOrder];
+                double error[kMaxLpcOrder];
+                maxLpcOrder = ComputeLpc(autoc, maxLpcOrder, lpc, error);
+
+                uint32_t firstLpc = 1;
+                uint32_t lastLpc = maxLpcOrder;
+
+                if (!params.exhaustive)
+                {
+                    // Expected bits from the prediction error of each order
+                    double bestEstimate = 1e300;
+                    const double errorScale = 0.5 / n;
+
+                    for (uint32_t order = 1; order <= maxLpcOrder; order++)
+                    {
+                        double perSample = error[order - 1] > 0.0 ? std::max(0.0, 0.5 * std::log2(errorScale * error[order - 1])) : 0.0;
+                        double estimate = perSample * (n - order) + (double)order * (precision + bps);
+                        if (estimate < bestEstimate)
+                        {
+                            bestEstimate = estimate;
+                            firstLpc = lastLpc = order;
+                        }
+                    }
+                }
+
+                for (uint32_t order = firstLpc; order <= lastLpc; order++)
+                {
+                    int32_t qlp[kMaxLpcOrder];
+                    int shift = 0;
+
+                    if (!QuantizeLpc(lpc[order - 1], order, precision, qlp, &shift) ||
+                        !LpcResidual(x, n, qlp, order, shift, m_trial.data()))
+                    {
+                        continue;
+                    }
+
+                    PlanResidual(m_trial.data(), n, order, params.maxPartitionOrder, trial);
+
+                    uint64_t bits = 8 + (uint64_t)order * bps + 4 + 5 + (uint64_t)order * precision + trial.bits;
+                    if (bits < bestBits)
+                    {
+                        bestBits = bits;
+                        bestOrder = order;
+                        bestLpc = true;
+                        bestShift = shift;
+                        std::memcpy(bestQlp, qlp, order * sizeof(int32_t));
+                        best = trial;
+                        m_residual.swap(m_trial);
+                    }
+                }
+            }
+        }
+
+        // Verbatim when prediction doesn't help
+        if (bestBits >= 8 + (uint64_t)n * bps)
+        {
+            writer.Write(0x02, 8);  // type 000001
+            for (uint32_t i = 0; i < n; i++) writer.WriteSigned(x[i], bps);
+            return;
+        }
+
+        if (bestLpc)
+        {
+            writer.Write(0x40 | ((bestOrder - 1) << 1), 8);     // type 1xxxxx
+            for (uint32_t i = 0; i < bestOrder; i++) writer.WriteSigned(x[i], bps);
+            writer.Write(precision - 1, 4);
+            writer.WriteSigned(bestShift, 5);
+            for (uint32_t i = 0; i < bestOrder; i++) writer.WriteSigned(bestQlp[i], precision);
+        }
+        else
+        {
+            writer.Write(0x10 | (bestOrder << 1), 8);           // type 001xxx
+            for (uint32_t i = 0; i < bestOrder; i++) writer.WriteSigned(x[i], bps);
+        }
+
+        WriteResidual(writer, m_residual.data(), n, bestOrder, best);
+    }
+
+    void FlacFrameEncoder::Encode(const int16_t* pcm, uint32_t frames, uint32_t channels, uint32_t sampleRate,
+        uint64_t frameNumber, const Params& params, std::vector<uint8_t>& out)
+    {
+        const uint32_t n = frames;
+        const bool stereo = channels == 2 && params.stereoDecorrelation;
+
+        // Deinterleave, with room for mid and side
+        m_channels.resize((size_t)n * (channels + (stereo ? 2 : 0)));
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            int32_t* dst = m_channels.data() + (size_t)c * n;
+            for (uint32_t i = 0; i < n; i++) dst[i] = pcm[(size_t)i * channels + c];
+        }
+
+        // Channel assignment: independent, or one of left/side, right/side, mid/side
+        uint32_t assignment = channels - 1;
+        const int32_t* signals[8];
+        uint32_t bps[8];
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            signals[c] = m_channels.data() + (size_t)c * n;
+            bps[c] = kBitsPerSample;
+        }
+
+        if (stereo)
+        {
+            const int32_t* left = signals[0];
+            const int32_t* right = signals[1];
+            int32_t* mid = m_channels.data() + 2 * (size_t)n;
+            int32_t* side = m_channels.data() + 3 * (size_t)n;
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                mid[i] = (left[i] + right[i]) >> 1;
+                side[i] = left[i] - right[i];
+            }
+
+            uint64_t bitsLeft, bitsRight, bitsMid, bitsSide;
+            GuessFixedOrder(left, n, &bitsLeft);
+            GuessFixedOrder(right, n, &bitsRight);
+            GuessFixedOrder(mid, n, &bitsMid);
+            GuessFixedOrder(side, n, &bitsSide);
+
+            uint64_t candidates[4] = {
+                bitsLeft + bitsRight,   // independent
+                bitsLeft + bitsSide,    // left/side
+                bitsRight + bitsSide,   // right/side
+                bitsMid + bitsSide,     // mid/side
+            };
+            uint32_t choice = (uint32_t)(std::min_element(candidates, candidates + 4) - candidates);
+
+            switch (choice)
+            {
+            case 1:
+                assignment = 8;
+                signals[1] = side;
+                bps[1] = kBitsPerSample + 1;
+                break;
+            case 2:
+                assignment = 9;
+                signals[0] = side;
+                bps[0] = kBitsPerSample + 1;
+                break;
+            case 3:
+                assignment = 10;
+                signals[0] = mid;
+                signals[1] = side;
+                bps[1] = kBitsPerSample + 1;
+                break;
+            default:
+                break;
+            }
+        }
+
+        out.clear();
+        FlacBitWriter writer(out);
+
+        // Frame header
+        const uint32_t blockSizeCode = BlockSizeCode(n);
+        writer.Write(0xFFF8, 16);       // sync, fixed block size
+        writer.Write(blockSizeCode, 4);
+        writer.Write(SampleRateCode(sampleRate), 4);
+        writer.Write(assignment, 4);
+        writer.Write(4, 3);             // 16 bits per sample
+        writer.Write(0, 1);
+        WriteUtf8(writer, frameNumber);
+        if (blockSizeCode == 6) writer.Write(n - 1, 8);
+        if (blockSizeCode == 7) writer.Write(n - 1, 16);
+        writer.Write(Crc8(out.data(), out.size()), 8);
+
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            EncodeSubframe(writer, signals[c], n, bps[c], params);
+        }
+
+        writer.AlignToByte();
+        uint16_t crc = Crc16(out.data(), out.size());
+        out.push_back((uint8_t)(crc >> 8));
+        out.push_back((uint8_t)crc);
+    }
+
+    // FlacEncoder
+    FlacEncoder::~FlacEncoder()
+    {
+        StopWorkers();
+    }
+
+    bool FlacEncoder::Open(const Options& options, WriteCallback onWrite)
+    {
+        StopWorkers();
+
+        if (options.numChannels < 1 || options.numChannels > 8 ||
+            options.sampleRate == 0 || options.sampleRate >= (1u << 20))
+        {
+            return false;
+        }
+
+        m_options = options;
+        m_params = FlacFrameEncoder::ParamsFor(options.compressionLevel);
+        m_onWrite = std::move(onWrite);
+        m_md5.Reset();
+        m_framesIn = 0;
+        m_frameNumber = 0;
+        m_offset = 0;
+        m_minFrameBytes = 0;
+        m_maxFrameBytes = 0;
+        m_nextSeekSample = 0;
+        m_seekPoints.clear();
+        m_inflight.clear();
+        m_current = nullptr;
+        m_failed = false;
+
+        if (!options.seekable) m_options.seekPoints = 0;
+
+        if (!WriteHeaders(false))
+        {
+            return false;
+        }
+
+        int threads = options.threads;
+        if (threads < 0)
+        {
+            // Leave a core to the capture
+            int cores = (int)std::thread::hardware_concurrency();
+            threads = std::clamp(cores - 1, 0, 8);
+        }
+
+        m_stopping = false;
+        for (int i = 0; i < threads; i++)
+        {
+            m_threads.emplace_back([this]() { WorkerLoop(); });
+        }
+
+        // Enough blocks ahead to keep every worker busy
+        m_maxInflight = std::max<size_t>(1, (size_t)threads * 2);
+        m_open = true;
+
+        return true;
+    }
+
+    bool FlacEncoder::WriteHeaders(bool final)
+    {
+        std::vector<uint8_t> header;
+        auto put = [&header](uint64_t value, int bytes) {
+            for (int i = bytes - 1; i >= 0; i--) header.push_back((uint8_t)(value >> (8 * i)));
+        };
+
+        const bool seekTable = m_options.seekPoints > 0;
+
+        header.insert(header.end(), { 'f', 'L', 'a', 'C' });
+
+        // STREAMINFO, sizes and MD5 are unknown until the end
+        header.push_back(seekTable ? 0x00 : 0x80);
+        put(kStreamInfoBytes, 3);
+        put(m_params.blockSize, 2);
+        put(m_params.blockSize, 2);
+        put(final ? m_minFrameBytes : 0, 3);
+        put(final ? m_maxFrameBytes : 0, 3);
+
+        uint64_t totalSamples = final ? m_framesIn : 0;
+        uint64_t packed = ((uint64_t)m_options.sampleRate << 44) |
+            ((uint64_t)(m_options.numChannels - 1) << 41) |
+            ((uint64_t)(kBitsPerSample - 1) << 36) |
+            (totalSamples & 0xFFFFFFFFFull);
+        put(packed, 8);
+
+        uint8_t digest[16] = {};
+        if (final) m_md5.Final(digest);
+        header.insert(header.end(), digest, digest + 16);
+
+        if (seekTable)
+        {
+            header.push_back(0x80 | 3);
+            put(m_options.seekPoints * kSeekPointBytes, 3);
+
+            // Evenly spread over the recorded points, placeholders after
+            const size_t available = final ? m_seekPoints.size() : 0;
+            const size_t used = std::min<size_t>(available, m_options.seekPoints);
+
+            for (size_t i = 0; i < m_options.seekPoints; i++)
+            {
+                if (i < used)
+                {
+                    const SeekPoint& point = m_seekPoints[i * available / used];
+                    put(point.sample, 8);
+                    put(point.offset, 8);
+                    put(point.frames, 2);
+                }
+                else
+                {
+                    put(UINT64_MAX, 8);
+                    put(0, 8);
+                    put(0, 2);
+                }
+            }
+        }
+
+        m_firstFrameOffset = header.size();
+        if (!final) m_offset = header.size();
+
+        if (m_onWrite && !m_onWrite(0, header.data(), header.size()))
+        {
+            m_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    void FlacEncoder::WorkerLoop()
+    {
+        FlacFrameEncoder encoder;
+
+        for (;;)
+        {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_workReady.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+                if (m_queue.empty()) return;
+
+                job = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            encoder.Encode(job->pcm.data(), job->frames, m_options.numChannels, m_options.sampleRate,
+                job->frameNumber, m_params, job->out);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                job->done = true;
+            }
+            m_jobDone.notify_all();
+        }
+    }
+
+    void FlacEncoder::StopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workReady.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_threads.clear();
+        m_queue.clear();
+    }
+
+    void FlacEncoder::Submit()
+    {
+        std::unique_ptr<Job> job = std::move(m_current);
+        job->frameNumber = m_frameNumber++;
+        job->done = false;
+
+        if (m_threads.empty())
+        {
+            m_inlineEncoder.Encode(job->pcm.data(), job->frames, m_options.numChannels, m_options.sampleRate,
+                job->frameNumber, m_params, job->out);
+            job->done = true;
+            m_inflight.push_back(std::move(job));
+            return;
+        }
+
+        Job* pending = job.get();
+        m_inflight.push_back(std::move(job));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(pending);
+        }
+        m_workReady.notify_one();
+    }
+
+    bool FlacEncoder::WriteCompleted(bool all)
+    {
+        while (!m_inflight.empty())
+        {
+            Job* front = m_inflight.front().get();
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if (!front->done)
+                {
+                    // Wait only when the pool is saturated (or finishing)
+                    if (!all && m_inflight.size() <= m_maxInflight) break;
+                    m_jobDone.wait(lock, [front]() { return front->done; });
+                }
+            }
+
+            if (!m_failed && !WriteFrame(*front))
+            {
+                m_failed = true;
+            }
+
+            m_free.push_back(std::move(m_inflight.front()));
+            m_inflight.pop_front();
+        }
+
+        return !m_failed;
+    }
+
+    bool FlacEncoder::WriteFrame(const Job& job)
+    {
+        const uint32_t size = (uint32_t)job.out.size();
+        const uint64_t sample = job.frameNumber * m_params.blockSize;
+
+        // One seek point candidate per second
+        if (m_options.seekPoints > 0 && sample >= m_nextSeekSample)
+        {
+            m_seekPoints.push_back({ sample, m_offset - m_firstFrameOffset, job.frames });
+            m_nextSeekSample = sample + m_options.sampleRate;
+        }
+
+        m_minFrameBytes = m_minFrameBytes == 0 ? size : std::min(m_minFrameBytes, size);
+        m_maxFrameBytes = std::max(m_maxFrameBytes, size);
+
+        if (m_onWrite && !m_onWrite(m_offset, job.out.data(), job.out.size()))
+        {
+            return false;
+        }
+
+        m_offset += size;
+        return true;
+    }
+
+    bool FlacEncoder::Encode(const int16_t* pcm, size_t frames)
+    {
+        if (!m_open || m_failed) return false;
+
+        const uint32_t channels = m_options.numChannels;
+        m_md5.Update(reinterpret_cast<const uint8_t*>(pcm), frames * channels * sizeof(int16_t));   // little-endian hosts
+        m_framesIn += frames;
+
+        while (frames > 0)
+        {
+            if (!m_current)
+            {
+                if (!m_free.empty())
+                {
+                    m_current = std::move(m_free.back());
+                    m_free.pop_back();
+                }
+                else
+                {
+                    m_current = std::make_unique<Job>();
+                }
+                m_current->pcm.resize((size_t)m_params.blockSize * channels);
+                m_current->frames = 0;
+            }
+
+            Job& job = *m_current;
+            size_t count = std::min<size_t>(frames, m_params.blockSize - job.frames);
+            std::memcpy(job.pcm.data() + (size_t)job.frames * channels, pcm, count * channels * sizeof(int16_t));
+            job.frames += (uint32_t)count;
+            pcm += count * channels;
+            frames -= count;
+
+            if (job.frames == m_params.blockSize)
+            {
+                Submit();
+            }
+        }
+
+        return WriteCompleted(false);
+    }
+
+    bool FlacEncoder::Finish()
+    {
+        if (!m_open) return !m_failed;
+        m_open = false;
+
+        // Last block is shorter
+        if (m_current && m_current->frames > 0)
+        {
+            Submit();
+        }
+        m_current = nullptr;
+
+        bool ok = WriteCompleted(true);
+        StopWorkers();
+
+        if (ok && m_options.seekable)
+        {
+            ok = WriteHeaders(true);
+        }
+
+        return ok;
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "md5.h"
+
+namespace record_windows
+{
+    class FlacBitWriter;
+
+    // Encodes single FLAC frames from PCM 16 bits samples.
+    //
+    // Subframes are constant, verbatim, fixed or LPC predicted, whichever is
+    // the smallest, with partitioned Rice residuals. Stereo picks the best of
+    // independent, left/side, right/side and mid/side.
+    // Holds scratch buffers: one instance per thread.
+    class FlacFrameEncoder
+    {
+    public:
+        struct Params
+        {
+            uint32_t blockSize = 4096;
+            uint32_t maxLpcOrder = 8;           // 0: fixed predictors only
+            uint32_t maxPartitionOrder = 5;
+            bool stereoDecorrelation = true;
+            bool exhaustive = false;            // tries every predictor order
+        };
+
+        // Same presets as the reference encoder (0 fastest to 8 smallest).
+        static Params ParamsFor(int compressionLevel);
+
+        // Interleaved samples, frames <= params.blockSize. out is replaced
+        // by the whole frame (header to CRC).
+        void Encode(const int16_t* pcm, uint32_t frames, uint32_t channels, uint32_t sampleRate,
+            uint64_t frameNumber, const Params& params, std::vector<uint8_t>& out);
+
+    private:
+        void EncodeSubframe(FlacBitWriter& writer, const int32_t* x, uint32_t n, uint32_t bps, const Params& params);
+        void PrepareWindow(uint32_t n);
+
+        std::vector<int32_t> m_channels;    // deinterleaved, then mid and side
+        std::vector<int32_t> m_residual;
+        std::vector<int32_t> m_trial;
+        std::vector<double> m_window;
+        std::vector<double> m_windowed;
+    };
+
+    // Streaming FLAC encoder.
+    //
+    // Blocks are encoded on a worker pool and written in order by the
+    // calling thread, as they complete. The MD5 signature is computed while
+    // streaming; on seekable outputs, STREAMINFO and the seek table are
+    // rewritten by Finish().
+    // Portable, Encode() and Finish() called from one thread at a time.
+    class FlacEncoder
+    {
+    public:
+        struct Options
+        {
+            uint32_t sampleRate = 44100;
+            uint32_t numChannels = 2;           // 1 to 8
+            int compressionLevel = 5;           // 0 to 8
+            int threads = -1;                   // -1: from the CPU count, 0: calling thread
+            bool seekable = true;               // false: headers are never rewritten (streaming)
+            uint32_t seekPoints = 100;          // reserved seek table entries, seekable only
+        };
+
+        // Positioned write. Offsets only go forward, except for the header
+        // rewrites of seekable outputs. Returns false to abort.
+        using WriteCallback = std::function<bool(uint64_t offset, const uint8_t* data, size_t size)>;
+
+        FlacEncoder() = default;
+        ~FlacEncoder();
+
+        FlacEncoder(const FlacEncoder&) = delete;
+        FlacEncoder& operator=(const FlacEncoder&) = delete;
+
+        // Writes the stream headers.
+        bool Open(const Options& options, WriteCallback onWrite);
+
+        // Interleaved samples, any number of frames.
+        bool Encode(const int16_t* pcm, size_t frames);
+
+        // Encodes the last block, waits for the pool and finalizes headers.
+        bool Finish();
+
+        uint64_t FramesIn() const { return m_framesIn; }
+        uint64_t BytesWritten() const { return m_offset; }
+
+    private:
+        struct Job
+        {
+            uint64_t frameNumber = 0;
+            uint32_t frames = 0;
+            std::vector<int16_t> pcm;
+            std::vector<uint8_t> out;
+            bool done = false;
+        };
+
+        struct SeekPoint
+        {
+            uint64_t sample;
+            uint64_t offset;
+            uint32_t frames;
+        };
+
+        void Submit();
+        bool WriteCompleted(bool all);
+        bool WriteFrame(const Job& job);
+        bool WriteHeaders(bool final);
+        void WorkerLoop();
+        void StopWorkers();
+
+        Options m_options;
+        FlacFrameEncoder::Params m_params;
+        WriteCallback m_onWrite;
+
+        // Pool
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_workReady;
+        std::condition_variable m_jobDone;
+        std::deque<Job*> m_queue;                       // waiting for a worker
+        bool m_stopping = false;
+        FlacFrameEncoder m_inlineEncoder;               // no worker threads
+
+        // Writer (calling thread)
+        std::deque<std::unique_ptr<Job>> m_inflight;    // submission order
+        std::vector<std::unique_ptr<Job>> m_free;
+        std::unique_ptr<Job> m_current;                 // block being filled
+        size_t m_maxInflight = 1;
+
+        Md5 m_md5;
+
+        uint64_t m_framesIn = 0;
+        uint64_t m_frameNumber = 0;
+        uint64_t m_offset = 0;
+        uint64_t m_firstFrameOffset = 0;
+        uint32_t m_minFrameBytes = 0;
+        uint32_t m_maxFrameBytes = 0;
+        uint64_t m_nextSeekSample = 0;
+        std::vector<SeekPoint> m_seekPoints;
+        bool m_open = false;
+        bool m_failed = false;
+    };
+}
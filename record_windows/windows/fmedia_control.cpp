@@ -0,0 +1,91 @@
+#include "fmedia_control.h"
+
+#include <chrono>
+
+namespace record_windows
+{
+    FmediaControl::FmediaControl(std::unique_ptr<FmediaHost> host)
+        : m_host(std::move(host))
+    {
+    }
+
+    FmediaControl::~FmediaControl()
+    {
+        if (m_running)
+        {
+            Shutdown(kExitTimeoutMs);
+        }
+    }
+
+    bool FmediaControl::Start(const std::wstring& pipeName, const std::vector<std::wstring>& arguments)
+    {
+        if (m_running)
+        {
+            Shutdown(kExitTimeoutMs);
+        }
+
+        if (!m_host->Launch(pipeName, arguments))
+        {
+            return false;
+        }
+
+        m_pipeName = pipeName;
+        m_running = true;
+        return true;
+    }
+
+    bool FmediaControl::Send(const std::string& command)
+    {
+        if (!m_running)
+        {
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool sent = false;
+
+        // A write may race with fmedia closing the previous connection, once more
+        for (int attempt = 0; attempt < 2 && !sent; attempt++)
+        {
+            if (!m_host->Connect(m_pipeName, kConnectTimeoutMs))
+            {
+                break;
+            }
+
+            sent = m_host->Write(command);
+            m_host->Disconnect();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        m_lastCommandUs.store(elapsed.count(), std::memory_order_relaxed);
+        m_commands.fetch_add(1, std::memory_order_relaxed);
+
+        if (!sent)
+        {
+            m_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return sent;
+    }
+
+    bool FmediaControl::Shutdown(uint32_t timeoutMs)
+    {
+        if (!m_running)
+        {
+            return true;
+        }
+
+        // The output is finalized on stop, quit ends the instance
+        bool exited = Send("stop") && Send("quit") && m_host->WaitExit(timeoutMs);
+
+        if (!exited)
+        {
+            m_host->Kill();
+        }
+
+        m_host->Close();
+        m_running = false;
+
+        return exited;
+    }
+}
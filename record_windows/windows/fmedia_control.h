@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace record_windows
+{
+    // Process and global command pipe of one fmedia instance, implemented
+    // per platform.
+    class FmediaHost
+    {
+    public:
+        virtual ~FmediaHost() = default;
+
+        // Starts fmedia with the arguments, listening for commands on pipeName.
+        virtual bool Launch(const std::wstring& pipeName, const std::vector<std::wstring>& arguments) = 0;
+
+        // Opens the command pipe, waits up to timeoutMs while the instance is
+        // starting or busy. False once the process has exited.
+        virtual bool Connect(const std::wstring& pipeName, uint32_t timeoutMs) = 0;
+        virtual bool Write(const std::string& command) = 0;
+        virtual void Disconnect() = 0;
+
+        // False on timeout.
+        virtual bool WaitExit(uint32_t timeoutMs) = 0;
+        virtual void Kill() = 0;
+        // Releases the process, running or not.
+        virtual void Close() = 0;
+    };
+
+    // Drives a recording fmedia instance through its global command pipe.
+    //
+    // The instance is started once per recording, then pause/resume/stop are
+    // short writes to its pipe instead of an fmedia process per command.
+    // fmedia reads one command per connection, each one is sent on its own.
+    // Portable, driven by one thread at a time. Counters can be read from
+    // any thread.
+    class FmediaControl
+    {
+    public:
+        // Pipe start up after launch, or fmedia busy with the previous command
+        static constexpr uint32_t kConnectTimeoutMs = 2000;
+        // Output finalization after stop, before the instance is killed
+        static constexpr uint32_t kExitTimeoutMs = 5000;
+
+        explicit FmediaControl(std::unique_ptr<FmediaHost> host);
+        ~FmediaControl();
+
+        FmediaControl(const FmediaControl&) = delete;
+        FmediaControl& operator=(const FmediaControl&) = delete;
+
+        // Ends the previous instance, if any, as Shutdown(kExitTimeoutMs).
+        bool Start(const std::wstring& pipeName, const std::vector<std::wstring>& arguments);
+
+        // Global command, e.g. "pause" or "unpause".
+        bool Send(const std::string& command);
+
+        // Stops the recording and waits for the instance to exit. Killed on
+        // timeout or when it can't be reached, false then.
+        bool Shutdown(uint32_t timeoutMs);
+
+        bool IsRunning() const { return m_running; }
+
+        uint64_t Commands() const { return m_commands.load(std::memory_order_relaxed); }
+        uint64_t Failures() const { return m_failures.load(std::memory_order_relaxed); }
+        int64_t LastCommandUs() const { return m_lastCommandUs.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<FmediaHost> m_host;
+        std::wstring m_pipeName;
+        bool m_running = false;
+
+        std::atomic<uint64_t> m_commands{ 0 };
+        std::atomic<uint64_t> m_failures{ 0 };
+        std::atomic<int64_t> m_lastCommandUs{ 0 };
+    };
+}
@@ -0,0 +1,150 @@
+#define NOMINMAX
+#include "fmedia_process.h"
+
+#include <shlwapi.h>
+
+namespace record_windows
+{
+    namespace
+    {
+        // Between two polls while the pipe is not created yet
+        constexpr DWORD kPollMs = 5;
+    }
+
+    FmediaProcess::FmediaProcess(std::wstring exePath)
+        : m_exePath(std::move(exePath))
+    {
+    }
+
+    FmediaProcess::~FmediaProcess()
+    {
+        Disconnect();
+        Close();
+    }
+
+    bool FmediaProcess::Launch(const std::wstring& pipeName, const std::vector<std::wstring>& arguments)
+    {
+        Close();
+
+        if (!PathFileExists(m_exePath.c_str()))
+        {
+            return false;
+        }
+
+        std::wstring cmdLine = L"\"" + m_exePath + L"\" --globcmd.pipe-name=" + pipeName;
+        for (const auto& arg : arguments)
+        {
+            cmdLine += L" " + arg;
+        }
+
+        STARTUPINFO si;
+        ZeroMemory(&si, sizeof(si));
+        si.cb = sizeof(si);
+        si.dwFlags = STARTF_USESHOWWINDOW;
+        si.wShowWindow = SW_HIDE;
+
+        PROCESS_INFORMATION pi;
+        ZeroMemory(&pi, sizeof(pi));
+
+        if (!CreateProcess(NULL, &cmdLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+        {
+            return false;
+        }
+
+        // Only the process is waited on
+        CloseHandle(pi.hThread);
+        m_hProcess = pi.hProcess;
+
+        return true;
+    }
+
+    bool FmediaProcess::Connect(const std::wstring& pipeName, uint32_t timeoutMs)
+    {
+        Disconnect();
+
+        const std::wstring path = L"\\\\.\\pipe\\" + pipeName;
+        const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+
+        for (;;)
+        {
+            m_hPipe = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+
+            if (m_hPipe != INVALID_HANDLE_VALUE)
+            {
+                return true;
+            }
+
+            DWORD error = GetLastError();
+            ULONGLONG now = GetTickCount64();
+
+            if (now >= deadline || HasExited())
+            {
+                return false;
+            }
+
+            if (error == ERROR_PIPE_BUSY)
+            {
+                // Serving another client
+                WaitNamedPipe(path.c_str(), (DWORD)(deadline - now));
+            }
+            else if (error == ERROR_FILE_NOT_FOUND)
+            {
+                // Not listening yet, or between two connections
+                Sleep(kPollMs);
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
+    bool FmediaProcess::Write(const std::string& command)
+    {
+        if (m_hPipe == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        DWORD written = 0;
+        return WriteFile(m_hPipe, command.data(), (DWORD)command.size(), &written, NULL) &&
+            written == command.size();
+    }
+
+    void FmediaProcess::Disconnect()
+    {
+        if (m_hPipe != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_hPipe);
+            m_hPipe = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    bool FmediaProcess::WaitExit(uint32_t timeoutMs)
+    {
+        return !m_hProcess || WaitForSingleObject(m_hProcess, timeoutMs) == WAIT_OBJECT_0;
+    }
+
+    void FmediaProcess::Kill()
+    {
+        if (m_hProcess && !HasExited())
+        {
+            TerminateProcess(m_hProcess, 1);
+            WaitForSingleObject(m_hProcess, INFINITE);
+        }
+    }
+
+    void FmediaProcess::Close()
+    {
+        if (m_hProcess)
+        {
+            CloseHandle(m_hProcess);
+            m_hProcess = NULL;
+        }
+    }
+
+    bool FmediaProcess::HasExited() const
+    {
+        return !m_hProcess || WaitForSingleObject(m_hProcess, 0) == WAIT_OBJECT_0;
+    }
+}
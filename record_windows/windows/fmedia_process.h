@@ -0,0 +1,35 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "fmedia_control.h"
+
+namespace record_windows
+{
+    // fmedia.exe child process, commands go to \\.\pipe\<pipe name>.
+    class FmediaProcess : public FmediaHost
+    {
+    public:
+        explicit FmediaProcess(std::wstring exePath);
+        ~FmediaProcess() override;
+
+        bool Launch(const std::wstring& pipeName, const std::vector<std::wstring>& arguments) override;
+        bool Connect(const std::wstring& pipeName, uint32_t timeoutMs) override;
+        bool Write(const std::string& command) override;
+        void Disconnect() override;
+        bool WaitExit(uint32_t timeoutMs) override;
+        void Kill() override;
+        void Close() override;
+
+    private:
+        bool HasExited() const;
+
+        std::wstring m_exePath;
+        HANDLE m_hProcess = NULL;
+        HANDLE m_hPipe = INVALID_HANDLE_VALUE;
+    };
+}
@@ -1,6 +1,7 @@
 #define NOMINMAX
 #include "fmedia_recorder.h"
 #include "record_windows_plugin.h"
+#include "fmedia_process.h"
 #include <shlwapi.h>
 #include <random>
 #include <algorithm>
@@ -11,15 +12,21 @@ namespace record_windows
     const std::wstring FmediaRecorder::FMEDIA_BIN = L"fmedia.exe";
     const std::wstring FmediaRecorder::PIPE_PROC_NAME = L"record_windows";
 
-    FmediaRecorder::FmediaRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler)
+    namespace
+    {
+        // 每次录音使用独立的管道名，多个录音器互不干扰
+        std::atomic<unsigned int> g_pipeCounter{ 0 };
+    }
+
+    FmediaRecorder::FmediaRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue)
         : m_stateEventHandler(stateEventHandler),
           m_recordEventHandler(recordEventHandler),
+          m_dispatchQueue(std::move(dispatchQueue)),
           m_recordState(RecordState::stop),
-          m_processRunning(false),
           m_amplitude(-160.0),
           m_maxAmplitude(-160.0)
     {
-        ZeroMemory(&m_processInfo, sizeof(m_processInfo));
+        m_control = std::make_unique<FmediaControl>(std::make_unique<FmediaProcess>(GetFmediaPath()));
     }
 
     FmediaRecorder::~FmediaRecorder()
@@ -64,13 +71,16 @@ namespace record_windows
         auto encoderSettings = GetEncoderSettings(m_pConfig->encoderName, m_pConfig->bitRate);
         args.insert(args.end(), encoderSettings.begin(), encoderSettings.end());
 
-        hr = CallFmedia(args);
-        if (SUCCEEDED(hr))
+        std::wstring pipeName = PIPE_PROC_NAME + L"-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(++g_pipeCounter);
+
+        // 之后的命令通过该实例的管道发送
+        if (!m_control->Start(pipeName, args))
         {
-            UpdateState(RecordState::record);
+            return E_FAIL;
         }
 
-        return hr;
+        UpdateState(RecordState::record);
+        return S_OK;
     }
 
     HRESULT FmediaRecorder::StartStream(std::unique_ptr<RecordConfig> config)
@@ -79,11 +89,17 @@ namespace record_windows
         return E_NOTIMPL;
     }
 
+    HRESULT FmediaRecorder::Arm(std::unique_ptr<RecordConfig> config)
+    {
+        // fmedia只在Start时启动采集
+        return E_NOTIMPL;
+    }
+
     HRESULT FmediaRecorder::Pause()
     {
         if (m_recordState == RecordState::record)
         {
-            HRESULT hr = CallFmedia({ L"--globcmd=pause" });
+            HRESULT hr = SendCommand("pause");
             if (SUCCEEDED(hr))
             {
                 UpdateState(RecordState::pause);
@@ -97,7 +113,7 @@ namespace record_windows
     {
         if (m_recordState == RecordState::pause)
         {
-            HRESULT hr = CallFmedia({ L"--globcmd=unpause" });
+            HRESULT hr = SendCommand("unpause");
             if (SUCCEEDED(hr))
             {
                 UpdateState(RecordState::record);
@@ -117,7 +133,8 @@ namespace record_windows
         auto recordingPath = GetRecordingPath();
         HRESULT hr = EndRecording();
 
-        if (SUCCEEDED(hr) && !recordingPath.empty())
+        // 即使超时，fmedia也已结束
+        if (!recordingPath.empty())
         {
             DeleteFile(recordingPath.c_str());
         }
@@ -151,6 +168,33 @@ namespace record_windows
         };
     }
 
+    MeterSnapshot FmediaRecorder::GetMeters()
+    {
+        // fmedia不提供PCM数据，无法计量
+        return MeterEngine::SilentSnapshot(0);
+    }
+
+    std::vector<float> FmediaRecorder::GetWaveform(double seconds, int pixels)
+    {
+        return std::vector<float>();
+    }
+
+    HRESULT FmediaRecorder::ExportRecent(double seconds, const std::string& encoderName, std::wstring path, std::function<void(HRESULT)> onDone)
+    {
+        // 音频由fmedia进程直接写入文件，没有内存中的最近音频
+        return E_NOTIMPL;
+    }
+
+    std::map<std::string, int64_t> FmediaRecorder::GetStats()
+    {
+        return {
+            {"dispatchDropped", (int64_t)m_dispatchQueue->DroppedCount()},
+            {"fmediaCommands", (int64_t)m_control->Commands()},
+            {"fmediaCommandFailures", (int64_t)m_control->Failures()},
+            {"fmediaLastCommandUs", m_control->LastCommandUs()},
+        };
+    }
+
     std::wstring FmediaRecorder::GetRecordingPath()
     {
         return m_recordingPath;
@@ -173,6 +217,26 @@ namespace record_windows
         return S_OK;
     }
 
+    HRESULT FmediaRecorder::GetEncoderCapabilities(std::vector<EncoderCapability>& capabilities)
+    {
+        const AudioEncoder encoders;
+        const std::string names[] = {
+            encoders.aacLc, encoders.aacEld, encoders.aacHe, encoders.amrNb, encoders.amrWb,
+            encoders.opus, encoders.flac, encoders.pcm16bits, encoders.wav
+        };
+
+        // fmedia没有格式查询，只报告支持的编码器
+        capabilities.clear();
+        for (const auto& name : names)
+        {
+            EncoderCapability capability;
+            capability.encoderName = name;
+            isEncoderSupported(name, &capability.supported);
+            capabilities.push_back(std::move(capability));
+        }
+        return S_OK;
+    }
+
     void FmediaRecorder::UpdateState(RecordState state)
     {
         {
@@ -182,7 +246,7 @@ namespace record_windows
 
         if (m_stateEventHandler)
         {
-            RecordWindowsPlugin::RunOnMainThread([this, state]() -> void {
+            m_dispatchQueue->Post([this, state]() -> void {
                 m_stateEventHandler->Success(std::make_unique<flutter::EncodableValue>(state));
             });
         }
@@ -272,69 +336,22 @@ namespace record_windows
         return { L"--aac-quality=" + std::to_wstring(quality) };
     }
 
-    HRESULT FmediaRecorder::CallFmedia(const std::vector<std::wstring>& arguments)
+    HRESULT FmediaRecorder::SendCommand(const std::string& command)
     {
-        std::wstring fmediaPath = GetFmediaPath();
-        
-        // 检查fmedia.exe是否存在
-        if (!PathFileExists(fmediaPath.c_str()))
-        {
-            return E_FAIL;
-        }
-
-        // 构建命令行
-        std::wstring cmdLine = L"\"" + fmediaPath + L"\" --globcmd.pipe-name=" + PIPE_PROC_NAME;
-        for (const auto& arg : arguments)
-        {
-            cmdLine += L" " + arg;
-        }
-
-        STARTUPINFO si;
-        ZeroMemory(&si, sizeof(si));
-        si.cb = sizeof(si);
-        si.dwFlags = STARTF_USESHOWWINDOW;
-        si.wShowWindow = SW_HIDE;
-
-        // 创建进程
-        if (!CreateProcess(
-            NULL,
-            const_cast<wchar_t*>(cmdLine.c_str()),
-            NULL,
-            NULL,
-            FALSE,
-            0,
-            NULL,
-            NULL,
-            &si,
-            &m_processInfo))
-        {
-            return E_FAIL;
-        }
-
-        m_processRunning = true;
-        return S_OK;
+        return m_control->Send(command) ? S_OK : E_FAIL;
     }
 
     HRESULT FmediaRecorder::EndRecording()
     {
         HRESULT hr = S_OK;
 
-        if (m_processRunning)
+        if (m_control->IsRunning())
         {
-            // 发送停止和退出命令
-            CallFmedia({ L"--globcmd=stop" });
-            CallFmedia({ L"--globcmd=quit" });
-
-            // 等待进程结束
-            if (m_processInfo.hProcess)
+            // 发送停止和退出命令并等待进程结束，超时则强制结束
+            if (!m_control->Shutdown(FmediaControl::kExitTimeoutMs))
             {
-                WaitForSingleObject(m_processInfo.hProcess, 5000); // 等待5秒
-                CloseHandle(m_processInfo.hProcess);
-                CloseHandle(m_processInfo.hThread);
-                ZeroMemory(&m_processInfo, sizeof(m_processInfo));
+                hr = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
             }
-
-            m_processRunning = false;
         }
 
         UpdateState(RecordState::stop);
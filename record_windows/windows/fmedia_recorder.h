@@ -1,6 +1,7 @@
 #pragma once
 
 #include "recorder_interface.h"
+#include "fmedia_control.h"
 #include <process.h>
 #include <vector>
 #include <thread>
@@ -13,11 +14,12 @@ namespace record_windows
     class FmediaRecorder : public IRecorder
     {
     public:
-        FmediaRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler);
+        FmediaRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue);
         virtual ~FmediaRecorder();
 
         HRESULT Start(std::unique_ptr<RecordConfig> config, std::wstring path) override;
         HRESULT StartStream(std::unique_ptr<RecordConfig> config) override;
+        HRESULT Arm(std::unique_ptr<RecordConfig> config) override;
         HRESULT Pause() override;
         HRESULT Resume() override;
         HRESULT Stop() override;
@@ -28,6 +30,11 @@ namespace record_windows
         std::map<std::string, double> GetAmplitude() override;
         std::wstring GetRecordingPath() override;
         HRESULT isEncoderSupported(const std::string encoderName, bool* supported) override;
+        HRESULT GetEncoderCapabilities(std::vector<EncoderCapability>& capabilities) override;
+        MeterSnapshot GetMeters() override;
+        std::vector<float> GetWaveform(double seconds, int pixels) override;
+        HRESULT ExportRecent(double seconds, const std::string& encoderName, std::wstring path, std::function<void(HRESULT)> onDone) override;
+        std::map<std::string, int64_t> GetStats() override;
 
     private:
         void UpdateState(RecordState state);
@@ -35,16 +42,16 @@ namespace record_windows
         std::wstring GetFileNameSuffix(const std::string& encoderName);
         std::vector<std::wstring> GetEncoderSettings(const std::string& encoderName, int bitRate);
         std::vector<std::wstring> GetAacQuality(int bitRate);
-        HRESULT CallFmedia(const std::vector<std::wstring>& arguments);
+        HRESULT SendCommand(const std::string& command);
         HRESULT EndRecording();
 
         EventStreamHandler<EncodableValue>* m_stateEventHandler;
         EventStreamHandler<EncodableValue>* m_recordEventHandler;
+        std::shared_ptr<DispatchQueue> m_dispatchQueue;
         RecordState m_recordState;
         std::wstring m_recordingPath;
         std::unique_ptr<RecordConfig> m_pConfig;
-        PROCESS_INFORMATION m_processInfo;
-        std::atomic<bool> m_processRunning;
+        std::unique_ptr<FmediaControl> m_control;
         std::mutex m_stateMutex;
         double m_amplitude;
         double m_maxAmplitude;
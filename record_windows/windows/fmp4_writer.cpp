@@ -0,0 +1,436 @@
+#include "fmp4_writer.h"
+
+#include <cstring>
+
+namespace record_windows
+{
+    namespace
+    {
+        constexpr uint32_t kTrackId = 1;
+        constexpr uint32_t kMovieTimescale = 1000;
+
+        // trex default: sync sample, depends on no other sample
+        constexpr uint32_t kSampleFlags = 0x02000000;
+
+        // tfhd: base data offset is the moof start
+        constexpr uint32_t kTfhdDefaultBaseIsMoof = 0x020000;
+        // trun: data offset and sample sizes present
+        constexpr uint32_t kTrunDataOffset = 0x000001;
+        constexpr uint32_t kTrunSampleSize = 0x000200;
+
+        const uint32_t kSampleRates[] = {
+            96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+        };
+
+        const uint32_t kUnityMatrix[] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+
+        // Big endian box serialization into a byte vector.
+        class BoxWriter
+        {
+        public:
+            explicit BoxWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+            size_t Begin(const char* type)
+            {
+                size_t start = m_out.size();
+                U32(0);
+                Tag(type);
+                return start;
+            }
+
+            size_t BeginFull(const char* type, uint8_t version, uint32_t flags)
+            {
+                size_t start = Begin(type);
+                U32(((uint32_t)version << 24) | (flags & 0xFFFFFF));
+                return start;
+            }
+
+            void End(size_t start)
+            {
+                Patch32(start, (uint32_t)(m_out.size() - start));
+            }
+
+            // MPEG-4 descriptor (esds), contents are always < 128 bytes here
+            size_t BeginDescriptor(uint8_t tag)
+            {
+                size_t start = m_out.size();
+                U8(tag);
+                U8(0);
+                return start;
+            }
+
+            void EndDescriptor(size_t start)
+            {
+                m_out[start + 1] = (uint8_t)(m_out.size() - start - 2);
+            }
+
+            void U8(uint8_t value) { m_out.push_back(value); }
+            void U16(uint16_t value) { U8((uint8_t)(value >> 8)); U8((uint8_t)value); }
+            void U24(uint32_t value) { U8((uint8_t)(value >> 16)); U16((uint16_t)value); }
+            void U32(uint32_t value) { U16((uint16_t)(value >> 16)); U16((uint16_t)value); }
+            void U64(uint64_t value) { U32((uint32_t)(value >> 32)); U32((uint32_t)value); }
+            void Tag(const char* tag) { Bytes(reinterpret_cast<const uint8_t*>(tag), 4); }
+            void Zeros(size_t count) { m_out.insert(m_out.end(), count, 0); }
+            void Bytes(const uint8_t* data, size_t size) { m_out.insert(m_out.end(), data, data + size); }
+
+            void Matrix()
+            {
+                for (uint32_t value : kUnityMatrix) U32(value);
+            }
+
+            size_t Size() const { return m_out.size(); }
+
+            void Patch32(size_t offset, uint32_t value)
+            {
+                m_out[offset] = (uint8_t)(value >> 24);
+                m_out[offset + 1] = (uint8_t)(value >> 16);
+                m_out[offset + 2] = (uint8_t)(value >> 8);
+                m_out[offset + 3] = (uint8_t)value;
+            }
+
+        private:
+            std::vector<uint8_t>& m_out;
+        };
+    }
+
+    bool Fmp4Writer::AacDecoderConfig(uint32_t sampleRate, uint32_t numChannels, std::vector<uint8_t>& config)
+    {
+        int rateIndex = -1;
+        for (int i = 0; i < (int)(sizeof(kSampleRates) / sizeof(kSampleRates[0])); i++)
+        {
+            if (kSampleRates[i] == sampleRate) rateIndex = i;
+        }
+
+        // Channel configurations 1 to 6 map to the count, 7 is 7.1
+        uint32_t channelConfig = numChannels == 8 ? 7 : numChannels;
+        if (rateIndex < 0 || channelConfig == 0 || channelConfig > 7)
+        {
+            return false;
+        }
+
+        const uint32_t objectType = 2; // AAC-LC
+        uint32_t bits = (objectType << 11) | ((uint32_t)rateIndex << 7) | (channelConfig << 3);
+
+        config.assign({ (uint8_t)(bits >> 8), (uint8_t)bits });
+        return true;
+    }
+
+    bool Fmp4Writer::Open(const Options& options, WriteCallback onWrite)
+    {
+        if (options.sampleRate == 0 || options.numChannels == 0 || options.frameDuration == 0 ||
+            options.decoderConfig.empty())
+        {
+            return false;
+        }
+
+        m_options = options;
+        m_onWrite = std::move(onWrite);
+        m_fragmentDuration = (uint64_t)options.fragmentMs * options.sampleRate / 1000;
+        m_mdat.clear();
+        m_sizes.clear();
+        m_index.clear();
+        m_fragmentTime = 0;
+        m_time = 0;
+        m_offset = 0;
+        m_sequence = 0;
+        m_failed = false;
+        m_open = true;
+
+        m_box.clear();
+        WriteInit(m_box);
+
+        return Emit(m_box);
+    }
+
+    void Fmp4Writer::WriteInit(std::vector<uint8_t>& out) const
+    {
+        BoxWriter box(out);
+
+        size_t ftyp = box.Begin("ftyp");
+        box.Tag("isom");
+        box.U32(0x200);
+        box.Tag("isom");
+        box.Tag("iso6");
+        box.Tag("mp41");
+        box.End(ftyp);
+
+        // Durations are 0: the samples are all in fragments
+        size_t moov = box.Begin("moov");
+        {
+            size_t mvhd = box.BeginFull("mvhd", 0, 0);
+            box.U32(0);                     // creation time
+            box.U32(0);                     // modification time
+            box.U32(kMovieTimescale);
+            box.U32(0);                     // duration
+            box.U32(0x00010000);            // rate 1.0
+            box.U16(0x0100);                // volume 1.0
+            box.Zeros(10);
+            box.Matrix();
+            box.Zeros(24);                  // pre defined
+            box.U32(kTrackId + 1);          // next track id
+            box.End(mvhd);
+
+            size_t trak = box.Begin("trak");
+            {
+                size_t tkhd = box.BeginFull("tkhd", 0, 0x000003); // enabled, in movie
+                box.U32(0);
+                box.U32(0);
+                box.U32(kTrackId);
+                box.U32(0);
+                box.U32(0);                 // duration
+                box.Zeros(8);
+                box.U16(0);                 // layer
+                box.U16(0);                 // alternate group
+                box.U16(0x0100);            // volume 1.0
+                box.U16(0);
+                box.Matrix();
+                box.U32(0);                 // width
+                box.U32(0);                 // height
+                box.End(tkhd);
+
+                size_t mdia = box.Begin("mdia");
+                {
+                    size_t mdhd = box.BeginFull("mdhd", 0, 0);
+                    box.U32(0);
+                    box.U32(0);
+                    box.U32(m_options.sampleRate);
+                    box.U32(0);             // duration
+                    box.U16(0x55C4);        // "und"
+                    box.U16(0);
+                    box.End(mdhd);
+
+                    size_t hdlr = box.BeginFull("hdlr", 0, 0);
+                    box.U32(0);
+                    box.Tag("soun");
+                    box.Zeros(12);
+                    box.Bytes(reinterpret_cast<const uint8_t*>("SoundHandler"), 13);
+                    box.End(hdlr);
+
+                    size_t minf = box.Begin("minf");
+                    {
+                        size_t smhd = box.BeginFull("smhd", 0, 0);
+                        box.U16(0);         // balance
+                        box.U16(0);
+                        box.End(smhd);
+
+                        size_t dinf = box.Begin("dinf");
+                        size_t dref = box.BeginFull("dref", 0, 0);
+                        box.U32(1);
+                        size_t url = box.BeginFull("url ", 0, 0x000001); // same file
+                        box.End(url);
+                        box.End(dref);
+                        box.End(dinf);
+
+                        size_t stbl = box.Begin("stbl");
+                        {
+                            size_t stsd = box.BeginFull("stsd", 0, 0);
+                            box.U32(1);
+
+                            size_t mp4a = box.Begin("mp4a");
+                            box.Zeros(6);
+                            box.U16(1);     // data reference index
+                            box.Zeros(8);
+                            box.U16((uint16_t)m_options.numChannels);
+                            box.U16(16);    // sample size
+                            box.U16(0);
+                            box.U16(0);
+                            // 16.16, 0 when it doesn't fit (the esds has the rate)
+                            box.U32(m_options.sampleRate <= 0xFFFF ? m_options.sampleRate << 16 : 0);
+
+                            size_t esds = box.BeginFull("esds", 0, 0);
+                            size_t es = box.BeginDescriptor(0x03);
+                            box.U16(0);     // ES id
+                            box.U8(0);      // flags
+                            size_t decoderConfig = box.BeginDescriptor(0x04);
+                            box.U8(0x40);   // MPEG-4 audio
+                            box.U8(0x15);   // audio stream
+                            box.U24(0);     // buffer size
+                            box.U32(m_options.bitRate);
+                            box.U32(m_options.bitRate);
+                            size_t decoderSpecific = box.BeginDescriptor(0x05);
+                            box.Bytes(m_options.decoderConfig.data(), m_options.decoderConfig.size());
+                            box.EndDescriptor(decoderSpecific);
+                            box.EndDescriptor(decoderConfig);
+                            size_t slConfig = box.BeginDescriptor(0x06);
+                            box.U8(0x02);   // predefined MP4
+                            box.EndDescriptor(slConfig);
+                            box.EndDescriptor(es);
+                            box.End(esds);
+
+                            box.End(mp4a);
+                            box.End(stsd);
+
+                            // Empty tables
+                            size_t stts = box.BeginFull("stts", 0, 0);
+                            box.U32(0);
+                            box.End(stts);
+
+                            size_t stsc = box.BeginFull("stsc", 0, 0);
+                            box.U32(0);
+                            box.End(stsc);
+
+                            size_t stsz = box.BeginFull("stsz", 0, 0);
+                            box.U32(0);
+                            box.U32(0);
+                            box.End(stsz);
+
+                            size_t stco = box.BeginFull("stco", 0, 0);
+                            box.U32(0);
+                            box.End(stco);
+                        }
+                        box.End(stbl);
+                    }
+                    box.End(minf);
+                }
+                box.End(mdia);
+            }
+            box.End(trak);
+
+            size_t mvex = box.Begin("mvex");
+            size_t trex = box.BeginFull("trex", 0, 0);
+            box.U32(kTrackId);
+            box.U32(1);                     // sample description index
+            box.U32(m_options.frameDuration);
+            box.U32(0);                     // sample size, in each trun
+            box.U32(kSampleFlags);
+            box.End(trex);
+            box.End(mvex);
+        }
+        box.End(moov);
+    }
+
+    bool Fmp4Writer::AddSample(const uint8_t* data, size_t size)
+    {
+        if (!m_open || m_failed)
+        {
+            return false;
+        }
+        if (size == 0)
+        {
+            return true;
+        }
+
+        if (m_sizes.empty())
+        {
+            m_fragmentTime = m_time;
+        }
+
+        m_mdat.insert(m_mdat.end(), data, data + size);
+        m_sizes.push_back((uint32_t)size);
+        m_time += m_options.frameDuration;
+
+        if (m_time - m_fragmentTime >= m_fragmentDuration)
+        {
+            return Flush();
+        }
+        return true;
+    }
+
+    bool Fmp4Writer::Flush()
+    {
+        if (!m_open || m_failed)
+        {
+            return false;
+        }
+        if (m_sizes.empty())
+        {
+            return true;
+        }
+
+        m_box.clear();
+        BoxWriter box(m_box);
+
+        size_t moof = box.Begin("moof");
+        size_t mfhd = box.BeginFull("mfhd", 0, 0);
+        box.U32(m_sequence + 1);
+        box.End(mfhd);
+
+        size_t traf = box.Begin("traf");
+        size_t tfhd = box.BeginFull("tfhd", 0, kTfhdDefaultBaseIsMoof);
+        box.U32(kTrackId);
+        box.End(tfhd);
+
+        size_t tfdt = box.BeginFull("tfdt", 1, 0);
+        box.U64(m_fragmentTime);
+        box.End(tfdt);
+
+        size_t trun = box.BeginFull("trun", 0, kTrunDataOffset | kTrunSampleSize);
+        box.U32((uint32_t)m_sizes.size());
+        size_t dataOffset = box.Size();
+        box.U32(0);
+        for (uint32_t size : m_sizes) box.U32(size);
+        box.End(trun);
+        box.End(traf);
+        box.End(moof);
+
+        // Samples start right after the mdat header
+        box.Patch32(dataOffset, (uint32_t)(box.Size() - moof + 8));
+
+        size_t mdat = box.Begin("mdat");
+        box.Bytes(m_mdat.data(), m_mdat.size());
+        box.End(mdat);
+
+        m_index.push_back({ m_fragmentTime, m_offset });
+        m_sequence++;
+        m_mdat.clear();
+        m_sizes.clear();
+
+        // moof and mdat together: a fragment is either whole or cut at the end
+        return Emit(m_box);
+    }
+
+    bool Fmp4Writer::Finish()
+    {
+        if (!m_open)
+        {
+            return false;
+        }
+
+        bool ok = Flush();
+
+        if (ok)
+        {
+            m_box.clear();
+            BoxWriter box(m_box);
+
+            size_t mfra = box.Begin("mfra");
+            size_t tfra = box.BeginFull("tfra", 1, 0);
+            box.U32(kTrackId);
+            box.U32(0);                     // 1 byte traf, trun and sample numbers
+            box.U32((uint32_t)m_index.size());
+            for (const FragmentEntry& entry : m_index)
+            {
+                box.U64(entry.time);
+                box.U64(entry.moofOffset);
+                box.U8(1);
+                box.U8(1);
+                box.U8(1);
+            }
+            box.End(tfra);
+
+            size_t mfro = box.BeginFull("mfro", 0, 0);
+            size_t mfraSize = box.Size();
+            box.U32(0);
+            box.End(mfro);
+            box.End(mfra);
+            box.Patch32(mfraSize, (uint32_t)(box.Size() - mfra));
+
+            ok = Emit(m_box);
+        }
+
+        m_open = false;
+        return ok;
+    }
+
+    bool Fmp4Writer::Emit(const std::vector<uint8_t>& data)
+    {
+        if (m_failed || !m_onWrite(data.data(), data.size()))
+        {
+            m_failed = true;
+            return false;
+        }
+
+        m_offset += data.size();
+        return true;
+    }
+}
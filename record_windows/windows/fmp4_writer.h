@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace record_windows
+{
+    // Fragmented MP4 (ISO BMFF) muxer for a single audio track.
+    //
+    // ftyp and an empty moov go first, then one moof/mdat pair every
+    // fragmentMs of audio. Each fragment is emitted in one write, so the
+    // file is playable up to the last complete fragment at any time (crash,
+    // power loss, or read while recording). Finish() appends the mfra
+    // random access index.
+    // Portable, driven by one thread at a time.
+    class Fmp4Writer
+    {
+    public:
+        struct Options
+        {
+            uint32_t sampleRate = 44100;
+            uint32_t numChannels = 2;
+            uint32_t bitRate = 128000;              // informative (esds)
+            uint32_t frameDuration = 1024;          // samples per access unit
+            uint32_t fragmentMs = 2000;             // 0: one fragment per access unit
+            std::vector<uint8_t> decoderConfig;     // AudioSpecificConfig
+        };
+
+        // Appends to the output. Returns false to abort.
+        using WriteCallback = std::function<bool(const uint8_t* data, size_t size)>;
+
+        // Writes ftyp and moov.
+        bool Open(const Options& options, WriteCallback onWrite);
+
+        // One raw access unit (no ADTS header).
+        bool AddSample(const uint8_t* data, size_t size);
+
+        // Writes the pending fragment, if any.
+        bool Flush();
+
+        // Writes the pending fragment and the mfra index.
+        bool Finish();
+
+        uint32_t Fragments() const { return m_sequence; }
+        uint64_t BytesWritten() const { return m_offset; }
+
+        // 2 bytes AudioSpecificConfig for AAC-LC. False if the format can't
+        // be described.
+        static bool AacDecoderConfig(uint32_t sampleRate, uint32_t numChannels, std::vector<uint8_t>& config);
+
+    private:
+        struct FragmentEntry
+        {
+            uint64_t time;
+            uint64_t moofOffset;
+        };
+
+        bool Emit(const std::vector<uint8_t>& data);
+        void WriteInit(std::vector<uint8_t>& out) const;
+
+        Options m_options;
+        WriteCallback m_onWrite;
+        uint64_t m_fragmentDuration = 0;    // in sample rate units
+
+        // Pending fragment
+        std::vector<uint8_t> m_mdat;
+        std::vector<uint32_t> m_sizes;
+        uint64_t m_fragmentTime = 0;        // decode time of its first sample
+
+        uint64_t m_time = 0;                // decode time of the next sample
+        uint64_t m_offset = 0;
+        uint32_t m_sequence = 0;
+        std::vector<FragmentEntry> m_index;
+        std::vector<uint8_t> m_box;
+        bool m_open = false;
+        bool m_failed = false;
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace record_windows
+{
+    // Move-only void() callable with fixed inline storage.
+    //
+    // Unlike std::function, the callable is never heap allocated: captures
+    // that do not fit in kStorageSize are rejected at compile time.
+    class InplaceTask
+    {
+    public:
+        static constexpr size_t kStorageSize = 64;
+
+        InplaceTask() = default;
+
+        template <typename F,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceTask>>>
+        InplaceTask(F&& f)
+        {
+            using Fn = std::decay_t<F>;
+            static_assert(sizeof(Fn) <= kStorageSize, "InplaceTask: capture too large");
+            static_assert(alignof(Fn) <= alignof(std::max_align_t), "InplaceTask: capture over-aligned");
+            static_assert(std::is_nothrow_move_constructible_v<Fn>, "InplaceTask: capture must be nothrow movable");
+
+            new (m_storage) Fn(std::forward<F>(f));
+            m_ops = &OpsFor<Fn>::ops;
+        }
+
+        InplaceTask(InplaceTask&& other) noexcept
+        {
+            MoveFrom(other);
+        }
+
+        InplaceTask& operator=(InplaceTask&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                MoveFrom(other);
+            }
+            return *this;
+        }
+
+        InplaceTask(const InplaceTask&) = delete;
+        InplaceTask& operator=(const InplaceTask&) = delete;
+
+        ~InplaceTask()
+        {
+            Reset();
+        }
+
+        explicit operator bool() const { return m_ops != nullptr; }
+
+        void operator()()
+        {
+            if (m_ops) m_ops->invoke(m_storage);
+        }
+
+        void Reset()
+        {
+            if (m_ops)
+            {
+                m_ops->destroy(m_storage);
+                m_ops = nullptr;
+            }
+        }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void*);
+            void (*move)(void* dst, void* src);
+            void (*destroy)(void*);
+        };
+
+        template <typename Fn>
+        struct OpsFor
+        {
+            static void Invoke(void* p) { (*std::launder(static_cast<Fn*>(p)))(); }
+            static void Move(void* dst, void* src)
+            {
+                Fn* from = std::launder(static_cast<Fn*>(src));
+                new (dst) Fn(std::move(*from));
+                from->~Fn();
+            }
+            static void Destroy(void* p) { std::launder(static_cast<Fn*>(p))->~Fn(); }
+
+            static constexpr Ops ops{ &Invoke, &Move, &Destroy };
+        };
+
+        void MoveFrom(InplaceTask& other)
+        {
+            if (other.m_ops)
+            {
+                other.m_ops->move(m_storage, other.m_storage);
+                m_ops = other.m_ops;
+                other.m_ops = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[kStorageSize];
+        const Ops* m_ops = nullptr;
+    };
+}
@@ -0,0 +1,150 @@
+#define NOMINMAX
+#include "main_thread_dispatcher.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace record_windows
+{
+    DispatchQueue::DispatchQueue(MainThreadDispatcher* dispatcher, size_t capacity)
+        : m_dispatcher(dispatcher),
+        m_tasks(capacity)
+    {
+    }
+
+    bool DispatchQueue::Post(InplaceTask task)
+    {
+        // Paired with Close(): either the closed flag is seen here, or Close()
+        // sees this call in progress and drains the task once it is pushed.
+        m_posting.fetch_add(1, std::memory_order_seq_cst);
+
+        if (m_closed.load(std::memory_order_seq_cst))
+        {
+            m_posting.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+
+        bool pushed = m_tasks.TryPush(std::move(task));
+        m_posting.fetch_sub(1, std::memory_order_release);
+
+        if (!pushed)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_dispatcher->Wake();
+        return true;
+    }
+
+    size_t DispatchQueue::Drain(size_t budget)
+    {
+        size_t count = 0;
+        InplaceTask task;
+
+        while (count < budget && m_tasks.TryPop(task))
+        {
+            if (!m_closed.load(std::memory_order_relaxed))
+            {
+                task();
+            }
+            task.Reset();
+            count++;
+        }
+
+        return count;
+    }
+
+    void DispatchQueue::Close()
+    {
+        m_closed.store(true, std::memory_order_seq_cst);
+
+        // Posts past the check finish their push (a few instructions)
+        while (m_posting.load(std::memory_order_acquire) != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        InplaceTask task;
+        while (m_tasks.TryPop(task))
+        {
+            task.Reset();
+        }
+    }
+
+    MainThreadDispatcher::MainThreadDispatcher(std::function<HWND()> windowProvider)
+        : m_windowProvider(std::move(windowProvider))
+    {
+    }
+
+    std::shared_ptr<DispatchQueue> MainThreadDispatcher::CreateQueue(size_t capacity)
+    {
+        auto queue = std::make_shared<DispatchQueue>(this, capacity);
+
+        auto queues = std::make_shared<QueueList>(*m_queues);
+        queues->push_back(queue);
+        m_queues = std::move(queues);
+
+        return queue;
+    }
+
+    void MainThreadDispatcher::RemoveQueue(const std::shared_ptr<DispatchQueue>& queue)
+    {
+        if (!queue) return;
+
+        queue->Close();
+
+        auto queues = std::make_shared<QueueList>(*m_queues);
+        queues->erase(std::remove(queues->begin(), queues->end(), queue), queues->end());
+        m_queues = std::move(queues);
+    }
+
+    void MainThreadDispatcher::Wake()
+    {
+        if (!m_wakePending.exchange(true, std::memory_order_acq_rel))
+        {
+            HWND hwnd = m_windowProvider ? m_windowProvider() : NULL;
+
+            if (!hwnd || !PostMessage(hwnd, WM_RUN_DELEGATE, 0, 0))
+            {
+                m_wakePending.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    void MainThreadDispatcher::DrainAll()
+    {
+        // Reset before draining so that any task posted from now on
+        // triggers a new wake message.
+        m_wakePending.store(false, std::memory_order_release);
+
+        size_t budget = kDrainBudget;
+        bool pending = false;
+
+        // Tasks may create or remove queues (e.g. dispose), the list taken
+        // here stays unchanged.
+        auto queues = m_queues;
+        const size_t count = queues->size();
+        const size_t first = count > 0 ? m_nextQueue % count : 0;
+        m_nextQueue = first + 1;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t index = (first + i) % count;
+            budget -= (*queues)[index]->Drain(budget);
+
+            if (budget == 0)
+            {
+                // Next drain starts after the queue that used up the budget
+                m_nextQueue = index + 1;
+                pending = true;
+                break;
+            }
+        }
+
+        if (pending)
+        {
+            Wake();
+        }
+    }
+}
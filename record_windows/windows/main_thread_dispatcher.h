@@ -0,0 +1,84 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "inplace_task.h"
+#include "mpsc_queue.h"
+
+#define WM_RUN_DELEGATE (WM_USER + 101)
+
+namespace record_windows
+{
+    class MainThreadDispatcher;
+
+    // Per recorder queue of tasks to run on the platform (UI) thread.
+    //
+    // Post() may be called from any thread (Media Foundation callbacks,
+    // workers...). Tasks are only ever run or destroyed on the main thread.
+    class DispatchQueue
+    {
+    public:
+        static constexpr size_t kDefaultCapacity = 1024;
+
+        DispatchQueue(MainThreadDispatcher* dispatcher, size_t capacity);
+
+        // Any thread. Returns false if the queue is full or closed.
+        bool Post(InplaceTask task);
+
+        // Number of tasks rejected because the queue was full.
+        uint64_t DroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        friend class MainThreadDispatcher;
+
+        // Main thread only.
+        size_t Drain(size_t budget);
+        void Close();
+
+        MainThreadDispatcher* m_dispatcher;
+        MpscQueue<InplaceTask> m_tasks;
+        std::atomic<bool> m_closed{ false };
+        // Post() calls past the closed check, Close() waits for them
+        std::atomic<uint32_t> m_posting{ 0 };
+        std::atomic<uint64_t> m_dropped{ 0 };
+    };
+
+    // Wakes the main thread with a single WM_RUN_DELEGATE and drains
+    // all pending recorder queues in one pass.
+    class MainThreadDispatcher
+    {
+    public:
+        // Upper bound of tasks run per WM_RUN_DELEGATE to keep the UI responsive.
+        static constexpr size_t kDrainBudget = 4096;
+
+        explicit MainThreadDispatcher(std::function<HWND()> windowProvider);
+
+        // Main thread only.
+        std::shared_ptr<DispatchQueue> CreateQueue(size_t capacity = DispatchQueue::kDefaultCapacity);
+        // Main thread only. Pending tasks are dropped without being run.
+        void RemoveQueue(const std::shared_ptr<DispatchQueue>& queue);
+        // Main thread only. Runs pending tasks of all queues.
+        void DrainAll();
+
+        // Any thread. Posts a wake message unless one is already pending.
+        void Wake();
+
+    private:
+        using QueueList = std::vector<std::shared_ptr<DispatchQueue>>;
+
+        std::function<HWND()> m_windowProvider;
+        // Replaced when queues are added or removed, so a drain in progress
+        // keeps iterating the list it started with.
+        std::shared_ptr<const QueueList> m_queues = std::make_shared<QueueList>();
+        // First queue of the next drain, rotated so that no queue starves
+        // when the budget runs out.
+        size_t m_nextQueue = 0;
+        std::atomic<bool> m_wakePending{ false };
+    };
+}
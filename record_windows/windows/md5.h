@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace record_windows
+{
+    // MD5 (RFC 1321), streaming. Used for the FLAC audio signature.
+    class Md5
+    {
+    public:
+        Md5() { Reset(); }
+
+        void Reset()
+        {
+            m_h[0] = 0x67452301;
+            m_h[1] = 0xefcdab89;
+            m_h[2] = 0x98badcfe;
+            m_h[3] = 0x10325476;
+            m_length = 0;
+        }
+
+        void Update(const uint8_t* data, size_t size)
+        {
+            size_t used = (size_t)(m_length % 64);
+            m_length += size;
+
+            if (used > 0)
+            {
+                size_t count = size < 64 - used ? size : 64 - used;
+                std::memcpy(m_block + used, data, count);
+                data += count;
+                size -= count;
+                if (used + count < 64) return;
+                Transform(m_block);
+            }
+
+            while (size >= 64)
+            {
+                Transform(data);
+                data += 64;
+                size -= 64;
+            }
+
+            std::memcpy(m_block, data, size);
+        }
+
+        void Final(uint8_t digest[16])
+        {
+            uint64_t bits = m_length * 8;
+            uint8_t padding[72] = { 0x80 };
+            size_t used = (size_t)(m_length % 64);
+            size_t padBytes = used < 56 ? 56 - used : 120 - used;
+
+            Update(padding, padBytes);
+            for (int i = 0; i < 8; i++) padding[i] = (uint8_t)(bits >> (8 * i));
+            Update(padding, 8);
+
+            for (int i = 0; i < 16; i++) digest[i] = (uint8_t)(m_h[i / 4] >> (8 * (i % 4)));
+        }
+
+    private:
+        static uint32_t Rotl(uint32_t x, int c) { return (x << c) | (x >> (32 - c)); }
+
+        void Transform(const uint8_t* block)
+        {
+            static const uint32_t k[64] = {
+                0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+                0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+                0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+                0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+                0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+                0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+                0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+            };
+            static const int r[64] = {
+                7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+                5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+                4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+                6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+            };
+
+            uint32_t w[16];
+            for (int i = 0; i < 16; i++)
+            {
+                w[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+                    ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+            }
+
+            uint32_t a = m_h[0], b = m_h[1], c = m_h[2], d = m_h[3];
+
+            for (int i = 0; i < 64; i++)
+            {
+                uint32_t f;
+                int g;
+                if (i < 16) { f = (b & c) | (~b & d); g = i; }
+                else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+                else if (i < 48) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+                else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+
+                uint32_t temp = d;
+                d = c;
+                c = b;
+                b = b + Rotl(a + f + k[i] + w[g], r[i]);
+                a = temp;
+            }
+
+            m_h[0] += a;
+            m_h[1] += b;
+            m_h[2] += c;
+            m_h[3] += d;
+        }
+
+        uint32_t m_h[4];
+        uint64_t m_length;
+        uint8_t m_block[64];
+    };
+}
@@ -0,0 +1,372 @@
+#include "meter_engine.h"
+#include "amplitude_kernel.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if RECORD_X86
+#include <emmintrin.h>
+#endif
+
+namespace record_windows
+{
+    namespace
+    {
+        constexpr double kPi = 3.14159265358979323846;
+        constexpr double kFloorDb = -160.0;
+
+        double PowerToLufs(double power)
+        {
+            return power > 0.0 ? std::max(-0.691 + 10.0 * std::log10(power), kFloorDb) : kFloorDb;
+        }
+    }
+
+    MeterEngine::MeterEngine()
+        : m_histCount(kHistogramBins, 0),
+        m_histEnergy(kHistogramBins, 0.0)
+    {
+        Reset(48000, 2);
+    }
+
+    void MeterEngine::Reset(int sampleRate, int numChannels)
+    {
+        m_sampleRate = sampleRate > 0 ? sampleRate : 48000;
+        m_stride = std::max(numChannels, 1);
+        m_channels = std::min(m_stride, kMaxChannels);
+        m_lanes = (m_channels + 1) & ~1;
+
+        DesignFilters();
+
+        std::fill(&m_z1[0][0], &m_z1[0][0] + 2 * kMaxChannels, 0.0);
+        std::fill(&m_z2[0][0], &m_z2[0][0] + 2 * kMaxChannels, 0.0);
+        std::fill(&m_tpHistory[0][0], &m_tpHistory[0][0] + kMaxChannels * 2 * kTruePeakTaps, 0.0f);
+        m_tpPos = 0;
+
+        // BS.1770 channel weights, surrounds of a 5.1 layout get +1.5 dB, LFE is ignored
+        for (int c = 0; c < kMaxChannels; c++)
+        {
+            m_weights[c] = c < m_channels ? 1.0 : 0.0;
+        }
+        if (m_channels == 6)
+        {
+            m_weights[3] = 0.0;
+            m_weights[4] = 1.41;
+            m_weights[5] = 1.41;
+        }
+
+        m_subBlockFrames = (size_t)std::max(m_sampleRate / 10, 1);
+        m_subBlockFill = 0;
+        std::fill(std::begin(m_subBlockEnergy), std::end(m_subBlockEnergy), 0.0);
+        std::fill(std::begin(m_blockPower), std::end(m_blockPower), 0.0);
+        m_blockIndex = 0;
+        m_blockCount = 0;
+        std::fill(m_histCount.begin(), m_histCount.end(), 0);
+        std::fill(m_histEnergy.begin(), m_histEnergy.end(), 0.0);
+
+        m_snapshot = SilentSnapshot(m_channels);
+    }
+
+    MeterSnapshot MeterEngine::SilentSnapshot(int numChannels)
+    {
+        MeterSnapshot snapshot{};
+        snapshot.channelCount = std::min(std::max(numChannels, 0), kMaxChannels);
+        for (auto& channel : snapshot.channels)
+        {
+            channel = { kFloorDb, kFloorDb, kFloorDb, kFloorDb, kFloorDb, 0 };
+        }
+        snapshot.momentaryLufs = kFloorDb;
+        snapshot.shortTermLufs = kFloorDb;
+        snapshot.integratedLufs = kFloorDb;
+        snapshot.maxMomentaryLufs = kFloorDb;
+        snapshot.maxShortTermLufs = kFloorDb;
+        return snapshot;
+    }
+
+    void MeterEngine::DesignFilters()
+    {
+        const double fs = (double)m_sampleRate;
+
+        // K-weighting stage 1: high shelf (BS.1770 pre-filter, derived for any rate)
+        {
+            const double f0 = 1681.974450955533;
+            const double gain = 3.999843853973347;
+            const double q = 0.7071752369554196;
+
+            double k = std::tan(kPi * f0 / fs);
+            double vh = std::pow(10.0, gain / 20.0);
+            double vb = std::pow(vh, 0.4996667741545416);
+            double a0 = 1.0 + k / q + k * k;
+
+            m_stage[0].b0 = (vh + vb * k / q + k * k) / a0;
+            m_stage[0].b1 = 2.0 * (k * k - vh) / a0;
+            m_stage[0].b2 = (vh - vb * k / q + k * k) / a0;
+            m_stage[0].a1 = 2.0 * (k * k - 1.0) / a0;
+            m_stage[0].a2 = (1.0 - k / q + k * k) / a0;
+        }
+
+        // K-weighting stage 2: RLB high pass
+        {
+            const double f0 = 38.13547087602444;
+            const double q = 0.5003270373238773;
+
+            double k = std::tan(kPi * f0 / fs);
+            double a0 = 1.0 + k / q + k * k;
+
+            m_stage[1].b0 = 1.0;
+            m_stage[1].b1 = -2.0;
+            m_stage[1].b2 = 1.0;
+            m_stage[1].a1 = 2.0 * (k * k - 1.0) / a0;
+            m_stage[1].a2 = (1.0 - k / q + k * k) / a0;
+        }
+
+        for (int s = 0; s < 2; s++)
+        {
+            const double values[5] = { m_stage[s].b0, m_stage[s].b1, m_stage[s].b2, m_stage[s].a1, m_stage[s].a2 };
+            for (int i = 0; i < 5; i++)
+            {
+                m_coeffs[s][2 * i] = values[i];
+                m_coeffs[s][2 * i + 1] = values[i];
+            }
+        }
+
+        // True peak: 48 taps windowed sinc low pass at the original Nyquist,
+        // split in 4 phases. Each phase is stored oldest sample first.
+        {
+            const int taps = kTruePeakPhases * kTruePeakTaps;
+            const double center = (taps - 1) / 2.0;
+            const double cutoff = 0.5 / kTruePeakPhases * 0.94;
+
+            double h[kTruePeakPhases * kTruePeakTaps];
+            double sum = 0.0;
+
+            for (int n = 0; n < taps; n++)
+            {
+                double t = n - center;
+                double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * kPi * cutoff * t) / (kPi * t);
+                double window = 0.42 - 0.5 * std::cos(2.0 * kPi * (n + 0.5) / taps) + 0.08 * std::cos(4.0 * kPi * (n + 0.5) / taps);
+                h[n] = sinc * window;
+                sum += h[n];
+            }
+
+            for (int p = 0; p < kTruePeakPhases; p++)
+            {
+                for (int j = 0; j < kTruePeakTaps; j++)
+                {
+                    int k = kTruePeakTaps - 1 - j;
+                    m_tpCoeffs[p][j] = (float)(h[p + kTruePeakPhases * k] * kTruePeakPhases / sum);
+                }
+            }
+        }
+    }
+
+    void MeterEngine::FilterFrame(const double* x)
+    {
+#if RECORD_X86
+        for (int c = 0; c < m_lanes; c += 2)
+        {
+            __m128d in = _mm_load_pd(x + c);
+
+            for (int s = 0; s < 2; s++)
+            {
+                const double* k = m_coeffs[s];
+                __m128d z1 = _mm_load_pd(&m_z1[s][c]);
+                __m128d z2 = _mm_load_pd(&m_z2[s][c]);
+
+                __m128d y = _mm_add_pd(_mm_mul_pd(in, _mm_load_pd(k)), z1);
+                z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(in, _mm_load_pd(k + 2)), _mm_mul_pd(y, _mm_load_pd(k + 6))), z2);
+                z2 = _mm_sub_pd(_mm_mul_pd(in, _mm_load_pd(k + 4)), _mm_mul_pd(y, _mm_load_pd(k + 8)));
+
+                _mm_store_pd(&m_z1[s][c], z1);
+                _mm_store_pd(&m_z2[s][c], z2);
+                in = y;
+            }
+
+            __m128d energy = _mm_load_pd(&m_subBlockEnergy[c]);
+            _mm_store_pd(&m_subBlockEnergy[c], _mm_add_pd(energy, _mm_mul_pd(in, in)));
+        }
+#else
+        for (int c = 0; c < m_channels; c++)
+        {
+            double in = x[c];
+
+            for (int s = 0; s < 2; s++)
+            {
+                const Biquad& f = m_stage[s];
+                double y = f.b0 * in + m_z1[s][c];
+                m_z1[s][c] = f.b1 * in - f.a1 * y + m_z2[s][c];
+                m_z2[s][c] = f.b2 * in - f.a2 * y;
+                in = y;
+            }
+
+            m_subBlockEnergy[c] += in * in;
+        }
+#endif
+    }
+
+    void MeterEngine::Process(const int16_t* interleaved, size_t frames)
+    {
+        if (!interleaved || frames == 0) return;
+
+        float peaks[kMaxChannels] = {};
+        float truePeaks[kMaxChannels] = {};
+        double sums[kMaxChannels] = {};
+        alignas(16) double x[kMaxChannels] = {};
+
+        for (size_t f = 0; f < frames; f++)
+        {
+            const int16_t* frame = interleaved + f * m_stride;
+
+            for (int c = 0; c < m_channels; c++)
+            {
+                int v = frame[c];
+                if (v >= 32767 || v <= -32768)
+                {
+                    m_snapshot.channels[c].clipCount++;
+                }
+
+                double value = v / 32768.0;
+                x[c] = value;
+
+                float a = (float)std::fabs(value);
+                if (a > peaks[c]) peaks[c] = a;
+                sums[c] += value * value;
+
+                float tp = TruePeak(c, (float)value);
+                if (tp > truePeaks[c]) truePeaks[c] = tp;
+            }
+
+            m_tpPos = m_tpPos + 1 == kTruePeakTaps ? 0 : m_tpPos + 1;
+
+            FilterFrame(x);
+
+            if (++m_subBlockFill == m_subBlockFrames)
+            {
+                EndSubBlock();
+            }
+        }
+
+        for (int c = 0; c < m_channels; c++)
+        {
+            auto& meter = m_snapshot.channels[c];
+            // Interpolated peak can't be lower than the sample peak
+            float truePeak = std::max(truePeaks[c], peaks[c]);
+
+            meter.peak = ToDbfs(peaks[c]);
+            meter.rms = ToDbfs(std::sqrt(sums[c] / (double)frames));
+            meter.truePeak = ToDbfs(truePeak);
+            meter.maxPeak = std::max(meter.maxPeak, meter.peak);
+            meter.maxTruePeak = std::max(meter.maxTruePeak, meter.truePeak);
+        }
+
+        m_snapshot.frames += frames;
+    }
+
+    void MeterEngine::EndSubBlock()
+    {
+        double power = 0.0;
+        for (int c = 0; c < m_channels; c++)
+        {
+            power += m_weights[c] * m_subBlockEnergy[c] / (double)m_subBlockFrames;
+            m_subBlockEnergy[c] = 0.0;
+        }
+        m_subBlockFill = 0;
+
+        m_blockPower[m_blockIndex] = power;
+        m_blockIndex = (m_blockIndex + 1) % kShortTermBlocks;
+        if (m_blockCount < kShortTermBlocks) m_blockCount++;
+
+        if (m_blockCount < kMomentaryBlocks)
+        {
+            return;
+        }
+
+        auto average = [this](int count) {
+            double sum = 0.0;
+            for (int i = 1; i <= count; i++)
+            {
+                sum += m_blockPower[(m_blockIndex - i + kShortTermBlocks) % kShortTermBlocks];
+            }
+            return sum / count;
+        };
+
+        // Momentary: 400 ms gating block, 75% overlap
+        double momentaryPower = average(kMomentaryBlocks);
+        double momentary = PowerToLufs(momentaryPower);
+        m_snapshot.momentaryLufs = momentary;
+        m_snapshot.maxMomentaryLufs = std::max(m_snapshot.maxMomentaryLufs, momentary);
+
+        // Short term: up to 3 s
+        double shortTerm = PowerToLufs(average(m_blockCount));
+        m_snapshot.shortTermLufs = shortTerm;
+        m_snapshot.maxShortTermLufs = std::max(m_snapshot.maxShortTermLufs, shortTerm);
+
+        // Integrated: blocks under the absolute gate are discarded
+        if (momentaryPower > 0.0 && momentary >= kHistogramMin)
+        {
+            int bin = std::min((int)((momentary - kHistogramMin) * 10.0), kHistogramBins - 1);
+            m_histCount[bin]++;
+            m_histEnergy[bin] += momentaryPower;
+        }
+
+        m_snapshot.integratedLufs = PowerToLufs(IntegratedPower());
+    }
+
+    double MeterEngine::IntegratedPower() const
+    {
+        uint64_t count = 0;
+        double energy = 0.0;
+        for (int b = 0; b < kHistogramBins; b++)
+        {
+            count += m_histCount[b];
+            energy += m_histEnergy[b];
+        }
+
+        if (count == 0) return 0.0;
+
+        // Relative gate, 10 LU below the absolute gated loudness
+        double relative = PowerToLufs(energy / count) - 10.0;
+        int first = std::max((int)std::floor((relative - kHistogramMin) * 10.0), 0);
+
+        count = 0;
+        energy = 0.0;
+        for (int b = first; b < kHistogramBins; b++)
+        {
+            count += m_histCount[b];
+            energy += m_histEnergy[b];
+        }
+
+        return count ? energy / count : 0.0;
+    }
+
+    float MeterEngine::TruePeak(int channel, float x)
+    {
+        float* history = m_tpHistory[channel];
+        history[m_tpPos] = x;
+        history[m_tpPos + kTruePeakTaps] = x;
+
+        // Window is oldest to newest, starts right after the newest sample
+        const float* window = history + m_tpPos + 1;
+        float peak = 0.0f;
+
+        for (int p = 0; p < kTruePeakPhases; p++)
+        {
+            const float* coeffs = m_tpCoeffs[p];
+#if RECORD_X86
+            __m128 acc = _mm_mul_ps(_mm_loadu_ps(window), _mm_load_ps(coeffs));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(window + 4), _mm_load_ps(coeffs + 4)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(window + 8), _mm_load_ps(coeffs + 8)));
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+            float y = _mm_cvtss_f32(acc);
+#else
+            float y = 0.0f;
+            for (int j = 0; j < kTruePeakTaps; j++) y += window[j] * coeffs[j];
+#endif
+            y = std::fabs(y);
+            if (y > peak) peak = y;
+        }
+
+        return peak;
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace record_windows
+{
+    // Per channel levels, in dBFS (floored at -160).
+    struct ChannelMeter
+    {
+        double peak;            // sample peak of the last processed chunk
+        double rms;             // RMS of the last processed chunk
+        double truePeak;        // 4x oversampled peak of the last processed chunk (dBTP)
+        double maxPeak;         // since start
+        double maxTruePeak;     // since start
+        uint64_t clipCount;     // samples at full scale since start
+    };
+
+    // Plain (trivially copyable) view of the meters at one point in time.
+    struct MeterSnapshot
+    {
+        static constexpr int kMaxChannels = 8;
+
+        int channelCount;
+        ChannelMeter channels[kMaxChannels];
+
+        // EBU R128 / ITU-R BS.1770 loudness, in LUFS (floored at -160).
+        double momentaryLufs;       // 400 ms window
+        double shortTermLufs;       // 3 s window
+        double integratedLufs;      // gated, since start
+        double maxMomentaryLufs;
+        double maxShortTermLufs;
+
+        uint64_t frames;            // frames (samples per channel) processed since start
+    };
+
+    // Incremental metering of interleaved 16 bits PCM.
+    //
+    // Computes sample peak, RMS, true peak (BS.1770 annex 2, 4x polyphase
+    // oversampling) and clip count per channel, plus K-weighted momentary,
+    // short-term and gated integrated loudness.
+    // Not thread safe: feed and read it from the same thread, publish
+    // snapshots to other threads.
+    class MeterEngine
+    {
+    public:
+        static constexpr int kMaxChannels = MeterSnapshot::kMaxChannels;
+
+        MeterEngine();
+
+        void Reset(int sampleRate, int numChannels);
+
+        // Channels above kMaxChannels are ignored.
+        void Process(const int16_t* interleaved, size_t frames);
+
+        const MeterSnapshot& Snapshot() const { return m_snapshot; }
+
+        // Snapshot with every level at the floor, as reported before any audio.
+        static MeterSnapshot SilentSnapshot(int numChannels);
+
+    private:
+        static constexpr int kTruePeakPhases = 4;
+        static constexpr int kTruePeakTaps = 12;            // per phase
+        static constexpr int kShortTermBlocks = 30;         // 3 s of 100 ms blocks
+        static constexpr int kMomentaryBlocks = 4;          // 400 ms
+        static constexpr double kHistogramMin = -70.0;      // absolute gate
+        static constexpr int kHistogramBins = 800;          // 0.1 LU steps up to +10 LUFS
+
+        struct Biquad
+        {
+            double b0, b1, b2, a1, a2;
+        };
+
+        void DesignFilters();
+        // Runs the K-weighting filters on one frame and accumulates energy.
+        void FilterFrame(const double* x);
+        float TruePeak(int channel, float x);
+        void EndSubBlock();
+        double IntegratedPower() const;
+
+        int m_sampleRate = 0;
+        int m_stride = 0;           // channels in the input
+        int m_channels = 0;         // metered channels
+        int m_lanes = 0;            // metered channels rounded up to SIMD pairs
+
+        // K-weighting: high shelf then high pass, transposed direct form II
+        Biquad m_stage[2]{};
+        alignas(16) double m_coeffs[2][10]{};   // b0 b1 b2 a1 a2, each duplicated for 2 lanes
+        alignas(16) double m_z1[2][kMaxChannels]{};
+        alignas(16) double m_z2[2][kMaxChannels]{};
+        double m_weights[kMaxChannels]{};
+
+        // True peak interpolator
+        alignas(16) float m_tpCoeffs[kTruePeakPhases][kTruePeakTaps]{};
+        alignas(16) float m_tpHistory[kMaxChannels][2 * kTruePeakTaps]{};
+        int m_tpPos = 0;
+
+        // Loudness
+        size_t m_subBlockFrames = 0;
+        size_t m_subBlockFill = 0;
+        alignas(16) double m_subBlockEnergy[kMaxChannels]{};
+        double m_blockPower[kShortTermBlocks]{};
+        int m_blockIndex = 0;
+        int m_blockCount = 0;
+        std::vector<uint64_t> m_histCount;
+        std::vector<double> m_histEnergy;
+
+        MeterSnapshot m_snapshot{};
+    };
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "meter_engine.h"
+
+namespace record_windows
+{
+    // Binary meter frame pushed on the meter event channel.
+    //
+    // Little endian, levels as float32 dBFS / LUFS (floored at -160):
+    //   0  uint8   version (1)
+    //   1  uint8   channel count (N)
+    //   2  uint16  reserved
+    //   4  uint32  sequence number
+    //   8  uint64  frames (samples per channel) since start
+    //   16 float32 current, max          (same as getAmplitude)
+    //   24 float32 momentary, short term, integrated LUFS
+    //   36 N x { float32 peak, rms, truePeak, maxPeak, maxTruePeak; uint32 clipCount }
+    struct MeterFrame
+    {
+        static constexpr uint8_t kVersion = 1;
+        static constexpr size_t kHeaderBytes = 36;
+        static constexpr size_t kChannelBytes = 24;
+        static constexpr size_t kMaxBytes = kHeaderBytes + kChannelBytes * MeterSnapshot::kMaxChannels;
+
+        static size_t SizeFor(int channelCount)
+        {
+            return kHeaderBytes + kChannelBytes * (size_t)channelCount;
+        }
+
+        // Writes the frame to out (at least SizeFor(snapshot.channelCount) bytes).
+        // Returns the number of bytes written.
+        static size_t Encode(const MeterSnapshot& snapshot, double current, double max, uint32_t sequence, uint8_t* out)
+        {
+            uint8_t* p = out;
+            auto put = [&p](const void* value, size_t size) {
+                std::memcpy(p, value, size);
+                p += size;
+            };
+            auto putFloat = [&put](double value) {
+                float f = (float)value;
+                put(&f, sizeof(f));
+            };
+
+            uint8_t header[4] = { kVersion, (uint8_t)snapshot.channelCount, 0, 0 };
+            put(header, sizeof(header));
+            put(&sequence, sizeof(sequence));
+            put(&snapshot.frames, sizeof(snapshot.frames));
+
+            putFloat(current);
+            putFloat(max);
+            putFloat(snapshot.momentaryLufs);
+            putFloat(snapshot.shortTermLufs);
+            putFloat(snapshot.integratedLufs);
+
+            for (int c = 0; c < snapshot.channelCount; c++)
+            {
+                const auto& channel = snapshot.channels[c];
+                putFloat(channel.peak);
+                putFloat(channel.rms);
+                putFloat(channel.truePeak);
+                putFloat(channel.maxPeak);
+                putFloat(channel.maxTruePeak);
+
+                uint32_t clips = channel.clipCount > UINT32_MAX ? UINT32_MAX : (uint32_t)channel.clipCount;
+                put(&clips, sizeof(clips));
+            }
+
+            return (size_t)(p - out);
+        }
+    };
+}
@@ -4,18 +4,22 @@
 
 namespace record_windows
 {
-    MediaFoundationRecorder::MediaFoundationRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler)
+    MediaFoundationRecorder::MediaFoundationRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, EventStreamHandler<EncodableValue>* meterEventHandler, EventStreamHandler<EncodableValue>* segmentEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue)
         : m_nRefCount(1),
         m_critsec(),
         m_pConfig(nullptr),
         m_pSource(NULL),
         m_pReader(NULL),
-        m_pWriter(NULL),
+        m_pInputType(NULL),
         m_pPresentationDescriptor(NULL),
         m_stateEventHandler(stateEventHandler),
         m_recordEventHandler(recordEventHandler),
+        m_meterEventHandler(meterEventHandler),
+        m_segmentEventHandler(segmentEventHandler),
+        m_dispatchQueue(std::move(dispatchQueue)),
         m_recordingPath(std::wstring()),
-        m_pMediaType(NULL)
+        m_streamPool(BufferPool::Create()),
+        m_meterPool(BufferPool::Create(8))
     {
     }
 
@@ -34,44 +38,290 @@ namespace record_windows
             return E_NOTIMPL;
         }
 
-        hr = InitRecording(std::move(config));
+        AdjustCaptureFormat(*config);
+
+        // Armed on the same input: capture keeps running, the recording
+        // starts with the pre-roll.
+        bool fromArmed = m_armed && CanReuseCapture(*config);
+
+        if (fromArmed)
+        {
+            // Samples captured meanwhile stay queued, after the pre-roll
+            m_pipeline.Stop();
+            m_pConfig = std::move(config);
+            m_armed = false;
+            m_flushPreRoll = true;
+        }
+        else
+        {
+            hr = InitRecording(std::move(config));
+        }
+
+        // Counted by the pipeline worker, a stop before any sample finds 0
+        m_dataWritten = 0;
 
         if (SUCCEEDED(hr))
         {
             m_recordingPath = path;
-            hr = CreateSinkWriter(path);
+            m_segmentFrames = SegmentFrames();
+            m_segmentWritten = 0;
+            m_segmentIndex = m_segmentFrames > 0 ? 1 : 0;
+            m_retentionSlots = RetentionSlots();
+
+            hr = m_pReader->GetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM, &m_pInputType);
+        }
+        if (SUCCEEDED(hr))
+        {
+            auto outputPath = m_segmentIndex > 0 ? SegmentPath(m_segmentIndex) : path;
+            hr = CreateOutput(outputPath, m_output);
+
+            if (SUCCEEDED(hr))
+            {
+                std::lock_guard<std::mutex> lock(m_segmentMutex);
+                m_outputPath = outputPath;
+            }
         }
         if (SUCCEEDED(hr))
         {
+            // Same capture buffers feed the file and the stream
+            if (m_pConfig->streamWhileRecording)
+            {
+                StartStreamSink();
+            }
+
+            StartPipeline();
+
+            // Request the first sample, already done when armed
+            if (!fromArmed)
+            {
+                hr = m_pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM,
+                    0,
+                    NULL, NULL, NULL, NULL
+                );
+            }
+        }
+        if (SUCCEEDED(hr))
+        {
+            UpdateState(RecordState::record);
+        }
+        else
+        {
+            EndRecording();
+        }
+
+        return hr;
+    }
+
+    HRESULT MediaFoundationRecorder::Arm(std::unique_ptr<RecordConfig> config)
+    {
+        HRESULT hr = InitRecording(std::move(config));
+
+        if (SUCCEEDED(hr))
+        {
+            // Capture format is always PCM 16 bits
+            size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+            size_t frames = (size_t)m_pConfig->sampleRate * std::max(m_pConfig->preRollMs, 0) / 1000;
+
+            // Ring is sized in InitRecording
+            m_preRollBytes = frames * frameBytes;
+            m_armed = true;
+
+            // Meters run while armed
+            StartPipeline();
+
             // Request the first sample
             hr = m_pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM,
                 0,
                 NULL, NULL, NULL, NULL
             );
         }
+        if (FAILED(hr))
+        {
+            EndRecording();
+        }
+
+        return hr;
+    }
+
+    void MediaFoundationRecorder::AdjustCaptureFormat(RecordConfig& config)
+    {
+        // Opus only encodes some rates, the source reader resamples
+        if (config.encoderName == AudioEncoder().opus)
+        {
+            config.sampleRate = (int)OpusOggEncoder::SupportedSampleRate((uint32_t)config.sampleRate);
+        }
+    }
+
+    bool MediaFoundationRecorder::CanReuseCapture(const RecordConfig& config) const
+    {
+        return m_pSource &&
+            config.deviceId == m_capture.deviceId &&
+            config.sampleRate == m_capture.sampleRate &&
+            config.numChannels == m_capture.numChannels;
+    }
+
+    // Stops reading and pauses the source, reader and its media type are kept.
+    HRESULT MediaFoundationRecorder::IdleCapture()
+    {
+        {
+            AutoLock lock(m_critsec);
+            m_captureIdle = true;
+        }
+
+        HRESULT hr = S_OK;
+
+        // Already paused by Pause()
+        if (!m_warm && m_recordState != RecordState::pause)
+        {
+            hr = m_pSource->Pause();
+        }
         if (SUCCEEDED(hr))
         {
-            UpdateState(RecordState::record);
+            m_warm = true;
         }
-        else
+
+        return hr;
+    }
+
+    // Warm capture: drops what the reader got before the pause, then
+    // restarts the source. The caller requests the first sample.
+    HRESULT MediaFoundationRecorder::ResumeCapture()
+    {
         {
-            EndRecording();
+            std::lock_guard<std::mutex> lock(m_flushMutex);
+            m_flushPending = true;
+        }
+
+        HRESULT hr = m_pReader->Flush((DWORD)MF_SOURCE_READER_ALL_STREAMS);
+
+        if (SUCCEEDED(hr))
+        {
+            // Reads requested before the flush completes could be dropped
+            std::unique_lock<std::mutex> lock(m_flushMutex);
+            if (!m_flushDone.wait_for(lock, std::chrono::seconds(1), [this] { return !m_flushPending; }))
+            {
+                hr = MF_E_TIMEOUT;
+            }
+        }
+        if (SUCCEEDED(hr))
+        {
+            AutoLock lock(m_critsec);
+            m_captureIdle = false;
+        }
+        if (SUCCEEDED(hr))
+        {
+            PROPVARIANT var;
+            PropVariantInit(&var);
+            var.vt = VT_EMPTY;
+
+            hr = m_pSource->Start(m_pPresentationDescriptor, NULL, &var);
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_warm = false;
         }
 
         return hr;
     }
 
-    HRESULT MediaFoundationRecorder::StartStream(std::unique_ptr<RecordConfig> config)
+    HRESULT MediaFoundationRecorder::ReleaseCapture()
     {
-        if (config->encoderName != AudioEncoder().pcm16bits)
+        HRESULT hr = S_OK;
+
+        // Release reader callback first
         {
-            return E_NOTIMPL;
+            AutoLock lock(m_critsec);
+            SafeRelease(m_pReader);
+            m_captureIdle = false;
         }
 
+        if (m_pSource)
+        {
+            hr = m_pSource->Stop();
+
+            if (SUCCEEDED(hr))
+            {
+                hr = m_pSource->Shutdown();
+            }
+        }
+
+        SafeRelease(m_pSource);
+        SafeRelease(m_pPresentationDescriptor);
+        m_capture = CaptureFormat();
+        m_warm = false;
+
+        return hr;
+    }
+
+    // Pipeline worker not running. PCM frames go to the record event channel,
+    // alone or next to the file (tee).
+    void MediaFoundationRecorder::StartStreamSink()
+    {
+        auto frameBytes = ChunkCoalescer::FrameBytesFor(
+            m_pConfig->streamChunkMs,
+            m_pConfig->streamChunkBytes,
+            m_pConfig->sampleRate,
+            m_pConfig->numChannels * 2
+        );
+
+        m_streamCoalescer.Reset(frameBytes, m_streamPool, [this](PooledBuffer&& frame) {
+            m_dispatchQueue->Post([this, frame = std::move(frame)]() mutable -> void {
+                if (m_recordEventHandler) {
+                    // Move the bytes in and out of the value, buffer goes back to the pool.
+                    EncodableValue value(frame.Lend());
+                    m_recordEventHandler->Success(value);
+                    frame.Restore(std::move(std::get<std::vector<uint8_t>>(value)));
+                }
+            });
+        });
+        m_streaming = true;
+    }
+
+    // Pipeline worker not running. Each packet is sent in its own event.
+    HRESULT MediaFoundationRecorder::StartEncodedStreamSink()
+    {
+        HRESULT hr = CreateStreamEncoder(EncoderConfig(), [this](const uint8_t* data, size_t size) {
+            auto packet = m_streamPool->Acquire(size);
+            packet.Data().assign(data, data + size);
+
+            m_dispatchQueue->Post([this, packet = std::move(packet)]() mutable -> void {
+                if (m_recordEventHandler) {
+                    EncodableValue value(packet.Lend());
+                    m_recordEventHandler->Success(value);
+                    packet.Restore(std::move(std::get<std::vector<uint8_t>>(value)));
+                }
+            });
+        }, m_streamEncoder);
+
+        if (SUCCEEDED(hr))
+        {
+            m_streaming = true;
+        }
+
+        return hr;
+    }
+
+    HRESULT MediaFoundationRecorder::StartStream(std::unique_ptr<RecordConfig> config)
+    {
+        bool encoded = config->encoderName != AudioEncoder().pcm16bits;
+
         HRESULT hr = InitRecording(std::move(config));
 
         if (SUCCEEDED(hr))
         {
+            if (encoded)
+            {
+                hr = StartEncodedStreamSink();
+            }
+            else
+            {
+                StartStreamSink();
+            }
+        }
+        if (SUCCEEDED(hr))
+        {
+            StartPipeline();
+
             // Request the first sample
             hr = m_pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM,
                 0,
@@ -92,23 +342,56 @@ namespace record_windows
 
     HRESULT MediaFoundationRecorder::InitRecording(std::unique_ptr<RecordConfig> config)
     {
+        auto setupStart = std::chrono::steady_clock::now();
+
         HRESULT hr = EndRecording();
 
         m_pConfig = std::move(config);
 
-        if (SUCCEEDED(hr))
+        AdjustCaptureFormat(*m_pConfig);
+
+        // Kept from the previous recording, only if it still fits
+        if (m_warm && !CanReuseCapture(*m_pConfig))
         {
-            if (!m_mfStarted)
-            {
-                hr = MFStartup(MF_VERSION, MFSTARTUP_NOSOCKET);
-            }
+            ReleaseCapture();
+        }
+
+        // Recent audio for the pre-roll and exports, plus some slack so the
+        // oldest requested bytes can't be overwritten while being copied
+        {
+            int historyMs = m_pConfig->historyMs > 0 ? m_pConfig->historyMs + kExportSlackMs : 0;
+            int recentMs = std::max(std::max(m_pConfig->preRollMs, 0), historyMs);
+            size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+            size_t frames = (size_t)m_pConfig->sampleRate * recentMs / 1000;
+
+            m_recent.Reset(frames * frameBytes, frameBytes);
+        }
+
+        if (SUCCEEDED(hr) && !m_mfStarted)
+        {
+            hr = MfRuntime::Acquire();
+
             if (SUCCEEDED(hr))
             {
                 m_mfStarted = true;
             }
         }
 
-        if (SUCCEEDED(hr))
+        bool warm = m_warm;
+
+        if (SUCCEEDED(hr) && warm)
+        {
+            hr = ResumeCapture();
+
+            // Not worth retrying on this capture
+            if (FAILED(hr))
+            {
+                ReleaseCapture();
+                warm = false;
+                hr = S_OK;
+            }
+        }
+        if (SUCCEEDED(hr) && !warm)
         {
             if (m_pConfig->deviceId.length() != 0)
             {
@@ -120,10 +403,23 @@ namespace record_windows
                 hr = CreateAudioCaptureDevice(NULL);
             }
         }
-        if (SUCCEEDED(hr))
+        if (SUCCEEDED(hr) && !warm)
         {
             hr = CreateSourceReaderAsync();
         }
+        if (SUCCEEDED(hr))
+        {
+            m_capture.deviceId = m_pConfig->deviceId;
+            m_capture.sampleRate = m_pConfig->sampleRate;
+            m_capture.numChannels = m_pConfig->numChannels;
+
+            (warm ? m_warmStarts : m_coldStarts)++;
+            m_startSetupUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - setupStart).count();
+
+            AutoLock lock(m_critsec);
+            m_startClock = setupStart;
+            m_startPending = true;
+        }
 
         return hr;
     }
@@ -132,7 +428,8 @@ namespace record_windows
     {
         HRESULT hr = S_OK;
 
-        if (m_pSource)
+        // Not while warm, the source is kept for the next recording
+        if (m_pSource && !m_warm)
         {
             hr = m_pSource->Pause();
 
@@ -149,13 +446,16 @@ namespace record_windows
     {
         HRESULT hr = S_OK;
 
-        if (m_pSource)
+        if (m_pSource && !m_warm)
         {
             PROPVARIANT var;
             PropVariantInit(&var);
             var.vt = VT_EMPTY;
 
-            m_llBaseTime = m_llLastTime;
+            {
+                AutoLock lock(m_critsec);
+                m_llBaseTime = m_llLastTime;
+            }
 
             hr = m_pSource->Start(m_pPresentationDescriptor, NULL, &var);
 
@@ -170,34 +470,37 @@ namespace record_windows
 
     HRESULT MediaFoundationRecorder::Stop()
     {
-        if (m_dataWritten == 0)
-        {
-            return Cancel();
-        }
+        // Base path, one sidecar for all the segments
+        auto recordingPath = m_recordingPath;
+        bool writeSidecar = m_pConfig && m_pConfig->waveformSidecar;
 
-        HRESULT hr = EndRecording();
+        // Nothing written is discarded, as a cancel. Only known once the
+        // queued samples and the pre-roll are out.
+        bool discarded = false;
+        HRESULT hr = EndRecording(false, &discarded);
 
         if (SUCCEEDED(hr))
         {
+            if (writeSidecar && !discarded && !recordingPath.empty())
+            {
+                // Best effort, the recording itself is complete
+                m_waveform.WriteSidecar(recordingPath + L".peaks");
+            }
+
             UpdateState(RecordState::stop);
         }
 
         return hr;
     }
 
+    // Segments already finalized (and notified) are kept.
     HRESULT MediaFoundationRecorder::Cancel()
     {
-        auto recordingPath = GetRecordingPath();
-        HRESULT hr = EndRecording();
+        HRESULT hr = EndRecording(true);
 
         if (SUCCEEDED(hr))
         {
             UpdateState(RecordState::stop);
-
-            if (!recordingPath.empty())
-            {
-                DeleteFile(recordingPath.c_str());
-            }
         }
 
         return hr;
@@ -225,52 +528,104 @@ namespace record_windows
         }
     }
 
-    HRESULT MediaFoundationRecorder::EndRecording()
+    HRESULT MediaFoundationRecorder::EndRecording(bool discard, bool* discardedEmpty)
     {
         HRESULT hr = S_OK;
 
-        // Release reader callback first
-        SafeRelease(m_pReader);
+        // Warm mode keeps the capture for the next recording
+        bool keepCapture = m_pSource && (m_warm || (m_pConfig && m_pConfig->keepWarm));
 
-        if (m_pSource)
+        if (keepCapture)
         {
-            hr = m_pSource->Stop();
+            keepCapture = SUCCEEDED(IdleCapture());
+        }
+        if (!keepCapture)
+        {
+            hr = ReleaseCapture();
+        }
 
-            if (SUCCEEDED(hr))
+        // Write out the samples still queued before finalizing. When the
+        // worker wasn't running (failed start from armed state), whatever
+        // got queued meanwhile would lead the next recording: drop it.
+        m_pipeline.Stop();
+        m_pipeline.Clear();
+
+        // Started from armed state but no sample came after
+        if (m_flushPreRoll && m_output)
+        {
+            FlushPreRoll();
+        }
+        m_flushPreRoll = false;
+        m_armed = false;
+        m_preRollBytes = 0;
+
+        if (discardedEmpty)
+        {
+            *discardedEmpty = m_output && m_dataWritten == 0;
+            discard = discard || *discardedEmpty;
+        }
+
+        m_waveform.Flush();
+
+        // Previous segments are finalized, the one opened ahead is dropped
+        m_segmentWorker.Stop();
+
+        if (m_nextOutput)
+        {
+            auto nextPath = m_nextOutput->Path();
+            m_nextOutput->Close();
+            m_nextOutput = nullptr;
+            DeleteFile(nextPath.c_str());
+        }
+        m_nextOutputPending = false;
+
+        if (m_output)
+        {
+            auto outputPath = m_output->Path();
+
+            if (discard)
             {
-                hr = m_pSource->Shutdown();
+                m_output->Close();
+                DeleteFile(outputPath.c_str());
+            }
+            else if (m_segmentIndex > 0)
+            {
+                hr = FinalizeSegment(std::move(m_output), m_segmentIndex);
+            }
+            else
+            {
+                hr = m_output->Close();
             }
+
+            m_output = nullptr;
         }
 
-        if (m_pWriter)
         {
-            hr = m_pWriter->Finalize();
+            std::lock_guard<std::mutex> lock(m_segmentMutex);
+            m_outputPath = std::wstring();
         }
+        m_segmentFrames = 0;
+        m_segmentIndex = 0;
+        m_retentionSlots = 0;
 
-        if (m_pConfig && m_pConfig->encoderName == AudioEncoder().wav) {
-            FillWavHeader();
+        // Send the remaining stream bytes
+        if (m_streamEncoder)
+        {
+            m_streamEncoder->Drain();
+            m_streamEncoder = nullptr;
         }
+        m_streamCoalescer.Flush();
+        m_streamCoalescer.Reset(0, nullptr, nullptr);
+        m_streaming = false;
 
         m_bFirstSample = true;
         m_llBaseTime = 0;
         m_llLastTime = 0;
 
-        m_amplitude = -160;
-        m_maxAmplitude = -160;
+        // Pipeline is stopped, no concurrent writer
+        m_amplitude.Store({ -160, -160 });
 
-        if (m_mfStarted)
-        {
-            hr = MFShutdown();
-            if (SUCCEEDED(hr))
-            {
-                m_mfStarted = false;
-            }
-        }
-
-        SafeRelease(m_pSource);
-        SafeRelease(m_pPresentationDescriptor);
-        SafeRelease(m_pWriter);
-        SafeRelease(m_pMediaType);
+        SafeRelease(m_pInputType);
         m_pConfig = nullptr;
         m_recordingPath = std::wstring();
 
@@ -281,8 +636,22 @@ namespace record_windows
     {
         HRESULT hr = EndRecording();
 
+        HRESULT hrRelease = ReleaseCapture();
+        if (SUCCEEDED(hr)) hr = hrRelease;
+
+        if (m_mfStarted)
+        {
+            MfRuntime::Release();
+            m_mfStarted = false;
+        }
+
+        // Exports in progress complete
+        m_exportWorker.Stop();
+
         m_stateEventHandler = nullptr;
         m_recordEventHandler = nullptr;
+        m_meterEventHandler = nullptr;
+        m_segmentEventHandler = nullptr;
 
         return hr;
     }
@@ -292,7 +661,7 @@ namespace record_windows
         m_recordState = state;
 
         if (m_stateEventHandler) {
-            RecordWindowsPlugin::RunOnMainThread([this, state]() -> void {
+            m_dispatchQueue->Post([this, state]() -> void {
                 m_stateEventHandler->Success(std::make_unique<flutter::EncodableValue>(state));
             });
         }
@@ -356,184 +725,540 @@ namespace record_windows
         {
             hr = CreateAudioProfileIn(&pMediaTypeIn);
         }
-        if (SUCCEEDED(hr))
+        if (SUCCEEDED(hr))
+        {
+            hr = m_pReader->SetCurrentMediaType(0, NULL, pMediaTypeIn);
+        }
+
+        SafeRelease(&pMediaTypeIn);
+        SafeRelease(&pAttributes);
+        return hr;
+    }
+
+    bool MediaFoundationRecorder::UsesWavWriter() const
+    {
+        return m_pConfig->encoderName == AudioEncoder().wav ||
+            m_pConfig->encoderName == AudioEncoder().pcm16bits;
+    }
+
+    OpusOggEncoder::Options MediaFoundationRecorder::OpusOptions() const
+    {
+        OpusOggEncoder::Options options;
+        options.sampleRate = m_pConfig->sampleRate;
+        options.numChannels = m_pConfig->numChannels;
+        options.bitRate = m_pConfig->bitRate;
+        options.frameMs = m_pConfig->opusFrameMs;
+        options.complexity = m_pConfig->opusComplexity;
+        options.vbr = m_pConfig->opusVbr;
+        options.dtx = m_pConfig->opusDtx;
+        return options;
+    }
+
+    FlacEncoder::Options MediaFoundationRecorder::FlacOptions() const
+    {
+        FlacEncoder::Options options;
+        options.sampleRate = m_pConfig->sampleRate;
+        options.numChannels = m_pConfig->numChannels;
+        options.compressionLevel = m_pConfig->flacCompressionLevel;
+        return options;
+    }
+
+    StreamEncoderConfig MediaFoundationRecorder::EncoderConfig() const
+    {
+        StreamEncoderConfig config;
+        config.encoderName = m_pConfig->encoderName;
+        config.sampleRate = m_pConfig->sampleRate;
+        config.numChannels = m_pConfig->numChannels;
+        config.bitRate = m_pConfig->bitRate;
+        config.opus = OpusOptions();
+        config.flacCompressionLevel = m_pConfig->flacCompressionLevel;
+        return config;
+    }
+
+    // Any thread, config and input type don't change while recording.
+    HRESULT MediaFoundationRecorder::CreateOutput(const std::wstring& path, std::unique_ptr<FileOutput>& output)
+    {
+        if (UsesWavWriter())
+        {
+            // Same format as the capture output, see CreateAudioProfileIn
+            WavFormat format;
+            format.channels = (uint16_t)m_pConfig->numChannels;
+            format.sampleRate = (uint32_t)m_pConfig->sampleRate;
+            format.bitsPerSample = 16;
+
+            WavWriter::Options options;
+            options.headerless = m_pConfig->encoderName == AudioEncoder().pcm16bits;
+            options.checkpointMs = (uint32_t)std::max(m_pConfig->checkpointMs, 0);
+            options.checkpointBytes = (uint64_t)std::max(m_pConfig->checkpointBytes, 0);
+
+            if (m_retentionSlots > 0)
+            {
+                // Rolling files keep their size, allocated once and overwritten
+                options.reuseFile = true;
+                options.extentBytes = WavWriter::kHeaderBytes + m_segmentFrames * format.BlockAlign();
+            }
+
+            return WavFileOutput::Create(path, format, options, output);
+        }
+
+        if (m_pConfig->encoderName == AudioEncoder().opus)
+        {
+            return OggOpusFileOutput::Create(path, OpusOptions(), output);
+        }
+
+        if (m_pConfig->encoderName == AudioEncoder().flac)
+        {
+            return FlacFileOutput::Create(path, FlacOptions(), output);
+        }
+
+        if (m_pConfig->encoderName == AudioEncoder().aacLc && m_pConfig->mp4FragmentMs > 0)
+        {
+            return Fmp4FileOutput::Create(path, EncoderConfig(), (UINT32)m_pConfig->mp4FragmentMs, output);
+        }
+
+        IMFMediaType* pMediaTypeOut = NULL;
+
+        HRESULT hr = CreateAudioProfileOut(m_pConfig->encoderName, &pMediaTypeOut);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = SinkWriterOutput::Create(path, pMediaTypeOut, m_pInputType,
+                m_pConfig->sampleRate, m_pConfig->numChannels * 2, output);
+        }
+
+        SafeRelease(&pMediaTypeOut);
+
+        return hr;
+    }
+
+    uint64_t MediaFoundationRecorder::SegmentFrames() const
+    {
+        const uint64_t sampleRate = (uint64_t)m_pConfig->sampleRate;
+        uint64_t byTime = (uint64_t)std::max(m_pConfig->segmentMs, 0) * sampleRate / 1000;
+        uint64_t byBytes = 0;
+
+        if (byTime == 0 && m_pConfig->segmentBytes <= 0 && m_pConfig->retentionMs > 0)
+        {
+            // Retention without segment size: window split in 8 files
+            byTime = (uint64_t)m_pConfig->retentionMs * sampleRate / 1000 / 8;
+        }
+
+        if (m_pConfig->segmentBytes > 0)
+        {
+            // Encoded size is only known afterwards, estimated from the bit rate
+            uint64_t bytesPerSecond = UsesWavWriter()
+                ? sampleRate * m_pConfig->numChannels * 2
+                : (uint64_t)std::max(m_pConfig->bitRate, 8) / 8;
+
+            byBytes = (uint64_t)m_pConfig->segmentBytes * sampleRate / bytesPerSecond;
+        }
+
+        uint64_t frames = (byTime > 0 && byBytes > 0) ? std::min(byTime, byBytes) : std::max(byTime, byBytes);
+        return (byTime > 0 || byBytes > 0) ? std::max<uint64_t>(frames, 1) : 0;
+    }
+
+    // Files needed to always keep retentionMs of complete audio: the window,
+    // plus the file being written and the one opened ahead.
+    int MediaFoundationRecorder::RetentionSlots() const
+    {
+        if (m_pConfig->retentionMs <= 0 || m_segmentFrames == 0)
+        {
+            return 0;
+        }
+
+        uint64_t window = (uint64_t)m_pConfig->retentionMs * m_pConfig->sampleRate / 1000;
+        uint64_t slots = (window + m_segmentFrames - 1) / m_segmentFrames + 2;
+
+        return (int)std::min<uint64_t>(slots, 9999);
+    }
+
+    // <stem>_0001<ext>, <stem>_0002<ext>...
+    // With retention, segments cycle through the first m_retentionSlots names.
+    std::wstring MediaFoundationRecorder::SegmentPath(int index) const
+    {
+        if (m_retentionSlots > 0)
+        {
+            index = (index - 1) % m_retentionSlots + 1;
+        }
+
+        auto separator = m_recordingPath.find_last_of(L"\\/");
+        auto dot = m_recordingPath.find_last_of(L'.');
+
+        if (dot == std::wstring::npos || (separator != std::wstring::npos && dot < separator))
         {
-            hr = m_pReader->SetCurrentMediaType(0, NULL, pMediaTypeIn);
+            dot = m_recordingPath.length();
         }
 
-        SafeRelease(&pMediaTypeIn);
-        SafeRelease(&pAttributes);
-        return hr;
+        wchar_t suffix[16];
+        swprintf_s(suffix, L"_%04d", index);
+
+        return m_recordingPath.substr(0, dot) + suffix + m_recordingPath.substr(dot);
     }
 
-    HRESULT MediaFoundationRecorder::CreateSinkWriter(std::wstring path)
+    // Pipeline worker thread (or before it starts). Opens the file of the
+    // next segment on the segment worker.
+    void MediaFoundationRecorder::PrepareNextSegment()
     {
-        IMFSinkWriter* pSinkWriter = NULL;
-        IMFMediaType* pMediaTypeOut = NULL;
-        IMFMediaType* pMediaTypeIn = NULL;
-        DWORD          streamIndex = 0;
-
-        HRESULT hr = MFCreateSinkWriterFromURL(path.c_str(), NULL, NULL, &pSinkWriter);
-
-        // Set the output media type.
-        if (SUCCEEDED(hr))
         {
-            hr = CreateAudioProfileOut(&pMediaTypeOut);
+            std::lock_guard<std::mutex> lock(m_segmentMutex);
+            m_nextOutputPending = true;
         }
-        if (SUCCEEDED(hr))
+
+        int index = m_segmentIndex + 1;
+        InplaceTask task([this, index]() {
+            std::unique_ptr<FileOutput> output;
+            HRESULT hr = CreateOutput(SegmentPath(index), output);
+
+            {
+                std::lock_guard<std::mutex> lock(m_segmentMutex);
+                m_nextOutput = std::move(output);
+                m_nextOutputHr = hr;
+                m_nextOutputPending = false;
+            }
+            m_segmentReady.notify_all();
+        });
+
+        if (!m_segmentWorker.Push(std::move(task)))
         {
-            hr = pSinkWriter->AddStream(pMediaTypeOut, &streamIndex);
+            task();
         }
+    }
+
+    // Pipeline worker thread. Swaps to the output opened ahead, only waits
+    // if it is not ready yet.
+    HRESULT MediaFoundationRecorder::RollOver()
+    {
+        std::unique_ptr<FileOutput> next;
+        HRESULT hr = S_OK;
 
-        // Set the input media type.
-        if (SUCCEEDED(hr))
         {
-            hr = m_pReader->GetCurrentMediaType(streamIndex, &pMediaTypeIn);
+            std::unique_lock<std::mutex> lock(m_segmentMutex);
+            m_segmentReady.wait(lock, [this]() { return !m_nextOutputPending; });
+
+            next = std::move(m_nextOutput);
+            hr = next ? m_nextOutputHr : E_UNEXPECTED;
+            if (SUCCEEDED(hr))
+            {
+                m_outputPath = next->Path();
+            }
         }
-        if (SUCCEEDED(hr))
+
+        if (FAILED(hr))
         {
-            hr = pSinkWriter->SetInputMediaType(streamIndex, pMediaTypeIn, NULL);
+            return hr;
         }
 
-        // Tell the sink writer to Start accepting data.
-        if (SUCCEEDED(hr))
+        std::unique_ptr<FileOutput> previous = std::move(m_output);
+        int previousIndex = m_segmentIndex;
+
+        m_output = std::move(next);
+        m_segmentIndex++;
+        m_segmentWritten = 0;
+
+        // Finalizing may take a while (encoder drain, header patch)
+        InplaceTask task([this, output = std::move(previous), previousIndex]() mutable {
+            FinalizeSegment(std::move(output), previousIndex);
+        });
+        if (!m_segmentWorker.Push(std::move(task)))
         {
-            hr = pSinkWriter->BeginWriting();
+            task();
         }
 
-        if (SUCCEEDED(hr))
+        PrepareNextSegment();
+
+        return S_OK;
+    }
+
+    // Segment worker thread, or control thread on stop.
+    HRESULT MediaFoundationRecorder::FinalizeSegment(std::unique_ptr<FileOutput> output, int index)
+    {
+        HRESULT hr = output->Close();
+
+        if (!m_segmentEventHandler)
         {
-            m_pWriter = pSinkWriter;
-            m_pWriter->AddRef();
-            m_pMediaType = pMediaTypeOut;
-            m_pMediaType->AddRef();
+            return hr;
         }
 
-        SafeRelease(&pSinkWriter);
-        SafeRelease(&pMediaTypeOut);
-        SafeRelease(&pMediaTypeIn);
+        struct SegmentInfo
+        {
+            int64_t bytes;
+            std::string path;
+            int index;
+            HRESULT hr;
+        };
+        SegmentInfo info{ (int64_t)output->Bytes(), Utf8FromUtf16(output->Path()), index, hr };
+
+        m_dispatchQueue->Post([this, info = std::move(info)]() -> void {
+            if (m_segmentEventHandler) {
+                EncodableMap map{
+                    {EncodableValue("path"), EncodableValue(info.path)},
+                    {EncodableValue("index"), EncodableValue(info.index)},
+                    {EncodableValue("bytes"), EncodableValue(info.bytes)},
+                };
+                if (FAILED(info.hr)) {
+                    _com_error err(info.hr);
+                    map[EncodableValue("error")] = EncodableValue(Utf8FromUtf16(err.ErrorMessage()));
+                }
+                m_segmentEventHandler->Success(EncodableValue(map));
+            }
+        });
 
         return hr;
     }
 
     std::map<std::string, double> MediaFoundationRecorder::GetAmplitude()
     {
+        auto amplitude = m_amplitude.Load();
+
         return {
-            {"current", m_amplitude},
-            {"max" , m_maxAmplitude},
+            {"current", amplitude.current},
+            {"max" , amplitude.max},
         };
     }
 
-    void MediaFoundationRecorder::GetAmplitudeFromSample(BYTE* chunk, DWORD size, int bytesPerSample) {
-        int maxSample = -160;
+    MeterSnapshot MediaFoundationRecorder::GetMeters()
+    {
+        return m_meterSnapshot.Load();
+    }
 
-        if (bytesPerSample == 2) { // PCM 16 bits
-            auto values = convertBytesToInt16(chunk, size);
+    std::vector<float> MediaFoundationRecorder::GetWaveform(double seconds, int pixels)
+    {
+        return m_waveform.Query(seconds, pixels);
+    }
 
-            for (DWORD i = 0; i < size; i++) {
-                int curSample = std::abs(values[i]);
-                if (curSample > maxSample) {
-                    maxSample = curSample;
-                }
-            }
+    void MediaFoundationRecorder::GetAmplitudeFromSample(BYTE* chunk, DWORD size, int bytesPerSample) {
+        AmplitudeStats stats;
 
-            m_amplitude = 20 * std::log10(maxSample / 32767.0); // 16 signed bits 2^15 - 1
+        if (bytesPerSample == 2) { // PCM 16 bits
+            stats = ComputeAmplitude<Pcm16Format>(chunk, size);
         }
         else /* if (bytesPerSample == 1) */ { // PCM 8 bits
-            for (DWORD i = 0; i < size; i++) {
-                byte curSample = chunk[i];
-                if (curSample > maxSample) {
-                    maxSample = curSample;
-                }
-            }
-
-            m_amplitude = 20 * std::log10(maxSample / 256.0); // 8 unsigned bits 2^8
+            stats = ComputeAmplitude<Pcm8Format>(chunk, size);
         }
 
-        if (m_amplitude > m_maxAmplitude) {
-            m_maxAmplitude = m_amplitude;
+        AmplitudeLevels levels = m_amplitude.Load();
+        levels.current = ToDbfs(stats.peak);
+
+        if (levels.current > levels.max) {
+            levels.max = levels.current;
         }
-    }
 
-    std::wstring MediaFoundationRecorder::GetRecordingPath()
-    {
-        return m_recordingPath;
+        m_amplitude.Store(levels);
     }
 
-    std::vector<int16_t> MediaFoundationRecorder::convertBytesToInt16(BYTE* bytes, DWORD size)
+    // Pipeline worker thread
+    void MediaFoundationRecorder::PushMeterFrame(size_t frames)
     {
-        // Convert to int16
-        std::vector<int16_t> values(size / 2);
-
-        int n = 1;
-        if (*(char*)&n == 1) {
-            // We're on little endian host
-            for (DWORD i = 0; i < size; i += 2) {
-                values.push_back(int16_t(bytes[i] << 0 | bytes[i + 1] << 8));
-            }
+        if (m_meterIntervalFrames == 0 || !m_meterEventHandler)
+        {
+            return;
         }
-        else {
-            // We're on big endian host
-            for (DWORD i = 0; i < size; i += 2) {
-                values.push_back(int16_t(bytes[i + 1] | bytes[i] << 8));
-            }
+
+        m_meterPendingFrames += frames;
+        if (m_meterPendingFrames < m_meterIntervalFrames)
+        {
+            return;
         }
+        m_meterPendingFrames %= m_meterIntervalFrames;
+
+        const auto& snapshot = m_meter.Snapshot();
+        auto amplitude = m_amplitude.Load();
+
+        PooledBuffer frame = m_meterPool->Acquire(MeterFrame::kMaxBytes);
+        auto& bytes = frame.Data();
+        bytes.resize(MeterFrame::SizeFor(snapshot.channelCount));
+        MeterFrame::Encode(snapshot, amplitude.current, amplitude.max, m_meterSequence++, bytes.data());
 
-        return values;
+        m_dispatchQueue->Post([this, frame = std::move(frame)]() mutable -> void {
+            if (m_meterEventHandler) {
+                EncodableValue value(frame.Lend());
+                m_meterEventHandler->Success(value);
+                frame.Restore(std::move(std::get<std::vector<uint8_t>>(value)));
+            }
+        });
     }
 
-    HRESULT MediaFoundationRecorder::isEncoderSupported(const std::string encoderName, bool* supported)
+    // Recorder command worker. The clip is copied out of the ring here (a
+    // few ms at most), the export worker only encodes it.
+    HRESULT MediaFoundationRecorder::ExportRecent(double seconds, const std::string& encoderName, std::wstring path, std::function<void(HRESULT)> onDone)
     {
-        MFT_REGISTER_TYPE_INFO typeLookup = {};
-        typeLookup.guidMajorType = MFMediaType_Audio;
-
-        if (encoderName == AudioEncoder().aacLc) typeLookup.guidSubtype = MFAudioFormat_AAC;
-        /*else if (encoderName == AudioEncoder().aacEld) typeLookup.guidSubtype = MFAudioFormat_AAC;
-        else if (encoderName == AudioEncoder().aacHe) typeLookup.guidSubtype = MFAudioFormat_AAC;*/
-        else if (encoderName == AudioEncoder().amrNb) typeLookup.guidSubtype = MFAudioFormat_AMR_NB;
-        else if (encoderName == AudioEncoder().amrWb) typeLookup.guidSubtype = MFAudioFormat_AMR_WB;
-        else if (encoderName == AudioEncoder().opus) typeLookup.guidSubtype = MFAudioFormat_Opus;
-        else if (encoderName == AudioEncoder().flac) typeLookup.guidSubtype = MFAudioFormat_FLAC;
-        else if (encoderName == AudioEncoder().pcm16bits || encoderName == AudioEncoder().wav) {
-            *supported = true;
-            return S_OK;
+        if (!m_pReader || !m_pConfig || m_recent.Capacity() == 0 || m_recent.Size() == 0)
+        {
+            return MF_E_INVALIDREQUEST;
         }
-        else {
-            *supported = false;
-            return S_OK;
+
+        bool supported = false;
+        HRESULT hr = isEncoderSupported(encoderName, &supported);
+
+        if (FAILED(hr) || !supported)
+        {
+            return E_NOTIMPL;
         }
 
-        // Enumerate all codecs except for codecs with field-of-use restrictions.
-        // Sort the results.
-        DWORD dwFlags =
-            (MFT_ENUM_FLAG_ALL & (~MFT_ENUM_FLAG_FIELDOFUSE)) |
-            MFT_ENUM_FLAG_SORTANDFILTER;
+        // Capture format is always PCM 16 bits
+        const size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+        const size_t historyBytes = (size_t)m_pConfig->sampleRate * std::max(m_pConfig->historyMs, m_pConfig->preRollMs) / 1000 * frameBytes;
+        size_t bytes = (size_t)std::max(seconds * m_pConfig->sampleRate, 0.0) * frameBytes;
+        bytes = std::min({ bytes, historyBytes, m_recent.Size() });
 
-        IMFActivate** ppMFTActivate = NULL;		// array of IMFActivate interface pointers
-        UINT32 numMFTActivate;
+        auto job = std::make_unique<ExportJob>();
+        job->path = std::move(path);
+        job->encoderName = encoderName;
+        job->sampleRate = m_pConfig->sampleRate;
+        job->numChannels = m_pConfig->numChannels;
+        job->opus = OpusOptions();
+        job->flac = FlacOptions();
+        job->onDone = std::move(onDone);
+        job->pcm.resize(bytes);
 
-        // Gets a list of output formats from an audio encoder.
-        HRESULT hr = MFTEnumEx(
-            MFT_CATEGORY_AUDIO_ENCODER,
-            dwFlags,
-            NULL,
-            &typeLookup,
-            &ppMFTActivate,
-            &numMFTActivate
-        );
+        if (!m_recent.Read(m_recent.Written() - bytes, job->pcm.data(), bytes))
+        {
+            return E_UNEXPECTED;
+        }
 
-        if (SUCCEEDED(hr))
+        if (encoderName != AudioEncoder().wav && encoderName != AudioEncoder().pcm16bits &&
+            encoderName != AudioEncoder().opus && encoderName != AudioEncoder().flac)
         {
-            *supported = numMFTActivate != 0;
+            hr = CreateAudioProfileOut(encoderName, &job->pTypeOut);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = m_pReader->GetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM, &job->pTypeIn);
+            }
+            if (FAILED(hr))
+            {
+                return hr;
+            }
         }
 
-        for (UINT32 i = 0; i < numMFTActivate; i++)
+        if (!m_exportWorker.IsRunning())
         {
-            SafeRelease(ppMFTActivate[i]);
+            m_exportWorker.Start(
+                [](InplaceTask& task) { task(); },
+                []() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+                []() { CoUninitialize(); }
+            );
         }
-        CoTaskMemFree(ppMFTActivate);
 
-        return hr;
+        InplaceTask task([this, job = std::move(job)]() mutable {
+            RunExport(std::move(job));
+        });
+
+        // Too many exports queued
+        return m_exportWorker.Push(std::move(task)) ? S_OK : MF_E_NOTACCEPTING;
+    }
+
+    // Export worker thread
+    void MediaFoundationRecorder::RunExport(std::unique_ptr<ExportJob> job)
+    {
+        // Keeps Media Foundation up even if the recorder is disposed meanwhile
+        HRESULT hr = MfRuntime::Acquire();
+
+        if (SUCCEEDED(hr))
+        {
+            std::unique_ptr<FileOutput> output;
+            const UINT32 blockAlign = job->numChannels * 2;
+
+            if (job->pTypeOut)
+            {
+                hr = SinkWriterOutput::Create(job->path, job->pTypeOut, job->pTypeIn, job->sampleRate, blockAlign, output);
+            }
+            else if (job->encoderName == AudioEncoder().opus)
+            {
+                hr = OggOpusFileOutput::Create(job->path, job->opus, output);
+            }
+            else if (job->encoderName == AudioEncoder().flac)
+            {
+                hr = FlacFileOutput::Create(job->path, job->flac, output);
+            }
+            else
+            {
+                WavFormat format;
+                format.channels = (uint16_t)job->numChannels;
+                format.sampleRate = job->sampleRate;
+                format.bitsPerSample = 16;
+
+                WavWriter::Options options;
+                options.headerless = job->encoderName == AudioEncoder().pcm16bits;
+
+                hr = WavFileOutput::Create(job->path, format, options, output);
+            }
+
+            // 100 ms per sample for the encoder
+            const size_t chunkBytes = std::max<size_t>(job->sampleRate / 10, 1) * blockAlign;
+            size_t offset = 0;
+
+            while (SUCCEEDED(hr) && offset < job->pcm.size())
+            {
+                DWORD size = (DWORD)std::min(chunkBytes, job->pcm.size() - offset);
+                hr = output->Write(NULL, job->pcm.data() + offset, size);
+                offset += size;
+            }
+
+            if (output)
+            {
+                HRESULT hrClose = output->Close();
+                if (SUCCEEDED(hr)) hr = hrClose;
+            }
+            if (FAILED(hr))
+            {
+                DeleteFile(job->path.c_str());
+            }
+
+            MfRuntime::Release();
+        }
+
+        // Not through m_dispatchQueue, it is closed on dispose while
+        // exports may still run
+        auto onDone = std::move(job->onDone);
+        job = nullptr;
+
+        if (onDone) onDone(hr);
+    }
+
+    std::map<std::string, int64_t> MediaFoundationRecorder::GetStats()
+    {
+        auto pool = m_streamPool->GetStats();
+
+        return {
+            {"streamPoolAllocations", (int64_t)pool.allocations},
+            {"streamPoolReuses", (int64_t)pool.reuses},
+            {"streamPoolDiscarded", (int64_t)pool.discarded},
+            {"streamPoolInUse", pool.inUse},
+            {"streamPoolAvailable", pool.available},
+            {"streamFrames", (int64_t)m_streamCoalescer.FramesEmitted()},
+            {"dispatchDropped", (int64_t)m_dispatchQueue->DroppedCount()},
+            {"pipelineOverruns", (int64_t)m_pipeline.Overruns()},
+            {"pipelineProcessed", (int64_t)m_pipeline.Processed()},
+            {"pipelineHighWater", (int64_t)m_pipeline.HighWater()},
+            {"pipelinePending", (int64_t)m_pipeline.Pending()},
+            {"startSetupUs", m_startSetupUs.load()},
+            {"startLatencyUs", m_startLatencyUs.load()},
+            {"warmStarts", m_warmStarts.load()},
+            {"coldStarts", m_coldStarts.load()},
+        };
+    }
+
+    std::wstring MediaFoundationRecorder::GetRecordingPath()
+    {
+        std::lock_guard<std::mutex> lock(m_segmentMutex);
+        return m_outputPath;
+    }
+
+    // Served from the capability table, built in the background by the plugin.
+    HRESULT MediaFoundationRecorder::isEncoderSupported(const std::string encoderName, bool* supported)
+    {
+        EncoderCapability capability;
+        *supported = EncoderCapabilities::Find(encoderName, capability) && capability.supported;
+
+        return S_OK;
+    }
+
+    HRESULT MediaFoundationRecorder::GetEncoderCapabilities(std::vector<EncoderCapability>& capabilities)
+    {
+        capabilities = EncoderCapabilities::All();
+
+        return S_OK;
     }
 
     // IUnknown methods
@@ -570,6 +1295,12 @@ namespace record_windows
 
     STDMETHODIMP MediaFoundationRecorder::OnFlush(DWORD)
     {
+        {
+            std::lock_guard<std::mutex> lock(m_flushMutex);
+            m_flushPending = false;
+        }
+        m_flushDone.notify_all();
+
         return S_OK;
     }
 
@@ -585,10 +1316,22 @@ namespace record_windows
 
         HRESULT hr = S_OK;
 
+        // Warm and idle: the pending read ends here, no other is requested
+        if (!m_pReader || m_captureIdle)
+        {
+            return S_OK;
+        }
+
         if (SUCCEEDED(hrStatus))
         {
             if (pSample)
             {
+                if (m_startPending)
+                {
+                    m_startLatencyUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startClock).count();
+                    m_startPending = false;
+                }
+
                 if (m_bFirstSample)
                 {
                     m_llBaseTime = llTimestamp;
@@ -604,55 +1347,211 @@ namespace record_windows
 
                 hr = pSample->SetSampleTime(llTimestamp);
 
-                // Write to file if there's a writer
-                if (SUCCEEDED(hr) && m_pWriter)
+                // Hand over to the pipeline worker, dropped (and counted) if it falls behind
+                if (SUCCEEDED(hr))
+                {
+                    m_pipeline.Push(PendingSample(pSample, dwStreamIndex));
+                }
+            }
+
+            // Stop requesting samples if the pipeline failed (e.g. writer error)
+            if (SUCCEEDED(hr))
+            {
+                hr = m_pipelineHr.load();
+            }
+
+            if (SUCCEEDED(hr))
+            {
+                // Read another sample
+                hr = m_pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM,
+                    0,
+                    NULL, NULL, NULL, NULL
+                );
+            }
+        }
+
+        return hr;
+    }
+
+    void MediaFoundationRecorder::StartPipeline()
+    {
+        m_pipelineHr = S_OK;
+
+        m_meter.Reset(m_pConfig->sampleRate, m_pConfig->numChannels);
+        m_meterSnapshot.Store(m_meter.Snapshot());
+        m_waveform.Reset(m_pConfig->sampleRate, m_pConfig->numChannels);
+
+        m_meterIntervalFrames = m_pConfig->meterIntervalMs > 0
+            ? std::max<size_t>((size_t)m_pConfig->sampleRate * m_pConfig->meterIntervalMs / 1000, 1)
+            : 0;
+        m_meterPendingFrames = 0;
+        m_meterSequence = 0;
+
+        if (m_segmentIndex > 0)
+        {
+            m_segmentWorker.Start(
+                [](InplaceTask& task) { task(); },
+                []() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+                []() { CoUninitialize(); }
+            );
+            PrepareNextSegment();
+        }
+
+        m_pipeline.Start(
+            [this](PendingSample& pending) { ProcessSample(pending); },
+            []() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+            []() { CoUninitialize(); }
+        );
+    }
+
+    // Pipeline worker thread
+    void MediaFoundationRecorder::ProcessSample(PendingSample& pending)
+    {
+        if (FAILED(m_pipelineHr.load()))
+        {
+            return;
+        }
+
+        HRESULT hr = S_OK;
+        IMFSample* pSample = pending.pSample;
+        IMFMediaBuffer* pBuffer = NULL;
+
+        // Recording started from armed state, pre-roll goes first
+        if (m_flushPreRoll)
+        {
+            m_flushPreRoll = false;
+            hr = FlushPreRoll();
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pSample->ConvertToContiguousBuffer(&pBuffer);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            BYTE* pChunk = NULL;
+            DWORD size = 0;
+            hr = pBuffer->Lock(&pChunk, NULL, &size);
+
+            if (SUCCEEDED(hr))
+            {
+                // Capture format is always PCM 16 bits
+                size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+                size_t frames = size / frameBytes;
+
+                // Write to file if there's one, keep in memory when armed
+                if (m_output)
                 {
-                    hr = m_pWriter->WriteSample(dwStreamIndex, pSample);
+                    hr = WriteOutput(pSample, pChunk, size);
                 }
 
+                // Keep recent audio (pre-roll, exports), no-op when disabled
+                m_recent.Write(pChunk, size);
+
                 if (SUCCEEDED(hr))
                 {
-                    IMFMediaBuffer* pBuffer = NULL;
-                    hr = pSample->ConvertToContiguousBuffer(&pBuffer);
+                    // Update total data written
+                    m_dataWritten += size;
+
+                    // Send data to stream (alone or with the file)
+                    if (m_streaming && m_recordEventHandler) {
+                        if (m_streamEncoder) {
+                            hr = m_streamEncoder->Encode(pChunk, size);
+                        }
+                        else {
+                            m_streamCoalescer.Push(pChunk, size);
+                        }
+                    }
 
-                    if (SUCCEEDED(hr))
-                    {
-                        BYTE* pChunk = NULL;
-                        DWORD size = 0;
-                        hr = pBuffer->Lock(&pChunk, NULL, &size);
+                    GetAmplitudeFromSample(pChunk, size, 2);
 
-                        if (SUCCEEDED(hr))
-                        {
-                            // Update total data written
-                            m_dataWritten += size;
+                    m_meter.Process(reinterpret_cast<const int16_t*>(pChunk), frames);
+                    m_meterSnapshot.Store(m_meter.Snapshot());
+                    m_waveform.Process(reinterpret_cast<const int16_t*>(pChunk), frames);
 
-                            // Send data to stream when there's no writer
-                            if (m_recordEventHandler && !m_pWriter) {
-                                std::vector<uint8_t> bytes(pChunk, pChunk + size);
+                    PushMeterFrame(frames);
+                }
 
-                                RecordWindowsPlugin::RunOnMainThread([this, bytes]() -> void {
-                                    m_recordEventHandler->Success(std::make_unique<flutter::EncodableValue>(bytes));
-                                });
-                            }
+                pBuffer->Unlock();
+            }
 
-                            GetAmplitudeFromSample(pChunk, size, 2);
+            SafeRelease(pBuffer);
+        }
 
-                            pBuffer->Unlock();
-                        }
+        if (FAILED(hr))
+        {
+            m_pipelineHr = hr;
+        }
+    }
 
-                        SafeRelease(pBuffer);
-                    }
+    // Pipeline worker thread. Writes to the current output, split on segment
+    // boundaries. pSample may be NULL, then data is copied.
+    HRESULT MediaFoundationRecorder::WriteOutput(IMFSample* pSample, const BYTE* data, DWORD size)
+    {
+        HRESULT hr = S_OK;
+        const size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+        const DWORD total = size;
+
+        while (SUCCEEDED(hr) && size > 0)
+        {
+            DWORD part = size;
+
+            if (m_segmentFrames > 0)
+            {
+                // Rolled over lazily, the last file is never empty
+                if (m_segmentWritten == m_segmentFrames)
+                {
+                    hr = RollOver();
+                    if (FAILED(hr)) break;
                 }
+
+                uint64_t room = (m_segmentFrames - m_segmentWritten) * frameBytes;
+                if (part > room) part = (DWORD)room;
+                m_segmentWritten += part / frameBytes;
+            }
+
+            // Whole samples are passed as is, parts are copied
+            hr = m_output->Write(part == total ? pSample : NULL, data, part);
+
+            data += part;
+            size -= part;
+        }
+
+        return hr;
+    }
+
+    // Pipeline worker thread, or control thread once it is stopped.
+    HRESULT MediaFoundationRecorder::FlushPreRoll()
+    {
+        HRESULT hr = S_OK;
+        uint64_t end = m_recent.Written();
+        uint64_t position = end - std::min<uint64_t>(m_recent.Size(), m_preRollBytes);
+
+        // Writer is this thread, reads can't fail
+        BYTE chunk[16384];
+        const size_t frameBytes = (size_t)m_pConfig->numChannels * sizeof(int16_t);
+        const size_t chunkBytes = sizeof(chunk) - sizeof(chunk) % frameBytes;
+
+        while (SUCCEEDED(hr) && position < end)
+        {
+            DWORD size = (DWORD)std::min<uint64_t>(chunkBytes, end - position);
+
+            if (!m_recent.Read(position, chunk, size))
+            {
+                hr = E_UNEXPECTED;
+                break;
             }
 
+            hr = WriteOutput(NULL, chunk, size);
+
             if (SUCCEEDED(hr))
             {
-                // Read another sample
-                hr = m_pReader->ReadSample((DWORD)MF_SOURCE_READER_FIRST_AUDIO_STREAM,
-                    0,
-                    NULL, NULL, NULL, NULL
-                );
+                m_dataWritten += size;
+                m_waveform.Process(reinterpret_cast<const int16_t*>(chunk), size / frameBytes);
             }
+
+            position += size;
         }
 
         return hr;
@@ -702,7 +1601,7 @@ namespace record_windows
         return hr;
     }
 
-    HRESULT MediaFoundationRecorder::CreateAudioProfileOut(IMFMediaType** ppMediaType)
+    HRESULT MediaFoundationRecorder::CreateAudioProfileOut(const std::string& encoderName, IMFMediaType** ppMediaType)
     {
         HRESULT hr = S_OK;
 
@@ -717,14 +1616,14 @@ namespace record_windows
         }
         if (SUCCEEDED(hr))
         {
-            if (m_pConfig->encoderName == "aacLc") hr = CreateACCProfile(pMediaType);
-            else if (m_pConfig->encoderName == "aacEld") hr = CreateACCProfile(pMediaType);
-            else if (m_pConfig->encoderName == "aacHe") hr = CreateACCProfile(pMediaType);
-            else if (m_pConfig->encoderName == "amrNb") hr = CreateAmrNbProfile(pMediaType);
-            else if (m_pConfig->encoderName == "amrWb") hr = CreateAmrNbProfile(pMediaType);
-            else if (m_pConfig->encoderName == "flac") hr = CreateFlacProfile(pMediaType);
-            else if (m_pConfig->encoderName == "pcm16bits") hr = CreatePcmProfile(pMediaType);
-            else if (m_pConfig->encoderName == "wav") hr = CreatePcmProfile(pMediaType);
+            if (encoderName == "aacLc") hr = CreateACCProfile(pMediaType);
+            else if (encoderName == "aacEld") hr = CreateACCProfile(pMediaType);
+            else if (encoderName == "aacHe") hr = CreateACCProfile(pMediaType);
+            else if (encoderName == "amrNb") hr = CreateAmrNbProfile(pMediaType);
+            else if (encoderName == "amrWb") hr = CreateAmrNbProfile(pMediaType);
+            else if (encoderName == "flac") hr = CreateFlacProfile(pMediaType);
+            else if (encoderName == "pcm16bits") hr = CreatePcmProfile(pMediaType);
+            else if (encoderName == "wav") hr = CreatePcmProfile(pMediaType);
             else hr = E_NOTIMPL;
         }
 
@@ -835,10 +1734,4 @@ namespace record_windows
 
         return hr;
     }
-
-    HRESULT MediaFoundationRecorder::FillWavHeader() {
-        // Implementation copied from original record_mediatype.cpp
-        // This is a placeholder - the actual implementation would be more complex
-        return S_OK;
-    }
 }; 
\ No newline at end of file
@@ -9,6 +9,10 @@
 #include <Mfreadwrite.h>
 
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 // utility functions
 #include "utils.h"
@@ -16,21 +20,72 @@
 #include "record_config.h"
 #include "event_stream_handler.h"
 #include "recorder_interface.h"
+#include "chunk_coalescer.h"
+#include "pipeline_worker.h"
+#include "amplitude_kernel.h"
+#include "meter_engine.h"
+#include "meter_frame.h"
+#include "seqlock.h"
+#include "waveform_pyramid.h"
+#include "file_output.h"
+#include "inplace_task.h"
+#include "pcm_ring.h"
+#include "stream_encoder.h"
+#include "mf_runtime.h"
 
 using namespace flutter;
 
 namespace record_windows
 {
+    // Captured sample handed from the reader callback to the pipeline worker.
+    struct PendingSample
+    {
+        IMFSample* pSample = NULL;
+        DWORD streamIndex = 0;
+
+        PendingSample() = default;
+        PendingSample(IMFSample* sample, DWORD index) : pSample(sample), streamIndex(index)
+        {
+            if (pSample) pSample->AddRef();
+        }
+        PendingSample(PendingSample&& other) noexcept : pSample(other.pSample), streamIndex(other.streamIndex)
+        {
+            other.pSample = NULL;
+        }
+        PendingSample& operator=(PendingSample&& other) noexcept
+        {
+            if (this != &other)
+            {
+                SafeRelease(pSample);
+                pSample = other.pSample;
+                streamIndex = other.streamIndex;
+                other.pSample = NULL;
+            }
+            return *this;
+        }
+        PendingSample(const PendingSample&) = delete;
+        PendingSample& operator=(const PendingSample&) = delete;
+        ~PendingSample() { SafeRelease(pSample); }
+    };
+
+    // Values returned by GetAmplitude, in dBFS.
+    struct AmplitudeLevels
+    {
+        double current;
+        double max;
+    };
+
     // 基于MediaFoundation的录音器实现（用于Windows 10+）
     class MediaFoundationRecorder : public IRecorder, public IMFSourceReaderCallback
     {
     public:
-        MediaFoundationRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler);
+        MediaFoundationRecorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, EventStreamHandler<EncodableValue>* meterEventHandler, EventStreamHandler<EncodableValue>* segmentEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue);
         virtual ~MediaFoundationRecorder();
 
         // IRecorder接口实现
         HRESULT Start(std::unique_ptr<RecordConfig> config, std::wstring path) override;
         HRESULT StartStream(std::unique_ptr<RecordConfig> config) override;
+        HRESULT Arm(std::unique_ptr<RecordConfig> config) override;
         HRESULT Pause() override;
         HRESULT Resume() override;
         HRESULT Stop() override;
@@ -39,8 +94,13 @@ namespace record_windows
         bool IsRecording() override;
         HRESULT Dispose() override;
         std::map<std::string, double> GetAmplitude() override;
+        MeterSnapshot GetMeters() override;
+        std::vector<float> GetWaveform(double seconds, int pixels) override;
         std::wstring GetRecordingPath() override;
         HRESULT isEncoderSupported(const std::string encoderName, bool* supported) override;
+        HRESULT GetEncoderCapabilities(std::vector<EncoderCapability>& capabilities) override;
+        HRESULT ExportRecent(double seconds, const std::string& encoderName, std::wstring path, std::function<void(HRESULT)> onDone) override;
+        std::map<std::string, int64_t> GetStats() override;
         
         // IUnknown methods
         STDMETHODIMP QueryInterface(REFIID iid, void** ppv);
@@ -55,21 +115,70 @@ namespace record_windows
     private:
         HRESULT CreateAudioCaptureDevice(LPCWSTR pszEndPointID);
         HRESULT CreateSourceReaderAsync();
-        HRESULT CreateSinkWriter(std::wstring path);
+        HRESULT CreateOutput(const std::wstring& path, std::unique_ptr<FileOutput>& output);
         HRESULT CreateAudioProfileIn( IMFMediaType** ppMediaType);
-        HRESULT CreateAudioProfileOut( IMFMediaType** ppMediaType);
+        HRESULT CreateAudioProfileOut(const std::string& encoderName, IMFMediaType** ppMediaType);
 
         HRESULT CreateACCProfile( IMFMediaType* pMediaType);
         HRESULT CreateFlacProfile( IMFMediaType* pMediaType);
         HRESULT CreateAmrNbProfile( IMFMediaType* pMediaType);
         HRESULT CreatePcmProfile( IMFMediaType* pMediaType);
-        HRESULT FillWavHeader();
+        bool UsesWavWriter() const;
+        OpusOggEncoder::Options OpusOptions() const;
+        FlacEncoder::Options FlacOptions() const;
+        StreamEncoderConfig EncoderConfig() const;
 
         HRESULT InitRecording(std::unique_ptr<RecordConfig> config);
         void UpdateState(RecordState state);
-        HRESULT EndRecording();
+        // discardedEmpty: discards the output when nothing was written, tells if it was.
+        HRESULT EndRecording(bool discard = false, bool* discardedEmpty = nullptr);
+        void StartPipeline();
+        void StartStreamSink();
+        HRESULT StartEncodedStreamSink();
+        void ProcessSample(PendingSample& pending);
+        HRESULT WriteOutput(IMFSample* pSample, const BYTE* data, DWORD size);
         void GetAmplitudeFromSample(BYTE* chunk, DWORD size, int bytesPerSample);
-        std::vector<int16_t> convertBytesToInt16(BYTE* bytes, DWORD size);
+        void PushMeterFrame(size_t frames);
+
+        // Segmented recording
+        uint64_t SegmentFrames() const;
+        int RetentionSlots() const;
+        std::wstring SegmentPath(int index) const;
+        void PrepareNextSegment();
+        HRESULT RollOver();
+        HRESULT FinalizeSegment(std::unique_ptr<FileOutput> output, int index);
+
+        // Capture kept between recordings (pre-roll, warm mode)
+        static void AdjustCaptureFormat(RecordConfig& config);
+        bool CanReuseCapture(const RecordConfig& config) const;
+        HRESULT IdleCapture();
+        HRESULT ResumeCapture();
+        HRESULT ReleaseCapture();
+
+        // Pre-roll
+        HRESULT FlushPreRoll();
+
+        // Clip export, encoded on the export worker from a copy of recent audio.
+        struct ExportJob
+        {
+            std::vector<uint8_t> pcm;
+            std::wstring path;
+            std::string encoderName;
+            UINT32 sampleRate = 0;
+            UINT32 numChannels = 0;
+            IMFMediaType* pTypeOut = NULL;
+            IMFMediaType* pTypeIn = NULL;
+            OpusOggEncoder::Options opus;
+            FlacEncoder::Options flac;
+            std::function<void(HRESULT)> onDone;
+
+            ~ExportJob()
+            {
+                SafeRelease(pTypeOut);
+                SafeRelease(pTypeIn);
+            }
+        };
+        void RunExport(std::unique_ptr<ExportJob> job);
 
         long                m_nRefCount;        // Reference count.
         CritSec				m_critsec;
@@ -77,23 +186,103 @@ namespace record_windows
         IMFMediaSource* m_pSource;
         IMFPresentationDescriptor* m_pPresentationDescriptor;
         IMFSourceReader* m_pReader;
-        IMFSinkWriter* m_pWriter;
+        // Capture format, kept to create outputs away from the reader.
+        IMFMediaType* m_pInputType;
+        // Opened capture, valid while m_pSource is set.
+        struct CaptureFormat
+        {
+            std::string deviceId;
+            int sampleRate = 0;
+            int numChannels = 0;
+        };
+        CaptureFormat m_capture;
+        // Warm: source paused and reader idle between recordings, until
+        // another device/format is requested or the recorder is disposed.
+        bool m_warm = false;
+        bool m_captureIdle = false;         // under m_critsec, samples are ignored
+        std::mutex m_flushMutex;
+        std::condition_variable m_flushDone;
+        bool m_flushPending = false;
+        // File being written, owned by the pipeline worker while recording.
+        // Native writer for wav and raw pcm16bits, sink writer otherwise.
+        std::unique_ptr<FileOutput> m_output;
         std::wstring m_recordingPath;
-        bool m_mfStarted = false;
-        IMFMediaType* m_pMediaType;
+        bool m_mfStarted = false;           // MfRuntime reference, held until Dispose
+
+        // Start latency, from InitRecording to the first captured sample
+        std::chrono::steady_clock::time_point m_startClock;
+        bool m_startPending = false;        // under m_critsec
+        std::atomic<int64_t> m_startSetupUs{ 0 };
+        std::atomic<int64_t> m_startLatencyUs{ 0 };
+        std::atomic<int64_t> m_warmStarts{ 0 };
+        std::atomic<int64_t> m_coldStarts{ 0 };
 
         bool m_bFirstSample = true;
         LONGLONG m_llBaseTime = 0;
         LONGLONG m_llLastTime = 0;
 
-        double m_amplitude = -160;
-        double m_maxAmplitude = -160;
-        DWORD m_dataWritten = 0;
+        // Written by the pipeline worker, read from any thread.
+        Seqlock<AmplitudeLevels> m_amplitude{ { -160, -160 } };
+        std::atomic<uint64_t> m_dataWritten{ 0 };
+
+        // Fed by the pipeline worker only, readers get the published copy.
+        MeterEngine m_meter;
+        Seqlock<MeterSnapshot> m_meterSnapshot{ MeterEngine::SilentSnapshot(0) };
+
+        // Overview of the recording, kept after stop until the next start.
+        WaveformPyramid m_waveform;
+
+        // Meter frames pushed every m_meterIntervalFrames when enabled.
+        std::shared_ptr<BufferPool> m_meterPool;
+        size_t m_meterIntervalFrames = 0;
+        size_t m_meterPendingFrames = 0;
+        uint32_t m_meterSequence = 0;
+
+        // Capture callback only queues samples, the worker writes/meters/streams them.
+        static constexpr size_t kPipelineCapacity = 256;
+        PipelineWorker<PendingSample> m_pipeline{ kPipelineCapacity };
+        std::atomic<HRESULT> m_pipelineHr{ S_OK };
+
+        // Segments: the next output is opened ahead by the segment worker,
+        // which also finalizes the previous one, the pipeline only swaps them.
+        uint64_t m_segmentFrames = 0;       // frames per segment, 0 when disabled
+        uint64_t m_segmentWritten = 0;      // frames in the current segment
+        int m_segmentIndex = 0;             // current segment, from 1
+        int m_retentionSlots = 0;           // files reused in turn, 0 when unlimited
+        std::mutex m_segmentMutex;
+        std::condition_variable m_segmentReady;
+        std::unique_ptr<FileOutput> m_nextOutput;
+        HRESULT m_nextOutputHr = S_OK;
+        bool m_nextOutputPending = false;
+        std::wstring m_outputPath;          // file being written, for GetRecordingPath
+        PipelineWorker<InplaceTask> m_segmentWorker{ 8 };
+
+        // Last captured audio (pre-roll and exports), fed by the pipeline worker.
+        // Sized and reset from the platform thread only.
+        PcmRing m_recent;
+        static constexpr int kExportSlackMs = 1000;
+
+        // Armed: capture runs, nothing is written. Flags change while the
+        // pipeline worker is stopped.
+        bool m_armed = false;
+        size_t m_preRollBytes = 0;
+
+        // Started on first export, independent from the recording.
+        PipelineWorker<InplaceTask> m_exportWorker{ 4 };
+        bool m_flushPreRoll = false;        // first thing the worker does after Start
+
+        std::shared_ptr<BufferPool> m_streamPool;
+        ChunkCoalescer m_streamCoalescer;
+        std::unique_ptr<StreamEncoder> m_streamEncoder;    // encoded stream, replaces the coalescer
+        bool m_streaming = false;           // set while the pipeline worker is stopped
 
         EventStreamHandler<EncodableValue>* m_stateEventHandler;
         EventStreamHandler<EncodableValue>* m_recordEventHandler;
+        EventStreamHandler<EncodableValue>* m_meterEventHandler;
+        EventStreamHandler<EncodableValue>* m_segmentEventHandler;
+        std::shared_ptr<DispatchQueue> m_dispatchQueue;
 
-        RecordState m_recordState = RecordState::stop;
+        std::atomic<RecordState> m_recordState{ RecordState::stop };
         std::unique_ptr<RecordConfig> m_pConfig;
     };
 }; 
\ No newline at end of file
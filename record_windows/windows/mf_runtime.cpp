@@ -0,0 +1,46 @@
+#define NOMINMAX
+#include "mf_runtime.h"
+
+#include <mfapi.h>
+
+#include <mutex>
+
+namespace record_windows
+{
+    static std::mutex s_mutex;
+    static long s_references = 0;
+
+    HRESULT MfRuntime::Acquire()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        if (s_references == 0)
+        {
+            HRESULT hr = MFStartup(MF_VERSION, MFSTARTUP_NOSOCKET);
+
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+
+        s_references++;
+        return S_OK;
+    }
+
+    void MfRuntime::Release()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        if (s_references > 0 && --s_references == 0)
+        {
+            MFShutdown();
+        }
+    }
+
+    long MfRuntime::References()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_references;
+    }
+}
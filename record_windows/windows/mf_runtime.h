@@ -0,0 +1,21 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+namespace record_windows
+{
+    // Process-wide Media Foundation startup, shared by recorders and export
+    // workers. MFStartup runs on the first reference, MFShutdown after the
+    // last one, so recordings don't pay for a runtime restart each time.
+    // Thread safe.
+    class MfRuntime
+    {
+    public:
+        static HRESULT Acquire();
+        static void Release();
+
+        // Current references, for diagnostics.
+        static long References();
+    };
+}
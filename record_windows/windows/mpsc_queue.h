@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace record_windows
+{
+    // Bounded lock-free multi-producer / single-consumer queue.
+    //
+    // Array based queue with a sequence number per cell (D. Vyukov design).
+    // Producers claim a slot with a CAS on the tail, the single consumer
+    // walks the head without any atomic read-modify-write.
+    // Capacity is rounded up to the next power of two.
+    //
+    // This header has no platform dependency on purpose so it can be
+    // compiled and exercised on its own.
+    template <typename T>
+    class MpscQueue
+    {
+    public:
+        explicit MpscQueue(size_t capacity)
+            : m_mask(RoundUpPow2(capacity < 2 ? 2 : capacity) - 1),
+            m_cells(new Cell[m_mask + 1])
+        {
+            for (size_t i = 0; i <= m_mask; i++)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_tail.store(0, std::memory_order_relaxed);
+            m_head = 0;
+        }
+
+        ~MpscQueue()
+        {
+            T item;
+            while (TryPop(item)) {}
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // Any thread. Returns false when the queue is full, item is left untouched.
+        bool TryPush(T&& item)
+        {
+            Cell* cell;
+            size_t pos = m_tail.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+                if (diff == 0)
+                {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // full
+                }
+                else
+                {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            new (cell->Storage()) T(std::move(item));
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer thread only. Returns false when the queue is empty.
+        bool TryPop(T& item)
+        {
+            Cell* cell = &m_cells[m_head & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+
+            if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0)
+            {
+                return false; // empty, or producer has not finished writing yet
+            }
+
+            T* stored = cell->Item();
+            item = std::move(*stored);
+            stored->~T();
+
+            cell->sequence.store(m_head + m_mask + 1, std::memory_order_release);
+            m_head++;
+            return true;
+        }
+
+        // Consumer thread only. Approximate, for diagnostics.
+        size_t SizeApprox() const
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            return tail >= m_head ? tail - m_head : 0;
+        }
+
+        size_t Capacity() const { return m_mask + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            void* Storage() { return storage; }
+            T* Item() { return std::launder(reinterpret_cast<T*>(storage)); }
+        };
+
+        static size_t RoundUpPow2(size_t v)
+        {
+            size_t p = 1;
+            while (p < v) p <<= 1;
+            return p;
+        }
+
+        static constexpr size_t kCacheLine = 64;
+
+        const size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
+
+        alignas(kCacheLine) std::atomic<size_t> m_tail;
+        alignas(kCacheLine) size_t m_head;
+    };
+}
@@ -0,0 +1,140 @@
+#include "ogg_page_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace record_windows
+{
+    namespace
+    {
+        // CRC-32, polynomial 0x04c11db7, no reflection, zero init and no final xor
+        struct CrcTable
+        {
+            uint32_t values[256];
+
+            CrcTable()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t r = i << 24;
+                    for (int bit = 0; bit < 8; bit++)
+                    {
+                        r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : (r << 1);
+                    }
+                    values[i] = r;
+                }
+            }
+        };
+
+        const CrcTable kCrcTable;
+
+        constexpr size_t kHeaderBytes = 27;
+        constexpr size_t kMaxSegments = 255;
+
+        void PutLE(uint8_t* p, uint64_t value, int bytes)
+        {
+            for (int i = 0; i < bytes; i++)
+            {
+                p[i] = (uint8_t)(value >> (8 * i));
+            }
+        }
+    }
+
+    uint32_t OggPageWriter::Crc(const uint8_t* data, size_t size, uint32_t crc)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (crc << 8) ^ kCrcTable.values[((crc >> 24) ^ data[i]) & 0xFF];
+        }
+        return crc;
+    }
+
+    void OggPageWriter::Reset(uint32_t serial, PageCallback onPage)
+    {
+        m_onPage = std::move(onPage);
+        m_serial = serial;
+        m_sequence = 0;
+        m_bytes = 0;
+        m_lacing.clear();
+        m_body.clear();
+        m_granule = -1;
+        m_continued = false;
+        m_eosWritten = false;
+    }
+
+    bool OggPageWriter::AddPacket(const uint8_t* data, size_t size, int64_t granule)
+    {
+        if (m_eosWritten) return false;
+
+        size_t offset = 0;
+
+        for (;;)
+        {
+            if (m_lacing.size() == kMaxSegments)
+            {
+                if (!EmitPage(false)) return false;
+
+                // Rest of this packet continues on the next page
+                m_continued = offset > 0;
+            }
+
+            // A packet ends with a lacing value below 255 (possibly 0)
+            size_t segment = std::min<size_t>(size - offset, 255);
+            m_lacing.push_back((uint8_t)segment);
+            m_body.insert(m_body.end(), data + offset, data + offset + segment);
+            offset += segment;
+
+            if (segment < 255)
+            {
+                m_granule = granule;
+                return true;
+            }
+        }
+    }
+
+    bool OggPageWriter::Flush(bool eos)
+    {
+        if (m_eosWritten) return !eos;
+
+        if (m_lacing.empty() && !eos)
+        {
+            return true;
+        }
+        return EmitPage(eos);
+    }
+
+    bool OggPageWriter::EmitPage(bool eos)
+    {
+        const size_t segments = m_lacing.size();
+        m_page.resize(kHeaderBytes + segments + m_body.size());
+        uint8_t* page = m_page.data();
+
+        uint8_t headerType = 0;
+        if (m_continued) headerType |= 0x01;
+        if (m_sequence == 0) headerType |= 0x02;
+        if (eos) headerType |= 0x04;
+
+        std::memcpy(page, "OggS", 4);
+        page[4] = 0;                                        // version
+        page[5] = headerType;
+        PutLE(page + 6, (uint64_t)m_granule, 8);
+        PutLE(page + 14, m_serial, 4);
+        PutLE(page + 18, m_sequence, 4);
+        PutLE(page + 22, 0, 4);                             // CRC, computed with zeros
+        page[26] = (uint8_t)segments;
+        if (segments > 0) std::memcpy(page + kHeaderBytes, m_lacing.data(), segments);
+        if (!m_body.empty()) std::memcpy(page + kHeaderBytes + segments, m_body.data(), m_body.size());
+
+        PutLE(page + 22, Crc(page, m_page.size()), 4);
+
+        m_sequence++;
+        m_bytes += m_page.size();
+        m_lacing.clear();
+        m_body.clear();
+        m_granule = -1;
+        m_continued = false;
+        m_eosWritten = eos;
+
+        return !m_onPage || m_onPage(page, m_page.size());
+    }
+}
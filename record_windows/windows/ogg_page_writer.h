@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace record_windows
+{
+    // Streaming Ogg page writer (RFC 3533) for a single logical stream.
+    //
+    // Packets are laced into the current page, which is emitted when full
+    // or on Flush(). Each emitted page is complete (header with CRC, then
+    // body) and can be written or sent as is.
+    // Portable, driven by one thread at a time.
+    class OggPageWriter
+    {
+    public:
+        // Returns false to abort (e.g. write failure).
+        using PageCallback = std::function<bool(const uint8_t* page, size_t size)>;
+
+        void Reset(uint32_t serial, PageCallback onPage);
+
+        // granule is the stream position at the end of the packet,
+        // in the codec's granule unit.
+        bool AddPacket(const uint8_t* data, size_t size, int64_t granule);
+
+        // Emits the pending packets, if any. With eos, the page is marked
+        // as the last one of the stream (emitted even when empty).
+        bool Flush(bool eos = false);
+
+        // Packets laced in the pending page.
+        bool HasPending() const { return !m_lacing.empty(); }
+
+        uint32_t PagesWritten() const { return m_sequence; }
+        uint64_t BytesWritten() const { return m_bytes; }
+
+        static uint32_t Crc(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+    private:
+        bool EmitPage(bool eos);
+
+        PageCallback m_onPage;
+        uint32_t m_serial = 0;
+        uint32_t m_sequence = 0;
+        uint64_t m_bytes = 0;
+
+        // Pending page
+        std::vector<uint8_t> m_lacing;
+        std::vector<uint8_t> m_body;
+        int64_t m_granule = -1;     // -1 when no packet ends in the page
+        bool m_continued = false;   // first packet started in the previous page
+        bool m_eosWritten = false;
+
+        std::vector<uint8_t> m_page;
+    };
+}
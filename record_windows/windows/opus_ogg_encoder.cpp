@@ -0,0 +1,241 @@
+#include "opus_ogg_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef RECORD_WITH_OPUS
+#include <opus.h>
+#endif
+
+namespace record_windows
+{
+    namespace
+    {
+        constexpr uint32_t kGranuleRate = 48000;
+        constexpr size_t kMaxPacketBytes = 4000;    // recommended by libopus
+
+#ifdef RECORD_WITH_OPUS
+        void PutLE(std::vector<uint8_t>& out, uint32_t value, int bytes)
+        {
+            for (int i = 0; i < bytes; i++)
+            {
+                out.push_back((uint8_t)(value >> (8 * i)));
+            }
+        }
+#endif
+    }
+
+    OpusOggEncoder::~OpusOggEncoder()
+    {
+#ifdef RECORD_WITH_OPUS
+        if (m_pEncoder) opus_encoder_destroy(m_pEncoder);
+#endif
+    }
+
+    bool OpusOggEncoder::Available()
+    {
+#ifdef RECORD_WITH_OPUS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint32_t OpusOggEncoder::SupportedSampleRate(uint32_t sampleRate)
+    {
+        static const uint32_t kRates[] = { 8000, 12000, 16000, 24000, 48000 };
+
+        for (uint32_t rate : kRates)
+        {
+            if (rate >= sampleRate) return rate;
+        }
+        return kGranuleRate;
+    }
+
+    bool OpusOggEncoder::Fail(int error)
+    {
+        m_lastError = error;
+        return false;
+    }
+
+    bool OpusOggEncoder::Open(const Options& options, OggPageWriter::PageCallback onPage)
+    {
+#ifdef RECORD_WITH_OPUS
+        if (m_pEncoder)
+        {
+            opus_encoder_destroy(m_pEncoder);
+            m_pEncoder = nullptr;
+        }
+
+        m_options = options;
+        m_lastError = 0;
+        m_finished = false;
+        m_framesIn = 0;
+        m_framesEncoded = 0;
+        m_pageGranule = 0;
+
+        const uint32_t frameMs = options.frameMs;
+        if (SupportedSampleRate(options.sampleRate) != options.sampleRate ||
+            options.numChannels < 1 || options.numChannels > 2 ||
+            (frameMs != 5 && frameMs != 10 && frameMs != 20 && frameMs != 40 && frameMs != 60))
+        {
+            return Fail(OPUS_BAD_ARG);
+        }
+
+        m_frameSize = (size_t)options.sampleRate * options.frameMs / 1000;
+        m_granuleScale = kGranuleRate / options.sampleRate;
+
+        // Low rates are voice, the VOIP mode favors intelligibility there
+        int application = options.bitRate < 32000 ? OPUS_APPLICATION_VOIP : OPUS_APPLICATION_AUDIO;
+        int error = OPUS_OK;
+
+        m_pEncoder = opus_encoder_create((opus_int32)options.sampleRate, (int)options.numChannels, application, &error);
+        if (error != OPUS_OK) return Fail(error);
+
+        opus_int32 lookahead = 0;
+        error = opus_encoder_ctl(m_pEncoder, OPUS_SET_BITRATE((opus_int32)options.bitRate));
+        if (error == OPUS_OK) error = opus_encoder_ctl(m_pEncoder, OPUS_SET_VBR(options.vbr ? 1 : 0));
+        if (error == OPUS_OK) error = opus_encoder_ctl(m_pEncoder, OPUS_SET_DTX(options.dtx ? 1 : 0));
+        if (error == OPUS_OK) error = opus_encoder_ctl(m_pEncoder, OPUS_SET_COMPLEXITY(std::clamp(options.complexity, 0, 10)));
+        if (error == OPUS_OK) error = opus_encoder_ctl(m_pEncoder, OPUS_GET_LOOKAHEAD(&lookahead));
+        if (error != OPUS_OK) return Fail(error);
+
+        m_preSkip = (uint64_t)lookahead;
+        m_pending.clear();
+        m_pending.reserve(m_frameSize * options.numChannels);
+        m_packet.resize(kMaxPacketBytes);
+
+        m_writer.Reset(options.serial, std::move(onPage));
+
+        // Identification header, alone on the first page
+        std::vector<uint8_t> header;
+        header.insert(header.end(), { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1 });
+        header.push_back((uint8_t)options.numChannels);
+        PutLE(header, (uint32_t)(m_preSkip * m_granuleScale), 2);
+        PutLE(header, options.sampleRate, 4);
+        PutLE(header, 0, 2);        // output gain
+        header.push_back(0);        // mapping family: mono/stereo
+
+        if (!m_writer.AddPacket(header.data(), header.size(), 0) || !m_writer.Flush())
+        {
+            return Fail(kWriteError);
+        }
+
+        // Comment header, audio starts on the next page
+        const char* vendor = opus_get_version_string();
+        uint32_t vendorLength = (uint32_t)std::strlen(vendor);
+
+        header.clear();
+        header.insert(header.end(), { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' });
+        PutLE(header, vendorLength, 4);
+        header.insert(header.end(), vendor, vendor + vendorLength);
+        PutLE(header, 0, 4);        // no user comments
+
+        if (!m_writer.AddPacket(header.data(), header.size(), 0) || !m_writer.Flush())
+        {
+            return Fail(kWriteError);
+        }
+
+        return true;
+#else
+        (void)options;
+        (void)onPage;
+        return Fail(kWriteError);
+#endif
+    }
+
+    bool OpusOggEncoder::Encode(const int16_t* pcm, size_t frames)
+    {
+        if (!m_pEncoder || m_finished || m_lastError != 0) return false;
+
+        const size_t channels = m_options.numChannels;
+        const size_t packetSamples = m_frameSize * channels;
+        m_framesIn += frames;
+
+        // Complete the partial packet first
+        if (!m_pending.empty())
+        {
+            size_t count = std::min(frames * channels, packetSamples - m_pending.size());
+            m_pending.insert(m_pending.end(), pcm, pcm + count);
+            pcm += count;
+            frames -= count / channels;
+
+            if (m_pending.size() < packetSamples) return true;
+
+            if (!EncodeFrame(m_pending.data())) return false;
+            m_pending.clear();
+        }
+
+        // Whole packets straight from the input
+        while (frames >= m_frameSize)
+        {
+            if (!EncodeFrame(pcm)) return false;
+            pcm += packetSamples;
+            frames -= m_frameSize;
+        }
+
+        m_pending.insert(m_pending.end(), pcm, pcm + frames * channels);
+        return true;
+    }
+
+    bool OpusOggEncoder::Finish()
+    {
+        if (!m_pEncoder || m_finished) return m_finished && m_lastError == 0;
+        m_finished = true;
+
+        if (m_lastError != 0) return false;
+
+        // Encoder delay: the last input samples come out preSkip later,
+        // pad with silence until they are all encoded
+        const size_t packetSamples = m_frameSize * m_options.numChannels;
+        const uint64_t endFrames = m_framesIn + m_preSkip;
+
+        do
+        {
+            m_pending.resize(packetSamples, 0);
+            bool last = m_framesEncoded + m_frameSize >= endFrames;
+
+            if (!EncodeFrame(m_pending.data(), last)) return false;
+            m_pending.clear();
+        } while (m_framesEncoded < endFrames);
+
+        if (!m_writer.Flush(true))
+        {
+            return Fail(kWriteError);
+        }
+
+        return true;
+    }
+
+    bool OpusOggEncoder::EncodeFrame(const int16_t* pcm, bool last)
+    {
+#ifdef RECORD_WITH_OPUS
+        opus_int32 bytes = opus_encode(m_pEncoder, pcm, (int)m_frameSize, m_packet.data(), (opus_int32)m_packet.size());
+        if (bytes < 0) return Fail(bytes);
+
+        m_framesEncoded += m_frameSize;
+
+        // End position trims the padding of the last packet (RFC 7845, 4.4)
+        uint64_t granule = (last ? m_framesIn + m_preSkip : m_framesEncoded) * m_granuleScale;
+
+        // DTX packets (1 or 2 bytes) are kept, they carry the timing
+        if (!m_writer.AddPacket(m_packet.data(), (size_t)bytes, (int64_t)granule))
+        {
+            return Fail(kWriteError);
+        }
+
+        // Page boundary by duration, each packet when streaming
+        if (!last && (granule - m_pageGranule) * 1000 >= (uint64_t)m_options.pageMs * kGranuleRate)
+        {
+            m_pageGranule = granule;
+            if (!m_writer.Flush()) return Fail(kWriteError);
+        }
+
+        return true;
+#else
+        (void)pcm;
+        (void)last;
+        return Fail(kWriteError);
+#endif
+    }
+}
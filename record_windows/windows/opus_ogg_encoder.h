@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ogg_page_writer.h"
+
+struct OpusEncoder;
+
+namespace record_windows
+{
+    // Opus in Ogg (RFC 7845) from PCM 16 bits, through libopus.
+    //
+    // Compiled in with RECORD_WITH_OPUS only, see Available().
+    // Portable, driven by one thread at a time.
+    class OpusOggEncoder
+    {
+    public:
+        struct Options
+        {
+            uint32_t sampleRate = 48000;    // 8, 12, 16, 24 or 48 kHz
+            uint32_t numChannels = 2;       // 1 or 2
+            uint32_t bitRate = 24000;
+            uint32_t frameMs = 20;          // 5, 10, 20, 40 or 60
+            bool vbr = true;
+            bool dtx = false;
+            int complexity = 5;             // 0 (fastest) to 10
+            // Page duration, 0 for one page per packet (streaming).
+            uint32_t pageMs = 1000;
+            uint32_t serial = 0;
+        };
+
+        OpusOggEncoder() = default;
+        ~OpusOggEncoder();
+
+        OpusOggEncoder(const OpusOggEncoder&) = delete;
+        OpusOggEncoder& operator=(const OpusOggEncoder&) = delete;
+
+        // False when built without libopus.
+        static bool Available();
+
+        // Closest rate Opus can encode, at least the given one when possible.
+        static uint32_t SupportedSampleRate(uint32_t sampleRate);
+
+        // Writes the header pages. Pages are emitted synchronously.
+        bool Open(const Options& options, OggPageWriter::PageCallback onPage);
+
+        // Interleaved samples, any number of frames.
+        bool Encode(const int16_t* pcm, size_t frames);
+
+        // Encodes the remaining samples and writes the last page.
+        bool Finish();
+
+        // Returned by LastError() when the page callback failed.
+        static constexpr int kWriteError = -100;
+
+        // libopus error code (negative) or kWriteError.
+        int LastError() const { return m_lastError; }
+
+        uint64_t FramesIn() const { return m_framesIn; }
+
+    private:
+        bool EncodeFrame(const int16_t* pcm, bool last = false);
+        bool Fail(int error);
+
+        Options m_options;
+        OpusEncoder* m_pEncoder = nullptr;
+        OggPageWriter m_writer;
+
+        size_t m_frameSize = 0;             // samples per channel per packet
+        uint32_t m_granuleScale = 1;        // 48 kHz granules per input sample
+        uint64_t m_preSkip = 0;             // in input samples
+        uint64_t m_framesIn = 0;
+        uint64_t m_framesEncoded = 0;
+        uint64_t m_pageGranule = 0;         // granule of the last emitted page
+
+        std::vector<int16_t> m_pending;     // partial packet
+        std::vector<uint8_t> m_packet;
+        bool m_finished = false;
+        int m_lastError = 0;
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace record_windows
+{
+    // Fixed-size ring keeping the most recent PCM bytes.
+    //
+    // One writer appends and overwrites the oldest bytes, any thread may copy
+    // a range out without locking: the range is validated after the copy
+    // and rejected if the writer reached it meanwhile (seqlock style).
+    //
+    // Positions are absolute byte counts since Reset(), the ring holds
+    // [Written() - Size(), Written()).
+    class PcmRing
+    {
+    public:
+        PcmRing() = default;
+
+        PcmRing(const PcmRing&) = delete;
+        PcmRing& operator=(const PcmRing&) = delete;
+
+        // Not thread safe. Capacity is rounded down to whole frames, memory
+        // is kept when it doesn't change.
+        void Reset(size_t capacity, size_t frameBytes)
+        {
+            if (frameBytes > 0) capacity -= capacity % frameBytes;
+
+            if (capacity != m_capacity)
+            {
+                m_data.reset(capacity > 0 ? new uint8_t[capacity] : nullptr);
+                m_capacity = capacity;
+            }
+
+            m_reserved.store(0, std::memory_order_relaxed);
+            m_written.store(0, std::memory_order_relaxed);
+        }
+
+        size_t Capacity() const { return m_capacity; }
+
+        // Writer thread only.
+        void Write(const uint8_t* data, size_t size)
+        {
+            if (m_capacity == 0 || size == 0) return;
+
+            uint64_t position = m_written.load(std::memory_order_relaxed);
+
+            // Only the last capacity bytes can survive
+            if (size > m_capacity)
+            {
+                position += size - m_capacity;
+                data += size - m_capacity;
+                size = m_capacity;
+            }
+
+            // Readers of the overwritten range fail their validation
+            m_reserved.store(position + size, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            size_t offset = (size_t)(position % m_capacity);
+            size_t head = std::min(size, m_capacity - offset);
+            std::memcpy(m_data.get() + offset, data, head);
+            std::memcpy(m_data.get(), data + head, size - head);
+
+            m_written.store(position + size, std::memory_order_release);
+        }
+
+        // Bytes written since Reset().
+        uint64_t Written() const { return m_written.load(std::memory_order_acquire); }
+
+        // Bytes currently held.
+        size_t Size() const { return (size_t)std::min<uint64_t>(Written(), m_capacity); }
+
+        // Any thread. Copies [from, from + size), false if the range is not
+        // (or no longer) in the ring.
+        bool Read(uint64_t from, uint8_t* out, size_t size) const
+        {
+            if (size == 0) return true;
+
+            uint64_t written = m_written.load(std::memory_order_acquire);
+            if (size > m_capacity || from + size > written || from + m_capacity < written)
+            {
+                return false;
+            }
+
+            size_t offset = (size_t)(from % m_capacity);
+            size_t head = std::min(size, m_capacity - offset);
+            std::memcpy(out, m_data.get() + offset, head);
+            std::memcpy(out + head, m_data.get(), size - head);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t reserved = m_reserved.load(std::memory_order_relaxed);
+
+            return from + m_capacity >= reserved;
+        }
+
+    private:
+        std::unique_ptr<uint8_t[]> m_data;
+        size_t m_capacity = 0;
+
+        std::atomic<uint64_t> m_reserved{ 0 };  // end of the write in progress
+        std::atomic<uint64_t> m_written{ 0 };   // end of the committed bytes
+    };
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "spsc_ring.h"
+
+namespace record_windows
+{
+    // Dedicated worker thread fed through an SPSC ring.
+    //
+    // The producer (capture callback) only pushes items and returns, all the
+    // heavy lifting (encoding, file writes, metering...) runs on the worker.
+    // Items pushed while the ring is full are dropped and counted as overruns.
+    template <typename T>
+    class PipelineWorker
+    {
+    public:
+        using ProcessFn = std::function<void(T& item)>;
+        using ThreadHook = std::function<void()>;
+
+        explicit PipelineWorker(size_t capacity)
+            : m_ring(capacity)
+        {
+        }
+
+        ~PipelineWorker()
+        {
+            Stop();
+        }
+
+        PipelineWorker(const PipelineWorker&) = delete;
+        PipelineWorker& operator=(const PipelineWorker&) = delete;
+
+        // onEnter/onExit run on the worker thread (e.g. COM apartment setup).
+        void Start(ProcessFn process, ThreadHook onEnter = nullptr, ThreadHook onExit = nullptr)
+        {
+            Stop();
+
+            m_process = std::move(process);
+            m_stopRequested = false;
+            m_overruns = 0;
+            m_processed = 0;
+            m_highWater = 0;
+
+            m_thread = std::thread([this, onEnter = std::move(onEnter), onExit = std::move(onExit)]() {
+                if (onEnter) onEnter();
+                Run();
+                if (onExit) onExit();
+            });
+        }
+
+        // Processes the items still queued, then joins the worker.
+        void Stop()
+        {
+            if (!m_thread.joinable()) return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopRequested = true;
+            }
+            m_cv.notify_one();
+
+            m_thread.join();
+            m_process = nullptr;
+        }
+
+        bool IsRunning() const { return m_thread.joinable(); }
+
+        // Drops the items queued while stopped. Not while running, the
+        // worker is the only consumer then.
+        void Clear()
+        {
+            if (m_thread.joinable()) return;
+
+            T item;
+            while (m_ring.TryPop(item))
+            {
+                item = T();
+            }
+        }
+
+        // Producer thread only.
+        bool Push(T&& item)
+        {
+            if (!m_ring.TryPush(std::move(item)))
+            {
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            auto size = (uint64_t)m_ring.Size();
+            if (size > m_highWater.load(std::memory_order_relaxed))
+            {
+                m_highWater.store(size, std::memory_order_relaxed);
+            }
+
+            {
+                // Empty critical section: pairs with the wait predicate so
+                // the notification cannot be lost.
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_cv.notify_one();
+            return true;
+        }
+
+        uint64_t Overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+        uint64_t Processed() const { return m_processed.load(std::memory_order_relaxed); }
+        uint64_t HighWater() const { return m_highWater.load(std::memory_order_relaxed); }
+        size_t Pending() const { return m_ring.Size(); }
+
+    private:
+        void Run()
+        {
+            T item;
+
+            for (;;)
+            {
+                while (m_ring.TryPop(item))
+                {
+                    m_process(item);
+                    item = T();
+                    m_processed.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return m_stopRequested || !m_ring.Empty(); });
+
+                if (m_stopRequested && m_ring.Empty())
+                {
+                    break;
+                }
+            }
+        }
+
+        SpscRing<T> m_ring;
+        ProcessFn m_process;
+        std::thread m_thread;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stopRequested = false;
+
+        std::atomic<uint64_t> m_overruns{ 0 };
+        std::atomic<uint64_t> m_processed{ 0 };
+        std::atomic<uint64_t> m_highWater{ 0 };
+    };
+}
@@ -5,9 +5,9 @@
 namespace record_windows
 {
 	// static
-	HRESULT Recorder::CreateInstance(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, Recorder** ppRecorder)
+	HRESULT Recorder::CreateInstance(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue, Recorder** ppRecorder)
 	{
-		auto pRecorder = new (std::nothrow) Recorder(stateEventHandler, recordEventHandler);
+		auto pRecorder = new (std::nothrow) Recorder(stateEventHandler, recordEventHandler, dispatchQueue);
 
 		if (pRecorder == NULL)
 		{
@@ -20,7 +20,7 @@ namespace record_windows
 		return S_OK;
 	}
 
-	Recorder::Recorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler)
+	Recorder::Recorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue)
 		: m_nRefCount(1),
 		m_critsec(),
 		m_pConfig(nullptr),
@@ -30,6 +30,7 @@ namespace record_windows
 		m_pPresentationDescriptor(NULL),
 		m_stateEventHandler(stateEventHandler),
 		m_recordEventHandler(recordEventHandler),
+		m_dispatchQueue(std::move(dispatchQueue)),
 		m_recordingPath(std::wstring()),
 		m_pMediaType(NULL)
 	{
@@ -308,7 +309,7 @@ namespace record_windows
 		m_recordState = state;
 
 		if (m_stateEventHandler) {
-			RecordWindowsPlugin::RunOnMainThread([this, state]() -> void {
+			m_dispatchQueue->Post([this, state]() -> void {
 				m_stateEventHandler->Success(std::make_unique<flutter::EncodableValue>(state));
 			});
 		}
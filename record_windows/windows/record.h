@@ -16,6 +16,7 @@
 #include "record_config.h"
 
 #include "event_stream_handler.h"
+#include "main_thread_dispatcher.h"
 
 using namespace flutter;
 
@@ -24,9 +25,9 @@ namespace record_windows
 	class Recorder : public IMFSourceReaderCallback
 	{
 	public:
-		static HRESULT CreateInstance(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, Recorder** recorder);
+		static HRESULT CreateInstance(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue, Recorder** recorder);
 
-		Recorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler);
+		Recorder(EventStreamHandler<EncodableValue>* stateEventHandler, EventStreamHandler<EncodableValue>* recordEventHandler, std::shared_ptr<DispatchQueue> dispatchQueue);
 		virtual ~Recorder();
 
 		HRESULT Start(std::unique_ptr<RecordConfig> config, std::wstring path);
@@ -88,10 +89,11 @@ namespace record_windows
 
 		double m_amplitude = -160;
 		double m_maxAmplitude = -160;
-		DWORD m_dataWritten = 0;
+		UINT64 m_dataWritten = 0;
 
 		EventStreamHandler<EncodableValue>* m_stateEventHandler;
 		EventStreamHandler<EncodableValue>* m_recordEventHandler;
+		std::shared_ptr<DispatchQueue> m_dispatchQueue;
 
 		RecordState m_recordState = RecordState::stop;
 		std::unique_ptr<RecordConfig> m_pConfig;
@@ -31,6 +31,40 @@ namespace record_windows
 		bool autoGain = false;
 		bool echoCancel = false;
 		bool noiseSuppress = false;
+		// Stream frame size. When set, PCM stream is sent in frames of exactly
+		// this duration (or byte size, which takes precedence) instead of
+		// whatever buffer size the capture source delivers.
+		int streamChunkMs = 0;
+		int streamChunkBytes = 0;
+		// Meter event frames interval, 0 disables the meter event channel.
+		int meterIntervalMs = 0;
+		// Writes the waveform overview next to the output file (<path>.peaks) on stop.
+		bool waveformSidecar = false;
+		// WAV header checkpoints while recording, by duration and/or size. 0 disables.
+		int checkpointMs = 0;
+		int checkpointBytes = 0;
+		// Rolls over to <stem>_0001<ext>, <stem>_0002<ext>... by duration and/or size. 0 disables.
+		int segmentMs = 0;
+		int segmentBytes = 0;
+		// Keeps only this much recent audio, segment files are reused in turn. 0 disables.
+		int retentionMs = 0;
+		// Audio kept in memory while armed, written first by Start().
+		int preRollMs = 0;
+		// Recent audio kept in memory for exportRecent. 0 disables.
+		int historyMs = 0;
+		// Also sends the PCM stream while recording to a file.
+		bool streamWhileRecording = false;
+		// In-process Opus encoder settings (packet duration, 0-10 complexity, VBR, DTX).
+		int opusFrameMs = 20;
+		int opusComplexity = 5;
+		bool opusVbr = true;
+		bool opusDtx = false;
+		// In-process FLAC encoder level, 0 (fastest) to 8 (smallest).
+		int flacCompressionLevel = 5;
+		// AAC-LC in fragmented MP4, one fragment per this much audio. 0 writes a plain MP4.
+		int mp4FragmentMs = 0;
+		// Keeps the input device opened (paused) after stop for a faster next start.
+		bool keepWarm = false;
 
 		RecordConfig(
 			const std::string& encoderName,
@@ -235,7 +235,10 @@ namespace record_windows
 		WAV_FILE_HEADER header;
 		ZeroMemory(&header, sizeof(header));
 
-		DWORD cbFileSize = m_dataWritten + sizeof(WAV_FILE_HEADER) - sizeof(RIFFCHUNK);
+		// This header has 32 bits sizes, saturate instead of wrapping past 4 GB
+		const UINT64 cbMaxData = 0xFFFFFFFF - (sizeof(WAV_FILE_HEADER) - sizeof(RIFFCHUNK));
+		DWORD cbData = (DWORD)(m_dataWritten < cbMaxData ? m_dataWritten : cbMaxData);
+		DWORD cbFileSize = cbData + sizeof(WAV_FILE_HEADER) - sizeof(RIFFCHUNK);
 
 		HRESULT hr = MFCreateWaveFormatExFromMFMediaType(m_pMediaType, &pWav, &cbSize);
 
@@ -249,7 +252,7 @@ namespace record_windows
 
 			CopyMemory(&header.WaveFormat, pWav, sizeof(WAVEFORMATEX));
 			header.DataHeader.fcc = MAKEFOURCC('d', 'a', 't', 'a');
-			header.DataHeader.cb = m_dataWritten;
+			header.DataHeader.cb = cbData;
 		}
 
 		// Move the file pointer back to the start of the file and write the
@@ -71,8 +71,8 @@ namespace record_windows
 							if (m_recordEventHandler && !m_pWriter) {
 								std::vector<uint8_t> bytes(pChunk, pChunk + size);
 
-								RecordWindowsPlugin::RunOnMainThread([this, bytes]() -> void {
-									m_recordEventHandler->Success(std::make_unique<flutter::EncodableValue>(bytes));
+								m_dispatchQueue->Post([this, bytes = std::move(bytes)]() mutable -> void {
+									m_recordEventHandler->Success(std::make_unique<flutter::EncodableValue>(std::move(bytes)));
 								});
 							}
 
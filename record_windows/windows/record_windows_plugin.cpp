@@ -2,6 +2,7 @@
 #include "record_windows_plugin.h"
 #include <mfreadwrite.h>
 #include <Mferror.h>
+#include <algorithm>
 #include "record_config.h"
 #include <flutter/event_stream_handler_functions.h>
 
@@ -58,19 +59,9 @@ namespace record_windows {
 				plugin_pointer->HandleMethodCall(call, std::move(result));
 			});
 
-		registrar->AddPlugin(std::move(plugin));
-	}
-
-	// static
-	std::queue<std::function<void()>> RecordWindowsPlugin::callbacks{};
+		plugin->StartDeviceMonitor();
 
-	// static
-	FlutterRootWindowProvider RecordWindowsPlugin::get_root_window{};
-
-	// static
-	void RecordWindowsPlugin::RunOnMainThread(std::function<void()> callback) {
-		callbacks.push(callback);
-		PostMessage(get_root_window(), WM_RUN_DELEGATE, 0, 0);
+		registrar->AddPlugin(std::move(plugin));
 	}
 
 	RecordWindowsPlugin::RecordWindowsPlugin(
@@ -78,24 +69,51 @@ namespace record_windows {
 		WindowProcDelegateUnregistrator unregistrator,
 		FlutterRootWindowProvider window_provider
 	):	m_win_proc_delegate_registrator(registrator),
-		m_win_proc_delegate_unregistrator(unregistrator) {
-
-		get_root_window = std::move(window_provider);
+		m_win_proc_delegate_unregistrator(unregistrator),
+		m_dispatcher(std::make_unique<MainThreadDispatcher>(std::move(window_provider))) {
 
 		m_window_proc_id = m_win_proc_delegate_registrator(
 			[this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
 				return HandleWindowProc(hwnd, message, wparam, lparam);
 			}
 		);
+
+		m_commandQueue = m_dispatcher->CreateQueue();
+
+		// Encoder lookups are served from memory, start() never enumerates MFTs
+		EncoderCapabilities::Start();
 	}
 
 	RecordWindowsPlugin::~RecordWindowsPlugin() {
+		// Queued calls run first, their replies are dropped with the queue
+		for (const auto& [recorderId, executor] : m_executors)
+		{
+			executor->Stop();
+		}
+		for (const auto& executor : m_disposingExecutors)
+		{
+			executor->Stop();
+		}
 		for (const auto& [recorderId, recorder] : m_recorders)
 		{
 			recorder->Dispose();
 		}
 
+		// After the recorders, running exports reply through it
+		m_dispatcher->RemoveQueue(m_commandQueue);
+		for (const auto& [recorderId, queue] : m_dispatchQueues)
+		{
+			m_dispatcher->RemoveQueue(queue);
+		}
+		if (m_deviceMonitor)
+		{
+			m_deviceMonitor->Stop();
+			m_dispatcher->RemoveQueue(m_deviceQueue);
+		}
+
 		m_win_proc_delegate_unregistrator(m_window_proc_id);
+
+		EncoderCapabilities::Stop();
 	}
 
 	std::optional<LRESULT> RecordWindowsPlugin::HandleWindowProc(HWND hwnd,
@@ -105,8 +123,7 @@ namespace record_windows {
 		std::optional<LRESULT> result;
 		switch (message) {
 		case WM_RUN_DELEGATE:
-			callbacks.front()();
-			callbacks.pop();
+			m_dispatcher->DrainAll();
 			result = 0;
 			break;
 		}
@@ -157,82 +174,126 @@ namespace record_windows {
 		{
 			result->Success(EncodableValue(true));
 		}
+		// Lifecycle calls and state queries run on the recorder worker, after
+		// the calls made before them. The recorder outlives them, it is only
+		// released by dispose, queued after them as well.
 		else if (method_call.method_name().compare("isPaused") == 0)
 		{
-			result->Success(EncodableValue(recorder->IsPaused()));
+			RunCommand(recorderId, [recorder](EncodableValue& value) {
+				value = EncodableValue(recorder->IsPaused());
+				return S_OK;
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("isRecording") == 0)
 		{
-			result->Success(EncodableValue(recorder->IsRecording()));
+			RunCommand(recorderId, [recorder](EncodableValue& value) {
+				value = EncodableValue(recorder->IsRecording());
+				return S_OK;
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("pause") == 0)
 		{
-			HRESULT hr = recorder->Pause();
-
-			if (SUCCEEDED(hr)) { result->Success(EncodableValue()); }
-			else { ErrorFromHR(hr, *result); }
+			RunCommand(recorderId, [recorder](EncodableValue&) {
+				return recorder->Pause();
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("resume") == 0)
 		{
-			HRESULT hr = recorder->Resume();
-
-			if (SUCCEEDED(hr)) { result->Success(EncodableValue()); }
-			else { ErrorFromHR(hr, *result); }
+			RunCommand(recorderId, [recorder](EncodableValue&) {
+				return recorder->Resume();
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("start") == 0)
 		{
-			auto config = InitRecordConfig(mapArgs);
+			std::shared_ptr<RecordConfig> config = InitRecordConfig(mapArgs);
 
 			std::string path;
 			GetValueFromEncodableMap(mapArgs, "path", path);
 
-			HRESULT hr = recorder->Start(std::move(config), Utf16FromUtf8(path));
+			RunCommand(recorderId, [recorder, config, path = Utf16FromUtf8(path)](EncodableValue&) {
+				return recorder->Start(std::make_unique<RecordConfig>(*config), path);
+			}, std::move(result));
+		}
+		else if (method_call.method_name().compare("arm") == 0)
+		{
+			std::shared_ptr<RecordConfig> config = InitRecordConfig(mapArgs);
 
-			if (SUCCEEDED(hr)) { result->Success(EncodableValue()); }
-			else { ErrorFromHR(hr, *result); }
+			RunCommand(recorderId, [recorder, config](EncodableValue&) {
+				return recorder->Arm(std::make_unique<RecordConfig>(*config));
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("startStream") == 0)
 		{
-			auto config = InitRecordConfig(mapArgs);
+			std::shared_ptr<RecordConfig> config = InitRecordConfig(mapArgs);
 
-			HRESULT hr = recorder->StartStream(std::move(config));
-
-			if (SUCCEEDED(hr)) { result->Success(EncodableValue()); }
-			else { ErrorFromHR(hr, *result); }
+			RunCommand(recorderId, [recorder, config](EncodableValue&) {
+				return recorder->StartStream(std::make_unique<RecordConfig>(*config));
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("stop") == 0)
 		{
-			auto recordingPath = recorder->GetRecordingPath();
-			HRESULT hr = recorder->Stop();
-
-			if (SUCCEEDED(hr))
-			{
-				result->Success(recordingPath.empty() ? EncodableValue() : EncodableValue(Utf8FromUtf16(recordingPath)));
-			}
-			else {
-				ErrorFromHR(hr, *result);
-			}
+			RunCommand(recorderId, [recorder](EncodableValue& value) {
+				auto recordingPath = recorder->GetRecordingPath();
+				HRESULT hr = recorder->Stop();
+
+				if (SUCCEEDED(hr) && !recordingPath.empty())
+				{
+					value = EncodableValue(Utf8FromUtf16(recordingPath));
+				}
+				return hr;
+			}, std::move(result));
 		}
 		else if (method_call.method_name().compare("cancel") == 0)
 		{
-			HRESULT hr = recorder->Cancel();
+			RunCommand(recorderId, [recorder](EncodableValue&) {
+				return recorder->Cancel();
+			}, std::move(result));
+		}
+		else if (method_call.method_name().compare("dispose") == 0)
+		{
+			// Drop pending callbacks before the recorder goes away.
+			auto queue = m_dispatchQueues.find(recorderId);
+			if (queue != m_dispatchQueues.end())
+			{
+				m_dispatcher->RemoveQueue(queue->second);
+				m_dispatchQueues.erase(queue);
+			}
 
-			if (SUCCEEDED(hr))
+			// From now on calls fail right away (or create a new recorder with
+			// the same id), the worker disposes and releases this one after
+			// the calls already queued.
+			std::shared_ptr<IRecorder> disposed = std::move(m_recorders[recorderId]);
+			m_recorders.erase(recorderId);
+
+			auto executor = std::move(m_executors[recorderId]);
+			m_executors.erase(recorderId);
+
+			std::shared_ptr<MethodResult<EncodableValue>> pending(std::move(result));
+			CommandExecutor* pExecutor = executor.get();
+
+			bool queued = executor->Submit(
+				[disposed]() { disposed->Dispose(); },
+				[this, pending, pExecutor]() {
+					pending->Success(EncodableValue());
+
+					// Joins the worker, idle once this reply is posted
+					m_disposingExecutors.erase(std::remove_if(m_disposingExecutors.begin(), m_disposingExecutors.end(),
+						[pExecutor](const auto& executor) { return executor.get() == pExecutor; }),
+						m_disposingExecutors.end());
+				}
+			);
+
+			if (queued)
 			{
-				result->Success(EncodableValue());
+				m_disposingExecutors.push_back(std::move(executor));
 			}
 			else
 			{
-				ErrorFromHR(hr, *result);
+				executor->Stop();
+				disposed->Dispose();
+				pending->Success(EncodableValue());
 			}
 		}
-		else if (method_call.method_name().compare("dispose") == 0)
-		{
-			recorder->Dispose();
-			m_recorders.erase(recorderId);
-
-			result->Success(EncodableValue());
-		}
 		else if (method_call.method_name().compare("getAmplitude") == 0)
 		{
 			auto amp = recorder->GetAmplitude();
@@ -245,6 +306,113 @@ namespace record_windows {
 				))
 			);
 		}
+		else if (method_call.method_name().compare("getMeters") == 0)
+		{
+			auto meters = recorder->GetMeters();
+
+			EncodableList channels;
+			for (int i = 0; i < meters.channelCount; i++)
+			{
+				const auto& channel = meters.channels[i];
+
+				channels.push_back(EncodableValue(EncodableMap({
+					{EncodableValue("peak"), EncodableValue(channel.peak)},
+					{EncodableValue("rms"), EncodableValue(channel.rms)},
+					{EncodableValue("truePeak"), EncodableValue(channel.truePeak)},
+					{EncodableValue("maxPeak"), EncodableValue(channel.maxPeak)},
+					{EncodableValue("maxTruePeak"), EncodableValue(channel.maxTruePeak)},
+					{EncodableValue("clipCount"), EncodableValue((int64_t)channel.clipCount)},
+				})));
+			}
+
+			result->Success(EncodableValue(
+				EncodableMap({
+					{EncodableValue("channels"), EncodableValue(channels)},
+					{EncodableValue("momentaryLufs"), EncodableValue(meters.momentaryLufs)},
+					{EncodableValue("shortTermLufs"), EncodableValue(meters.shortTermLufs)},
+					{EncodableValue("integratedLufs"), EncodableValue(meters.integratedLufs)},
+					{EncodableValue("maxMomentaryLufs"), EncodableValue(meters.maxMomentaryLufs)},
+					{EncodableValue("maxShortTermLufs"), EncodableValue(meters.maxShortTermLufs)},
+					{EncodableValue("frames"), EncodableValue((int64_t)meters.frames)},
+					}
+				))
+			);
+		}
+		else if (method_call.method_name().compare("exportRecent") == 0)
+		{
+			double seconds = 0;
+			int secondsInt = 0;
+			if (!GetValueFromEncodableMap(mapArgs, "seconds", seconds) &&
+				GetValueFromEncodableMap(mapArgs, "seconds", secondsInt))
+			{
+				seconds = secondsInt;
+			}
+			std::string encoder;
+			GetValueFromEncodableMap(mapArgs, "encoder", encoder);
+			std::string path;
+			GetValueFromEncodableMap(mapArgs, "path", path);
+
+			if (seconds <= 0 || path.empty())
+			{
+				result->Error("Bad arguments", "Expected positive seconds and a path.");
+				return;
+			}
+
+			// Completed once the clip is written
+			std::shared_ptr<MethodResult<EncodableValue>> pending(std::move(result));
+			auto queuedHr = std::make_shared<HRESULT>(S_OK);
+			auto exportPath = std::make_shared<std::string>(path);
+
+			// Reads the capture state, ordered with start/stop. The reply
+			// goes through m_commandQueue, the recorder queue is closed on
+			// dispose while the export may still run.
+			bool queued = m_executors[recorderId]->Submit(
+				[recorder, seconds, encoder, exportPath, pending, queuedHr, queue = m_commandQueue]() {
+					*queuedHr = recorder->ExportRecent(seconds, encoder, Utf16FromUtf8(*exportPath), [pending, exportPath, queue](HRESULT hr) {
+						queue->Post([pending, exportPath, hr]() {
+							if (SUCCEEDED(hr)) { pending->Success(EncodableValue(*exportPath)); }
+							else { ErrorFromHR(hr, *pending); }
+						});
+					});
+				},
+				[pending, queuedHr]() {
+					if (FAILED(*queuedHr)) { ErrorFromHR(*queuedHr, *pending); }
+				}
+			);
+
+			if (!queued) { ErrorFromHR(E_PENDING, *pending); }
+		}
+		else if (method_call.method_name().compare("getWaveform") == 0)
+		{
+			double seconds = 0;
+			int secondsInt = 0;
+			if (!GetValueFromEncodableMap(mapArgs, "seconds", seconds) &&
+				GetValueFromEncodableMap(mapArgs, "seconds", secondsInt))
+			{
+				seconds = secondsInt;
+			}
+			int pixels = 0;
+			GetValueFromEncodableMap(mapArgs, "pixels", pixels);
+
+			if (seconds <= 0 || pixels <= 0)
+			{
+				result->Error("Bad arguments", "Expected positive seconds and pixels.");
+				return;
+			}
+
+			result->Success(EncodableValue(recorder->GetWaveform(seconds, pixels)));
+		}
+		else if (method_call.method_name().compare("getStats") == 0)
+		{
+			EncodableMap stats;
+			for (const auto& [name, value] : recorder->GetStats())
+			{
+				stats[EncodableValue(name)] = EncodableValue(value);
+			}
+			stats[EncodableValue("pendingCommands")] = EncodableValue((int64_t)m_executors[recorderId]->Pending());
+
+			result->Success(EncodableValue(stats));
+		}
 		else if (method_call.method_name().compare("isEncoderSupported") == 0)
 		{
 			std::string encoderName;
@@ -266,6 +434,39 @@ namespace record_windows {
 				ErrorFromHR(hr, *result);
 			}
 		}
+		else if (method_call.method_name().compare("getEncoderCapabilities") == 0)
+		{
+			std::vector<EncoderCapability> capabilities;
+			HRESULT hr = recorder->GetEncoderCapabilities(capabilities);
+
+			if (FAILED(hr))
+			{
+				ErrorFromHR(hr, *result);
+				return;
+			}
+
+			auto toList = [](const std::vector<int>& values) {
+				EncodableList list;
+				for (int value : values) list.push_back(EncodableValue(value));
+				return list;
+			};
+
+			EncodableList list;
+			for (const auto& capability : capabilities)
+			{
+				list.push_back(EncodableValue(EncodableMap({
+					{EncodableValue("encoder"), EncodableValue(capability.encoderName)},
+					{EncodableValue("supported"), EncodableValue(capability.supported)},
+					{EncodableValue("sampleRates"), EncodableValue(toList(capability.sampleRates))},
+					{EncodableValue("numChannels"), EncodableValue(toList(capability.numChannels))},
+					{EncodableValue("bitRates"), EncodableValue(toList(capability.bitRates))},
+					{EncodableValue("minBitRate"), EncodableValue(capability.minBitRate)},
+					{EncodableValue("maxBitRate"), EncodableValue(capability.maxBitRate)},
+				})));
+			}
+
+			result->Success(EncodableValue(list));
+		}
 		else if (method_call.method_name().compare("listInputDevices") == 0)
 		{
 			ListInputDevices(*result);
@@ -296,6 +497,44 @@ namespace record_windows {
 		GetValueFromEncodableMap(args, "echoCancel", echoCancel);
 		bool noiseSuppress;
 		GetValueFromEncodableMap(args, "noiseSuppress", noiseSuppress);
+		int streamChunkMs = 0;
+		GetValueFromEncodableMap(args, "streamChunkMs", streamChunkMs);
+		int streamChunkBytes = 0;
+		GetValueFromEncodableMap(args, "streamChunkBytes", streamChunkBytes);
+		int meterIntervalMs = 0;
+		GetValueFromEncodableMap(args, "meterIntervalMs", meterIntervalMs);
+		bool waveformSidecar = false;
+		GetValueFromEncodableMap(args, "waveformSidecar", waveformSidecar);
+		int checkpointMs = 0;
+		GetValueFromEncodableMap(args, "checkpointMs", checkpointMs);
+		int checkpointBytes = 0;
+		GetValueFromEncodableMap(args, "checkpointBytes", checkpointBytes);
+		int segmentMs = 0;
+		GetValueFromEncodableMap(args, "segmentMs", segmentMs);
+		int segmentBytes = 0;
+		GetValueFromEncodableMap(args, "segmentBytes", segmentBytes);
+		int retentionMs = 0;
+		GetValueFromEncodableMap(args, "retentionMs", retentionMs);
+		int preRollMs = 0;
+		GetValueFromEncodableMap(args, "preRollMs", preRollMs);
+		int historyMs = 0;
+		GetValueFromEncodableMap(args, "historyMs", historyMs);
+		bool streamWhileRecording = false;
+		GetValueFromEncodableMap(args, "streamWhileRecording", streamWhileRecording);
+		int opusFrameMs = 20;
+		GetValueFromEncodableMap(args, "opusFrameMs", opusFrameMs);
+		int opusComplexity = 5;
+		GetValueFromEncodableMap(args, "opusComplexity", opusComplexity);
+		bool opusVbr = true;
+		GetValueFromEncodableMap(args, "opusVbr", opusVbr);
+		bool opusDtx = false;
+		GetValueFromEncodableMap(args, "opusDtx", opusDtx);
+		int flacCompressionLevel = 5;
+		GetValueFromEncodableMap(args, "flacCompressionLevel", flacCompressionLevel);
+		int mp4FragmentMs = 0;
+		GetValueFromEncodableMap(args, "mp4FragmentMs", mp4FragmentMs);
+		bool keepWarm = false;
+		GetValueFromEncodableMap(args, "keepWarm", keepWarm);
 
 		auto config = std::make_unique<RecordConfig>(
 			encoderName,
@@ -307,6 +546,25 @@ namespace record_windows {
 			echoCancel,
 			noiseSuppress
 		);
+		config->streamChunkMs = streamChunkMs;
+		config->streamChunkBytes = streamChunkBytes;
+		config->meterIntervalMs = meterIntervalMs;
+		config->waveformSidecar = waveformSidecar;
+		config->checkpointMs = checkpointMs;
+		config->checkpointBytes = checkpointBytes;
+		config->segmentMs = segmentMs;
+		config->segmentBytes = segmentBytes;
+		config->retentionMs = retentionMs;
+		config->preRollMs = preRollMs;
+		config->historyMs = historyMs;
+		config->streamWhileRecording = streamWhileRecording;
+		config->opusFrameMs = opusFrameMs;
+		config->opusComplexity = opusComplexity;
+		config->opusVbr = opusVbr;
+		config->opusDtx = opusDtx;
+		config->flacCompressionLevel = flacCompressionLevel;
+		config->mp4FragmentMs = mp4FragmentMs;
+		config->keepWarm = keepWarm;
 
 		return config;
 	}
@@ -331,14 +589,43 @@ namespace record_windows {
 		std::unique_ptr<StreamHandler<EncodableValue>> pRecordEventHandler{static_cast<StreamHandler<EncodableValue>*>(eventRecordHandler)};
 		eventRecordChannel->SetStreamHandler(std::move(pRecordEventHandler));
 
+		// Meter event channel
+		auto eventMeterChannel = std::make_unique<EventChannel<EncodableValue>>(
+			m_binaryMessenger, "com.llfbandit.record/eventsMeter/" + recorderId,
+			&StandardMethodCodec::GetInstance());
+
+		auto eventMeterHandler = new EventStreamHandler<>();
+		std::unique_ptr<StreamHandler<EncodableValue>> pMeterEventHandler{static_cast<StreamHandler<EncodableValue>*>(eventMeterHandler)};
+		eventMeterChannel->SetStreamHandler(std::move(pMeterEventHandler));
+
+		// Segment event channel
+		auto eventSegmentChannel = std::make_unique<EventChannel<EncodableValue>>(
+			m_binaryMessenger, "com.llfbandit.record/eventsSegment/" + recorderId,
+			&StandardMethodCodec::GetInstance());
+
+		auto eventSegmentHandler = new EventStreamHandler<>();
+		std::unique_ptr<StreamHandler<EncodableValue>> pSegmentEventHandler{static_cast<StreamHandler<EncodableValue>*>(eventSegmentHandler)};
+		eventSegmentChannel->SetStreamHandler(std::move(pSegmentEventHandler));
+
+		auto dispatchQueue = m_dispatcher->CreateQueue();
+
 		// 使用工厂方法创建录音器
-		auto recorder = RecorderFactory::CreateRecorder(eventHandler, eventRecordHandler);
+		auto recorder = RecorderFactory::CreateRecorder(eventHandler, eventRecordHandler, eventMeterHandler, eventSegmentHandler, dispatchQueue);
 		if (recorder)
 		{
-			m_recorders.insert(std::make_pair(recorderId, std::move(recorder)));
+			if (m_recorders.insert(std::make_pair(recorderId, std::move(recorder))).second)
+			{
+				m_dispatchQueues.insert(std::make_pair(recorderId, dispatchQueue));
+				m_executors.insert(std::make_pair(recorderId, std::make_unique<CommandExecutor>(m_commandQueue)));
+			}
+			else
+			{
+				m_dispatcher->RemoveQueue(dispatchQueue);
+			}
 			return S_OK;
 		}
 
+		m_dispatcher->RemoveQueue(dispatchQueue);
 		return E_FAIL;
 	}
 
@@ -351,68 +638,78 @@ namespace record_windows {
 		return searchedRecorder->second.get();
 	}
 
-	HRESULT RecordWindowsPlugin::ListInputDevices(MethodResult<EncodableValue>& result)
+	// Runs command on the recorder worker, after the calls already queued,
+	// then replies with its value from the platform thread.
+	void RecordWindowsPlugin::RunCommand(
+		const std::string& recorderId,
+		std::function<HRESULT(EncodableValue& value)> command,
+		std::unique_ptr<MethodResult<EncodableValue>> result)
 	{
-		EncodableList devices;
+		struct Reply
+		{
+			HRESULT hr = S_OK;
+			EncodableValue value;
+		};
 
-		IMFAttributes* pDeviceAttributes = NULL;
-		IMFActivate** ppDevices = NULL;
-		UINT32 deviceCount = 0;
+		auto reply = std::make_shared<Reply>();
+		std::shared_ptr<MethodResult<EncodableValue>> pending(std::move(result));
 
-		HRESULT hr = MFCreateAttributes(&pDeviceAttributes, 1);
-		if (SUCCEEDED(hr))
-		{
-			// Request audio capture devices
-			hr = pDeviceAttributes->SetGUID(
-				MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-				MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_GUID);
-		}
+		bool queued = m_executors[recorderId]->Submit(
+			[command = std::move(command), reply]() {
+				reply->hr = command(reply->value);
+			},
+			[reply, pending]() {
+				if (SUCCEEDED(reply->hr)) { pending->Success(reply->value); }
+				else { ErrorFromHR(reply->hr, *pending); }
+			}
+		);
 
-		if (SUCCEEDED(hr))
-		{
-			hr = MFEnumDeviceSources(pDeviceAttributes, &ppDevices, &deviceCount);
-		}
+		// Too many calls pending
+		if (!queued) { ErrorFromHR(E_PENDING, *pending); }
+	}
 
-		for (UINT32 i = 0; i < deviceCount; i++)
-		{
-			LPWSTR friendlyName = NULL;
-			UINT32 friendlyNameLength = 0;
-			LPWSTR id;
-			UINT32 idLength = 0;
+	void RecordWindowsPlugin::StartDeviceMonitor()
+	{
+		// Device changes event channel, shared by all recorders
+		auto eventChannel = std::make_unique<EventChannel<EncodableValue>>(
+			m_binaryMessenger, "com.llfbandit.record/devices",
+			&StandardMethodCodec::GetInstance());
 
-			hr = ppDevices[i]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_ENDPOINT_ID, &id, &idLength);
-			if (SUCCEEDED(hr))
-			{
-				hr = ppDevices[i]->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME, &friendlyName, &friendlyNameLength);
-			}
-			if (SUCCEEDED(hr))
-			{
-				devices.push_back(EncodableMap({
-				{EncodableValue("id"), EncodableValue(toString(id))},
-				{EncodableValue("label"), EncodableValue(toString(friendlyName))}
-					}));
+		auto eventHandler = new EventStreamHandler<>();
+		std::unique_ptr<StreamHandler<EncodableValue>> pEventHandler{static_cast<StreamHandler<EncodableValue>*>(eventHandler)};
+		eventChannel->SetStreamHandler(std::move(pEventHandler));
 
-				CoTaskMemFree(id);
-				CoTaskMemFree(friendlyName);
-			}
-		}
+		m_deviceQueue = m_dispatcher->CreateQueue();
+		m_deviceMonitor = std::make_unique<DeviceMonitor>(eventHandler, m_deviceQueue);
+
+		// Without notifications, the list is still cached
+		m_deviceMonitor->Start();
+	}
+
+	HRESULT RecordWindowsPlugin::ListInputDevices(MethodResult<EncodableValue>& result)
+	{
+		std::vector<AudioDevice> devices;
+
+		HRESULT hr = m_deviceMonitor->Devices(devices);
 
 		if (SUCCEEDED(hr))
 		{
-			result.Success(std::move(EncodableValue(devices)));
+			EncodableList list;
+			for (const auto& device : devices)
+			{
+				list.push_back(EncodableMap({
+					{EncodableValue("id"), EncodableValue(device.id)},
+					{EncodableValue("label"), EncodableValue(device.label)}
+					}));
+			}
+
+			result.Success(EncodableValue(std::move(list)));
 		}
 		else
 		{
 			ErrorFromHR(hr, result);
 		}
 
-		for (UINT32 i = 0; i < deviceCount; i++)
-		{
-			SafeRelease(ppDevices[i]);
-		}
-		SafeRelease(pDeviceAttributes);
-		CoTaskMemFree(ppDevices);
-
 		return hr;
 	}
 }  // namespace record_windows
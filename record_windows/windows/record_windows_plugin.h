@@ -9,7 +9,9 @@
 #include <flutter/event_stream_handler_functions.h>
 #include <flutter/method_channel.h>
 #include <flutter/standard_method_codec.h>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <windows.h>
 #include <mfidl.h>
@@ -18,12 +20,12 @@
 
 #include "utils.h"
 #include "recorder_interface.h"
-#include <queue>
+#include "main_thread_dispatcher.h"
+#include "command_executor.h"
+#include "device_monitor.h"
 
 using namespace flutter;
 
-#define WM_RUN_DELEGATE (WM_USER + 101)
-
 namespace record_windows {
 	typedef flutter::EventSink<flutter::EncodableValue> FlEventSink;
 	typedef flutter::StreamHandlerError<flutter::EncodableValue> FlStreamHandlerError;
@@ -48,15 +50,6 @@ namespace record_windows {
 		RecordWindowsPlugin(const RecordWindowsPlugin&) = delete;
 		RecordWindowsPlugin& operator=(const RecordWindowsPlugin&) = delete;
 
-		// The function to call to get the root window.
-		static FlutterRootWindowProvider get_root_window;
-
-		// A queue of callbacks to run on the main thread.
-		static std::queue<std::function<void()>> callbacks;
-
-		// Runs the given callback on the main thread.
-		static void RunOnMainThread(std::function<void()> callback);
-
 	private:
 		static inline BinaryMessenger* m_binaryMessenger;
 
@@ -66,12 +59,30 @@ namespace record_windows {
 
 		HRESULT CreateRecorder(std::string recorderId);
 		IRecorder* GetRecorder(std::string recorderId);
+		void RunCommand(const std::string& recorderId,
+			std::function<HRESULT(EncodableValue& value)> command,
+			std::unique_ptr<MethodResult<EncodableValue>> result);
 		HRESULT ListInputDevices(MethodResult<EncodableValue>& result);
+		void StartDeviceMonitor();
 
 		std::unique_ptr<RecordConfig> InitRecordConfig(const EncodableMap* args);
 
 		std::map<std::string, std::unique_ptr<IRecorder>> m_recorders{};
 
+		// Runs recorder callbacks on the main thread, one queue per recorder.
+		std::unique_ptr<MainThreadDispatcher> m_dispatcher;
+		std::map<std::string, std::shared_ptr<DispatchQueue>> m_dispatchQueues{};
+
+		// Lifecycle calls run on one worker per recorder, in call order.
+		// Replies go through m_commandQueue, which outlives the recorders.
+		std::map<std::string, std::unique_ptr<CommandExecutor>> m_executors{};
+		std::vector<std::unique_ptr<CommandExecutor>> m_disposingExecutors{};
+		std::shared_ptr<DispatchQueue> m_commandQueue;
+
+		// Cached input devices, changes go to the devices event channel.
+		std::unique_ptr<DeviceMonitor> m_deviceMonitor;
+		std::shared_ptr<DispatchQueue> m_deviceQueue;
+
 		// Called for top-level WindowProc delegation.
 		std::optional<LRESULT> HandleWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
 
@@ -9,18 +9,21 @@ namespace record_windows
 {
     std::unique_ptr<IRecorder> RecorderFactory::CreateRecorder(
         EventStreamHandler<EncodableValue>* stateEventHandler,
-        EventStreamHandler<EncodableValue>* recordEventHandler)
+        EventStreamHandler<EncodableValue>* recordEventHandler,
+        EventStreamHandler<EncodableValue>* meterEventHandler,
+        EventStreamHandler<EncodableValue>* segmentEventHandler,
+        std::shared_ptr<DispatchQueue> dispatchQueue)
     {
         // 根据Windows版本选择不同的录音器实现
         if (IsWindows10Plus())
         {
             // Windows 10及以上版本使用MediaFoundation
-            return std::make_unique<MediaFoundationRecorder>(stateEventHandler, recordEventHandler);
+            return std::make_unique<MediaFoundationRecorder>(stateEventHandler, recordEventHandler, meterEventHandler, segmentEventHandler, dispatchQueue);
         }
         else
         {
-            // Windows 7和8使用fmedia
-            return std::make_unique<FmediaRecorder>(stateEventHandler, recordEventHandler);
+            // Windows 7和8使用fmedia，不支持计量和分段
+            return std::make_unique<FmediaRecorder>(stateEventHandler, recordEventHandler, dispatchQueue);
         }
     }
 } 
\ No newline at end of file
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 #define NOMINMAX
 #include <windows.h>
 #include "record_config.h"
 #include "event_stream_handler.h"
+#include "main_thread_dispatcher.h"
+#include "meter_engine.h"
+#include "encoder_capabilities.h"
 
 using namespace flutter;
 
@@ -20,6 +25,9 @@ namespace record_windows
 
         virtual HRESULT Start(std::unique_ptr<RecordConfig> config, std::wstring path) = 0;
         virtual HRESULT StartStream(std::unique_ptr<RecordConfig> config) = 0;
+        // Opens the capture and keeps the last preRollMs of audio in memory,
+        // a following Start() with the same input begins with it.
+        virtual HRESULT Arm(std::unique_ptr<RecordConfig> config) = 0;
         virtual HRESULT Pause() = 0;
         virtual HRESULT Resume() = 0;
         virtual HRESULT Stop() = 0;
@@ -28,8 +36,21 @@ namespace record_windows
         virtual bool IsRecording() = 0;
         virtual HRESULT Dispose() = 0;
         virtual std::map<std::string, double> GetAmplitude() = 0;
+        // Per channel levels and loudness since the recording started.
+        virtual MeterSnapshot GetMeters() = 0;
+        // Overview of the last seconds as (min, max) pairs in [-1, 1], one per pixel.
+        virtual std::vector<float> GetWaveform(double seconds, int pixels) = 0;
         virtual std::wstring GetRecordingPath() = 0;
         virtual HRESULT isEncoderSupported(const std::string encoderName, bool* supported) = 0;
+        // Formats accepted by each encoder known to the plugin.
+        virtual HRESULT GetEncoderCapabilities(std::vector<EncoderCapability>& capabilities) = 0;
+        // Writes the last seconds of captured audio (up to historyMs) to path,
+        // encoded in the background. onDone runs on the export worker, even
+        // when the recorder is disposed meanwhile. It is not called when the
+        // export could not be queued (error returned).
+        virtual HRESULT ExportRecent(double seconds, const std::string& encoderName, std::wstring path, std::function<void(HRESULT)> onDone) = 0;
+        // Internal counters for diagnostics (buffer pools, queues...).
+        virtual std::map<std::string, int64_t> GetStats() = 0;
     };
 
     // 录音器工厂类
@@ -38,7 +59,10 @@ namespace record_windows
     public:
         static std::unique_ptr<IRecorder> CreateRecorder(
             EventStreamHandler<EncodableValue>* stateEventHandler,
-            EventStreamHandler<EncodableValue>* recordEventHandler
+            EventStreamHandler<EncodableValue>* recordEventHandler,
+            EventStreamHandler<EncodableValue>* meterEventHandler,
+            EventStreamHandler<EncodableValue>* segmentEventHandler,
+            std::shared_ptr<DispatchQueue> dispatchQueue
         );
     };
 } 
\ No newline at end of file
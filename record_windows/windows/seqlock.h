@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace record_windows
+{
+    // Single writer / multiple readers snapshot of a trivially copyable value.
+    //
+    // Writer never blocks, readers retry while a write is in progress.
+    // Payload is copied through relaxed atomic words so concurrent reads
+    // are not data races, torn copies are detected by the sequence number.
+    template <typename T>
+    class Seqlock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Seqlock value must be trivially copyable");
+
+    public:
+        Seqlock() : Seqlock(T{}) {}
+
+        explicit Seqlock(const T& value)
+        {
+            Store(value);
+        }
+
+        Seqlock(const Seqlock&) = delete;
+        Seqlock& operator=(const Seqlock&) = delete;
+
+        // Writer thread only (or when no other writer can run).
+        void Store(const T& value)
+        {
+            uint64_t words[kWords] = {};
+            std::memcpy(words, &value, sizeof(T));
+
+            uint32_t seq = m_seq.load(std::memory_order_relaxed);
+            m_seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t i = 0; i < kWords; i++)
+            {
+                m_words[i].store(words[i], std::memory_order_relaxed);
+            }
+
+            m_seq.store(seq + 2, std::memory_order_release);
+        }
+
+        // Any thread.
+        T Load() const
+        {
+            uint64_t words[kWords];
+            uint32_t before, after;
+
+            do
+            {
+                before = m_seq.load(std::memory_order_acquire);
+
+                for (size_t i = 0; i < kWords; i++)
+                {
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_seq.load(std::memory_order_relaxed);
+            } while ((before & 1) != 0 || before != after);
+
+            T value;
+            std::memcpy(&value, words, sizeof(T));
+            return value;
+        }
+
+        // Number of completed writes.
+        uint32_t Version() const { return m_seq.load(std::memory_order_acquire) / 2; }
+
+    private:
+        static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> m_seq{ 0 };
+        std::atomic<uint64_t> m_words[kWords];
+    };
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace record_windows
+{
+    // Bounded lock-free single-producer / single-consumer ring.
+    //
+    // One slot is always kept free to tell full from empty, usable capacity
+    // is the requested one. Elements are move-assigned in and out of
+    // pre-constructed slots so T must be default constructible.
+    template <typename T>
+    class SpscRing
+    {
+    public:
+        explicit SpscRing(size_t capacity)
+            : m_slots(capacity + 1)
+        {
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // Producer thread only. Returns false when full, item is left untouched.
+        bool TryPush(T&& item)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t next = Next(tail);
+
+            if (next == m_head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            m_slots[tail] = std::move(item);
+            m_tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer thread only. Returns false when empty.
+        bool TryPop(T& item)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            item = std::move(m_slots[head]);
+            m_slots[head] = T();
+            m_head.store(Next(head), std::memory_order_release);
+            return true;
+        }
+
+        // Approximate when called concurrently.
+        size_t Size() const
+        {
+            size_t head = m_head.load(std::memory_order_acquire);
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            return tail >= head ? tail - head : m_slots.size() - head + tail;
+        }
+
+        bool Empty() const { return Size() == 0; }
+        size_t Capacity() const { return m_slots.size() - 1; }
+
+    private:
+        size_t Next(size_t index) const
+        {
+            return index + 1 == m_slots.size() ? 0 : index + 1;
+        }
+
+        static constexpr size_t kCacheLine = 64;
+
+        std::vector<T> m_slots;
+        alignas(kCacheLine) std::atomic<size_t> m_head{ 0 };
+        alignas(kCacheLine) std::atomic<size_t> m_tail{ 0 };
+    };
+}
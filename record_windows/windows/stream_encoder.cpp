@@ -0,0 +1,126 @@
+#define NOMINMAX
+#include "stream_encoder.h"
+#include "aac_stream_encoder.h"
+#include "opus_ogg_encoder.h"
+#include "record_config.h"
+
+namespace record_windows
+{
+    // One Ogg page per Opus packet, header pages are sent first.
+    class OpusStreamEncoder : public StreamEncoder
+    {
+    public:
+        static HRESULT Create(const StreamEncoderConfig& config, PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder)
+        {
+            if (!OpusOggEncoder::Available())
+            {
+                return E_NOTIMPL;
+            }
+
+            OpusOggEncoder::Options options = config.opus;
+            options.sampleRate = config.sampleRate;
+            options.numChannels = config.numChannels;
+            options.bitRate = config.bitRate;
+            options.pageMs = 0;
+
+            std::unique_ptr<OpusStreamEncoder> opusEncoder(new OpusStreamEncoder(config.numChannels * 2));
+
+            bool opened = opusEncoder->m_encoder.Open(options, [onPacket = std::move(onPacket)](const uint8_t* page, size_t size) {
+                onPacket(page, size);
+                return true;
+            });
+
+            if (!opened)
+            {
+                return opusEncoder->m_encoder.LastError() == -1 ? MF_E_INVALIDMEDIATYPE : E_FAIL;
+            }
+
+            encoder = std::move(opusEncoder);
+            return S_OK;
+        }
+
+        HRESULT Encode(const BYTE* data, DWORD size) override
+        {
+            return m_encoder.Encode(reinterpret_cast<const int16_t*>(data), size / m_blockAlign) ? S_OK : E_FAIL;
+        }
+
+        HRESULT Drain() override
+        {
+            return m_encoder.Finish() ? S_OK : E_FAIL;
+        }
+
+    private:
+        explicit OpusStreamEncoder(UINT32 blockAlign) : m_blockAlign(blockAlign) {}
+
+        OpusOggEncoder m_encoder;
+        UINT32 m_blockAlign;
+    };
+
+    // Stream header (fLaC and STREAMINFO) first, then one FLAC frame per packet.
+    class FlacStreamEncoder : public StreamEncoder
+    {
+    public:
+        static HRESULT Create(const StreamEncoderConfig& config, PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder)
+        {
+            FlacEncoder::Options options;
+            options.sampleRate = config.sampleRate;
+            options.numChannels = config.numChannels;
+            options.compressionLevel = config.flacCompressionLevel;
+            options.seekable = false;
+
+            std::unique_ptr<FlacStreamEncoder> flacEncoder(new FlacStreamEncoder(config.numChannels * 2));
+
+            bool opened = flacEncoder->m_encoder.Open(options, [onPacket = std::move(onPacket)](uint64_t, const uint8_t* data, size_t size) {
+                onPacket(data, size);
+                return true;
+            });
+
+            if (!opened)
+            {
+                return MF_E_INVALIDMEDIATYPE;
+            }
+
+            encoder = std::move(flacEncoder);
+            return S_OK;
+        }
+
+        HRESULT Encode(const BYTE* data, DWORD size) override
+        {
+            return m_encoder.Encode(reinterpret_cast<const int16_t*>(data), size / m_blockAlign) ? S_OK : E_FAIL;
+        }
+
+        HRESULT Drain() override
+        {
+            return m_encoder.Finish() ? S_OK : E_FAIL;
+        }
+
+    private:
+        explicit FlacStreamEncoder(UINT32 blockAlign) : m_blockAlign(blockAlign) {}
+
+        FlacEncoder m_encoder;
+        UINT32 m_blockAlign;
+    };
+
+    HRESULT CreateStreamEncoder(const StreamEncoderConfig& config, StreamEncoder::PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder)
+    {
+        if (config.numChannels == 0 || config.sampleRate == 0)
+        {
+            return E_INVALIDARG;
+        }
+
+        if (config.encoderName == AudioEncoder().aacLc)
+        {
+            return AacStreamEncoder::Create(config, std::move(onPacket), encoder);
+        }
+        if (config.encoderName == AudioEncoder().opus)
+        {
+            return OpusStreamEncoder::Create(config, std::move(onPacket), encoder);
+        }
+        if (config.encoderName == AudioEncoder().flac)
+        {
+            return FlacStreamEncoder::Create(config, std::move(onPacket), encoder);
+        }
+
+        return E_NOTIMPL;
+    }
+}
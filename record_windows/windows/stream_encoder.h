@@ -0,0 +1,50 @@
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "opus_ogg_encoder.h"
+#include "flac_encoder.h"
+
+namespace record_windows
+{
+    // Compresses the captured PCM 16 bits samples for startStream.
+    //
+    // Output is cut in self-delimiting packets (ADTS frame, Ogg page, FLAC
+    // frame), each one can be decoded on its own by the listener.
+    // Driven by one thread at a time (the pipeline worker while streaming).
+    class StreamEncoder
+    {
+    public:
+        using PacketCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+        virtual ~StreamEncoder() = default;
+
+        // Interleaved PCM, whole frames. Packets ready are sent synchronously
+        // through the callback.
+        virtual HRESULT Encode(const BYTE* data, DWORD size) = 0;
+
+        // Sends the remaining packets. No more Encode() afterwards.
+        virtual HRESULT Drain() = 0;
+    };
+
+    struct StreamEncoderConfig
+    {
+        std::string encoderName;
+        UINT32 sampleRate = 44100;
+        UINT32 numChannels = 2;
+        UINT32 bitRate = 128000;
+        // Opus settings, format fields are taken from above.
+        OpusOggEncoder::Options opus;
+        int flacCompressionLevel = 5;
+    };
+
+    // E_NOTIMPL when the encoder can't be streamed.
+    HRESULT CreateStreamEncoder(const StreamEncoderConfig& config, StreamEncoder::PacketCallback onPacket, std::unique_ptr<StreamEncoder>& encoder);
+}
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "amplitude_kernel.h"
+#include "bench_support.h"
+#include "cpu_features.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // 20 ms of 48 kHz stereo, the size of a typical capture chunk
+    const size_t kBlockSamples = 48000 / 50 * 2;
+    const size_t kBlockBytes = kBlockSamples * sizeof(int16_t);
+
+    // The previous implementation (GetAmplitudeFromSample with
+    // convertBytesToInt16), kept as the baseline.
+    std::vector<int16_t> LegacyConvertBytesToInt16(const uint8_t* bytes, uint32_t size)
+    {
+        std::vector<int16_t> values(size / 2);
+
+        for (uint32_t i = 0; i < size; i += 2)
+        {
+            values.push_back(int16_t(bytes[i] << 0 | bytes[i + 1] << 8));
+        }
+        return values;
+    }
+
+    double LegacyAmplitude(const uint8_t* chunk, uint32_t size)
+    {
+        int maxSample = -160;
+        auto values = LegacyConvertBytesToInt16(chunk, size);
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+            int curSample = std::abs(values[i]);
+            if (curSample > maxSample) maxSample = curSample;
+        }
+
+        return 20 * std::log10(maxSample / 32767.0);
+    }
+
+    volatile double g_sink;
+
+    // Runs fn over every block, best of several passes. Returns ns per block.
+    template <typename Fn>
+    double Measure(const std::vector<int16_t>& samples, size_t blocks, int passes, Fn&& fn)
+    {
+        double seconds = bench::BestOf(passes, [&]() {
+            double sum = 0.0;
+            for (size_t b = 0; b < blocks; b++) sum += fn(samples.data() + b * kBlockSamples);
+            g_sink = sum;
+        });
+        return seconds * 1e9 / (double)blocks;
+    }
+
+    void Print(const char* name, double ns, double baselineNs)
+    {
+        std::printf("%-10s %9.1f ns/block  %7.2f GB/s  %6.1fx\n",
+            name, ns, (double)kBlockBytes / ns, baselineNs / ns);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = bench::Quick(argc, argv);
+    const size_t blocks = 256;
+    const int passes = quick ? 2 : 200;
+
+    std::mt19937 rng(1);
+    std::normal_distribution<float> dist(0.0f, 6000.0f);
+    std::vector<int16_t> samples(blocks * kBlockSamples);
+    for (auto& s : samples) s = (int16_t)std::max(-32768.0f, std::min(32767.0f, dist(rng)));
+
+    std::printf("%zu blocks of %zu bytes (20 ms, 48 kHz stereo 16-bit)\n", blocks, kBlockBytes);
+
+    double legacy = Measure(samples, blocks, passes, [](const int16_t* block) {
+        return LegacyAmplitude(reinterpret_cast<const uint8_t*>(block), (uint32_t)kBlockBytes);
+    });
+    Print("legacy", legacy, legacy);
+
+    Print("scalar", Measure(samples, blocks, passes, [](const int16_t* block) {
+        return ToDbfs(amplitude_detail::Pcm16Scalar(block, kBlockSamples).peak);
+    }), legacy);
+
+#if RECORD_X86
+    const CpuFeatures& cpu = GetCpuFeatures();
+    if (cpu.sse2)
+    {
+        Print("sse2", Measure(samples, blocks, passes, [](const int16_t* block) {
+            return ToDbfs(amplitude_detail::Pcm16Sse2(block, kBlockSamples).peak);
+        }), legacy);
+    }
+    if (cpu.avx2)
+    {
+        Print("avx2", Measure(samples, blocks, passes, [](const int16_t* block) {
+            return ToDbfs(amplitude_detail::Pcm16Avx2(block, kBlockSamples).peak);
+        }), legacy);
+    }
+#endif
+
+    Print("dispatch", Measure(samples, blocks, passes, [](const int16_t* block) {
+        return ToDbfs(ComputeAmplitude<Pcm16Format>(reinterpret_cast<const uint8_t*>(block), kBlockBytes).peak);
+    }), legacy);
+
+    return 0;
+}
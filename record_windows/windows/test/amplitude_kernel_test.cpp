@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "amplitude_kernel.h"
+#include "cpu_features.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // Odd sizes exercise the scalar tails of the SIMD loops
+    const size_t kCounts[] = { 0, 1, 7, 8, 15, 16, 17, 31, 33, 1000, 4099 };
+
+    void CheckSame(const AmplitudeStats& expected, const AmplitudeStats& actual)
+    {
+        CHECK(expected.peak == actual.peak);
+        CHECK_EQ(expected.count, actual.count);
+        CHECK(std::fabs(expected.sumSquares - actual.sumSquares) <= 1e-9 * (1.0 + expected.sumSquares));
+    }
+
+    std::vector<int16_t> Pcm16Samples(size_t count, std::mt19937& rng)
+    {
+        std::uniform_int_distribution<int> dist(-32768, 32767);
+        std::vector<int16_t> samples(count);
+        for (auto& s : samples) s = (int16_t)dist(rng);
+        return samples;
+    }
+
+    std::vector<float> Float32Samples(size_t count, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> dist(-1.5f, 1.5f);
+        std::vector<float> samples(count);
+        for (auto& s : samples) s = dist(rng);
+        return samples;
+    }
+
+    void CheckPcm16(const std::vector<int16_t>& samples)
+    {
+        const int16_t* data = samples.data();
+        const size_t count = samples.size();
+        AmplitudeStats expected = amplitude_detail::Pcm16Scalar(data, count);
+
+        CheckSame(expected, amplitude_detail::Pcm16Dispatch(data, count));
+
+#if RECORD_X86
+        const CpuFeatures& cpu = GetCpuFeatures();
+        if (cpu.sse2) CheckSame(expected, amplitude_detail::Pcm16Sse2(data, count));
+        if (cpu.avx2) CheckSame(expected, amplitude_detail::Pcm16Avx2(data, count));
+#endif
+    }
+
+    void CheckFloat32(const std::vector<float>& samples)
+    {
+        const float* data = samples.data();
+        const size_t count = samples.size();
+        AmplitudeStats expected = amplitude_detail::Float32Scalar(data, count);
+
+        CheckSame(expected, amplitude_detail::Float32Dispatch(data, count));
+
+#if RECORD_X86
+        const CpuFeatures& cpu = GetCpuFeatures();
+        if (cpu.sse2) CheckSame(expected, amplitude_detail::Float32Sse2(data, count));
+        if (cpu.avx2) CheckSame(expected, amplitude_detail::Float32Avx2(data, count));
+#endif
+    }
+
+    void Pcm16Parity()
+    {
+        std::mt19937 rng(1);
+        for (size_t count : kCounts)
+        {
+            CheckPcm16(Pcm16Samples(count, rng));
+        }
+    }
+
+    void Pcm16FullScale()
+    {
+        for (size_t count : kCounts)
+        {
+            if (count == 0) continue;
+
+            for (size_t at : { (size_t)0, count / 2, count - 1 })
+            {
+                // -32768 has no positive counterpart in 16 bits
+                std::vector<int16_t> samples(count, 100);
+                samples[at] = -32768;
+                CheckPcm16(samples);
+                CHECK(amplitude_detail::Pcm16Dispatch(samples.data(), count).peak == 1.0f);
+
+                samples[at] = 32767;
+                CheckPcm16(samples);
+            }
+        }
+    }
+
+    void Float32Parity()
+    {
+        std::mt19937 rng(2);
+        for (size_t count : kCounts)
+        {
+            CheckFloat32(Float32Samples(count, rng));
+        }
+
+        std::vector<float> samples(33, 0.25f);
+        samples[32] = -2.0f;
+        CheckFloat32(samples);
+        CHECK(amplitude_detail::Float32Dispatch(samples.data(), samples.size()).peak == 2.0f);
+    }
+
+    void UnalignedBuffersFallBack()
+    {
+        std::mt19937 rng(3);
+        std::vector<int16_t> pcm = Pcm16Samples(1001, rng);
+        std::vector<float> floats = Float32Samples(1001, rng);
+
+        std::vector<uint8_t> bytes(sizeof(float) * 1001 + 1);
+
+        std::memcpy(bytes.data() + 1, pcm.data(), pcm.size() * sizeof(int16_t));
+        CheckSame(amplitude_detail::Pcm16Scalar(pcm.data(), pcm.size()),
+            ComputeAmplitude<Pcm16Format>(bytes.data() + 1, pcm.size() * sizeof(int16_t)));
+
+        std::memcpy(bytes.data() + 1, floats.data(), floats.size() * sizeof(float));
+        CheckSame(amplitude_detail::Float32Scalar(floats.data(), floats.size()),
+            ComputeAmplitude<Float32Format>(bytes.data() + 1, floats.size() * sizeof(float)));
+
+        // Trailing bytes of an incomplete sample are ignored
+        CHECK_EQ(500u, ComputeAmplitude<Pcm16Format>(bytes.data(), 1001).count);
+    }
+}
+
+int main()
+{
+#if RECORD_X86
+    const CpuFeatures& cpu = GetCpuFeatures();
+    std::printf("sse2 %d, avx2 %d\n", cpu.sse2 ? 1 : 0, cpu.avx2 ? 1 : 0);
+#endif
+
+    RUN_TEST(Pcm16Parity);
+    RUN_TEST(Pcm16FullScale);
+    RUN_TEST(Float32Parity);
+    RUN_TEST(UnalignedBuffersFallBack);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Helpers for the native benchmarks. Each benchmark runs a short smoke
+// pass under ctest (--quick) and the full measurement when run by hand.
+namespace bench
+{
+    using Clock = std::chrono::steady_clock;
+
+    inline bool Quick(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--quick") == 0) return true;
+        }
+        return false;
+    }
+
+    inline double Seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Best of several runs of fn(), in seconds.
+    template <typename Fn>
+    double BestOf(int runs, Fn&& fn)
+    {
+        double best = 1e300;
+        for (int i = 0; i < runs; i++)
+        {
+            auto start = Clock::now();
+            fn();
+            best = std::min(best, Seconds(start));
+        }
+        return best;
+    }
+
+    // p in [0, 1], sorts the samples.
+    inline double Percentile(std::vector<double>& samples, double p)
+    {
+        if (samples.empty()) return 0.0;
+        std::sort(samples.begin(), samples.end());
+        size_t index = std::min(samples.size() - 1, (size_t)(p * (double)(samples.size() - 1) + 0.5));
+        return samples[index];
+    }
+}
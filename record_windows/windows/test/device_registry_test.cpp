@@ -0,0 +1,159 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "device_registry.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    class FakeEnumerator : public DeviceEnumerator
+    {
+    public:
+        bool Enumerate(std::vector<AudioDevice>& out, std::string& defaultId) override
+        {
+            calls++;
+            if (fail) return false;
+
+            out = devices;
+            defaultId = this->defaultId;
+            return true;
+        }
+
+        std::vector<AudioDevice> devices;
+        std::string defaultId;
+        bool fail = false;
+        int calls = 0;
+    };
+
+    struct Fixture
+    {
+        Fixture()
+        {
+            auto fake = std::make_unique<FakeEnumerator>();
+            enumerator = fake.get();
+            registry = std::make_unique<DeviceRegistry>(std::move(fake), [this](const std::vector<DeviceChange>& changes) {
+                sent.push_back(changes);
+            });
+        }
+
+        FakeEnumerator* enumerator;
+        std::unique_ptr<DeviceRegistry> registry;
+        std::vector<std::vector<DeviceChange>> sent;
+    };
+
+    void EnumeratesOnce()
+    {
+        Fixture f;
+        f.enumerator->devices = { { "a", "Mic A" }, { "b", "Mic B" } };
+        f.enumerator->defaultId = "a";
+
+        std::vector<AudioDevice> devices;
+        std::string defaultId;
+        CHECK(f.registry->Devices(devices, &defaultId));
+        CHECK_EQ(2u, devices.size());
+        CHECK(defaultId == "a");
+        CHECK_EQ(1, f.enumerator->calls);
+
+        CHECK(f.registry->Devices(devices));
+        CHECK_EQ(1, f.enumerator->calls);
+
+        // Same list, nothing sent
+        CHECK(f.registry->Refresh());
+        CHECK_EQ(2, f.enumerator->calls);
+        CHECK(f.sent.empty());
+    }
+
+    void FirstEnumerationSendsNothing()
+    {
+        Fixture f;
+        f.enumerator->devices = { { "a", "Mic A" } };
+
+        CHECK(f.registry->Refresh());
+        CHECK(f.sent.empty());
+
+        std::vector<AudioDevice> devices;
+        CHECK(f.registry->Devices(devices));
+        CHECK_EQ(1, f.enumerator->calls);
+    }
+
+    void SendsChanges()
+    {
+        Fixture f;
+        f.enumerator->devices = { { "a", "Mic A" }, { "b", "Mic B" } };
+        f.enumerator->defaultId = "a";
+
+        std::vector<AudioDevice> devices;
+        CHECK(f.registry->Devices(devices));
+
+        f.enumerator->devices = { { "b", "Mic B" }, { "c", "Mic C" } };
+        f.enumerator->defaultId = "c";
+        CHECK(f.registry->Refresh());
+
+        CHECK_EQ(1u, f.sent.size());
+        const auto& changes = f.sent[0];
+        CHECK_EQ(3u, changes.size());
+        CHECK(changes[0].kind == DeviceChange::Kind::removed && changes[0].device.id == "a");
+        CHECK(changes[1].kind == DeviceChange::Kind::added && changes[1].device.id == "c");
+        CHECK(changes[2].kind == DeviceChange::Kind::defaultChanged && changes[2].device.label == "Mic C");
+
+        CHECK(f.registry->Devices(devices));
+        CHECK(devices == f.enumerator->devices);
+    }
+
+    void RelabeledDeviceIsReplaced()
+    {
+        std::vector<DeviceChange> changes = DeviceRegistry::Diff(
+            { { "b", "Mic B" } }, "b",
+            { { "b", "Renamed" } }, "");
+
+        CHECK_EQ(3u, changes.size());
+        CHECK(changes[0].kind == DeviceChange::Kind::removed && changes[0].device.label == "Mic B");
+        CHECK(changes[1].kind == DeviceChange::Kind::added && changes[1].device.label == "Renamed");
+        // No default anymore
+        CHECK(changes[2].kind == DeviceChange::Kind::defaultChanged && changes[2].device.id.empty());
+    }
+
+    void FailureKeepsTheCache()
+    {
+        Fixture f;
+        f.enumerator->devices = { { "a", "Mic A" } };
+
+        std::vector<AudioDevice> devices;
+        CHECK(f.registry->Devices(devices));
+
+        f.enumerator->fail = true;
+        CHECK(!f.registry->Refresh());
+        CHECK(f.sent.empty());
+        CHECK(f.registry->Devices(devices));
+        CHECK_EQ(1u, devices.size());
+    }
+
+    void NeverEnumerated()
+    {
+        Fixture f;
+        f.enumerator->fail = true;
+
+        std::vector<AudioDevice> devices;
+        CHECK(!f.registry->Devices(devices));
+        // Tried again on the next call
+        CHECK(!f.registry->Devices(devices));
+        CHECK_EQ(2, f.enumerator->calls);
+
+        f.enumerator->fail = false;
+        CHECK(f.registry->Devices(devices));
+    }
+}
+
+int main()
+{
+    RUN_TEST(EnumeratesOnce);
+    RUN_TEST(FirstEnumerationSendsNothing);
+    RUN_TEST(SendsChanges);
+    RUN_TEST(RelabeledDeviceIsReplaced);
+    RUN_TEST(FailureKeepsTheCache);
+    RUN_TEST(NeverEnumerated);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench_support.h"
+#include "flac_encoder.h"
+
+using namespace record_windows;
+
+namespace
+{
+    const uint32_t kSampleRate = 48000;
+    const uint32_t kChannels = 2;
+
+    // Two detuned tones with some noise, so the predictors have work to do
+    // and the residuals aren't trivially small.
+    std::vector<int16_t> SyntheticPcm(size_t frames)
+    {
+        std::mt19937 rng(7);
+        std::normal_distribution<double> noise(0.0, 200.0);
+        std::vector<int16_t> pcm(frames * kChannels);
+
+        for (size_t i = 0; i < frames; i++)
+        {
+            double t = (double)i / kSampleRate;
+            double left = 9000.0 * std::sin(2 * M_PI * 440.0 * t) + 3000.0 * std::sin(2 * M_PI * 1870.0 * t);
+            double right = 9000.0 * std::sin(2 * M_PI * 443.0 * t) + 2500.0 * std::sin(2 * M_PI * 660.0 * t);
+            pcm[i * 2] = (int16_t)std::lround(left + noise(rng));
+            pcm[i * 2 + 1] = (int16_t)std::lround(right + noise(rng));
+        }
+        return pcm;
+    }
+
+    struct Result
+    {
+        double seconds = 0.0;
+        uint64_t bytes = 0;
+    };
+
+    // Encodes in 20 ms chunks, as the capture callback would.
+    Result Encode(const std::vector<int16_t>& pcm, int level, int threads)
+    {
+        FlacEncoder::Options options;
+        options.sampleRate = kSampleRate;
+        options.numChannels = kChannels;
+        options.compressionLevel = level;
+        options.threads = threads;
+
+        Result result;
+        const size_t frames = pcm.size() / kChannels;
+        const size_t chunk = kSampleRate / 50;
+
+        result.seconds = bench::BestOf(3, [&]() {
+            FlacEncoder encoder;
+            encoder.Open(options, [](uint64_t, const uint8_t*, size_t) { return true; });
+
+            for (size_t offset = 0; offset < frames; offset += chunk)
+            {
+                encoder.Encode(pcm.data() + offset * kChannels, std::min(chunk, frames - offset));
+            }
+            encoder.Finish();
+            result.bytes = encoder.BytesWritten();
+        });
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = bench::Quick(argc, argv);
+    const size_t seconds = quick ? 2 : 60;
+    const size_t frames = seconds * kSampleRate;
+    const std::vector<int16_t> pcm = SyntheticPcm(frames);
+    const double pcmBytes = (double)pcm.size() * sizeof(int16_t);
+
+    std::printf("%zu s of 48 kHz stereo 16-bit, %u hardware threads\n", seconds, std::thread::hardware_concurrency());
+
+    for (int level : { 0, 5, 8 })
+    {
+        for (int threads : { 0, -1 })
+        {
+            Result result = Encode(pcm, level, threads);
+            std::printf("level %d  %-12s %10.0f sample frames/s  %7.1fx realtime  ratio %.3f\n",
+                level, threads == 0 ? "inline" : "worker pool",
+                (double)frames / result.seconds, (double)seconds / result.seconds,
+                (double)result.bytes / pcmBytes);
+        }
+    }
+
+    return 0;
+}
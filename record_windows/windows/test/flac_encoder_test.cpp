@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "flac_encoder.h"
+#include "md5.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // Reference CRCs, bitwise on purpose (the encoder uses tables)
+    uint8_t Crc8(const uint8_t* data, size_t size)
+    {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++) crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        return crc;
+    }
+
+    uint16_t Crc16(const uint8_t* data, size_t size)
+    {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc ^= (uint16_t)(data[i] << 8);
+            for (int bit = 0; bit < 8; bit++) crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+        return crc;
+    }
+
+    uint64_t ReadBE(const uint8_t* p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value = (value << 8) | p[i];
+        return value;
+    }
+
+    class BitReader
+    {
+    public:
+        BitReader(const std::vector<uint8_t>& data, size_t offset) : m_data(data), m_bit(offset * 8) {}
+
+        uint32_t Read(int bits)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < bits; i++)
+            {
+                CHECK(m_bit / 8 < m_data.size());
+                value = (value << 1) | ((m_data[m_bit / 8] >> (7 - m_bit % 8)) & 1);
+                m_bit++;
+            }
+            return value;
+        }
+
+        int32_t ReadSigned(int bits)
+        {
+            uint32_t value = Read(bits);
+            return bits > 0 && (value >> (bits - 1)) ? (int32_t)(value - (1ull << bits)) : (int32_t)value;
+        }
+
+        uint32_t ReadUnary()
+        {
+            uint32_t zeros = 0;
+            while (Read(1) == 0) zeros++;
+            return zeros;
+        }
+
+        void Align() { m_bit = (m_bit + 7) & ~(size_t)7; }
+        size_t Byte() const { return m_bit / 8; }
+
+    private:
+        const std::vector<uint8_t>& m_data;
+        size_t m_bit;
+    };
+
+    struct Stream
+    {
+        uint32_t minBlock = 0, maxBlock = 0, minFrame = 0, maxFrame = 0;
+        uint32_t sampleRate = 0, channels = 0, bitsPerSample = 0;
+        uint64_t totalSamples = 0;
+        uint8_t md5[16] = {};
+        std::vector<uint64_t> seekSamples, seekOffsets;
+        std::vector<int16_t> pcm;
+        uint32_t frames = 0;
+    };
+
+    void ReadResidual(BitReader& reader, uint32_t n, uint32_t order, std::vector<int32_t>& out)
+    {
+        uint32_t method = reader.Read(2);
+        CHECK(method <= 1);
+        const int paramBits = method == 0 ? 4 : 5;
+        const uint32_t partitionOrder = reader.Read(4);
+
+        for (uint32_t p = 0; p < (1u << partitionOrder); p++)
+        {
+            uint32_t count = (n >> partitionOrder) - (p == 0 ? order : 0);
+            uint32_t k = reader.Read(paramBits);
+            CHECK(k != (1u << paramBits) - 1);  // escape codes are never written
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t u = (reader.ReadUnary() << k) | reader.Read((int)k);
+                out.push_back((int32_t)(u >> 1) ^ -(int32_t)(u & 1));
+            }
+        }
+    }
+
+    std::vector<int32_t> ReadSubframe(BitReader& reader, uint32_t n, int bps)
+    {
+        CHECK_EQ(0u, reader.Read(1));
+        uint32_t type = reader.Read(6);
+        CHECK_EQ(0u, reader.Read(1));   // no wasted bits
+
+        std::vector<int32_t> x;
+
+        if (type == 0)
+        {
+            x.assign(n, reader.ReadSigned(bps));
+        }
+        else if (type == 1)
+        {
+            for (uint32_t i = 0; i < n; i++) x.push_back(reader.ReadSigned(bps));
+        }
+        else if (type >= 8 && type <= 12)
+        {
+            static const int kFixed[5][4] = { {}, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 } };
+            uint32_t order = type - 8;
+            for (uint32_t i = 0; i < order; i++) x.push_back(reader.ReadSigned(bps));
+
+            std::vector<int32_t> residual;
+            ReadResidual(reader, n, order, residual);
+            for (int32_t e : residual)
+            {
+                int64_t prediction = 0;
+                for (uint32_t j = 0; j < order; j++) prediction += (int64_t)kFixed[order][j] * x[x.size() - 1 - j];
+                x.push_back((int32_t)(e + prediction));
+            }
+        }
+        else
+        {
+            CHECK(type >= 32);
+            uint32_t order = type - 31;
+            for (uint32_t i = 0; i < order; i++) x.push_back(reader.ReadSigned(bps));
+
+            int precision = (int)reader.Read(4) + 1;
+            int shift = reader.ReadSigned(5);
+            CHECK(shift >= 0);
+
+            std::vector<int32_t> coefs;
+            for (uint32_t i = 0; i < order; i++) coefs.push_back(reader.ReadSigned(precision));
+
+            std::vector<int32_t> residual;
+            ReadResidual(reader, n, order, residual);
+            for (int32_t e : residual)
+            {
+                int64_t prediction = 0;
+                for (uint32_t j = 0; j < order; j++) prediction += (int64_t)coefs[j] * x[x.size() - 1 - j];
+                x.push_back((int32_t)(e + (prediction >> shift)));
+            }
+        }
+
+        CHECK_EQ(n, x.size());
+        return x;
+    }
+
+    // Checks the framing (sync, CRCs, frame numbers, seek table) and decodes
+    // the samples.
+    Stream Decode(const std::vector<uint8_t>& data)
+    {
+        Stream stream;
+        CHECK(data.size() >= 4 && std::memcmp(data.data(), "fLaC", 4) == 0);
+
+        size_t pos = 4;
+        bool last = false;
+        bool streamInfo = false;
+
+        while (!last)
+        {
+            CHECK(pos + 4 <= data.size());
+            last = (data[pos] & 0x80) != 0;
+            uint32_t type = data[pos] & 0x7F;
+            size_t length = (size_t)ReadBE(&data[pos + 1], 3);
+            const uint8_t* body = &data[pos + 4];
+            CHECK(pos + 4 + length <= data.size());
+
+            if (type == 0)
+            {
+                CHECK_EQ(34u, length);
+                streamInfo = true;
+                stream.minBlock = (uint32_t)ReadBE(body, 2);
+                stream.maxBlock = (uint32_t)ReadBE(body + 2, 2);
+                stream.minFrame = (uint32_t)ReadBE(body + 4, 3);
+                stream.maxFrame = (uint32_t)ReadBE(body + 7, 3);
+                uint64_t packed = ReadBE(body + 10, 8);
+                stream.sampleRate = (uint32_t)(packed >> 44);
+                stream.channels = (uint32_t)((packed >> 41) & 7) + 1;
+                stream.bitsPerSample = (uint32_t)((packed >> 36) & 31) + 1;
+                stream.totalSamples = packed & 0xFFFFFFFFFull;
+                std::memcpy(stream.md5, body + 18, 16);
+            }
+            else if (type == 3)
+            {
+                CHECK_EQ(0u, length % 18);
+                for (size_t i = 0; i < length; i += 18)
+                {
+                    uint64_t sample = ReadBE(body + i, 8);
+                    if (sample == UINT64_MAX) continue;    // placeholder
+                    stream.seekSamples.push_back(sample);
+                    stream.seekOffsets.push_back(ReadBE(body + i + 8, 8));
+                }
+            }
+
+            pos += 4 + length;
+        }
+
+        CHECK(streamInfo);
+        CHECK_EQ(16u, stream.bitsPerSample);
+
+        const size_t firstFrame = pos;
+        std::vector<uint64_t> frameOffsets;
+
+        while (pos < data.size())
+        {
+            const size_t start = pos;
+            BitReader reader(data, pos);
+
+            CHECK_EQ(0xFFF8u, reader.Read(16));    // sync, fixed block size
+            uint32_t blockSizeCode = reader.Read(4);
+            reader.Read(4);
+            uint32_t assignment = reader.Read(4);
+            CHECK_EQ(4u, reader.Read(3));
+            CHECK_EQ(0u, reader.Read(1));
+
+            uint32_t lead = reader.Read(8);
+            uint64_t frameNumber = lead;
+            if (lead & 0x80)
+            {
+                int extra = 0;
+                while (lead & (0x40 >> extra)) extra++;
+                frameNumber = lead & ((1u << (6 - extra)) - 1);
+                for (int i = 0; i < extra; i++) frameNumber = (frameNumber << 6) | (reader.Read(8) & 0x3F);
+            }
+            CHECK_EQ(stream.frames, frameNumber);
+
+            uint32_t n = 0;
+            if (blockSizeCode == 1) n = 192;
+            else if (blockSizeCode >= 2 && blockSizeCode <= 5) n = 576u << (blockSizeCode - 2);
+            else if (blockSizeCode == 6) n = reader.Read(8) + 1;
+            else if (blockSizeCode == 7) n = reader.Read(16) + 1;
+            else if (blockSizeCode >= 8) n = 256u << (blockSizeCode - 8);
+            CHECK(n > 0 && n <= stream.maxBlock);
+
+            size_t headerEnd = reader.Byte();
+            CHECK_EQ(Crc8(&data[start], headerEnd - start), reader.Read(8));
+
+            std::vector<std::vector<int32_t>> channels;
+            for (uint32_t c = 0; c < stream.channels; c++)
+            {
+                // Side channels carry one more bit
+                bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+                channels.push_back(ReadSubframe(reader, n, 16 + (side ? 1 : 0)));
+            }
+
+            reader.Align();
+            size_t end = reader.Byte();
+            CHECK(end + 2 <= data.size());
+            CHECK_EQ(Crc16(&data[start], end - start), (uint16_t)ReadBE(&data[end], 2));
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                if (assignment == 8) channels[1][i] = channels[0][i] - channels[1][i];
+                else if (assignment == 9) channels[0][i] = channels[0][i] + channels[1][i];
+                else if (assignment == 10)
+                {
+                    int32_t mid = (channels[0][i] * 2) | (channels[1][i] & 1);
+                    int32_t side = channels[1][i];
+                    channels[0][i] = (mid + side) >> 1;
+                    channels[1][i] = (mid - side) >> 1;
+                }
+
+                for (uint32_t c = 0; c < stream.channels; c++) stream.pcm.push_back((int16_t)channels[c][i]);
+            }
+
+            frameOffsets.push_back(start - firstFrame);
+            uint32_t frameBytes = (uint32_t)(end + 2 - start);
+            if (stream.maxFrame)
+            {
+                CHECK(frameBytes >= stream.minFrame && frameBytes <= stream.maxFrame);
+            }
+
+            stream.frames++;
+            pos = end + 2;
+        }
+
+        for (size_t i = 0; i < stream.seekSamples.size(); i++)
+        {
+            CHECK_EQ(0u, stream.seekSamples[i] % stream.minBlock);
+            uint64_t frame = stream.seekSamples[i] / stream.minBlock;
+            CHECK(frame < frameOffsets.size());
+            CHECK_EQ(frameOffsets[frame], stream.seekOffsets[i]);
+        }
+
+        return stream;
+    }
+
+    std::vector<int16_t> TestSignal(size_t frames, uint32_t channels, uint32_t sampleRate)
+    {
+        std::mt19937 rng(1);
+        std::normal_distribution<double> noise(0, 300);
+        std::vector<int16_t> pcm(frames * channels);
+        const double pi = std::acos(-1.0);
+
+        for (size_t i = 0; i < frames; i++)
+        {
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                double t = (double)i / sampleRate;
+                double v = 8000 * std::sin(2 * pi * 440 * t * (1 + c * 0.01)) + 3000 * std::sin(2 * pi * 3100 * t) + noise(rng);
+
+                // Silence (constant subframes) and full scale noise (verbatim)
+                if (i > frames / 3 && i < frames / 3 + 5000) v = 0;
+                if (i > frames / 2 && i < frames / 2 + 3000) v = (double)(int)(rng() % 65536) - 32768;
+
+                pcm[i * channels + c] = (int16_t)std::max(-32768.0, std::min(32767.0, v));
+            }
+        }
+        return pcm;
+    }
+
+    std::vector<uint8_t> Encode(const std::vector<int16_t>& pcm, const FlacEncoder::Options& options)
+    {
+        std::vector<uint8_t> out;
+        uint64_t nextOffset = 0;
+
+        FlacEncoder encoder;
+        bool opened = encoder.Open(options, [&out, &nextOffset, &options](uint64_t offset, const uint8_t* data, size_t size) {
+            // Streams only ever append
+            if (!options.seekable) CHECK_EQ(nextOffset, offset);
+            nextOffset = offset + size;
+
+            if (out.size() < offset + size) out.resize((size_t)(offset + size));
+            std::memcpy(out.data() + offset, data, size);
+            return true;
+        });
+        CHECK(opened);
+
+        // Uneven chunks, as delivered by a capture device
+        const size_t frames = pcm.size() / options.numChannels;
+        std::mt19937 rng(5);
+        size_t pos = 0;
+
+        while (pos < frames)
+        {
+            size_t n = std::min<size_t>(frames - pos, 100 + rng() % 2000);
+            CHECK(encoder.Encode(pcm.data() + pos * options.numChannels, n));
+            pos += n;
+        }
+
+        CHECK(encoder.Finish());
+        CHECK_EQ(frames, encoder.FramesIn());
+        CHECK_EQ(out.size(), encoder.BytesWritten());
+        return out;
+    }
+
+    void Md5KnownDigest()
+    {
+        const uint8_t expected[16] = {
+            0x90, 0x01, 0x50, 0x98, 0x3c, 0xd2, 0x4f, 0xb0, 0xd6, 0x96, 0x3f, 0x7d, 0x28, 0xe1, 0x7f, 0x72 };
+
+        Md5 md5;
+        md5.Update(reinterpret_cast<const uint8_t*>("a"), 1);
+        md5.Update(reinterpret_cast<const uint8_t*>("bc"), 2);
+        uint8_t digest[16];
+        md5.Final(digest);
+        CHECK(std::memcmp(expected, digest, 16) == 0);
+    }
+
+    void RoundTrip(uint32_t channels, uint32_t sampleRate, int level, int threads)
+    {
+        std::printf("  %u channels, %u Hz, level %d, %d threads\n", channels, sampleRate, level, threads);
+
+        const size_t frames = sampleRate * 2 + 123;
+        std::vector<int16_t> pcm = TestSignal(frames, channels, sampleRate);
+
+        FlacEncoder::Options options;
+        options.sampleRate = sampleRate;
+        options.numChannels = channels;
+        options.compressionLevel = level;
+        options.threads = threads;
+
+        Stream stream = Decode(Encode(pcm, options));
+
+        CHECK_EQ(sampleRate, stream.sampleRate);
+        CHECK_EQ(channels, stream.channels);
+        CHECK_EQ(frames, stream.totalSamples);
+        CHECK_EQ(stream.minBlock, stream.maxBlock);
+        CHECK_EQ((frames + stream.minBlock - 1) / stream.minBlock, stream.frames);
+        CHECK(!stream.seekSamples.empty());
+        CHECK(stream.pcm == pcm);
+
+        uint8_t digest[16];
+        Md5 md5;
+        md5.Update(reinterpret_cast<const uint8_t*>(pcm.data()), pcm.size() * sizeof(int16_t));
+        md5.Final(digest);
+        CHECK(std::memcmp(stream.md5, digest, 16) == 0);
+    }
+
+    void RoundTrips()
+    {
+        for (int level = 0; level <= 8; level++) RoundTrip(2, 44100, level, level % 2 ? 2 : 0);
+        for (uint32_t channels = 1; channels <= 8; channels++) RoundTrip(channels, 48000, 5, 0);
+        for (uint32_t sampleRate : { 11025u, 22050u, 32000u, 96000u }) RoundTrip(1, sampleRate, 5, 0);
+        // Sample rate without a frame header code
+        RoundTrip(3, 37800, 5, 2);
+    }
+
+    void ThreadsDoNotChangeTheOutput()
+    {
+        std::vector<int16_t> pcm = TestSignal(100000, 2, 44100);
+
+        FlacEncoder::Options options;
+        options.threads = 0;
+        std::vector<uint8_t> single = Encode(pcm, options);
+
+        options.threads = 4;
+        CHECK(single == Encode(pcm, options));
+    }
+
+    void StreamingHasNoRewrite()
+    {
+        std::vector<int16_t> pcm = TestSignal(50000, 2, 16000);
+
+        FlacEncoder::Options options;
+        options.sampleRate = 16000;
+        options.seekable = false;
+
+        Stream stream = Decode(Encode(pcm, options));
+
+        // Unknown while streaming
+        CHECK_EQ(0u, stream.totalSamples);
+        CHECK(stream.seekSamples.empty());
+        CHECK(stream.pcm == pcm);
+    }
+}
+
+int main()
+{
+    RUN_TEST(Md5KnownDigest);
+    RUN_TEST(RoundTrips);
+    RUN_TEST(ThreadsDoNotChangeTheOutput);
+    RUN_TEST(StreamingHasNoRewrite);
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fmedia_control.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // What the stub fmedia saw and how it behaves, outlives the host.
+    struct StubState
+    {
+        std::wstring pipeName;
+        std::vector<std::wstring> arguments;
+        std::vector<std::string> commands;
+
+        bool running = false;
+        bool connected = false;
+        int launches = 0;
+        int closes = 0;
+        int kills = 0;
+        std::vector<uint32_t> waitTimeouts;
+
+        // Behavior
+        bool launchFails = false;
+        bool ignoresQuit = false;   // hung instance
+        int refusedConnects = 0;    // pipe not reachable for the next n connects
+        int droppedWrites = 0;      // connection closed under the next n writes
+    };
+
+    // In-process stand-in for the fmedia process and its command pipe.
+    class StubFmedia : public FmediaHost
+    {
+    public:
+        explicit StubFmedia(std::shared_ptr<StubState> state) : m_state(std::move(state)) {}
+
+        bool Launch(const std::wstring& pipeName, const std::vector<std::wstring>& arguments) override
+        {
+            if (m_state->launchFails) return false;
+
+            m_state->pipeName = pipeName;
+            m_state->arguments = arguments;
+            m_state->running = true;
+            m_state->launches++;
+            return true;
+        }
+
+        bool Connect(const std::wstring& pipeName, uint32_t timeoutMs) override
+        {
+            CHECK(pipeName == m_state->pipeName);
+            CHECK_EQ(FmediaControl::kConnectTimeoutMs, timeoutMs);
+            CHECK(!m_state->connected);
+
+            if (!m_state->running) return false;
+            if (m_state->refusedConnects > 0)
+            {
+                m_state->refusedConnects--;
+                return false;
+            }
+
+            m_state->connected = true;
+            return true;
+        }
+
+        bool Write(const std::string& command) override
+        {
+            CHECK(m_state->connected);
+
+            if (m_state->droppedWrites > 0)
+            {
+                m_state->droppedWrites--;
+                return false;
+            }
+
+            m_state->commands.push_back(command);
+            if (command == "quit" && !m_state->ignoresQuit) m_state->running = false;
+            return true;
+        }
+
+        void Disconnect() override
+        {
+            m_state->connected = false;
+        }
+
+        bool WaitExit(uint32_t timeoutMs) override
+        {
+            m_state->waitTimeouts.push_back(timeoutMs);
+            return !m_state->running;
+        }
+
+        void Kill() override
+        {
+            m_state->kills++;
+            m_state->running = false;
+        }
+
+        void Close() override
+        {
+            m_state->closes++;
+        }
+
+    private:
+        std::shared_ptr<StubState> m_state;
+    };
+
+    struct Fixture
+    {
+        std::shared_ptr<StubState> state = std::make_shared<StubState>();
+        std::unique_ptr<FmediaControl> control = std::make_unique<FmediaControl>(std::make_unique<StubFmedia>(state));
+
+        void Start()
+        {
+            CHECK(control->Start(L"record-1", { L"--record", L"--out=a.m4a" }));
+        }
+    };
+
+    void SendsCommandsOnePerConnection()
+    {
+        Fixture f;
+        CHECK(!f.control->IsRunning());
+        f.Start();
+
+        CHECK(f.control->IsRunning());
+        CHECK(f.state->pipeName == L"record-1");
+        CHECK_EQ(2u, f.state->arguments.size());
+
+        CHECK(f.control->Send("pause"));
+        CHECK(f.control->Send("unpause"));
+        CHECK(!f.state->connected);
+
+        CHECK(f.state->commands == std::vector<std::string>({ "pause", "unpause" }));
+        CHECK_EQ(2u, f.control->Commands());
+        CHECK_EQ(0u, f.control->Failures());
+        CHECK(f.control->LastCommandUs() >= 0);
+    }
+
+    void RetriesADroppedWrite()
+    {
+        Fixture f;
+        f.Start();
+
+        f.state->droppedWrites = 1;
+        CHECK(f.control->Send("pause"));
+        CHECK(f.state->commands == std::vector<std::string>({ "pause" }));
+        CHECK_EQ(1u, f.control->Commands());
+        CHECK_EQ(0u, f.control->Failures());
+
+        // Once only
+        f.state->droppedWrites = 2;
+        CHECK(!f.control->Send("unpause"));
+        CHECK_EQ(2u, f.control->Commands());
+        CHECK_EQ(1u, f.control->Failures());
+    }
+
+    void CountsUnreachablePipes()
+    {
+        Fixture f;
+        CHECK(!f.control->Send("pause"));
+        CHECK_EQ(0u, f.control->Commands());
+
+        f.Start();
+        f.state->refusedConnects = 1;
+        CHECK(!f.control->Send("pause"));
+        CHECK(f.state->commands.empty());
+        CHECK_EQ(1u, f.control->Failures());
+    }
+
+    void LaunchFailure()
+    {
+        Fixture f;
+        f.state->launchFails = true;
+        CHECK(!f.control->Start(L"record-1", {}));
+        CHECK(!f.control->IsRunning());
+        CHECK(!f.control->Send("pause"));
+    }
+
+    void ShutdownStopsThenQuits()
+    {
+        Fixture f;
+        f.Start();
+
+        CHECK(f.control->Shutdown(1234));
+        CHECK(!f.control->IsRunning());
+        CHECK(f.state->commands == std::vector<std::string>({ "stop", "quit" }));
+        CHECK(f.state->waitTimeouts == std::vector<uint32_t>({ 1234 }));
+        CHECK_EQ(0, f.state->kills);
+        CHECK_EQ(1, f.state->closes);
+
+        // Already down
+        CHECK(f.control->Shutdown(1234));
+        CHECK_EQ(1, f.state->closes);
+    }
+
+    void KillsAHungInstance()
+    {
+        Fixture f;
+        f.Start();
+
+        f.state->ignoresQuit = true;
+        CHECK(!f.control->Shutdown(10));
+        CHECK_EQ(1, f.state->kills);
+        CHECK_EQ(1, f.state->closes);
+        CHECK(!f.control->IsRunning());
+    }
+
+    void KillsAnUnreachableInstance()
+    {
+        Fixture f;
+        f.Start();
+
+        f.state->refusedConnects = 100;
+        CHECK(!f.control->Shutdown(10));
+        // Not waited on, it never got the stop
+        CHECK(f.state->waitTimeouts.empty());
+        CHECK_EQ(1, f.state->kills);
+    }
+
+    void RestartAndDestructionFinalize()
+    {
+        Fixture f;
+        f.Start();
+
+        // The previous recording gets the full finalization time
+        f.Start();
+        CHECK_EQ(2, f.state->launches);
+        CHECK(f.state->waitTimeouts == std::vector<uint32_t>({ FmediaControl::kExitTimeoutMs }));
+
+        f.control.reset();
+        CHECK(f.state->waitTimeouts == std::vector<uint32_t>({ FmediaControl::kExitTimeoutMs, FmediaControl::kExitTimeoutMs }));
+        CHECK_EQ(0, f.state->kills);
+        CHECK_EQ(2, f.state->closes);
+    }
+}
+
+int main()
+{
+    RUN_TEST(SendsCommandsOnePerConnection);
+    RUN_TEST(RetriesADroppedWrite);
+    RUN_TEST(CountsUnreachablePipes);
+    RUN_TEST(LaunchFailure);
+    RUN_TEST(ShutdownStopsThenQuits);
+    RUN_TEST(KillsAHungInstance);
+    RUN_TEST(KillsAnUnreachableInstance);
+    RUN_TEST(RestartAndDestructionFinalize);
+    return 0;
+}
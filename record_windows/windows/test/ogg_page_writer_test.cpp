@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ogg_page_writer.h"
+#include "ogg_test_support.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    std::vector<uint8_t> Packet(size_t size, uint8_t seed)
+    {
+        std::vector<uint8_t> packet(size);
+        for (size_t i = 0; i < size; i++) packet[i] = (uint8_t)(seed + i * 7);
+        return packet;
+    }
+
+    void CrcMatchesReference()
+    {
+        const uint8_t data[] = "The quick brown fox jumps over the lazy dog";
+        CHECK_EQ(ogg_test::Crc(data, sizeof(data) - 1), OggPageWriter::Crc(data, sizeof(data) - 1));
+    }
+
+    void PacketsSurviveLacing()
+    {
+        std::vector<uint8_t> stream;
+        OggPageWriter writer;
+        writer.Reset(7, [&stream](const uint8_t* page, size_t size) {
+            stream.insert(stream.end(), page, page + size);
+            return true;
+        });
+
+        // Empty, exact multiples of 255 (need a terminating 0 lacing value),
+        // and one spanning several pages
+        std::vector<std::vector<uint8_t>> packets = {
+            Packet(10, 1), Packet(0, 2), Packet(255, 3), Packet(510, 4), Packet(150000, 5), Packet(255 * 3, 6), Packet(1, 7) };
+
+        CHECK(writer.AddPacket(packets[0].data(), packets[0].size(), 100));
+        CHECK(writer.Flush());
+        // Nothing pending, no page
+        CHECK(writer.Flush());
+        CHECK_EQ(1u, writer.PagesWritten());
+
+        for (size_t i = 1; i < packets.size(); i++)
+        {
+            CHECK(writer.AddPacket(packets[i].data(), packets[i].size(), 100 + (int64_t)i));
+        }
+        CHECK(writer.Flush(true));
+        CHECK(!writer.AddPacket(packets[0].data(), packets[0].size(), 200));
+
+        std::vector<ogg_test::Page> pages;
+        std::vector<std::vector<uint8_t>> parsed = ogg_test::Parse(stream, 7, pages);
+
+        CHECK_EQ(writer.PagesWritten(), pages.size());
+        CHECK_EQ(writer.BytesWritten(), stream.size());
+        CHECK(parsed == packets);
+
+        CHECK(pages.front().bos);
+        CHECK(pages.back().eos);
+        CHECK_EQ(100, pages.front().granule);
+        CHECK_EQ(106, pages.back().granule);
+
+        // The 150000 bytes packet fills a whole page ending no packet
+        bool continuedWithoutEnd = false;
+        for (const auto& page : pages)
+        {
+            if (page.continued && page.granule == -1) continuedWithoutEnd = true;
+        }
+        CHECK(continuedWithoutEnd);
+    }
+
+    void EosPageCanBeEmpty()
+    {
+        std::vector<uint8_t> stream;
+        OggPageWriter writer;
+        writer.Reset(9, [&stream](const uint8_t* page, size_t size) {
+            stream.insert(stream.end(), page, page + size);
+            return true;
+        });
+
+        std::vector<uint8_t> packet = Packet(20, 1);
+        CHECK(writer.AddPacket(packet.data(), packet.size(), 960));
+        CHECK(writer.Flush());
+        CHECK(writer.Flush(true));
+        CHECK(!writer.Flush(true));
+
+        std::vector<ogg_test::Page> pages;
+        ogg_test::Parse(stream, 9, pages);
+        CHECK_EQ(2u, pages.size());
+        CHECK_EQ(0u, pages[1].segments);
+        CHECK(pages[1].eos);
+    }
+
+    void CallbackFailureAborts()
+    {
+        OggPageWriter writer;
+        writer.Reset(1, [](const uint8_t*, size_t) { return false; });
+
+        std::vector<uint8_t> packet = Packet(100, 1);
+        CHECK(writer.AddPacket(packet.data(), packet.size(), 1));
+        CHECK(!writer.Flush());
+    }
+}
+
+int main()
+{
+    RUN_TEST(CrcMatchesReference);
+    RUN_TEST(PacketsSurviveLacing);
+    RUN_TEST(EosPageCanBeEmpty);
+    RUN_TEST(CallbackFailureAborts);
+    return 0;
+}
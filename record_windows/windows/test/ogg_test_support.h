@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "test_support.h"
+
+// Independent Ogg (RFC 3533) parser for the page writer and Opus tests.
+namespace ogg_test
+{
+    struct Page
+    {
+        bool continued = false;
+        bool bos = false;
+        bool eos = false;
+        int64_t granule = 0;
+        uint32_t sequence = 0;
+        size_t segments = 0;
+    };
+
+    // CRC-32, polynomial 0x04c11db7, bitwise on purpose (the writer uses a table)
+    inline uint32_t Crc(const uint8_t* data, size_t size)
+    {
+        uint32_t crc = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc ^= (uint32_t)data[i] << 24;
+            for (int bit = 0; bit < 8; bit++) crc = crc & 0x80000000u ? (crc << 1) ^ 0x04c11db7u : crc << 1;
+        }
+        return crc;
+    }
+
+    inline uint64_t ReadLE(const uint8_t* p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+        return value;
+    }
+
+    // Checks every page header and CRC, returns the reassembled packets.
+    inline std::vector<std::vector<uint8_t>> Parse(const std::vector<uint8_t>& stream, uint32_t serial, std::vector<Page>& pages)
+    {
+        std::vector<std::vector<uint8_t>> packets;
+        std::vector<uint8_t> packet;
+        bool open = false;  // packet continues on the next page
+        size_t pos = 0;
+
+        while (pos < stream.size())
+        {
+            CHECK(pos + 27 <= stream.size());
+            const uint8_t* header = &stream[pos];
+            CHECK(std::memcmp(header, "OggS", 4) == 0);
+            CHECK_EQ(0, header[4]);
+            CHECK_EQ(0, header[5] & ~0x07);
+
+            Page page;
+            page.continued = (header[5] & 0x01) != 0;
+            page.bos = (header[5] & 0x02) != 0;
+            page.eos = (header[5] & 0x04) != 0;
+            page.granule = (int64_t)ReadLE(header + 6, 8);
+            page.sequence = (uint32_t)ReadLE(header + 18, 4);
+            page.segments = header[26];
+
+            CHECK_EQ(serial, (uint32_t)ReadLE(header + 14, 4));
+            CHECK_EQ(pages.size(), page.sequence);
+            CHECK_EQ(pages.empty(), page.bos);
+            CHECK_EQ(open, page.continued);
+            CHECK(pages.empty() || !pages.back().eos);
+
+            size_t bodySize = 0;
+            CHECK(pos + 27 + page.segments <= stream.size());
+            for (size_t i = 0; i < page.segments; i++) bodySize += header[27 + i];
+
+            const size_t pageSize = 27 + page.segments + bodySize;
+            CHECK(pos + pageSize <= stream.size());
+
+            std::vector<uint8_t> copy(stream.begin() + pos, stream.begin() + pos + pageSize);
+            std::memset(copy.data() + 22, 0, 4);
+            CHECK_EQ((uint32_t)ReadLE(header + 22, 4), Crc(copy.data(), copy.size()));
+
+            // A page ending no packet has no granule
+            bool ended = false;
+            const uint8_t* body = header + 27 + page.segments;
+
+            for (size_t i = 0; i < page.segments; i++)
+            {
+                uint8_t lacing = header[27 + i];
+                packet.insert(packet.end(), body, body + lacing);
+                body += lacing;
+
+                if (lacing < 255)
+                {
+                    packets.push_back(std::move(packet));
+                    packet.clear();
+                    ended = true;
+                }
+            }
+
+            open = page.segments > 0 && header[27 + page.segments - 1] == 255;
+            if (!ended) CHECK_EQ(-1, page.granule);
+
+            pages.push_back(page);
+            pos += pageSize;
+        }
+
+        CHECK(!open);
+        return packets;
+    }
+}
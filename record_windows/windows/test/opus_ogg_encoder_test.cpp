@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ogg_test_support.h"
+#include "opus_ogg_encoder.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    constexpr uint64_t kGranuleRate = 48000;
+
+    struct Encoded
+    {
+        std::vector<ogg_test::Page> pages;
+        std::vector<std::vector<uint8_t>> packets;
+        uint64_t framesIn = 0;
+    };
+
+    Encoded EncodeTone(const OpusOggEncoder::Options& options, size_t frames)
+    {
+        std::vector<uint8_t> stream;
+        OpusOggEncoder encoder;
+
+        bool opened = encoder.Open(options, [&stream](const uint8_t* page, size_t size) {
+            stream.insert(stream.end(), page, page + size);
+            return true;
+        });
+        CHECK(opened);
+
+        std::vector<int16_t> pcm(frames * options.numChannels);
+        for (size_t i = 0; i < pcm.size(); i++) pcm[i] = (int16_t)((i * 37) % 20000 - 10000);
+
+        // Chunks not aligned on the Opus frame size
+        size_t pos = 0;
+        while (pos < frames)
+        {
+            size_t n = std::min<size_t>(frames - pos, 777);
+            CHECK(encoder.Encode(pcm.data() + pos * options.numChannels, n));
+            pos += n;
+        }
+        CHECK(encoder.Finish());
+        CHECK(!encoder.Encode(pcm.data(), 1));
+
+        Encoded encoded;
+        encoded.framesIn = encoder.FramesIn();
+        encoded.packets = ogg_test::Parse(stream, options.serial, encoded.pages);
+        return encoded;
+    }
+
+    // RFC 7845: header pages, then granules in 48 kHz units ending at the
+    // last input sample plus pre-skip.
+    void CheckStream(const Encoded& encoded, const OpusOggEncoder::Options& options)
+    {
+        CHECK(encoded.pages.size() >= 3);
+        CHECK(encoded.packets.size() >= 3);
+
+        const std::vector<uint8_t>& head = encoded.packets[0];
+        CHECK_EQ(19u, head.size());
+        CHECK(std::memcmp(head.data(), "OpusHead", 8) == 0);
+        CHECK_EQ(1, head[8]);
+        CHECK_EQ(options.numChannels, head[9]);
+        const uint64_t preSkip = ogg_test::ReadLE(&head[10], 2);
+        CHECK_EQ(options.sampleRate, (uint32_t)ogg_test::ReadLE(&head[12], 4));
+
+        CHECK(std::memcmp(encoded.packets[1].data(), "OpusTags", 8) == 0);
+
+        // Each header alone on its page, granule 0
+        CHECK_EQ(1u, encoded.pages[0].segments);
+        CHECK_EQ(0, encoded.pages[0].granule);
+        CHECK_EQ(0, encoded.pages[1].granule);
+        CHECK(!encoded.pages[2].continued);
+
+        const uint64_t scale = kGranuleRate / options.sampleRate;
+        const uint64_t frameGranules = (uint64_t)options.frameMs * kGranuleRate / 1000;
+        const uint64_t endGranule = encoded.framesIn * scale + preSkip;
+        CHECK_EQ((endGranule + frameGranules - 1) / frameGranules, encoded.packets.size() - 2);
+
+        int64_t previous = 0;
+        for (size_t i = 2; i < encoded.pages.size(); i++)
+        {
+            CHECK(encoded.pages[i].granule > previous);
+            previous = encoded.pages[i].granule;
+        }
+
+        CHECK(encoded.pages.back().eos);
+        CHECK_EQ(endGranule, (uint64_t)encoded.pages.back().granule);
+    }
+
+    void StreamsOnePacketPerPage()
+    {
+        OpusOggEncoder::Options options;
+        options.sampleRate = 16000;
+        options.numChannels = 1;
+        options.pageMs = 0;
+        options.serial = 1234;
+
+        Encoded encoded = EncodeTone(options, 16000 + 123);
+        CheckStream(encoded, options);
+        CHECK_EQ(encoded.packets.size(), encoded.pages.size());
+    }
+
+    void GroupsPacketsByDuration()
+    {
+        OpusOggEncoder::Options options;
+        options.sampleRate = 48000;
+        options.numChannels = 2;
+        options.pageMs = 1000;
+        options.serial = 99;
+
+        Encoded encoded = EncodeTone(options, 48000 * 5 + 1);
+        CheckStream(encoded, options);
+
+        // Every audio page but the last one covers at least pageMs
+        for (size_t i = 2; i + 1 < encoded.pages.size(); i++)
+        {
+            int64_t previous = i == 2 ? 0 : encoded.pages[i - 1].granule;
+            CHECK(encoded.pages[i].granule - previous >= 48000);
+        }
+    }
+
+    void RejectsUnsupportedFormats()
+    {
+        CHECK(OpusOggEncoder::Available());
+        CHECK_EQ(48000u, OpusOggEncoder::SupportedSampleRate(44100));
+
+        OpusOggEncoder encoder;
+        OpusOggEncoder::Options options;
+        options.sampleRate = 44100;
+        CHECK(!encoder.Open(options, nullptr));
+        CHECK(encoder.LastError() < 0);
+
+        options.sampleRate = 48000;
+        options.numChannels = 3;
+        CHECK(!encoder.Open(options, nullptr));
+    }
+}
+
+int main()
+{
+    RUN_TEST(StreamsOnePacketPerPage);
+    RUN_TEST(GroupsPacketsByDuration);
+    RUN_TEST(RejectsUnsupportedFormats);
+    return 0;
+}
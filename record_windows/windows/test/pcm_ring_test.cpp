@@ -0,0 +1,120 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "pcm_ring.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // Byte at absolute position p holds (uint8_t)p, any copy is checkable.
+    void WritePattern(PcmRing& ring, uint64_t& position, size_t size)
+    {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(position + i);
+        ring.Write(data.data(), size);
+        position += size;
+    }
+
+    bool MatchesPattern(const uint8_t* data, uint64_t from, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (data[i] != (uint8_t)(from + i)) return false;
+        }
+        return true;
+    }
+
+    void ResetRoundsToFrames()
+    {
+        PcmRing ring;
+        ring.Reset(4001, 4);
+        CHECK_EQ(4000u, ring.Capacity());
+        CHECK_EQ(0u, ring.Written());
+        CHECK_EQ(0u, ring.Size());
+    }
+
+    void KeepsTheMostRecentBytes()
+    {
+        PcmRing ring;
+        ring.Reset(1000, 1);
+
+        uint64_t position = 0;
+        std::vector<uint8_t> out(1000);
+
+        WritePattern(ring, position, 600);
+        CHECK_EQ(600u, ring.Size());
+        CHECK(ring.Read(0, out.data(), 600));
+        CHECK(MatchesPattern(out.data(), 0, 600));
+
+        // Wraps, the first 200 bytes are overwritten
+        WritePattern(ring, position, 600);
+        CHECK_EQ(1200u, ring.Written());
+        CHECK_EQ(1000u, ring.Size());
+        CHECK(!ring.Read(0, out.data(), 10));
+        CHECK(!ring.Read(199, out.data(), 10));
+        CHECK(ring.Read(200, out.data(), 1000));
+        CHECK(MatchesPattern(out.data(), 200, 1000));
+
+        // Not written yet, or larger than the ring
+        CHECK(!ring.Read(1100, out.data(), 101));
+        CHECK(!ring.Read(200, out.data(), 1001));
+
+        // Larger than the ring, only the tail survives
+        WritePattern(ring, position, 2500);
+        CHECK_EQ(3700u, ring.Written());
+        CHECK(ring.Read(2700, out.data(), 1000));
+        CHECK(MatchesPattern(out.data(), 2700, 1000));
+    }
+
+    void ReadersNeverSeeTornRanges()
+    {
+        PcmRing ring;
+        ring.Reset(4000, 4);
+
+        std::atomic<bool> done{ false };
+        std::thread writer([&ring, &done]() {
+            uint64_t position = 0;
+            for (int i = 0; i < 200000; i++) WritePattern(ring, position, 300);
+            done = true;
+        });
+
+        uint64_t accepted = 0;
+        std::vector<uint8_t> out(1000);
+
+        while (!done)
+        {
+            uint64_t written = ring.Written();
+            if (written < 2000) continue;
+
+            // Close to the oldest bytes, often overwritten while copied
+            uint64_t from = written - 3900;
+            if (ring.Read(from, out.data(), out.size()))
+            {
+                CHECK(MatchesPattern(out.data(), from, out.size()));
+                accepted++;
+            }
+
+            from = written - 1500;
+            if (ring.Read(from, out.data(), out.size()))
+            {
+                CHECK(MatchesPattern(out.data(), from, out.size()));
+                accepted++;
+            }
+        }
+
+        writer.join();
+        CHECK(accepted > 0);
+    }
+}
+
+int main()
+{
+    RUN_TEST(ResetRoundsToFrames);
+    RUN_TEST(KeepsTheMostRecentBytes);
+    RUN_TEST(ReadersNeverSeeTornRanges);
+    return 0;
+}
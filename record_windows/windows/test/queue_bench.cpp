@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench_support.h"
+#include "inplace_task.h"
+#include "mpsc_queue.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // Mutex-protected deque of std::function, the usual alternative to the
+    // lock-free queue.
+    class LockedQueue
+    {
+    public:
+        bool TryPush(std::function<void()>&& task)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+            return true;
+        }
+
+        bool TryPop(std::function<void()>& task)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty()) return false;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::deque<std::function<void()>> m_tasks;
+    };
+
+    struct Result
+    {
+        double seconds = 0.0;
+        double p50Us = 0.0;
+        double p99Us = 0.0;
+        double maxUs = 0.0;
+    };
+
+    int64_t NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(bench::Clock::now().time_since_epoch()).count();
+    }
+
+    // producers threads post perProducer tasks each, the consumer runs them
+    // as the dispatcher does. Each task records its queueing latency (post
+    // to run) in a slot sized like a recorder callback capture.
+    template <typename Queue, typename Task>
+    Result Run(Queue& queue, int producers, uint32_t perProducer)
+    {
+        const uint64_t total = (uint64_t)producers * perProducer;
+        std::vector<double> latencies(total);
+        std::atomic<uint64_t> next{ 0 };
+        std::atomic<bool> go{ false };
+        std::vector<std::thread> threads;
+
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&queue, &go, &latencies, &next, perProducer]() {
+                while (!go.load()) std::this_thread::yield();
+
+                for (uint32_t i = 0; i < perProducer; i++)
+                {
+                    double* slot = &latencies[next.fetch_add(1, std::memory_order_relaxed)];
+                    int64_t posted = NowNs();
+
+                    Task task([slot, posted]() { *slot = (double)(NowNs() - posted) / 1000.0; });
+                    while (!queue.TryPush(std::move(task))) std::this_thread::yield();
+                }
+            });
+        }
+
+        auto start = bench::Clock::now();
+        go = true;
+
+        uint64_t ran = 0;
+        Task task;
+
+        while (ran < total)
+        {
+            if (!queue.TryPop(task))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            task();
+            task = Task();
+            ran++;
+        }
+
+        Result result;
+        result.seconds = bench::Seconds(start);
+        for (auto& thread : threads) thread.join();
+
+        result.p50Us = bench::Percentile(latencies, 0.50);
+        result.p99Us = bench::Percentile(latencies, 0.99);
+        result.maxUs = latencies.back();
+        return result;
+    }
+
+    void Print(const char* name, int producers, uint32_t perProducer, const Result& result)
+    {
+        double total = (double)producers * perProducer;
+        std::printf("%-28s %2d producers  %8.2f M tasks/s  latency p50 %8.1f us  p99 %8.1f us  max %9.1f us\n",
+            name, producers, total / result.seconds / 1e6, result.p50Us, result.p99Us, result.maxUs);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = bench::Quick(argc, argv);
+    const uint32_t perProducer = quick ? 5000 : 500000;
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%u hardware threads\n", cpus);
+
+    for (int producers : { 1, 2, 4, 8 })
+    {
+        // Capacity of a recorder dispatch queue
+        MpscQueue<InplaceTask> mpsc(4096);
+        Print("MpscQueue<InplaceTask>", producers, perProducer, Run<MpscQueue<InplaceTask>, InplaceTask>(mpsc, producers, perProducer));
+
+        LockedQueue locked;
+        Print("mutex + std::function", producers, perProducer, Run<LockedQueue, std::function<void()>>(locked, producers, perProducer));
+    }
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "inplace_task.h"
+#include "mpsc_queue.h"
+#include "pipeline_worker.h"
+#include "spsc_ring.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    constexpr int kProducers = 4;
+    constexpr uint32_t kPerProducer = 100000;
+
+    void MpscKeepsOrderPerProducer()
+    {
+        MpscQueue<uint64_t> queue(1000);
+        CHECK_EQ(1024u, queue.Capacity());
+
+        std::atomic<bool> go{ false };
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < kProducers; p++)
+        {
+            producers.emplace_back([&queue, &go, p]() {
+                while (!go.load()) std::this_thread::yield();
+
+                for (uint32_t i = 0; i < kPerProducer; i++)
+                {
+                    uint64_t item = ((uint64_t)p << 32) | i;
+                    while (!queue.TryPush(std::move(item))) std::this_thread::yield();
+                }
+            });
+        }
+
+        go = true;
+
+        std::vector<uint32_t> next(kProducers, 0);
+        uint64_t received = 0;
+        uint64_t item;
+
+        while (received < (uint64_t)kProducers * kPerProducer)
+        {
+            if (!queue.TryPop(item))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint32_t producer = (uint32_t)(item >> 32);
+            CHECK(producer < (uint32_t)kProducers);
+            CHECK_EQ(next[producer], (uint32_t)item);
+            next[producer]++;
+            received++;
+        }
+
+        for (auto& producer : producers) producer.join();
+        CHECK(!queue.TryPop(item));
+    }
+
+    void MpscRejectsWhenFull()
+    {
+        MpscQueue<int> queue(4);
+        for (int i = 0; i < 4; i++)
+        {
+            int item = i;
+            CHECK(queue.TryPush(std::move(item)));
+        }
+
+        int extra = 42;
+        CHECK(!queue.TryPush(std::move(extra)));
+        CHECK_EQ(42, extra);
+
+        int item;
+        CHECK(queue.TryPop(item));
+        CHECK_EQ(0, item);
+        CHECK(queue.TryPush(std::move(extra)));
+    }
+
+    void MpscRunsAndReleasesTasks()
+    {
+        MpscQueue<InplaceTask> queue(64);
+        auto owned = std::make_shared<int>(0);
+        std::atomic<int> runs{ 0 };
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < kProducers; p++)
+        {
+            producers.emplace_back([&queue, &runs, owned]() {
+                for (int i = 0; i < 1000; i++)
+                {
+                    InplaceTask task([&runs, owned]() { runs++; });
+                    while (!queue.TryPush(std::move(task))) std::this_thread::yield();
+                }
+            });
+        }
+
+        int popped = 0;
+        InplaceTask task;
+
+        while (popped < kProducers * 1000)
+        {
+            if (!queue.TryPop(task))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            task();
+            task.Reset();
+            popped++;
+        }
+
+        for (auto& producer : producers) producer.join();
+        CHECK_EQ(kProducers * 1000, runs.load());
+        // Every capture was destroyed with its task
+        CHECK_EQ(1, owned.use_count());
+    }
+
+    void SpscWrapsAround()
+    {
+        SpscRing<int> ring(3);
+        CHECK_EQ(3u, ring.Capacity());
+
+        int next = 0;
+        int expected = 0;
+        int item;
+
+        for (int round = 0; round < 10; round++)
+        {
+            while (true)
+            {
+                int value = next;
+                if (!ring.TryPush(std::move(value))) break;
+                next++;
+            }
+            CHECK_EQ(3u, ring.Size());
+
+            CHECK(ring.TryPop(item));
+            CHECK_EQ(expected++, item);
+            CHECK(ring.TryPop(item));
+            CHECK_EQ(expected++, item);
+        }
+
+        while (ring.TryPop(item)) CHECK_EQ(expected++, item);
+        CHECK_EQ(next, expected);
+        CHECK(ring.Empty());
+    }
+
+    void SpscAcrossThreads()
+    {
+        SpscRing<uint32_t> ring(256);
+        constexpr uint32_t kItems = 200000;
+
+        std::thread producer([&ring]() {
+            for (uint32_t i = 0; i < kItems; i++)
+            {
+                uint32_t item = i;
+                while (!ring.TryPush(std::move(item))) std::this_thread::yield();
+            }
+        });
+
+        uint32_t expected = 0;
+        uint32_t item;
+
+        while (expected < kItems)
+        {
+            if (!ring.TryPop(item))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            CHECK_EQ(expected, item);
+            expected++;
+        }
+
+        producer.join();
+    }
+
+    void PipelineWorkerDrainsOnStop()
+    {
+        PipelineWorker<int> worker(1024);
+        std::vector<int> seen;
+        std::atomic<int> entered{ 0 };
+        std::atomic<int> exited{ 0 };
+
+        worker.Start(
+            [&seen](int& item) { seen.push_back(item); },
+            [&entered]() { entered++; },
+            [&exited]() { exited++; });
+
+        for (int i = 1; i <= 1000; i++)
+        {
+            int item = i;
+            CHECK(worker.Push(std::move(item)));
+        }
+
+        worker.Stop();
+
+        CHECK(!worker.IsRunning());
+        CHECK_EQ(1, entered.load());
+        CHECK_EQ(1, exited.load());
+        CHECK_EQ(1000u, seen.size());
+        for (int i = 0; i < 1000; i++) CHECK_EQ(i + 1, seen[i]);
+        CHECK_EQ(1000u, worker.Processed());
+        CHECK_EQ(0u, worker.Overruns());
+    }
+
+    // Items queued while the worker is stopped (armed capture) must not
+    // reach the next Start() once cleared.
+    void PipelineWorkerClearDropsQueuedItems()
+    {
+        PipelineWorker<std::shared_ptr<int>> worker(16);
+        auto tracked = std::make_shared<int>(7);
+
+        for (int i = 0; i < 3; i++)
+        {
+            auto item = tracked;
+            CHECK(worker.Push(std::move(item)));
+        }
+        CHECK_EQ(3u, worker.Pending());
+        CHECK_EQ(4, (int)tracked.use_count());
+
+        worker.Clear();
+        CHECK_EQ(0u, worker.Pending());
+        CHECK_EQ(1, (int)tracked.use_count());
+
+        int processed = 0;
+        worker.Start([&processed](std::shared_ptr<int>&) { processed++; });
+        worker.Stop();
+        CHECK_EQ(0, processed);
+    }
+}
+
+int main()
+{
+    RUN_TEST(MpscKeepsOrderPerProducer);
+    RUN_TEST(MpscRejectsWhenFull);
+    RUN_TEST(MpscRunsAndReleasesTasks);
+    RUN_TEST(SpscWrapsAround);
+    RUN_TEST(SpscAcrossThreads);
+    RUN_TEST(PipelineWorkerDrainsOnStop);
+    RUN_TEST(PipelineWorkerClearDropsQueuedItems);
+    return 0;
+}
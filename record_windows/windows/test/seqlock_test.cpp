@@ -0,0 +1,89 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "seqlock.h"
+#include "test_support.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // Every field holds the same value, a torn copy mixes two of them.
+    struct Sample
+    {
+        uint64_t values[37];
+        uint32_t tail;
+    };
+
+    Sample Make(uint64_t value)
+    {
+        Sample sample;
+        for (auto& v : sample.values) v = value;
+        sample.tail = (uint32_t)value;
+        return sample;
+    }
+
+    bool Consistent(const Sample& sample)
+    {
+        for (auto v : sample.values)
+        {
+            if (v != sample.values[0]) return false;
+        }
+        return sample.tail == (uint32_t)sample.values[0];
+    }
+
+    void StoresAndLoads()
+    {
+        Seqlock<Sample> lock(Make(7));
+        CHECK_EQ(1u, lock.Version());
+        CHECK_EQ(7u, lock.Load().values[36]);
+
+        lock.Store(Make(8));
+        CHECK_EQ(2u, lock.Version());
+        CHECK(Consistent(lock.Load()));
+        CHECK_EQ(8u, lock.Load().tail);
+    }
+
+    void ReadersNeverSeeTornValues()
+    {
+        Seqlock<Sample> lock(Make(0));
+        constexpr uint64_t kWrites = 300000;
+
+        std::atomic<bool> done{ false };
+        std::thread writer([&lock, &done]() {
+            for (uint64_t i = 1; i <= kWrites; i++) lock.Store(Make(i));
+            done = true;
+        });
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 2; r++)
+        {
+            readers.emplace_back([&lock, &done]() {
+                uint64_t last = 0;
+                while (!done)
+                {
+                    Sample sample = lock.Load();
+                    CHECK(Consistent(sample));
+                    // Single writer, values only go forward
+                    CHECK(sample.values[0] >= last);
+                    last = sample.values[0];
+                }
+            });
+        }
+
+        writer.join();
+        for (auto& reader : readers) reader.join();
+
+        CHECK_EQ(kWrites, lock.Load().values[0]);
+        CHECK_EQ((uint32_t)(kWrites + 1), lock.Version());
+    }
+}
+
+int main()
+{
+    RUN_TEST(StoresAndLoads);
+    RUN_TEST(ReadersNeverSeeTornValues);
+    return 0;
+}
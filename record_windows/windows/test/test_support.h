@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks for the native tests, no framework needed. A failed check
+// prints its location and ends the test with a non-zero exit code.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) \
+    do \
+    { \
+        auto checkExpected_ = (expected); \
+        auto checkActual_ = (actual); \
+        if (!(checkExpected_ == checkActual_)) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, \
+                #expected, #actual, (long long)checkExpected_, (long long)checkActual_); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+#define RUN_TEST(test) \
+    do \
+    { \
+        std::printf("%s\n", #test); \
+        test(); \
+    } while (0)
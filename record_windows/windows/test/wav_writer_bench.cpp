@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bench_support.h"
+#include "file_backend.h"
+#include "wav_writer.h"
+
+using namespace record_windows;
+
+namespace
+{
+    // 20 ms of 48 kHz stereo 16-bit, as delivered by the capture callback
+    const size_t kChunkBytes = 48000 / 50 * 4;
+
+    std::filesystem::path TempPath()
+    {
+        return std::filesystem::temp_directory_path() / "record_windows_wav_writer_bench.wav";
+    }
+
+    struct Result
+    {
+        double seconds = 0.0;
+        std::vector<double> callUs;     // time spent in each write call
+    };
+
+    template <typename WriteFn>
+    Result Run(uint64_t totalBytes, WriteFn&& write)
+    {
+        std::vector<uint8_t> chunk(kChunkBytes);
+        for (size_t i = 0; i < chunk.size(); i++) chunk[i] = (uint8_t)(i * 7);
+
+        Result result;
+        result.callUs.reserve((size_t)(totalBytes / kChunkBytes));
+
+        for (uint64_t offset = 0; offset < totalBytes; offset += kChunkBytes)
+        {
+            auto call = bench::Clock::now();
+            write(chunk.data(), chunk.size());
+            result.callUs.push_back(bench::Seconds(call) * 1e6);
+        }
+        return result;
+    }
+
+    void Print(const char* name, uint64_t totalBytes, Result& result)
+    {
+        double p50 = bench::Percentile(result.callUs, 0.50);
+        double p99 = bench::Percentile(result.callUs, 0.99);
+
+        std::printf("%-14s %8.1f MB/s  write p50 %6.2f us  p99 %8.2f us  max %9.1f us\n",
+            name, (double)totalBytes / result.seconds / 1e6, p50, p99, result.callUs.back());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool quick = bench::Quick(argc, argv);
+    const uint64_t totalBytes = (quick ? 16ull : 1024ull) << 20;
+    const std::filesystem::path path = TempPath();
+
+    std::printf("%llu MB in %zu bytes chunks to %s\n", (unsigned long long)(totalBytes >> 20), kChunkBytes, path.string().c_str());
+
+    {
+        WavFormat format;
+        format.sampleRate = 48000;
+
+        WavWriter writer(CreateFileBackend());
+        if (!writer.Open(path.wstring(), format))
+        {
+            std::fprintf(stderr, "open failed: %d\n", writer.LastError());
+            return 1;
+        }
+
+        auto start = bench::Clock::now();
+        Result result = Run(totalBytes, [&writer](const uint8_t* data, size_t size) { writer.Write(data, size); });
+        writer.Close();
+        result.seconds = bench::Seconds(start);
+
+        Print("WavWriter", totalBytes, result);
+    }
+
+    {
+        // Baseline: blocking stream writes on the calling thread
+        auto start = bench::Clock::now();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        Result result = Run(totalBytes, [&out](const uint8_t* data, size_t size) {
+            out.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+        });
+        out.close();
+        result.seconds = bench::Seconds(start);
+
+        Print("std::ofstream", totalBytes, result);
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
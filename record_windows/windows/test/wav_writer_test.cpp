@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_backend.h"
+#include "test_support.h"
+#include "wav_writer.h"
+
+using namespace record_windows;
+
+namespace
+{
+    struct ParsedWav
+    {
+        bool valid = false;
+        bool rf64 = false;
+        uint32_t riffBytes = 0;         // 32 bits field
+        uint64_t riff64Bytes = 0;       // ds64, RF64 only
+        uint64_t sampleCount = 0;       // ds64, RF64 only
+        uint16_t formatTag = 0;
+        uint16_t channels = 0;
+        uint32_t sampleRate = 0;
+        uint32_t byteRate = 0;
+        uint16_t blockAlign = 0;
+        uint16_t bitsPerSample = 0;
+        size_t dataOffset = 0;
+        uint32_t dataBytes = 0;         // 32 bits field
+        uint64_t data64Bytes = 0;       // ds64, RF64 only
+    };
+
+    uint16_t GetU16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+    uint32_t GetU32(const uint8_t* p) { return (uint32_t)GetU16(p) | (uint32_t)GetU16(p + 2) << 16; }
+    uint64_t GetU64(const uint8_t* p) { return (uint64_t)GetU32(p) | (uint64_t)GetU32(p + 4) << 32; }
+
+    // Walks the chunks up to "data", independently of the writer's layout.
+    ParsedWav ParseWav(const std::vector<uint8_t>& file)
+    {
+        ParsedWav wav;
+        if (file.size() < 12 || std::memcmp(file.data() + 8, "WAVE", 4) != 0) return wav;
+
+        wav.rf64 = std::memcmp(file.data(), "RF64", 4) == 0;
+        if (!wav.rf64 && std::memcmp(file.data(), "RIFF", 4) != 0) return wav;
+        wav.riffBytes = GetU32(file.data() + 4);
+
+        size_t pos = 12;
+        while (pos + 8 <= file.size())
+        {
+            const uint8_t* chunk = file.data() + pos;
+            uint32_t size = GetU32(chunk + 4);
+            const uint8_t* body = chunk + 8;
+
+            if (std::memcmp(chunk, "data", 4) == 0)
+            {
+                wav.dataOffset = pos + 8;
+                wav.dataBytes = size;
+                wav.valid = wav.blockAlign != 0;
+                return wav;
+            }
+            if (pos + 8 + size > file.size()) return wav;
+
+            if (std::memcmp(chunk, "ds64", 4) == 0 && size >= 24)
+            {
+                wav.riff64Bytes = GetU64(body);
+                wav.data64Bytes = GetU64(body + 8);
+                wav.sampleCount = GetU64(body + 16);
+            }
+            else if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+            {
+                wav.formatTag = GetU16(body);
+                wav.channels = GetU16(body + 2);
+                wav.sampleRate = GetU32(body + 4);
+                wav.byteRate = GetU32(body + 8);
+                wav.blockAlign = GetU16(body + 12);
+                wav.bitsPerSample = GetU16(body + 14);
+            }
+            pos += 8 + size + (size & 1);
+        }
+        return wav;
+    }
+
+    std::wstring TempPath(const char* name)
+    {
+        auto path = std::filesystem::temp_directory_path() / ("record_windows_" + std::string(name) + ".wav");
+        return path.wstring();
+    }
+
+    std::vector<uint8_t> ReadFile(const std::wstring& path)
+    {
+        std::ifstream in(std::filesystem::path(path), std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    uint8_t PatternByte(uint64_t i)
+    {
+        return (uint8_t)(i * 7 + (i >> 13));
+    }
+
+    // Writes size bytes of the test pattern in chunks of chunkBytes.
+    void WritePattern(WavWriter& writer, uint64_t size, size_t chunkBytes)
+    {
+        std::vector<uint8_t> chunk(chunkBytes);
+        uint64_t offset = 0;
+
+        while (offset < size)
+        {
+            size_t n = (size_t)std::min<uint64_t>(chunkBytes, size - offset);
+            for (size_t i = 0; i < n; i++) chunk[i] = PatternByte(offset + i);
+
+            CHECK(writer.Write(chunk.data(), n));
+            offset += n;
+        }
+    }
+
+    bool MatchesPattern(const uint8_t* data, uint64_t size)
+    {
+        for (uint64_t i = 0; i < size; i++)
+        {
+            if (data[i] != PatternByte(i)) return false;
+        }
+        return true;
+    }
+
+    WavFormat StereoFormat()
+    {
+        WavFormat format;
+        format.channels = 2;
+        format.sampleRate = 48000;
+        format.bitsPerSample = 16;
+        return format;
+    }
+
+    // Small buffers and extents, so a few MB cross every boundary.
+    WavWriter::Options SmallOptions()
+    {
+        WavWriter::Options options;
+        options.bufferBytes = 64 << 10;
+        options.bufferCount = 4;
+        options.extentBytes = 1 << 20;
+        return options;
+    }
+
+    void CheckWavFile(const std::wstring& path, const WavFormat& format, uint64_t dataBytes)
+    {
+        std::vector<uint8_t> file = ReadFile(path);
+        CHECK_EQ((uint64_t)WavWriter::kHeaderBytes + dataBytes, (uint64_t)file.size());
+
+        ParsedWav wav = ParseWav(file);
+        CHECK(wav.valid);
+        CHECK(!wav.rf64);
+        CHECK_EQ(file.size() - 8, wav.riffBytes);
+        CHECK_EQ(format.formatTag, wav.formatTag);
+        CHECK_EQ(format.channels, wav.channels);
+        CHECK_EQ(format.sampleRate, wav.sampleRate);
+        CHECK_EQ(format.ByteRate(), wav.byteRate);
+        CHECK_EQ(format.BlockAlign(), wav.blockAlign);
+        CHECK_EQ(format.bitsPerSample, wav.bitsPerSample);
+        CHECK_EQ(WavWriter::kHeaderBytes, wav.dataOffset);
+        CHECK_EQ(dataBytes, wav.dataBytes);
+        CHECK(MatchesPattern(file.data() + wav.dataOffset, dataBytes));
+    }
+
+    void HeaderAndSizeAfterClose()
+    {
+        const std::wstring path = TempPath("header");
+        const WavFormat format = StereoFormat();
+
+        // Empty, inside the first buffer, exactly one buffer and across
+        // buffers and extents
+        const uint64_t sizes[] = { 0, 4, (64 << 10) - WavWriter::kHeaderBytes, 3 * (1 << 20) + 1000 };
+
+        for (uint64_t size : sizes)
+        {
+            WavWriter writer(CreateFileBackend());
+            CHECK(writer.Open(path, format, SmallOptions()));
+            WritePattern(writer, size, 3000);
+            CHECK_EQ(size, writer.DataBytes());
+            CHECK(writer.Close());
+
+            CheckWavFile(path, format, size);
+        }
+
+        std::filesystem::remove(std::filesystem::path(path));
+    }
+
+    void ReopenReplacesTheFile()
+    {
+        const std::wstring path = TempPath("reopen");
+        const WavFormat format = StereoFormat();
+
+        WavWriter writer(CreateFileBackend());
+        CHECK(writer.Open(path, format, SmallOptions()));
+        WritePattern(writer, 2 << 20, 4096);
+        CHECK(writer.Close());
+
+        // Same writer, shorter recording: no leftovers past the new end
+        CHECK(writer.Open(path, format, SmallOptions()));
+        WritePattern(writer, 100000, 4096);
+        CHECK(writer.Close());
+
+        CheckWavFile(path, format, 100000);
+        std::filesystem::remove(std::filesystem::path(path));
+    }
+
+    void HeaderlessIsRawPcm()
+    {
+        const std::wstring path = TempPath("headerless");
+
+        WavWriter::Options options = SmallOptions();
+        options.headerless = true;
+
+        WavWriter writer(CreateFileBackend());
+        CHECK(writer.Open(path, StereoFormat(), options));
+        WritePattern(writer, 300000, 4000);
+        CHECK(writer.Close());
+
+        std::vector<uint8_t> file = ReadFile(path);
+        CHECK_EQ(300000u, file.size());
+        CHECK(MatchesPattern(file.data(), file.size()));
+
+        std::filesystem::remove(std::filesystem::path(path));
+    }
+    // The test target lowers the RF64 threshold (RECORD_WAV_RF64_THRESHOLD),
+    // so the 4 GiB boundary is crossed with a few MB.
+    void Rf64PromotionAtThreshold()
+    {
+        const uint64_t threshold = RECORD_WAV_RF64_THRESHOLD;
+        const uint64_t largestData = (threshold - (WavWriter::kHeaderBytes - 8)) / 4 * 4;
+
+        CHECK(!WavWriter::NeedsRf64(largestData));
+        CHECK(WavWriter::NeedsRf64(largestData + 4));
+
+        const std::wstring path = TempPath("rf64");
+        const WavFormat format = StereoFormat();
+        WavWriter writer(CreateFileBackend());
+
+        // Largest data size that still fits the 32 bits fields
+        CHECK(writer.Open(path, format, SmallOptions()));
+        WritePattern(writer, largestData, 6000);
+        CHECK(writer.Close());
+        CheckWavFile(path, format, largestData);
+
+        // One more sample frame
+        const uint64_t dataBytes = largestData + format.BlockAlign();
+        CHECK(writer.Open(path, format, SmallOptions()));
+        WritePattern(writer, dataBytes, 6000);
+        CHECK(writer.Close());
+
+        std::vector<uint8_t> file = ReadFile(path);
+        CHECK_EQ((uint64_t)WavWriter::kHeaderBytes + dataBytes, (uint64_t)file.size());
+
+        ParsedWav wav = ParseWav(file);
+        CHECK(wav.valid);
+        CHECK(wav.rf64);
+        CHECK_EQ(0xFFFFFFFFu, wav.riffBytes);
+        CHECK_EQ(0xFFFFFFFFu, wav.dataBytes);
+        CHECK_EQ(file.size() - 8, wav.riff64Bytes);
+        CHECK_EQ(dataBytes, wav.data64Bytes);
+        CHECK_EQ(dataBytes / format.BlockAlign(), wav.sampleCount);
+        CHECK_EQ(WavWriter::kHeaderBytes, wav.dataOffset);
+        CHECK(MatchesPattern(file.data() + wav.dataOffset, dataBytes));
+
+        std::filesystem::remove(std::filesystem::path(path));
+    }
+    // A killed process leaves whatever reached the disk. The file is read
+    // while the writer is still open, as a crash at that point would leave
+    // it: the header must describe data that is all there, at most one
+    // checkpoint interval (plus the buffer being filled) behind.
+    void CheckpointLeavesReadableFile()
+    {
+        const std::wstring path = TempPath("checkpoint");
+        const WavFormat format = StereoFormat();
+        const uint64_t interval = 64 << 10;
+        const uint64_t written = (1 << 20) + 1000;
+
+        WavWriter::Options options = SmallOptions();
+        options.bufferBytes = 1 << 20;
+        options.checkpointBytes = interval;
+
+        WavWriter writer(CreateFileBackend());
+        CHECK(writer.Open(path, format, options));
+        WritePattern(writer, written, 3000);
+
+        // The writer thread catches up on its own, no Close()
+        std::vector<uint8_t> snapshot;
+        ParsedWav wav;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        do
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            snapshot = ReadFile(path);
+            wav = ParseWav(snapshot);
+        } while ((!wav.valid || wav.dataBytes + 2 * interval < written) && std::chrono::steady_clock::now() < deadline);
+
+        CHECK(wav.valid);
+        CHECK(!wav.rf64);
+        CHECK(wav.dataBytes + 2 * interval >= written);
+        CHECK(wav.dataBytes <= written);
+        CHECK_EQ(wav.dataBytes + WavWriter::kHeaderBytes - 8, wav.riffBytes);
+        CHECK_EQ(format.sampleRate, wav.sampleRate);
+        CHECK(wav.dataOffset + wav.dataBytes <= snapshot.size());
+        CHECK(MatchesPattern(snapshot.data() + wav.dataOffset, wav.dataBytes));
+
+        CHECK(writer.Close());
+        CheckWavFile(path, format, written);
+
+        std::filesystem::remove(std::filesystem::path(path));
+    }
+}
+
+int main()
+{
+    RUN_TEST(HeaderAndSizeAfterClose);
+    RUN_TEST(ReopenReplacesTheFile);
+    RUN_TEST(HeaderlessIsRawPcm);
+    RUN_TEST(Rf64PromotionAtThreshold);
+    RUN_TEST(CheckpointLeavesReadableFile);
+    return 0;
+}
@@ -0,0 +1,366 @@
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace record_windows
+{
+    static size_t AlignUp(size_t value)
+    {
+        return (value + kIoAlignment - 1) / kIoAlignment * kIoAlignment;
+    }
+
+    static void PutU16(uint8_t* p, uint16_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static void PutU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    static void PutU64(uint8_t* p, uint64_t v)
+    {
+        for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    static constexpr uint32_t kDs64Bytes = 28;
+
+    // Largest RIFF size, the native tests lower it to cross it with a few MB
+#ifndef RECORD_WAV_RF64_THRESHOLD
+#define RECORD_WAV_RF64_THRESHOLD 0xFFFFFFFFull
+#endif
+
+    bool WavWriter::NeedsRf64(uint64_t dataBytes)
+    {
+        return dataBytes + kHeaderBytes - 8 > (uint64_t)RECORD_WAV_RF64_THRESHOLD;
+    }
+
+    void WavWriter::BuildHeader(const WavFormat& format, uint64_t dataBytes, uint8_t* out)
+    {
+        const uint64_t riffBytes = dataBytes + kHeaderBytes - 8;
+        const bool rf64 = NeedsRf64(dataBytes);
+
+        // EBU Tech 3306: with RF64 the 32 bits sizes are -1, real ones are in ds64
+        std::memcpy(out, rf64 ? "RF64" : "RIFF", 4);
+        PutU32(out + 4, rf64 ? 0xFFFFFFFFu : (uint32_t)riffBytes);
+        std::memcpy(out + 8, "WAVE", 4);
+
+        std::memcpy(out + 12, rf64 ? "ds64" : "JUNK", 4);
+        PutU32(out + 16, kDs64Bytes);
+        std::memset(out + 20, 0, kDs64Bytes);
+        if (rf64)
+        {
+            uint16_t blockAlign = format.BlockAlign();
+
+            PutU64(out + 20, riffBytes);
+            PutU64(out + 28, dataBytes);
+            PutU64(out + 36, blockAlign ? dataBytes / blockAlign : 0);
+            PutU32(out + 44, 0); // no table
+        }
+
+        std::memcpy(out + 48, "fmt ", 4);
+        PutU32(out + 52, 16);
+        PutU16(out + 56, format.formatTag);
+        PutU16(out + 58, format.channels);
+        PutU32(out + 60, format.sampleRate);
+        PutU32(out + 64, format.ByteRate());
+        PutU16(out + 68, format.BlockAlign());
+        PutU16(out + 70, format.bitsPerSample);
+
+        std::memcpy(out + 72, "data", 4);
+        PutU32(out + 76, rf64 ? 0xFFFFFFFFu : (uint32_t)dataBytes);
+    }
+
+    WavWriter::WavWriter(std::unique_ptr<FileBackend> backend)
+        : m_backend(std::move(backend))
+    {
+    }
+
+    WavWriter::~WavWriter()
+    {
+        Close();
+    }
+
+    bool WavWriter::Open(const std::wstring& path, const WavFormat& format)
+    {
+        return Open(path, format, Options());
+    }
+
+    bool WavWriter::Open(const std::wstring& path, const WavFormat& format, const Options& options)
+    {
+        Close();
+
+        m_format = format;
+        m_options = options;
+        m_options.bufferBytes = AlignUp(std::max(options.bufferBytes, kIoAlignment));
+        m_options.bufferCount = std::max<size_t>(options.bufferCount, 2);
+
+        m_checkpointInterval = 0;
+        if (!m_options.headerless)
+        {
+            uint64_t byBytes = options.checkpointBytes;
+            uint64_t byTime = (uint64_t)options.checkpointMs * format.ByteRate() / 1000;
+
+            if (byBytes > 0 && byTime > 0) m_checkpointInterval = std::min(byBytes, byTime);
+            else m_checkpointInterval = std::max(byBytes, byTime);
+        }
+        if (m_checkpointInterval > 0)
+        {
+            size_t interval = (size_t)std::min<uint64_t>(m_checkpointInterval, m_options.bufferBytes);
+            m_options.bufferBytes = std::max(interval / kIoAlignment * kIoAlignment, kIoAlignment);
+        }
+
+        if (!m_backend->Open(path, m_options.reuseFile))
+        {
+            m_lastError = m_backend->LastError();
+            return false;
+        }
+
+        // Buffers are kept across recordings when the size doesn't change
+        if (m_buffers.size() != m_options.bufferCount || m_buffers[0].Size() != m_options.bufferBytes)
+        {
+            m_buffers.clear();
+            for (size_t i = 0; i < m_options.bufferCount; i++)
+            {
+                m_buffers.emplace_back(m_options.bufferBytes);
+            }
+        }
+        if (!m_firstBlock.Data()) m_firstBlock = AlignedBuffer(kIoAlignment);
+        std::memset(m_firstBlock.Data(), 0, kIoAlignment);
+
+        m_free.clear();
+        for (size_t i = 0; i < m_buffers.size(); i++) m_free.push_back(i);
+        m_jobs.assign(m_buffers.size(), Job{});
+        m_jobHead = 0;
+        m_jobCount = 0;
+        m_stopping = false;
+        m_failed = false;
+        m_lastError = 0;
+        m_reserved = 0;
+        m_lastCheckpoint = 0;
+
+        m_current = -1;
+        m_currentUsed = 0;
+        m_fileOffset = 0;
+        m_dataBytes = 0;
+        m_open = true;
+
+        m_thread = std::thread(&WavWriter::Run, this);
+
+        // Header placeholder, patched on close
+        if (!m_options.headerless)
+        {
+            uint8_t header[kHeaderBytes];
+            BuildHeader(m_format, 0, header);
+
+            if (!AcquireBuffer()) return false;
+            std::memcpy(m_buffers[(size_t)m_current].Data(), header, kHeaderBytes);
+            m_currentUsed = kHeaderBytes;
+        }
+
+        return true;
+    }
+
+    bool WavWriter::Write(const uint8_t* data, size_t size)
+    {
+        if (!m_open) return false;
+
+        while (size > 0)
+        {
+            if (m_current < 0 && !AcquireBuffer())
+            {
+                return false;
+            }
+
+            size_t n = std::min(size, m_options.bufferBytes - m_currentUsed);
+            std::memcpy(m_buffers[(size_t)m_current].Data() + m_currentUsed, data, n);
+
+            m_currentUsed += n;
+            m_dataBytes += n;
+            data += n;
+            size -= n;
+
+            if (m_currentUsed == m_options.bufferBytes)
+            {
+                Submit(m_currentUsed);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_failed;
+    }
+
+    bool WavWriter::Close()
+    {
+        if (!m_open) return true;
+
+        if (m_current >= 0)
+        {
+            if (m_currentUsed > 0)
+            {
+                Submit(m_currentUsed);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free.push_back((size_t)m_current);
+                m_current = -1;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobReady.notify_one();
+        m_thread.join();
+
+        bool ok = !m_failed;
+        uint64_t fileSize = (m_options.headerless ? 0 : kHeaderBytes) + m_dataBytes;
+
+        if (ok && !m_options.headerless)
+        {
+            BuildHeader(m_format, m_dataBytes, m_firstBlock.Data());
+            ok = m_backend->WriteAt(0, m_firstBlock.Data(), kIoAlignment);
+        }
+        if (ok)
+        {
+            // Drops the padding of the last block and the reserved space
+            ok = m_backend->Truncate(fileSize);
+        }
+        if (!ok && m_lastError == 0)
+        {
+            m_lastError = m_backend->LastError();
+        }
+
+        m_backend->Close();
+        m_open = false;
+
+        return ok;
+    }
+
+    int WavWriter::LastError() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lastError;
+    }
+
+    bool WavWriter::AcquireBuffer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_bufferFree.wait(lock, [this] { return !m_free.empty() || m_failed; });
+
+        if (m_failed) return false;
+
+        m_current = (int64_t)m_free.back();
+        m_free.pop_back();
+        m_currentUsed = 0;
+        return true;
+    }
+
+    void WavWriter::Submit(size_t used)
+    {
+        size_t index = (size_t)m_current;
+        size_t padded = AlignUp(used);
+
+        // Unbuffered writes need whole blocks, the padding is cut on close
+        std::memset(m_buffers[index].Data() + used, 0, padded - used);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs[(m_jobHead + m_jobCount) % m_jobs.size()] = { index, used, padded, m_fileOffset };
+            m_jobCount++;
+        }
+        m_jobReady.notify_one();
+
+        m_fileOffset += used;
+        m_current = -1;
+        m_currentUsed = 0;
+    }
+
+    void WavWriter::Fail(int error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_failed)
+            {
+                m_failed = true;
+                m_lastError = error;
+            }
+        }
+        m_bufferFree.notify_all();
+    }
+
+    // Writer thread. Patches the header sizes for the data already on disk.
+    bool WavWriter::Checkpoint(uint64_t fileBytes)
+    {
+        uint8_t* header = m_firstBlock.Data();
+        BuildHeader(m_format, fileBytes - kHeaderBytes, header);
+        m_lastCheckpoint = fileBytes;
+
+        // Unbuffered handles can only write whole blocks
+        return m_backend->Unbuffered()
+            ? m_backend->WriteAt(0, header, kIoAlignment)
+            : m_backend->WriteAt(0, header, kHeaderBytes);
+    }
+
+    // Writer thread
+    void WavWriter::Run()
+    {
+        for (;;)
+        {
+            Job job;
+            bool ok;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobReady.wait(lock, [this] { return m_jobCount > 0 || m_stopping; });
+
+                if (m_jobCount == 0) return;
+
+                job = m_jobs[m_jobHead];
+                m_jobHead = (m_jobHead + 1) % m_jobs.size();
+                m_jobCount--;
+                // Once failed, buffers are only recycled
+                ok = !m_failed;
+            }
+
+            const uint8_t* data = m_buffers[job.buffer].Data();
+
+            if (ok && m_options.extentBytes > 0 && job.offset + job.size > m_reserved)
+            {
+                while (m_reserved < job.offset + job.size) m_reserved += m_options.extentBytes;
+                ok = m_backend->Reserve(m_reserved);
+            }
+            if (ok)
+            {
+                ok = m_backend->WriteAt(job.offset, data, job.size);
+            }
+            if (ok && job.offset == 0)
+            {
+                std::memcpy(m_firstBlock.Data(), data, kIoAlignment);
+            }
+            if (ok && m_checkpointInterval > 0)
+            {
+                uint64_t fileBytes = job.offset + job.used;
+                // Buffers are aligned down to the interval, allow for the rounding
+                if (fileBytes - m_lastCheckpoint + kIoAlignment > m_checkpointInterval)
+                {
+                    ok = Checkpoint(fileBytes);
+                }
+            }
+            if (!ok)
+            {
+                Fail(m_backend->LastError());
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free.push_back(job.buffer);
+            }
+            m_bufferFree.notify_one();
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_backend.h"
+
+namespace record_windows
+{
+    struct WavFormat
+    {
+        uint16_t formatTag = 1;         // WAVE_FORMAT_PCM
+        uint16_t channels = 2;
+        uint32_t sampleRate = 44100;
+        uint16_t bitsPerSample = 16;
+
+        uint16_t BlockAlign() const { return (uint16_t)(channels * (bitsPerSample / 8)); }
+        uint32_t ByteRate() const { return sampleRate * BlockAlign(); }
+    };
+
+    // Streaming WAV (or headerless PCM) file writer.
+    //
+    // Samples are copied into large aligned buffers, full buffers are written
+    // by a dedicated thread at their final offset, so the producer only pays
+    // a memcpy. Disk space is reserved ahead in extents. On close the tail
+    // is written, the RIFF header is patched through the same handle and
+    // the file is cut to its exact size.
+    //
+    // The header reserves a JUNK chunk large enough for a ds64 chunk, files
+    // whose sizes don't fit in 32 bits are promoted to RF64 in place.
+    //
+    // With checkpoints enabled, the header sizes are also rewritten in place
+    // as data reaches the disk, so a killed process leaves a readable file
+    // missing at most one interval.
+    //
+    // Write() must be called from one thread at a time. It blocks only when
+    // every buffer is waiting for the disk.
+    class WavWriter
+    {
+    public:
+        struct Options
+        {
+            size_t bufferBytes = 1 << 20;       // rounded up to kIoAlignment
+            size_t bufferCount = 4;
+            uint64_t extentBytes = 16 << 20;    // preallocation step, 0 disables it
+            bool headerless = false;            // raw PCM, no RIFF header
+            // Header checkpoint interval, in audio duration and/or bytes.
+            // Buffers are shrunk to the interval so data is written as often.
+            uint32_t checkpointMs = 0;
+            uint64_t checkpointBytes = 0;
+            // Overwrites an existing file in place instead of recreating it,
+            // its disk allocation is reused (rolling files of a fixed size).
+            bool reuseFile = false;
+        };
+
+        // RIFF (12) + JUNK/ds64 (8 + 28) + fmt (8 + 16) + data header (8)
+        static constexpr size_t kHeaderBytes = 80;
+
+        explicit WavWriter(std::unique_ptr<FileBackend> backend);
+        ~WavWriter();
+
+        WavWriter(const WavWriter&) = delete;
+        WavWriter& operator=(const WavWriter&) = delete;
+
+        bool Open(const std::wstring& path, const WavFormat& format);
+        bool Open(const std::wstring& path, const WavFormat& format, const Options& options);
+
+        bool Write(const uint8_t* data, size_t size);
+
+        // Flushes, patches the header and closes the file. Returns false if
+        // any write failed since Open().
+        bool Close();
+
+        bool IsOpen() const { return m_open; }
+        uint64_t DataBytes() const { return m_dataBytes; }
+
+        // Platform error code of the first failure.
+        int LastError() const;
+
+        // kHeaderBytes header for the given data size, RIFF when it fits in
+        // 32 bits sizes, RF64 otherwise.
+        static void BuildHeader(const WavFormat& format, uint64_t dataBytes, uint8_t* out);
+
+        static bool NeedsRf64(uint64_t dataBytes);
+
+    private:
+        struct Job
+        {
+            size_t buffer;
+            size_t used;
+            size_t size;        // padded to kIoAlignment
+            uint64_t offset;
+        };
+
+        void Run();
+        bool AcquireBuffer();
+        void Submit(size_t used);
+        void Fail(int error);
+        bool Checkpoint(uint64_t fileBytes);
+
+        std::unique_ptr<FileBackend> m_backend;
+        WavFormat m_format;
+        Options m_options;
+        bool m_open = false;
+
+        // Producer side
+        int64_t m_current = -1;         // buffer being filled
+        size_t m_currentUsed = 0;
+        uint64_t m_fileOffset = 0;      // file offset of the current buffer
+        uint64_t m_dataBytes = 0;
+
+        std::vector<AlignedBuffer> m_buffers;
+        AlignedBuffer m_firstBlock;     // copy of the first kIoAlignment bytes, to patch the header
+
+        // Shared with the writer thread
+        mutable std::mutex m_mutex;
+        std::condition_variable m_jobReady;
+        std::condition_variable m_bufferFree;
+        std::vector<size_t> m_free;
+        std::vector<Job> m_jobs;        // FIFO, at most bufferCount entries
+        size_t m_jobHead = 0;
+        size_t m_jobCount = 0;
+        bool m_stopping = false;
+        bool m_failed = false;
+        int m_lastError = 0;
+
+        // Writer thread only
+        uint64_t m_reserved = 0;
+        uint64_t m_checkpointInterval = 0;  // bytes, 0 when disabled
+        uint64_t m_lastCheckpoint = 0;
+
+        std::thread m_thread;
+    };
+}
@@ -0,0 +1,275 @@
+#include "waveform_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace record_windows
+{
+    // Sidecar layout, little endian:
+    //   0  char[4]  "RWPK"
+    //   4  uint16   version (1)
+    //   6  uint16   level count (L)
+    //   8  uint32   sample rate
+    //   12 uint16   channels
+    //   14 uint16   reserved
+    //   16 uint64   frames
+    //   24 L x { uint32 frames per bucket, uint32 bucket count, uint64 first bucket index }
+    //   then for each level, bucket count x { int16 min, int16 max }, oldest first
+    static const char kSidecarMagic[4] = { 'R', 'W', 'P', 'K' };
+    static constexpr uint16_t kSidecarVersion = 1;
+
+    WaveformPyramid::WaveformPyramid(size_t capacity)
+        : m_capacity(std::max<size_t>(capacity, 1))
+    {
+    }
+
+    uint64_t WaveformPyramid::FramesPerBucket(int level)
+    {
+        uint64_t frames = kBaseFrames;
+        for (int i = 0; i < level; i++) frames *= kFactor;
+        return frames;
+    }
+
+    void WaveformPyramid::Merge(Peak& into, const Peak& from)
+    {
+        if (from.min < into.min) into.min = from.min;
+        if (from.max > into.max) into.max = from.max;
+    }
+
+    void WaveformPyramid::Reset(int sampleRate, int numChannels)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_sampleRate = sampleRate;
+        m_numChannels = std::max(numChannels, 1);
+        m_current = { INT16_MAX, INT16_MIN };
+        m_currentFrames = 0;
+        m_frames = 0;
+
+        for (auto& level : m_levels)
+        {
+            // Allocated once, kept for the next recordings
+            if (level.ring.size() != m_capacity) level.ring.assign(m_capacity, Peak{ 0, 0 });
+            level.count = 0;
+            level.pending = { INT16_MAX, INT16_MIN };
+            level.pendingCount = 0;
+        }
+    }
+
+    void WaveformPyramid::Process(const int16_t* interleaved, size_t frames)
+    {
+        const size_t channels = (size_t)m_numChannels;
+
+        while (frames > 0)
+        {
+            size_t n = std::min<size_t>(frames, kBaseFrames - m_currentFrames);
+            const int16_t* samples = interleaved;
+            const size_t count = n * channels;
+
+            int16_t lo = m_current.min;
+            int16_t hi = m_current.max;
+            for (size_t i = 0; i < count; i++)
+            {
+                lo = std::min(lo, samples[i]);
+                hi = std::max(hi, samples[i]);
+            }
+            m_current = { lo, hi };
+
+            m_currentFrames += (uint32_t)n;
+            interleaved += count;
+            frames -= n;
+
+            if (m_currentFrames == kBaseFrames)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                PushBucket(0, m_current);
+                m_frames += kBaseFrames;
+
+                m_current = { INT16_MAX, INT16_MIN };
+                m_currentFrames = 0;
+            }
+        }
+    }
+
+    void WaveformPyramid::Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_currentFrames > 0)
+        {
+            PushBucket(0, m_current);
+            m_frames += m_currentFrames;
+
+            m_current = { INT16_MAX, INT16_MIN };
+            m_currentFrames = 0;
+        }
+
+        for (int i = 1; i < kLevels; i++)
+        {
+            Level& level = m_levels[i];
+            if (level.pendingCount > 0)
+            {
+                Peak pending = level.pending;
+                level.pending = { INT16_MAX, INT16_MIN };
+                level.pendingCount = 0;
+                PushBucket(i, pending);
+            }
+        }
+    }
+
+    void WaveformPyramid::PushBucket(int index, const Peak& peak)
+    {
+        Level& level = m_levels[index];
+        level.ring[level.count % m_capacity] = peak;
+        level.count++;
+
+        if (index + 1 < kLevels)
+        {
+            Level& parent = m_levels[index + 1];
+            Merge(parent.pending, peak);
+
+            if (++parent.pendingCount == kFactor)
+            {
+                Peak pending = parent.pending;
+                parent.pending = { INT16_MAX, INT16_MIN };
+                parent.pendingCount = 0;
+                PushBucket(index + 1, pending);
+            }
+        }
+    }
+
+    uint64_t WaveformPyramid::FirstBucket(const Level& level) const
+    {
+        return level.count > m_capacity ? level.count - m_capacity : 0;
+    }
+
+    void WaveformPyramid::Accumulate(int index, uint64_t start, uint64_t end, Peak& out, bool& found) const
+    {
+        const Level& level = m_levels[index];
+        const uint64_t framesPerBucket = FramesPerBucket(index);
+        const uint64_t levelStart = FirstBucket(level) * framesPerBucket;
+        const uint64_t levelEnd = level.count * framesPerBucket;
+
+        uint64_t a = std::max(start, levelStart);
+        uint64_t b = std::min(end, levelEnd);
+
+        for (uint64_t bucket = a / framesPerBucket; a < b && bucket * framesPerBucket < b; bucket++)
+        {
+            Merge(out, level.ring[bucket % m_capacity]);
+            found = true;
+        }
+
+        // Most recent frames are not merged in this level yet
+        if (end > levelEnd && index > 0)
+        {
+            Accumulate(index - 1, std::max(start, levelEnd), end, out, found);
+        }
+    }
+
+    std::vector<float> WaveformPyramid::Query(double seconds, int pixels) const
+    {
+        std::vector<float> result;
+        if (pixels <= 0 || seconds <= 0.0) return result;
+
+        result.assign((size_t)pixels * 2, 0.0f);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_sampleRate <= 0) return result;
+
+        const uint64_t end = m_levels[0].count * kBaseFrames;
+        const double wanted = std::max(seconds * m_sampleRate, 1.0);
+        const double framesPerPixel = wanted / pixels;
+        const double origin = (double)end - wanted;
+
+        // Coarsest level still finer than a pixel, going coarser when it
+        // doesn't reach back far enough.
+        int index = 0;
+        while (index + 1 < kLevels && (double)FramesPerBucket(index + 1) <= framesPerPixel) index++;
+        while (index + 1 < kLevels && origin < (double)(FirstBucket(m_levels[index]) * FramesPerBucket(index))) index++;
+
+        for (int p = 0; p < pixels; p++)
+        {
+            double from = origin + p * framesPerPixel;
+            double to = from + framesPerPixel;
+            if (to <= 0.0) continue;
+
+            uint64_t start = from <= 0.0 ? 0 : (uint64_t)from;
+            uint64_t stop = std::max((uint64_t)std::ceil(to), start + 1);
+
+            Peak peak{ INT16_MAX, INT16_MIN };
+            bool found = false;
+            Accumulate(index, start, stop, peak, found);
+
+            if (found)
+            {
+                result[2 * p] = peak.min / 32768.0f;
+                result[2 * p + 1] = peak.max / 32768.0f;
+            }
+        }
+
+        return result;
+    }
+
+    uint64_t WaveformPyramid::Frames() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_frames;
+    }
+
+    bool WaveformPyramid::WriteSidecar(const std::wstring& path) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::ofstream out(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        auto put = [&out](const void* data, size_t size) {
+            out.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+        };
+
+        uint16_t version = kSidecarVersion;
+        uint16_t levelCount = kLevels;
+        uint32_t sampleRate = (uint32_t)m_sampleRate;
+        uint16_t channels = (uint16_t)m_numChannels;
+        uint16_t reserved = 0;
+
+        put(kSidecarMagic, sizeof(kSidecarMagic));
+        put(&version, sizeof(version));
+        put(&levelCount, sizeof(levelCount));
+        put(&sampleRate, sizeof(sampleRate));
+        put(&channels, sizeof(channels));
+        put(&reserved, sizeof(reserved));
+        put(&m_frames, sizeof(m_frames));
+
+        for (int i = 0; i < kLevels; i++)
+        {
+            const Level& level = m_levels[i];
+            uint32_t framesPerBucket = (uint32_t)FramesPerBucket(i);
+            uint32_t bucketCount = (uint32_t)(level.count - FirstBucket(level));
+            uint64_t firstBucket = FirstBucket(level);
+
+            put(&framesPerBucket, sizeof(framesPerBucket));
+            put(&bucketCount, sizeof(bucketCount));
+            put(&firstBucket, sizeof(firstBucket));
+        }
+
+        for (const Level& level : m_levels)
+        {
+            uint64_t first = FirstBucket(level);
+            size_t begin = (size_t)(first % m_capacity);
+            size_t count = (size_t)(level.count - first);
+
+            // Ring may wrap, write both parts
+            size_t head = std::min(count, m_capacity - begin);
+            put(level.ring.data() + begin, head * sizeof(Peak));
+            put(level.ring.data(), (count - head) * sizeof(Peak));
+        }
+
+        out.flush();
+        return out.good();
+    }
+}
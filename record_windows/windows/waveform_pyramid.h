@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace record_windows
+{
+    // Multi resolution min/max overview of the recorded signal.
+    //
+    // Level 0 holds one min/max pair per kBaseFrames frames (all channels
+    // mixed), each following level merges kFactor buckets of the previous
+    // one. Every level is a ring of the same capacity, so fine levels keep
+    // the last minutes while coarse levels cover the whole recording.
+    //
+    // Process() and Flush() must be called from a single thread, Query() and
+    // WriteSidecar() may be called from any thread.
+    class WaveformPyramid
+    {
+    public:
+        static constexpr uint32_t kBaseFrames = 256;
+        static constexpr uint32_t kFactor = 4;
+        static constexpr int kLevels = 5;
+        static constexpr size_t kDefaultCapacity = 65536;   // buckets per level
+
+        struct Peak
+        {
+            int16_t min;
+            int16_t max;
+        };
+
+        explicit WaveformPyramid(size_t capacity = kDefaultCapacity);
+
+        WaveformPyramid(const WaveformPyramid&) = delete;
+        WaveformPyramid& operator=(const WaveformPyramid&) = delete;
+
+        void Reset(int sampleRate, int numChannels);
+
+        void Process(const int16_t* interleaved, size_t frames);
+
+        // Closes the pending partial buckets (end of recording).
+        void Flush();
+
+        // Overview of the last seconds, as `pixels` (min, max) pairs
+        // normalized to [-1, 1], oldest first. Time before the start of the
+        // recording is reported as silence.
+        std::vector<float> Query(double seconds, int pixels) const;
+
+        // Writes the retained levels to a sidecar file, see waveform_pyramid.cpp
+        // for the layout. Returns false on I/O error.
+        bool WriteSidecar(const std::wstring& path) const;
+
+        uint64_t Frames() const;
+
+        static uint64_t FramesPerBucket(int level);
+
+    private:
+        struct Level
+        {
+            std::vector<Peak> ring;
+            uint64_t count = 0;         // buckets produced since reset
+            Peak pending{ INT16_MAX, INT16_MIN };
+            uint32_t pendingCount = 0;  // buckets of the finer level merged in pending
+        };
+
+        static void Merge(Peak& into, const Peak& from);
+
+        // Lock held.
+        void PushBucket(int level, const Peak& peak);
+        uint64_t FirstBucket(const Level& level) const;
+        void Accumulate(int level, uint64_t start, uint64_t end, Peak& out, bool& found) const;
+
+        const size_t m_capacity;
+        int m_sampleRate = 0;
+        int m_numChannels = 0;
+
+        // Current base bucket, pipeline thread only.
+        Peak m_current{ INT16_MAX, INT16_MIN };
+        uint32_t m_currentFrames = 0;
+
+        mutable std::mutex m_mutex;
+        Level m_levels[kLevels];
+        uint64_t m_frames = 0;
+    };
+}